@@ -1,6 +1,7 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include "main.h"
 #include "camera.h"
 #include "lcd.h"
@@ -11,6 +12,34 @@
 #include "ov5640.h"
 
 Camera_HandleTypeDef hcamera;
+
+// Register programming layer. Writes are checked against the last value
+// written and queued; the queue drains through interrupt-driven I2C while the
+// driver carries on. On sensors that auto-increment the register address,
+// a write to the register after the previous one extends that transfer.
+typedef struct
+{
+	uint16_t key;		// page/register the entry belongs to
+	uint8_t val;
+	uint8_t valid;
+} Camera_RegCacheEntry;
+
+typedef struct
+{
+	uint16_t key;		// cache key of the first register of this run
+	uint16_t next;		// register the next byte of this run would land on
+	uint8_t len;		// address + data bytes in buf
+	uint8_t buf[2 + CAMERA_REG_BURST_MAX];
+} Camera_RegXfer;
+
+static Camera_RegCacheEntry reg_cache[CAMERA_REG_CACHE_SIZE];
+static Camera_RegXfer reg_queue[CAMERA_REG_QUEUE_LEN];
+static Camera_HandleTypeDef *reg_dev;		// device the queue belongs to
+static volatile uint8_t reg_head;			// next transfer to send
+static volatile uint8_t reg_tail;			// next free slot
+static volatile uint8_t reg_busy;			// a transfer is on the bus
+static volatile uint8_t reg_error;			// a queued transfer failed
+static Camera_RegStatsTypeDef reg_stats;
 // Resolution table
 //----------------------------------------
 const uint16_t dvp_cam_resolution[][2] = {
@@ -57,6 +86,7 @@ int32_t Camera_WriteReg(Camera_HandleTypeDef *hov, uint8_t regAddr, const uint8_
 	uint8_t tt[2];
 	tt[0] = regAddr;
 	tt[1] = pData[0];
+	Camera_RegFlush(hov);
 	if (HAL_I2C_Master_Transmit(hov->hi2c, hov->addr, tt, 2, hov->timeout) == HAL_OK)
 	{
 		return Camera_OK;
@@ -69,8 +99,10 @@ int32_t Camera_WriteReg(Camera_HandleTypeDef *hov, uint8_t regAddr, const uint8_
 
 int32_t Camera_ReadReg(Camera_HandleTypeDef *hov, uint8_t regAddr, uint8_t *pData)
 {
-	HAL_I2C_Master_Transmit(hov->hi2c, hov->addr, &regAddr, 1, hov->timeout);
-	if (HAL_I2C_Master_Receive(hov->hi2c, hov->addr, pData, 1, hov->timeout) == HAL_OK)
+	Camera_RegFlush(hov);
+	// Without the address the read would return some other register
+	if (HAL_I2C_Master_Transmit(hov->hi2c, hov->addr, &regAddr, 1, hov->timeout) == HAL_OK &&
+		HAL_I2C_Master_Receive(hov->hi2c, hov->addr, pData, 1, hov->timeout) == HAL_OK)
 	{
 		return Camera_OK;
 	}
@@ -82,6 +114,7 @@ int32_t Camera_ReadReg(Camera_HandleTypeDef *hov, uint8_t regAddr, uint8_t *pDat
 
 int32_t Camera_WriteRegb2(Camera_HandleTypeDef *hov, uint16_t reg_addr, uint8_t reg_data)
 {
+	Camera_RegFlush(hov);
 	if (HAL_I2C_Mem_Write(hov->hi2c, hov->addr, reg_addr,
 						  I2C_MEMADD_SIZE_16BIT, &reg_data, 1, hov->timeout) == HAL_OK)
 	{
@@ -95,6 +128,7 @@ int32_t Camera_WriteRegb2(Camera_HandleTypeDef *hov, uint16_t reg_addr, uint8_t
 
 int32_t Camera_ReadRegb2(Camera_HandleTypeDef *hov, uint16_t reg_addr, uint8_t *reg_data)
 {
+	Camera_RegFlush(hov);
 	if (HAL_I2C_Mem_Read(hov->hi2c, hov->addr, reg_addr,
 						 I2C_MEMADD_SIZE_16BIT, reg_data, 1, hov->timeout) == HAL_OK)
 	{
@@ -111,14 +145,10 @@ int32_t Camera_WriteRegList(Camera_HandleTypeDef *hov, const struct regval_t *re
 	const struct regval_t *pReg = reg_list;
 	while (pReg->reg_addr != 0xFF && pReg->value != 0xFF)
 	{
-		int write_result = Camera_WriteReg(hov, pReg->reg_addr, &(pReg->value));
-		if (write_result != Camera_OK)
-		{
-			return write_result;
-		}
+		Camera_RegWrite(hov, pReg->reg_addr, pReg->value, CAMERA_REG_CACHED);
 		pReg++;
 	}
-	return Camera_OK;
+	return Camera_RegFlush(hov);
 }
 
 int32_t Camera_read_id(Camera_HandleTypeDef *hov)
@@ -247,6 +277,7 @@ void Camera_Init_Device(I2C_HandleTypeDef *hi2c, framesize_t framesize)
         // Setup XCLK using TIM1 PWM mode
         //Camera_XCLK_Set(RCC_MCO1);
         ov2640_init(framesize);
+        Camera_RegFlush(&hcamera);
     }
     else
     {
@@ -269,6 +300,7 @@ void Camera_Picture_Device(I2C_HandleTypeDef *hi2c)
         // Setup XCLK using TIM1 PWM mode
       //  Camera_XCLK_Set(RCC_MCO1);
         ov2640_init_pic();
+        Camera_RegFlush(&hcamera);
     }
     else
     {
@@ -277,3 +309,356 @@ void Camera_Picture_Device(I2C_HandleTypeDef *hi2c)
     }
 
 }
+
+void Camera_Burst_Device(I2C_HandleTypeDef *hi2c, framesize_t framesize, int qs)
+{
+	hcamera.hi2c = hi2c;
+	hcamera.addr = OV2640_ADDRESS;
+	hcamera.timeout = 100;
+
+    Camera_read_id(&hcamera);
+    if (hcamera.manuf_id == 0x7fa2 && ((hcamera.device_id - 0x2641) <= 2))
+    {
+        ov2640_init_burst(framesize, qs);
+        Camera_RegFlush(&hcamera);
+    }
+    else
+    {
+        hcamera.addr = 0;
+        hcamera.device_id = 0;
+    }
+}
+
+// JPEG at a capture profile's size and QS; a change between profiles
+// while in JPEG writes only the framesize and QS that differ
+void Camera_JPEG_Device(I2C_HandleTypeDef *hi2c, framesize_t framesize, int qs)
+{
+	hcamera.hi2c = hi2c;
+	hcamera.addr = OV2640_ADDRESS;
+	hcamera.timeout = 100;
+
+    Camera_read_id(&hcamera);
+    if (hcamera.manuf_id == 0x7fa2 && ((hcamera.device_id - 0x2641) <= 2))
+    {
+        ov2640_init_jpeg(framesize, qs);
+        Camera_RegFlush(&hcamera);
+    }
+    else
+    {
+        hcamera.addr = 0;
+        hcamera.device_id = 0;
+    }
+}
+
+void Camera_Quality_Device(int qs)
+{
+    if (hcamera.addr == OV2640_ADDRESS && hcamera.pixformat == PIXFORMAT_JPEG)
+    {
+        ov2640_set_quality(qs);
+        Camera_RegFlush(&hcamera);
+    }
+}
+
+// Exposure/white balance control for the auto-exposure loop. Writes are
+// only queued: they reach the sensor behind the running preview.
+int32_t Camera_GetExposure_Device(uint16_t *lines, uint16_t *gain16)
+{
+    if (hcamera.addr != OV2640_ADDRESS)
+    {
+        return camera_ERROR;
+    }
+    ov2640_get_exposure(lines, gain16);
+    return Camera_OK;
+}
+
+void Camera_Exposure_Device(uint16_t lines, uint16_t gain16)
+{
+    if (hcamera.addr == OV2640_ADDRESS)
+    {
+        ov2640_set_manual_exposure(lines, gain16);
+    }
+}
+
+void Camera_WhiteBalance_Device(uint8_t r, uint8_t g, uint8_t b)
+{
+    if (hcamera.addr == OV2640_ADDRESS)
+    {
+        ov2640_set_wb_gains(r, g, b);
+    }
+}
+
+void Camera_AutoExposure_Device(void)
+{
+    if (hcamera.addr == OV2640_ADDRESS)
+    {
+        ov2640_set_auto_exposure();
+    }
+}
+
+void Camera_Standby_Device(uint8_t enable)
+{
+    if (hcamera.addr == OV2640_ADDRESS)
+    {
+        ov2640_set_standby(enable);
+    }
+    Camera_RegFlush(&hcamera);
+}
+
+//----------------------------------------
+// Register programming layer
+
+static uint16_t Camera_RegKey(Camera_HandleTypeDef *hov, uint16_t reg)
+{
+	return hov->reg16 ? reg : (uint16_t)((hov->page << 8) | (reg & 0xFF));
+}
+
+static Camera_RegCacheEntry *Camera_RegEntry(uint16_t key)
+{
+	return &reg_cache[key % CAMERA_REG_CACHE_SIZE];
+}
+
+// The registers of a transfer that did not reach the sensor no longer hold
+// what the cache says: drop them so the next write of the same value goes out
+static void Camera_RegForget(const Camera_RegXfer *x)
+{
+	uint8_t n = x->len - (reg_dev->reg16 ? 2 : 1);
+	Camera_RegCacheEntry *e;
+
+	for (uint8_t i = 0; i < n; i++)
+	{
+		e = Camera_RegEntry(x->key + i);
+		if (e->key == x->key + i)
+		{
+			e->valid = 0;
+		}
+	}
+}
+
+// Start the transfer at the queue head if the bus is idle
+static void Camera_RegKick(void)
+{
+	HAL_StatusTypeDef status;
+	Camera_RegXfer *x;
+
+	while (!reg_busy && reg_head != reg_tail)
+	{
+		x = &reg_queue[reg_head];
+		reg_stats.transactions++;
+#if CAMERA_REG_USE_IT
+		reg_busy = 1;
+		status = HAL_I2C_Master_Transmit_IT(reg_dev->hi2c, reg_dev->addr, x->buf, x->len);
+		if (status == HAL_OK)
+		{
+			return;
+		}
+		reg_busy = 0;
+#else
+		status = HAL_I2C_Master_Transmit(reg_dev->hi2c, reg_dev->addr, x->buf, x->len, reg_dev->timeout);
+#endif
+		if (status != HAL_OK)
+		{
+			Camera_RegForget(x);
+			reg_error = 1;
+		}
+		reg_head = (reg_head + 1) % CAMERA_REG_QUEUE_LEN;
+	}
+}
+
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	if (reg_dev != NULL && hi2c == reg_dev->hi2c && reg_busy)
+	{
+		reg_head = (reg_head + 1) % CAMERA_REG_QUEUE_LEN;
+		reg_busy = 0;
+		Camera_RegKick();
+	}
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+	if (reg_dev != NULL && hi2c == reg_dev->hi2c && reg_busy)
+	{
+		Camera_RegForget(&reg_queue[reg_head]);
+		reg_error = 1;
+		reg_head = (reg_head + 1) % CAMERA_REG_QUEUE_LEN;
+		reg_busy = 0;
+		Camera_RegKick();
+	}
+}
+
+// Queue one register write; extends the newest queued run when possible
+static int32_t Camera_RegQueue(Camera_HandleTypeDef *hov, uint16_t reg, uint8_t val)
+{
+	uint32_t primask;
+	uint8_t last, next;
+	Camera_RegXfer *x;
+
+	if (reg_dev != hov)
+	{
+		Camera_RegFlush(reg_dev);
+		reg_dev = hov;
+	}
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	// The newest transfer can grow while it is still waiting for the bus
+	if (hov->reg_burst && reg_tail != reg_head)
+	{
+		last = (reg_tail + CAMERA_REG_QUEUE_LEN - 1) % CAMERA_REG_QUEUE_LEN;
+		x = &reg_queue[last];
+		if (!(reg_busy && last == reg_head) && x->next == reg &&
+			x->len < sizeof(x->buf))
+		{
+			x->buf[x->len++] = val;
+			x->next++;
+			reg_stats.coalesced++;
+			__set_PRIMASK(primask);
+			return Camera_OK;
+		}
+	}
+	__set_PRIMASK(primask);
+
+	next = (reg_tail + 1) % CAMERA_REG_QUEUE_LEN;
+	if (next == reg_head)
+	{
+		// Queue full: drain it, keeping any error for the caller's flush
+		if (Camera_RegFlush(hov) != Camera_OK)
+		{
+			reg_error = 1;
+		}
+	}
+
+	x = &reg_queue[reg_tail];
+	x->len = 0;
+	if (hov->reg16)
+	{
+		x->buf[x->len++] = (uint8_t)(reg >> 8);
+	}
+	x->buf[x->len++] = (uint8_t)reg;
+	x->buf[x->len++] = val;
+	x->key = Camera_RegKey(hov, reg);
+	x->next = reg + 1;
+
+	// The interrupt only runs while a transfer is in flight, so an idle bus
+	// can be started from here without masking it
+	reg_tail = next;
+	if (!reg_busy)
+	{
+		Camera_RegKick();
+	}
+	return Camera_OK;
+}
+
+int32_t Camera_RegWrite(Camera_HandleTypeDef *hov, uint16_t reg, uint8_t val, uint8_t flags)
+{
+	Camera_RegCacheEntry *e;
+	uint16_t key;
+
+	key = Camera_RegKey(hov, reg);
+	e = Camera_RegEntry(key);
+	if (flags & CAMERA_REG_VOLATILE)
+	{
+		// Forget any stale copy so a later cached write is not skipped
+		if (e->key == key)
+		{
+			e->valid = 0;
+		}
+		return Camera_RegQueue(hov, reg, val);
+	}
+
+	if (e->valid && e->key == key && e->val == val)
+	{
+		reg_stats.skipped++;
+		return Camera_OK;
+	}
+	e->key = key;
+	e->val = val;
+	e->valid = 1;
+	return Camera_RegQueue(hov, reg, val);
+}
+
+int32_t Camera_RegRead(Camera_HandleTypeDef *hov, uint16_t reg, uint8_t *val, uint8_t flags)
+{
+	Camera_RegCacheEntry *e = NULL;
+	uint16_t key = Camera_RegKey(hov, reg);
+	int32_t ret;
+
+	if (!(flags & CAMERA_REG_VOLATILE))
+	{
+		e = Camera_RegEntry(key);
+		if (e->valid && e->key == key)
+		{
+			*val = e->val;
+			return Camera_OK;
+		}
+	}
+
+	// Reads go out in order with the writes queued before them
+	Camera_RegFlush(hov);
+	ret = hov->reg16 ? Camera_ReadRegb2(hov, reg, val) : Camera_ReadReg(hov, (uint8_t)reg, val);
+	if (ret == Camera_OK && e != NULL)
+	{
+		e->key = key;
+		e->val = *val;
+		e->valid = 1;
+	}
+	return ret;
+}
+
+int32_t Camera_RegLookup(Camera_HandleTypeDef *hov, uint16_t reg, uint8_t *val)
+{
+	uint16_t key = Camera_RegKey(hov, reg);
+	Camera_RegCacheEntry *e = Camera_RegEntry(key);
+
+	if (e->valid && e->key == key)
+	{
+		*val = e->val;
+		return Camera_OK;
+	}
+	return camera_ERROR;
+}
+
+int32_t Camera_RegFlush(Camera_HandleTypeDef *hov)
+{
+	uint32_t tickstart = HAL_GetTick();
+	uint8_t error;
+
+	if (hov == NULL || hov != reg_dev)
+	{
+		return Camera_OK;
+	}
+	while (reg_head != reg_tail || reg_busy)
+	{
+		if (HAL_GetTick() - tickstart > hov->timeout)
+		{
+			// Bus stuck: drop what is left, and its cache entries with it
+			HAL_I2C_Master_Abort_IT(hov->hi2c, hov->addr);
+			reg_busy = 0;
+			for (; reg_head != reg_tail; reg_head = (reg_head + 1) % CAMERA_REG_QUEUE_LEN)
+			{
+				Camera_RegForget(&reg_queue[reg_head]);
+			}
+			reg_error = 1;
+			break;
+		}
+	}
+	error = reg_error;
+	reg_error = 0;
+	return error ? camera_ERROR : Camera_OK;
+}
+
+void Camera_RegInvalidate(void)
+{
+	memset(reg_cache, 0, sizeof(reg_cache));
+}
+
+void Camera_RegDelay(uint32_t ms)
+{
+	Camera_RegFlush(reg_dev);
+	HAL_Delay(ms);
+}
+
+void Camera_RegGetStats(Camera_RegStatsTypeDef *stats)
+{
+	*stats = reg_stats;
+}
@@ -13,7 +13,7 @@
 
 #define Camera_OK 0
 #define camera_ERROR 1
-#define Camera_delay HAL_Delay
+#define Camera_delay Camera_RegDelay
 
 
 struct regval_t{
@@ -77,8 +77,28 @@ typedef struct {
 	uint16_t device_id;
 	framesize_t framesize;
 	pixformat_t pixformat;
+	uint8_t quality;	// JPEG QS register (lower is finer), 0 if never set
+	uint8_t reg16;		// 16-bit register addresses (OV5640)
+	uint8_t reg_burst;	// sensor auto-increments the register address on writes
+	uint8_t page;		// register page selected by the driver (OV2640 bank)
 } Camera_HandleTypeDef;
 
+// Register programming layer shared by the sensor drivers
+#define CAMERA_REG_CACHED      0x00
+#define CAMERA_REG_VOLATILE    0x01	// always sent/read on the bus, never cached
+#define CAMERA_REG_CACHE_SIZE  512	// direct-mapped last-written values
+#define CAMERA_REG_QUEUE_LEN   32	// transfers waiting for the bus
+#define CAMERA_REG_BURST_MAX   16	// data bytes per auto-increment burst
+#ifndef CAMERA_REG_USE_IT
+#define CAMERA_REG_USE_IT      1	// 0: blocking I2C, same queueing
+#endif
+
+typedef struct {
+	uint32_t transactions;	// I2C transfers started
+	uint32_t skipped;		// writes dropped because the value was already set
+	uint32_t coalesced;		// writes merged into a previous transfer
+} Camera_RegStatsTypeDef;
+
 extern Camera_HandleTypeDef hcamera;;
 extern const uint16_t dvp_cam_resolution[][2];
 
@@ -87,11 +107,41 @@ int32_t Camera_ReadReg(Camera_HandleTypeDef *hov, uint8_t regAddr, uint8_t *pDat
 int32_t Camera_WriteRegb2(Camera_HandleTypeDef *hov, uint16_t reg_addr, uint8_t reg_data);
 int32_t Camera_ReadRegb2(Camera_HandleTypeDef *hov, uint16_t reg_addr, uint8_t *reg_data);
 int32_t Camera_WriteRegList(Camera_HandleTypeDef *hov, const struct regval_t *reg_list);
+// Queue a register write; unless VOLATILE it is skipped when the cached
+// value already matches. Completion is only guaranteed after Camera_RegFlush.
+int32_t Camera_RegWrite(Camera_HandleTypeDef *hov, uint16_t reg, uint8_t val, uint8_t flags);
+// Read a register, from the cache when known unless VOLATILE
+int32_t Camera_RegRead(Camera_HandleTypeDef *hov, uint16_t reg, uint8_t *val, uint8_t flags);
+// Cached value of a register without touching the bus; camera_ERROR if unknown
+int32_t Camera_RegLookup(Camera_HandleTypeDef *hov, uint16_t reg, uint8_t *val);
+// Wait until all queued writes are on the sensor; camera_ERROR if any failed.
+// Registers of a failed transfer are dropped from the cache, so a retry of
+// the same value goes out on the bus.
+int32_t Camera_RegFlush(Camera_HandleTypeDef *hov);
+// Forget every cached value (after a sensor soft reset)
+void Camera_RegInvalidate(void);
+// Flush queued writes, then wait
+void Camera_RegDelay(uint32_t ms);
+void Camera_RegGetStats(Camera_RegStatsTypeDef *stats);
 int32_t Camera_read_id(Camera_HandleTypeDef *hov);
 void Camera_Reset(Camera_HandleTypeDef *hov);
 void Camera_XCLK_Set(uint8_t xclktype);
 void Camera_Init_Device(I2C_HandleTypeDef *hi2c, framesize_t framesize);
 void Camera_Picture_Device(I2C_HandleTypeDef *hi2c);
+void Camera_Burst_Device(I2C_HandleTypeDef *hi2c, framesize_t framesize, int qs);
+// JPEG at any size and QS (capture profiles)
+void Camera_JPEG_Device(I2C_HandleTypeDef *hi2c, framesize_t framesize, int qs);
+// Change the JPEG quality (QS) of the running JPEG mode
+void Camera_Quality_Device(int qs);
+// Exposure (lines) and AGC gain (16 = 1x) the sensor is running at
+int32_t Camera_GetExposure_Device(uint16_t *lines, uint16_t *gain16);
+// Manual exposure and gain, manual white balance gains (0x40 ~ 1x), or the
+// sensor's own AEC/AGC/AWB back; queued, not flushed
+void Camera_Exposure_Device(uint16_t lines, uint16_t gain16);
+void Camera_WhiteBalance_Device(uint8_t r, uint8_t g, uint8_t b);
+void Camera_AutoExposure_Device(void);
+// Sensor standby on or off, registers kept; flushed before it returns
+void Camera_Standby_Device(uint8_t enable);
 #endif
 
 
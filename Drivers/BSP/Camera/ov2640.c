@@ -1,6 +1,7 @@
 #include "ov2640.h"
 #include "camera.h"
 #include "ov2640_regs.h"
+#include <string.h>
 
 #define OV2640_XCLK_FREQUENCY       (10000000)
 #define OV2640_NUM_ALLOWED_SIZES    (13)
@@ -10,7 +11,7 @@
 #define NUM_EFFECTS                 (9)
 #define REGLENGTH 8
 
-#define ov2640_delay HAL_Delay
+#define ov2640_delay Camera_RegDelay
 
 static const uint8_t allowed_sizes[OV2640_NUM_ALLOWED_SIZES] = {
         FRAMESIZE_CIF,      // 352x288
@@ -409,17 +410,105 @@ const unsigned char OV2640_160x120_JPEG[][2]=
   { 0x52, 0x96 },
 };
 //-----------------------------------------------------
+// Registers go through the shared camera register layer, which skips writes
+// that would not change a register, so replaying a mode's tables only sends
+// the diff. The layer's cache is keyed by bank via hcamera.page.
+#define SHADOW_BIT(bits, reg)      ((bits)[(reg) >> 5] & (1UL << ((reg) & 31)))
+#define SHADOW_SET_BIT(bits, reg)  ((bits)[(reg) >> 5] |= (1UL << ((reg) & 31)))
+
+static int8_t shadow_bank = -1;         // BANK_SEL as last written, -1 unknown
+static uint8_t preview_valid;           // sensor holds the state ov2640_init() set up
+
+// Preview values of the registers a JPEG profile changed. Going back to
+// preview writes these instead of resetting and reloading every table.
+static uint8_t saved_val[2][256];
+static uint32_t saved_known[2][8];
+static uint8_t saved_indirect;          // indirect register groups the profile wrote
+static uint8_t saving;                  // a JPEG profile is active
+static framesize_t saved_framesize;
+
+// Registers that must always reach the sensor: self-clearing resets, DSP
+// bypass, indirect address/data ports and the AEC/AGC results
+static int reg_is_volatile(int bank, uint8_t reg)
+{
+    if (bank == BANK_SEL_DSP) {
+        return reg == R_BYPASS || reg == REG_RESET || reg == BPADDR || reg == BPDATA ||
+               (reg >= 0x90 && reg <= 0x97);
+    }
+    return reg == GAIN || reg == AEC || reg == REG45;
+}
+
+// DSP indirect register group behind an address/data port, 0 if none
+static uint8_t reg_indirect_group(uint8_t reg)
+{
+    switch (reg) {
+        case BPADDR: case BPDATA: return 0x01;
+        case 0x90:   case 0x91:   return 0x02;
+        case 0x92:   case 0x93:   return 0x04;
+        case 0x96:   case 0x97:   return 0x08;
+        default:                  return 0;
+    }
+}
+
+// After a soft reset nothing about the register file is known
+static void shadow_invalidate(void)
+{
+    Camera_RegInvalidate();
+    memset(saved_known, 0, sizeof(saved_known));
+    saved_indirect = 0;
+    saving = 0;
+    preview_valid = 0;
+    shadow_bank = -1;
+}
+
 static uint8_t OV2640_WR_Reg(uint8_t reg, uint8_t data)
 {
-    Camera_WriteReg(&hcamera, reg, &data);
+    int bank = shadow_bank;
+    uint8_t cur;
+
+    if (reg == BANK_SEL) {
+        if (bank != data) {
+            Camera_RegWrite(&hcamera, reg, data, CAMERA_REG_VOLATILE);
+            shadow_bank = (data <= BANK_SEL_SENSOR) ? (int8_t)data : -1;
+            hcamera.page = data;
+        }
+        return 0;
+    }
+
+    // Bank unknown or register not cacheable: always on the bus
+    if (bank < 0 || reg_is_volatile(bank, reg)) {
+        if (saving && bank == BANK_SEL_DSP) {
+            saved_indirect |= reg_indirect_group(reg);
+        }
+        Camera_RegWrite(&hcamera, reg, data, CAMERA_REG_VOLATILE);
+        return 0;
+    }
+
+    // First change under a JPEG profile: remember the preview value
+    if (saving && !SHADOW_BIT(saved_known[bank], reg) &&
+        (Camera_RegLookup(&hcamera, reg, &cur) != Camera_OK || cur != data)) {
+        Camera_RegRead(&hcamera, reg, &saved_val[bank][reg], CAMERA_REG_CACHED);
+        SHADOW_SET_BIT(saved_known[bank], reg);
+    }
+
+    if (bank == BANK_SEL_SENSOR && reg == COM7 && (data & COM7_SRST)) {
+        Camera_RegWrite(&hcamera, reg, data, CAMERA_REG_VOLATILE);
+        shadow_invalidate();
+        return 0;
+    }
+
+    Camera_RegWrite(&hcamera, reg, data, CAMERA_REG_CACHED);
     return 0;
 }
 
 //---------------------------------------
 static uint8_t OV2640_RD_Reg(uint8_t reg)
 {
-	uint8_t data;
-  Camera_ReadReg(&hcamera,reg,&data);
+	uint8_t data = 0;
+    int bank = shadow_bank;
+
+    Camera_RegRead(&hcamera, reg, &data,
+                   (bank < 0 || reg_is_volatile(bank, reg)) ? CAMERA_REG_VOLATILE : CAMERA_REG_CACHED);
     return data;
 }
 
@@ -427,10 +516,69 @@ static uint8_t OV2640_RD_Reg(uint8_t reg)
 static void wrSensorRegs(const uint8_t (*regs)[2])
 {
     for (int i = 0; regs[i][0]; i++) {
-        Camera_WriteReg(&hcamera, regs[i][0], &regs[i][1]);
+        OV2640_WR_Reg(regs[i][0], regs[i][1]);
+    }
+}
+
+//------------------------------------------------------------------------
+// Rewrite the indirect register sequences of the given groups from a table
+static void wrSensorRegsIndirect(const uint8_t (*regs)[2], uint8_t groups)
+{
+    int bank = -1;
+
+    for (int i = 0; regs[i][0]; i++) {
+        if (regs[i][0] == BANK_SEL) {
+            bank = regs[i][1];
+        } else if (bank == BANK_SEL_DSP && (reg_indirect_group(regs[i][0]) & groups)) {
+            OV2640_WR_Reg(BANK_SEL, BANK_SEL_DSP);
+            OV2640_WR_Reg(regs[i][0], regs[i][1]);
+        }
     }
 }
 
+//-----------------------------------------------------------------------
+// Start recording the preview values a JPEG profile is about to overwrite
+static void begin_jpeg_profile(void)
+{
+    // Camera_read_id() selects a bank behind the shadow's back
+    shadow_bank = -1;
+    if (!saving && preview_valid) {
+        saving = 1;
+        saved_framesize = hcamera.framesize;
+    }
+}
+
+//--------------------------------------------------------------------------
+// Back from a JPEG profile to the preview it was entered from: only the
+// registers the profile changed are written, with the DSP held in bypass
+static void restore_preview(void)
+{
+    saving = 0;
+
+    OV2640_WR_Reg(BANK_SEL, BANK_SEL_DSP);
+    OV2640_WR_Reg(R_BYPASS, R_BYPASS_DSP_BYPAS);
+    OV2640_WR_Reg(REG_RESET, REG_RESET_JPEG | REG_RESET_DVP);
+
+    for (int bank = BANK_SEL_SENSOR; bank >= BANK_SEL_DSP; bank--) {
+        OV2640_WR_Reg(BANK_SEL, bank);
+        for (int reg = 0; reg < 256; reg++) {
+            if (SHADOW_BIT(saved_known[bank], reg)) {
+                OV2640_WR_Reg(reg, saved_val[bank][reg]);
+            }
+        }
+    }
+    if (saved_indirect) {
+        wrSensorRegsIndirect(ov2640_Slow_regs, saved_indirect);
+    }
+
+    memset(saved_known, 0, sizeof(saved_known));
+    saved_indirect = 0;
+
+    OV2640_WR_Reg(BANK_SEL, BANK_SEL_DSP);
+    OV2640_WR_Reg(REG_RESET, 0x00);
+    OV2640_WR_Reg(R_BYPASS, R_BYPASS_DSP_EN);
+}
+
 //----------------
 static int reset()
 {
@@ -584,20 +732,17 @@ static void _set_framesize(uint8_t framesize)
             OV2640_WR_Reg(BANK_SEL, BANK_SEL_SENSOR);
             OV2640_WR_Reg(COM8, COM8_SET(COM8_BNDF_EN | COM8_AGC_EN | COM8_AEC_EN));
             OV2640_WR_Reg(BANK_SEL, BANK_SEL_DSP);
+            // The sensor only needs to settle once the whole set is in;
+            // see the delay after _set_framesize()
             wrSensorRegs(OV2640_JPEG_INIT);
-            ov2640_delay(20);
-            // Short delay to settle
             wrSensorRegs(OV2640_YUV422);
             //wrSensorRegs(OV2640_JPEG_INIT);
-            ov2640_delay(20);
           // wrSensorRegs(OV2640_uxga_regs);
            //wrSensorRegs(OV2640_YUV422);
            //wrSensorRegs(OV2640_JPEG);
            wrSensorRegs(OV2640_JPEG);
-            ov2640_delay(20);
             //wrSensorRegs(OV2640_160x120_JPEG);
             wrSensorRegs(OV2640_1280x960_JPEG);
-         ov2640_delay(20);
             // Enable DSP
             OV2640_WR_Reg(BANK_SEL, BANK_SEL_DSP);
             OV2640_WR_Reg(R_BYPASS, R_BYPASS_DSP_EN);
@@ -706,6 +851,7 @@ static int set_quality(int qs)
     OV2640_WR_Reg(BANK_SEL, BANK_SEL_DSP);
     // Write QS register
     OV2640_WR_Reg(QS, qs);
+    hcamera.quality = qs;
 
     return 0;
 }
@@ -828,6 +974,22 @@ static int set_night_mode(int enable)
 //===============================
 int ov2640_init(framesize_t framesize)
 {
+    // Camera_read_id() selects a bank behind the shadow's back
+    shadow_bank = -1;
+    // Already previewing at this size: nothing to do
+    if (preview_valid && !saving && hcamera.framesize == framesize &&
+        hcamera.pixformat == PIXFORMAT_RGB565) {
+        return 0;
+    }
+    // Back from JPEG to the preview it left: undo its register changes
+    if (saving && saved_framesize == framesize) {
+        restore_preview();
+        hcamera.framesize = framesize;
+        hcamera.pixformat = PIXFORMAT_RGB565;
+        ov2640_delay(10);
+        return 0;
+    }
+
 	reset();
 	hcamera.framesize = framesize;
 	hcamera.pixformat = PIXFORMAT_RGB565;
@@ -835,18 +997,138 @@ int ov2640_init(framesize_t framesize)
 	set_pixformat(hcamera.pixformat);
 	set_hmirror(1);
 	set_vflip(1);
+    preview_valid = 1;
   return 0;
 }
 int ov2640_init_pic()
 {
-	//reset();
-	//hcamera.framesize = framesize;
-	hcamera.framesize = FRAMESIZE_UXGA;
+    return ov2640_init_jpeg(FRAMESIZE_UXGA, 2); // highest quality (lowest compression)
+}
+
+// JPEG at a given size and QS. Already in JPEG mode (a profile change, a
+// retake) only the framesize and QS that differ are written; otherwise the
+// full JPEG setup is entered from the current preview.
+int ov2640_init_jpeg(framesize_t framesize, int qs)
+{
+    int ret = 0;
+
+    if (hcamera.pixformat == PIXFORMAT_JPEG) {
+        if (hcamera.framesize != framesize) {
+            ret = set_framesize(framesize);
+        }
+        if (ret == 0 && hcamera.quality != qs) {
+            ret = set_quality(qs);
+        }
+        return ret;
+    }
+
+    begin_jpeg_profile();
+	hcamera.framesize = framesize;
     hcamera.pixformat = PIXFORMAT_JPEG;
     set_pixformat(hcamera.pixformat);
-    set_quality(2); // highest quality (lowest compression)
+    set_quality(qs);
     set_brightness(0);
     set_hmirror(1);
     set_vflip(1);
     return 0;
 }
+
+// JPEG at a reduced size and quality so frames fit the burst queue slots
+int ov2640_init_burst(framesize_t framesize, int qs)
+{
+    return ov2640_init_jpeg(framesize, qs);
+}
+
+// AGC gain register: bits 7..4 each double the gain, bits 3..0 add
+// sixteenths, so gain = 2^n * (1 + frac/16). gain16 is gain * 16.
+static uint8_t gain_to_reg(uint16_t gain16)
+{
+    uint8_t hi = 0;
+
+    while (gain16 >= 32 && hi != 0xF0) {
+        gain16 >>= 1;
+        hi = (uint8_t)((hi << 1) | 0x10);
+    }
+    if (gain16 < 16) gain16 = 16;
+    if (gain16 > 31) gain16 = 31;
+    return hi | (uint8_t)(gain16 - 16);
+}
+
+static uint16_t reg_to_gain(uint8_t reg)
+{
+    uint16_t gain16 = 16 + (reg & 0x0F);
+
+    for (uint8_t bit = 0x10; bit; bit <<= 1) {
+        if (reg & bit) gain16 <<= 1;
+    }
+    return gain16;
+}
+
+// Exposure in lines and AGC gain the sensor is running at
+int ov2640_get_exposure(uint16_t *lines, uint16_t *gain16)
+{
+    OV2640_WR_Reg(BANK_SEL, BANK_SEL_SENSOR);
+    *lines = (uint16_t)((OV2640_RD_Reg(REG45) & 0x3f) << 10) |
+             (uint16_t)(OV2640_RD_Reg(AEC) << 2) |
+             (uint16_t)(OV2640_RD_Reg(REG04) & 0x03);
+    *gain16 = reg_to_gain(OV2640_RD_Reg(GAIN));
+    return 0;
+}
+
+// Manual exposure and gain with the sensor's AEC/AGC off. Unlike
+// set_exposure() the DSP stays enabled, so the running preview does not
+// glitch, and REG04's mirror/flip bits are kept.
+int ov2640_set_manual_exposure(uint16_t lines, uint16_t gain16)
+{
+    uint16_t max_exp = (dvp_cam_resolution[hcamera.framesize][0] <= 800) ? 672 : 1248;
+
+    if (lines == 0) lines = 1;
+    if (lines > max_exp) lines = max_exp;
+
+    OV2640_WR_Reg(BANK_SEL, BANK_SEL_SENSOR);
+    OV2640_WR_Reg(COM8, COM8_SET(COM8_BNDF_EN));
+    OV2640_WR_Reg(REG45, (uint8_t)((lines >> 10) & 0x3f));
+    OV2640_WR_Reg(AEC, (uint8_t)((lines >> 2) & 0xff));
+    OV2640_WR_Reg(REG04, (uint8_t)((OV2640_RD_Reg(REG04) & ~0x03) | (lines & 0x03)));
+    OV2640_WR_Reg(GAIN, gain_to_reg(gain16));
+    return 0;
+}
+
+// Manual white balance: AWB off, R/G/B channel gains (0x40 is about 1x)
+int ov2640_set_wb_gains(uint8_t r, uint8_t g, uint8_t b)
+{
+    OV2640_WR_Reg(BANK_SEL, BANK_SEL_DSP);
+    OV2640_WR_Reg(0xc7, 0x50); // simple AWB, off
+    OV2640_WR_Reg(0xcc, r);
+    OV2640_WR_Reg(0xcd, g);
+    OV2640_WR_Reg(0xce, b);
+    return 0;
+}
+
+// Sensor AEC/AGC and AWB back in charge
+int ov2640_set_auto_exposure(void)
+{
+    OV2640_WR_Reg(BANK_SEL, BANK_SEL_SENSOR);
+    OV2640_WR_Reg(COM8, COM8_SET(COM8_BNDF_EN | COM8_AGC_EN | COM8_AEC_EN));
+    OV2640_WR_Reg(BANK_SEL, BANK_SEL_DSP);
+    OV2640_WR_Reg(0xc7, 0x10); // simple AWB
+    return 0;
+}
+
+// Soft standby (COM2): the sensor stops streaming and drops to standby
+// current but keeps every register, so waking it needs no reload
+int ov2640_set_standby(int enable)
+{
+    uint8_t com2;
+
+    OV2640_WR_Reg(BANK_SEL, BANK_SEL_SENSOR);
+    com2 = OV2640_RD_Reg(COM2);
+    OV2640_WR_Reg(COM2, enable ? (com2 | COM2_STDBY) : (com2 & ~COM2_STDBY));
+    return 0;
+}
+
+// QS only; the sensor stays in whatever JPEG mode it is in
+int ov2640_set_quality(int qs)
+{
+    return set_quality(qs);
+}
@@ -7,6 +7,15 @@
 #define CAMERA_Picture 1
 int ov2640_init(framesize_t framesize);
 int ov2640_init_pic();
+int ov2640_init_jpeg(framesize_t framesize, int qs);
+int ov2640_init_burst(framesize_t framesize, int qs);
+int ov2640_set_quality(int qs);
+int ov2640_check_framesize(uint8_t framesize);
+int ov2640_get_exposure(uint16_t *lines, uint16_t *gain16);
+int ov2640_set_manual_exposure(uint16_t lines, uint16_t gain16);
+int ov2640_set_wb_gains(uint8_t r, uint8_t g, uint8_t b);
+int ov2640_set_auto_exposure(void);
+int ov2640_set_standby(int enable);
 void     CAMERA_Delay(uint32_t delay);
 void ov2640_set_picture_mode(uint8_t action, uint16_t DeviceAddr);
 #endif
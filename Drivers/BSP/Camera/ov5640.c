@@ -34,14 +34,19 @@ static uint16_t readout_h = ACTIVE_SENSOR_HEIGHT;
 
 static uint8_t ov5640_WR_Reg(uint16_t reg, uint8_t data)
 {
-    Camera_WriteRegb2(&hcamera, reg, data);
+    // System control is a command register (reset/power down): never skipped
+    Camera_RegWrite(&hcamera, reg, data,
+                    (reg == SYSTEM_CTROL0) ? CAMERA_REG_VOLATILE : CAMERA_REG_CACHED);
+    if (reg == SYSTEM_CTROL0 && (data & 0x80)) {
+        Camera_RegInvalidate();
+    }
     return 0;
 }
 
 static uint8_t ov5640_RD_Reg(uint16_t reg, uint8_t *data)
 {
 
-    return Camera_ReadRegb2(&hcamera, reg, data);
+    return Camera_RegRead(&hcamera, reg, data, CAMERA_REG_VOLATILE);
 }
 
 static int ov5640_reset(void)
@@ -337,6 +342,9 @@ static int ov5640_set_vflip(int enable)
 
 int ov5640_init(framesize_t framesize)
 {
+    // 16-bit register addresses; sequential writes auto-increment
+    hcamera.reg16 = 1;
+    hcamera.reg_burst = 1;
     ov5640_reset();
     hcamera.framesize = framesize;
     hcamera.pixformat = PIXFORMAT_RGB565;
@@ -344,6 +352,7 @@ int ov5640_init(framesize_t framesize)
     ov5640_set_framesize(hcamera.framesize);
     ov5640_set_hmirror(0);
     ov5640_set_vflip(0);
+    Camera_RegFlush(&hcamera);
 
     return 1;
 }
@@ -3,10 +3,8 @@
 
 int OV7670_WriteReg(uint8_t regAddr, const uint8_t *pData)
 {
-	uint8_t tt[2];
-	tt[0] = regAddr;
-	tt[1] = pData[0];
-	if (HAL_I2C_Master_Transmit(hcamera.hi2c, hcamera.addr,tt,2,hcamera.timeout) == HAL_OK)
+	// Queued through the shared register cache; errors surface on flush
+	if (Camera_RegWrite(&hcamera, regAddr, pData[0], CAMERA_REG_CACHED) == Camera_OK)
 	{
 		return OV7670_OK;
 	}
@@ -18,8 +16,7 @@ int OV7670_WriteReg(uint8_t regAddr, const uint8_t *pData)
 
 int OV7670_ReadReg(uint8_t regAddr, uint8_t *pData)
 {
-	HAL_I2C_Master_Transmit(hcamera.hi2c, hcamera.addr+1,&regAddr,1,hcamera.timeout);
-	if (HAL_I2C_Master_Receive(hcamera.hi2c, hcamera.addr+1,pData,1,hcamera.timeout) == HAL_OK)
+	if (Camera_RegRead(&hcamera, regAddr, pData, CAMERA_REG_VOLATILE) == Camera_OK)
 	{
 		return OV7670_OK;
 	}
@@ -31,13 +28,13 @@ int OV7670_ReadReg(uint8_t regAddr, uint8_t *pData)
 
 int OV7670_Reset(void)
 {
-	HAL_Delay(100);
-	uint8_t data = COM7_RESET;
-	if (OV7670_WriteReg(REG_COM7, &data) != OV7670_OK)
+	Camera_RegDelay(100);
+	if (Camera_RegWrite(&hcamera, REG_COM7, COM7_RESET, CAMERA_REG_VOLATILE) != Camera_OK)
 	{
 		return OV7670_ERROR;
 	}
-	HAL_Delay(100);
+	Camera_RegInvalidate();
+	Camera_RegDelay(100);
 	return OV7670_OK;
 }
 
@@ -53,7 +50,7 @@ int OV7670_WriteRegList(const struct regval_t *reg_list)
 		}
 		pReg++;
 	}
-	return OV7670_OK;
+	return (Camera_RegFlush(&hcamera) == Camera_OK) ? OV7670_OK : OV7670_ERROR;
 }
 
 ////////////////////////////////////////////////////////////////////////////
@@ -278,6 +275,9 @@ void ov7670_Window_Set(uint16_t sx,uint16_t sy,uint16_t width,uint16_t height)
 
 int OV7670_Config(void)
 {
+	hcamera.reg16 = 0;
+	hcamera.reg_burst = 0;	// SCCB: one register per transfer
+	hcamera.page = 0;
 	int ov_reset_result = OV7670_Reset();
 	if (ov_reset_result != OV7670_OK)
 	{
@@ -339,7 +339,7 @@ int OV7670_Config(void)
 		return ov_write_reg_result;
 	}
 	
-	HAL_Delay(100);
+	Camera_RegDelay(100);
 	
 //	OV7670_Light_Mode(4);
 //	OV7670_Color_Saturation(2);
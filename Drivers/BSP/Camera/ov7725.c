@@ -4,13 +4,18 @@
 
 static uint8_t ov7725_WR_Reg(uint8_t reg, uint8_t data)
 {
-    Camera_WriteReg(&hcamera, reg, &data);
+    if (reg == COM7 && (data & COM7_RESET)) {
+        Camera_RegWrite(&hcamera, reg, data, CAMERA_REG_VOLATILE);
+        Camera_RegInvalidate();
+        return 0;
+    }
+    Camera_RegWrite(&hcamera, reg, data, CAMERA_REG_CACHED);
     return 0;
 }
 
 static uint8_t ov7725_RD_Reg(uint8_t reg,uint8_t *data)
 {
-    return Camera_ReadReg(&hcamera,reg,data);
+    return Camera_RegRead(&hcamera, reg, data, CAMERA_REG_VOLATILE);
 }
 
 static int ov7725_reset(void)
@@ -145,6 +150,9 @@ static int ov7725_set_vflip(int enable)
 
 int ov7725_init(framesize_t framesize)
 {
+	hcamera.reg16 = 0;
+	hcamera.reg_burst = 0;	// SCCB: one register per transfer
+	hcamera.page = 0;
 	ov7725_reset();
 	hcamera.framesize = framesize;
 	hcamera.pixformat = PIXFORMAT_RGB565;
@@ -152,6 +160,7 @@ int ov7725_init(framesize_t framesize)
 	ov7725_set_framesize(hcamera.framesize);
 	ov7725_set_hmirror(1);
 	ov7725_set_vflip(1);
+	Camera_RegFlush(&hcamera);
 	
 	return 1;
 }
@@ -30,6 +30,7 @@ static int32_t lcd_writereg(uint8_t reg,uint8_t* pdata,uint32_t length);
 static int32_t lcd_readreg(uint8_t reg,uint8_t* pdata);
 static int32_t lcd_senddata(uint8_t* pdata,uint32_t length);
 static int32_t lcd_recvdata(uint8_t* pdata,uint32_t length);
+static int32_t lcd_senddata_dma(uint8_t* pdata,uint32_t length);
 
 ST7735_IO_t st7735_pIO = {
 	lcd_init,
@@ -39,9 +40,17 @@ ST7735_IO_t st7735_pIO = {
 	lcd_readreg,
 	lcd_senddata,
 	lcd_recvdata,
-	lcd_gettick
+	lcd_gettick,
+	lcd_senddata_dma
 };
 
+//SPI DMA transfer state (TSIZE limits one transfer to 65535 bytes)
+#define LCD_DMA_MAX_CHUNK 0xFFFFU
+static volatile uint8_t lcd_dma_busy = 0;
+static uint8_t *lcd_dma_ptr;
+static uint32_t lcd_dma_left;
+static void (*lcd_dma_cplt)(void);
+
 ST7735_Object_t st7735_pObj;
 uint32_t st7735_id;
 
@@ -350,6 +359,7 @@ static int32_t lcd_gettick(void)
 static int32_t lcd_writereg(uint8_t reg,uint8_t* pdata,uint32_t length)
 {
 	int32_t result;
+	LCD_WaitTransfer();
 	LCD_CS_RESET;
 	LCD_RS_RESET;
 	result = HAL_SPI_Transmit(SPI_Drv,&reg,1,100);
@@ -364,6 +374,7 @@ static int32_t lcd_writereg(uint8_t reg,uint8_t* pdata,uint32_t length)
 static int32_t lcd_readreg(uint8_t reg,uint8_t* pdata)
 {
 	int32_t result;
+	LCD_WaitTransfer();
 	LCD_CS_RESET;
 	LCD_RS_RESET;
 	
@@ -378,6 +389,7 @@ static int32_t lcd_readreg(uint8_t reg,uint8_t* pdata)
 static int32_t lcd_senddata(uint8_t* pdata,uint32_t length)
 {
 	int32_t result;
+	LCD_WaitTransfer();
 	LCD_CS_RESET;
 	//LCD_RS_SET;
 	result =HAL_SPI_Transmit(SPI_Drv,pdata,length,100);
@@ -389,6 +401,7 @@ static int32_t lcd_senddata(uint8_t* pdata,uint32_t length)
 static int32_t lcd_recvdata(uint8_t* pdata,uint32_t length)
 {
 	int32_t result;
+	LCD_WaitTransfer();
 	LCD_CS_RESET;
 	//LCD_RS_SET;
 	result = HAL_SPI_Receive(SPI_Drv,pdata,length,500);
@@ -397,3 +410,98 @@ static int32_t lcd_recvdata(uint8_t* pdata,uint32_t length)
 	return result;
 }
 
+static int32_t lcd_dma_next(void)
+{
+	uint32_t chunk = lcd_dma_left > LCD_DMA_MAX_CHUNK ? LCD_DMA_MAX_CHUNK : lcd_dma_left;
+	uint8_t *ptr = lcd_dma_ptr;
+
+	lcd_dma_ptr += chunk;
+	lcd_dma_left -= chunk;
+	return HAL_SPI_Transmit_DMA(SPI_Drv,ptr,chunk) == HAL_OK ? 0:-1;
+}
+
+//Start sending pixel data by DMA; CS stays low until the last chunk is out
+static int32_t lcd_senddata_dma(uint8_t* pdata,uint32_t length)
+{
+	//DMA1 cannot reach DTCM (stack, heap): send those buffers the blocking way
+	if(((uint32_t)pdata & 0xFFF00000U) == 0x20000000U || length == 0)
+	{
+		void (*cplt)(void) = lcd_dma_cplt;
+		int32_t result = lcd_senddata(pdata,length);
+		lcd_dma_cplt = NULL;
+		if(cplt != NULL)
+			cplt();
+		return result;
+	}
+
+	LCD_WaitTransfer();
+#if defined(__DCACHE_PRESENT) && (__DCACHE_PRESENT == 1U)
+	SCB_CleanDCache_by_Addr((uint32_t *)pdata,(int32_t)length);
+#endif
+	lcd_dma_ptr = pdata;
+	lcd_dma_left = length;
+	lcd_dma_busy = 1;
+	LCD_CS_RESET;
+	if(lcd_dma_next() != 0)
+	{
+		LCD_CS_SET;
+		lcd_dma_busy = 0;
+		return -1;
+	}
+	return 0;
+}
+
+//Draw an RGB565 rectangle in the background. XferCplt (may be NULL) runs in
+//interrupt context once the last byte has left; pData must not change before.
+int32_t LCD_FillRGBRect_DMA(uint16_t x,uint16_t y,uint8_t *pData,uint16_t width,uint16_t height,void (*XferCplt)(void))
+{
+	int32_t result;
+
+	LCD_WaitTransfer();
+	lcd_dma_cplt = XferCplt;
+	result = ST7735_FillRGBRectDMA(&st7735_pObj,x,y,pData,width,height);
+	if(result != ST7735_OK && !lcd_dma_busy)
+		lcd_dma_cplt = NULL;
+	return result;
+}
+
+uint8_t LCD_IsBusy(void)
+{
+	return lcd_dma_busy;
+}
+
+void LCD_WaitTransfer(void)
+{
+	while(lcd_dma_busy)
+	{
+	}
+}
+
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef *hspi)
+{
+	void (*cplt)(void);
+
+	if(hspi != SPI_Drv || !lcd_dma_busy)
+		return;
+
+	if(lcd_dma_left > 0 && lcd_dma_next() == 0)
+		return;
+
+	LCD_CS_SET;
+	cplt = lcd_dma_cplt;
+	lcd_dma_cplt = NULL;
+	lcd_dma_busy = 0;
+	if(cplt != NULL)
+		cplt();
+}
+
+void HAL_SPI_ErrorCallback(SPI_HandleTypeDef *hspi)
+{
+	if(hspi != SPI_Drv)
+		return;
+
+	LCD_CS_SET;
+	lcd_dma_left = 0;
+	lcd_dma_cplt = NULL;
+	lcd_dma_busy = 0;
+}
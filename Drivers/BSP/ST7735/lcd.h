@@ -40,6 +40,9 @@ void LCD_SoftPWMCtrlRun(void);
 void LCD_Light(uint32_t Brightness_Dis,uint32_t time);
 void LCD_ShowChar(uint16_t x,uint16_t y,uint8_t num,uint8_t size,uint8_t mode);
 void LCD_ShowString(uint16_t x,uint16_t y,uint16_t width,uint16_t height,uint8_t size,uint8_t *p);
+int32_t LCD_FillRGBRect_DMA(uint16_t x,uint16_t y,uint8_t *pData,uint16_t width,uint16_t height,void (*XferCplt)(void));
+uint8_t LCD_IsBusy(void);
+void LCD_WaitTransfer(void);
 extern ST7735_Ctx_t ST7735Ctx;
 
 #endif
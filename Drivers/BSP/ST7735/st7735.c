@@ -85,6 +85,9 @@ static int32_t ST7735_WriteRegWrap(void *Handle, uint8_t Reg, uint8_t *pData, ui
 static int32_t ST7735_SendDataWrap(void *Handle, uint8_t *pData, uint32_t Length);
 static int32_t ST7735_RecvDataWrap(void *Handle, uint8_t *pData, uint32_t Length);
 static int32_t ST7735_IO_Delay(ST7735_Object_t *pObj, uint32_t Delay);
+
+/* Set when the display window was narrowed to a rectangle; SetCursor restores it */
+static uint8_t WindowIsRect = 0;
 /**
 * @}
 */
@@ -116,6 +119,7 @@ int32_t ST7735_RegisterBusIO (ST7735_Object_t *pObj, ST7735_IO_t *pIO)
     pObj->IO.SendData  = pIO->SendData;
     pObj->IO.RecvData  = pIO->RecvData;
     pObj->IO.GetTick   = pIO->GetTick;
+    pObj->IO.SendDataDMA = pIO->SendDataDMA;
 
     pObj->Ctx.ReadReg   = ST7735_ReadRegWrap;
     pObj->Ctx.WriteReg  = ST7735_WriteRegWrap;
@@ -542,6 +546,16 @@ int32_t ST7735_SetCursor(ST7735_Object_t *pObj, uint32_t Xpos, uint32_t Ypos)
 {
   int32_t ret;
   uint8_t tmp;
+
+  /* Cursor moves assume a full-screen window */
+  if(WindowIsRect != 0U)
+  {
+    if(ST7735_SetDisplayWindow(pObj, 0U, 0U, ST7735Ctx.Width, ST7735Ctx.Height) != ST7735_OK)
+    {
+      return ST7735_ERROR;
+    }
+    WindowIsRect = 0U;
+  }
 	
 	/* Cursor calibration */
 	if(ST7735Ctx.Orientation <= ST7735_ORIENTATION_PORTRAIT_ROT180) {
@@ -701,35 +715,73 @@ int32_t ST7735_DrawBitmap(ST7735_Object_t *pObj, uint32_t Xpos, uint32_t Ypos, u
 int32_t ST7735_FillRGBRect(ST7735_Object_t *pObj, uint32_t Xpos, uint32_t Ypos, uint8_t *pData, uint32_t Width, uint32_t Height)
 {
   int32_t ret = ST7735_OK;
-  static uint8_t pdata[640];
-  uint8_t *rgb_data = pData;
-  uint32_t i, j;
+  uint8_t tmp;
 
   if(((Xpos + Width) > ST7735Ctx.Width) || ((Ypos + Height) > ST7735Ctx.Height))
   {
     ret = ST7735_ERROR;
-  }/* Set Cursor */
+  }/* Set window once, then send all rows in one go */
+  else if(ST7735_SetDisplayWindow(pObj, Xpos, Ypos, Width, Height) != ST7735_OK)
+  {
+    ret = ST7735_ERROR;
+  }
   else
   {
-    for(j = 0; j < Height; j++)
+    WindowIsRect = 1U;
+    if(st7735_write_reg(&pObj->Ctx, ST7735_WRITE_RAM, &tmp, 0) != ST7735_OK)
     {
-      if(ST7735_SetCursor(pObj, Xpos, Ypos+j) != ST7735_OK)
-      {
-        ret = ST7735_ERROR;
-      }
-      else
-      {
-        for(i = 0; i < Width; i++)
-        {
-          pdata[2U*i] = (uint8_t)(*(rgb_data));
-          pdata[(2U*i) + 1U] = (uint8_t)(*(rgb_data + 1));
-          rgb_data +=2;
-        }
-        if(st7735_send_data(&pObj->Ctx, (uint8_t*)&pdata[0], 2U*Width) != ST7735_OK)
-        {
-          ret = ST7735_ERROR;
-        }
-      }
+      ret = ST7735_ERROR;
+    }
+    else if(st7735_send_data(&pObj->Ctx, pData, 2U*Width*Height) != ST7735_OK)
+    {
+      ret = ST7735_ERROR;
+    }
+  }
+
+  return ret;
+}
+
+/**
+  * @brief  Draws a full RGB rectangle without waiting for the pixel data:
+  *         the window is set, then the whole buffer is handed to the bus
+  *         SendDataDMA routine. Falls back to ST7735_FillRGBRect when the
+  *         bus has no DMA routine.
+  * @note   pData must stay untouched until the bus reports completion.
+  * @param  pObj Component object
+  * @param  Xpos   specifies the X position.
+  * @param  Ypos   specifies the Y position.
+  * @param  pData  pointer to RGB data
+  * @param  Width  specifies the rectangle width.
+  * @param  Height Specifies the rectangle height
+  * @retval The component status
+  */
+int32_t ST7735_FillRGBRectDMA(ST7735_Object_t *pObj, uint32_t Xpos, uint32_t Ypos, uint8_t *pData, uint32_t Width, uint32_t Height)
+{
+  int32_t ret = ST7735_OK;
+  uint8_t tmp;
+
+  if(pObj->IO.SendDataDMA == NULL)
+  {
+    ret = ST7735_FillRGBRect(pObj, Xpos, Ypos, pData, Width, Height);
+  }
+  else if(((Xpos + Width) > ST7735Ctx.Width) || ((Ypos + Height) > ST7735Ctx.Height))
+  {
+    ret = ST7735_ERROR;
+  }
+  else if(ST7735_SetDisplayWindow(pObj, Xpos, Ypos, Width, Height) != ST7735_OK)
+  {
+    ret = ST7735_ERROR;
+  }
+  else
+  {
+    WindowIsRect = 1U;
+    if(st7735_write_reg(&pObj->Ctx, ST7735_WRITE_RAM, &tmp, 0) != ST7735_OK)
+    {
+      ret = ST7735_ERROR;
+    }
+    else if(pObj->IO.SendDataDMA(pData, 2U*Width*Height) != ST7735_OK)
+    {
+      ret = ST7735_ERROR;
     }
   }
 
@@ -64,6 +64,7 @@ typedef struct
   ST7735_SendData_Func      SendData;
   ST7735_RecvData_Func      RecvData;
   ST7735_GetTick_Func       GetTick; 
+  ST7735_SendData_Func      SendDataDMA;  /* Optional: start a background transfer, NULL if not supported */
 } ST7735_IO_t;
 
  
@@ -202,6 +203,7 @@ int32_t ST7735_GetOrientation(ST7735_Object_t *pObj, uint32_t *Orientation);
 int32_t ST7735_SetCursor(ST7735_Object_t *pObj, uint32_t Xpos, uint32_t Ypos);
 int32_t ST7735_DrawBitmap(ST7735_Object_t *pObj, uint32_t Xpos, uint32_t Ypos, uint8_t *pBmp);
 int32_t ST7735_FillRGBRect(ST7735_Object_t *pObj, uint32_t Xpos, uint32_t Ypos, uint8_t *pData, uint32_t Width, uint32_t Height);
+int32_t ST7735_FillRGBRectDMA(ST7735_Object_t *pObj, uint32_t Xpos, uint32_t Ypos, uint8_t *pData, uint32_t Width, uint32_t Height);
 int32_t ST7735_DrawHLine(ST7735_Object_t *pObj, uint32_t Xpos, uint32_t Ypos, uint32_t Length, uint32_t Color);
 int32_t ST7735_DrawVLine(ST7735_Object_t *pObj, uint32_t Xpos, uint32_t Ypos, uint32_t Length, uint32_t Color);
 int32_t ST7735_FillRect(ST7735_Object_t *pObj, uint32_t Xpos, uint32_t Ypos, uint32_t Width, uint32_t Height, uint32_t Color);
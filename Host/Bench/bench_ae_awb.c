@@ -0,0 +1,50 @@
+#include "host.h"
+#include "stdlib.h"
+#include "unistd.h"
+#include "ae_awb.h"
+
+// AeAwb_ComputeStats on a preview frame against the 0.5 ms per frame the
+// exposure loop may take, in host time: the sampling loop and the
+// CMSIS-DSP reductions, without the sensor update that follows at most
+// every AE_UPDATE_MS. Cycles are host nanoseconds at SystemCoreClock,
+// which says little about the target.
+//
+//   bench_ae_awb [-r rounds]
+
+#define BENCH_BUDGET_US 500U
+
+int main(int argc, char **argv)
+{
+    static uint16_t frame[PREVIEW_WIDTH * PREVIEW_HEIGHT];
+    AeAwb_StatsTypeDef st;
+    uint32_t rounds = 100000U;
+    uint64_t start;
+    double us;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:")) != -1) {
+        switch (opt) {
+        case 'r': rounds = (uint32_t)atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-r rounds]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Host_SceneRGB565(frame, PREVIEW_WIDTH, PREVIEW_HEIGHT, 1);
+    start = Host_Now();
+    for (uint32_t r = 0; r < rounds; r++) {
+        AeAwb_ComputeStats(frame, PREVIEW_WIDTH, PREVIEW_HEIGHT, &st);
+    }
+    us = (double)(Host_Now() - start) / 1000.0 / rounds;
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+    printf("CMSIS-DSP: SIMD (emulated, so slower than on the target)\n");
+#else
+    printf("CMSIS-DSP: plain C\n");
+#endif
+    printf("%ux%u frame, %u samples: %.2f us per frame (%.0f cycles at %lu MHz), %.1f%% of %u us\n",
+           PREVIEW_WIDTH, PREVIEW_HEIGHT, st.samples, us, us * (SystemCoreClock / 1000000U),
+           (unsigned long)(SystemCoreClock / 1000000U), 100.0 * us / BENCH_BUDGET_US, BENCH_BUDGET_US);
+    return 0;
+}
@@ -0,0 +1,195 @@
+#include "host.h"
+#include "stdlib.h"
+#include "string.h"
+#include "unistd.h"
+#include "capture.h"
+#include "review.h"
+
+// Preview rate and shot latency of the whole firmware, main() unmodified,
+// with K1 pressed from the loop hook as a user would. JPEG frames come from
+// the files given, or the synthetic scene; the disk image answers with the
+// latencies given. CPU time is the host's, so work the firmware does on the
+// CPU counts for less than on the target; waits on the sensor, bus and card
+// are modelled in full.
+//
+//   bench_camera [-n shots] [-r read_us] [-w write_us] [-b block_us] [frame.jpg ...]
+
+#define BENCH_DISK          HOST_OUT_DIR "/bench_camera.img"
+#define BENCH_PREVIEW_MS    5000U
+#define BENCH_PRESS_MS      100U
+#define BENCH_TIMEOUT_MS    600000U
+#define BENCH_MAX_SHOTS     64U
+
+int Firmware_Main(void);
+
+typedef enum {
+    STEP_BOOT_PRESS,    // start-up loop waits for K1
+    STEP_BOOT_RELEASE,  // same pin is the card detect, present when released
+    STEP_SETTLE,        // sensor settling, first frames
+    STEP_PREVIEW,       // preview rate over BENCH_PREVIEW_MS
+    STEP_PRESS,
+    STEP_RELEASE,       // shot starts on release
+    STEP_SAVING,
+    STEP_REVIEW,        // photo on the LCD, then back to preview
+} step_t;
+
+static step_t step;
+static uint32_t step_tick;
+static uint32_t lcd_start;
+static uint32_t shots, shots_done, shots_failed;
+static uint32_t shot_ms[BENCH_MAX_SHOTS];
+static uint32_t shot_kbs[BENCH_MAX_SHOTS];
+
+static void next(step_t s)
+{
+    step = s;
+    step_tick = HAL_GetTick();
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static void report(void)
+{
+    uint32_t sum = 0;
+
+    printf("shots: %lu saved, %lu failed\n", (unsigned long)shots_done, (unsigned long)shots_failed);
+    if (shots_done == 0U) {
+        return;
+    }
+    for (uint32_t i = 0; i < shots_done; i++) {
+        sum += shot_ms[i];
+    }
+    qsort(shot_ms, shots_done, sizeof(shot_ms[0]), cmp_u32);
+    qsort(shot_kbs, shots_done, sizeof(shot_kbs[0]), cmp_u32);
+    printf("shot latency (release to file closed): min %lu ms, median %lu ms, max %lu ms, mean %lu ms\n",
+           (unsigned long)shot_ms[0], (unsigned long)shot_ms[shots_done / 2U],
+           (unsigned long)shot_ms[shots_done - 1U], (unsigned long)(sum / shots_done));
+    printf("card write rate: median %lu KB/s\n", (unsigned long)shot_kbs[shots_done / 2U]);
+}
+
+static void loop_hook(void)
+{
+    uint32_t now = HAL_GetTick();
+
+    if (now > BENCH_TIMEOUT_MS) {
+        printf("timed out in step %d\n", step);
+        exit(1);
+    }
+
+    switch (step) {
+    case STEP_BOOT_PRESS:
+        Host_SetKey(1);
+        next(STEP_BOOT_RELEASE);
+        break;
+    case STEP_BOOT_RELEASE:
+        Host_SetKey(0);
+        next(STEP_SETTLE);
+        break;
+    case STEP_SETTLE:
+        if (now - step_tick >= 1000U) {
+            lcd_start = Host_LcdFrames();
+            next(STEP_PREVIEW);
+        }
+        break;
+    case STEP_PREVIEW:
+        if (now - step_tick >= BENCH_PREVIEW_MS) {
+            printf("preview: %.1f FPS on the LCD\n",
+                   (Host_LcdFrames() - lcd_start) * 1000.0 / (now - step_tick));
+            next(shots ? STEP_PRESS : STEP_REVIEW);
+        }
+        break;
+    case STEP_PRESS:
+        Host_SetKey(1);
+        next(STEP_RELEASE);
+        break;
+    case STEP_RELEASE:
+        if (now - step_tick >= BENCH_PRESS_MS) {
+            Host_SetKey(0);
+            next(STEP_SAVING);
+        }
+        break;
+    case STEP_SAVING:
+        // The release pass has started the capture by the next call
+        if (Capture_GetState() == CAPTURE_STATE_IDLE && now != step_tick) {
+            if (Capture_LastResult()) {
+                shot_ms[shots_done] = now - step_tick;
+                shot_kbs[shots_done] = Capture_LastWriteRate();
+                shots_done++;
+            } else {
+                shots_failed++;
+            }
+            next(STEP_REVIEW);
+        }
+        break;
+    case STEP_REVIEW:
+        if (now - step_tick >= REVIEW_HOLD_MS + 500U) {
+            if (shots_done + shots_failed >= shots) {
+                report();
+                exit(0);
+            }
+            next(STEP_PRESS);
+        }
+        break;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t read_us = 500U, write_us = 1500U, block_us = 20U;
+    const uint8_t **frames;
+    uint32_t *lens;
+    uint32_t count;
+    int opt;
+
+    shots = 10U;
+    while ((opt = getopt(argc, argv, "n:r:w:b:")) != -1) {
+        switch (opt) {
+        case 'n': shots = (uint32_t)atoi(optarg); break;
+        case 'r': read_us = (uint32_t)atoi(optarg); break;
+        case 'w': write_us = (uint32_t)atoi(optarg); break;
+        case 'b': block_us = (uint32_t)atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n shots] [-r read_us] [-w write_us] [-b block_us] [frame.jpg ...]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    if (shots > BENCH_MAX_SHOTS) {
+        shots = BENCH_MAX_SHOTS;
+    }
+
+    count = (optind < argc) ? (uint32_t)(argc - optind) : 1U;
+    frames = calloc(count, sizeof(*frames));
+    lens = calloc(count, sizeof(*lens));
+    for (uint32_t i = 0; i < count; i++) {
+        frames[i] = (optind < argc) ? Host_LoadFile(argv[optind + i], &lens[i])
+                                    : Host_SceneJPEG(1600, 1200, 1, 85, &lens[i]);
+        if (frames[i] == NULL) {
+            fprintf(stderr, "cannot read %s\n", argv[optind + i]);
+            return 2;
+        }
+    }
+    Host_CameraSetJPEG(frames, lens, count);
+
+    static uint16_t preview[160 * 120];
+    Host_SceneRGB565(preview, 160, 120, 1);
+    Host_CameraSetRGB565(preview, 160, 120, 1);
+
+    if (!Host_DiskOpen(BENCH_DISK, 4U * 1024U * 2048U, read_us, write_us, block_us) ||
+        Host_DiskFormat(0) != FR_OK) {
+        fprintf(stderr, "cannot set up %s\n", BENCH_DISK);
+        return 2;
+    }
+    printf("card: read %lu us, write %lu us, %lu us per block; %lu frame(s), first %lu bytes\n",
+           (unsigned long)read_us, (unsigned long)write_us, (unsigned long)block_us,
+           (unsigned long)count, (unsigned long)lens[0]);
+
+    Host_SetLoopHook(loop_hook);
+    Firmware_Main();
+    return 1;
+}
@@ -0,0 +1,127 @@
+#include "host.h"
+#include "stdlib.h"
+#include "unistd.h"
+#include "libjpeg.h"
+#include "jpeg_dsp.h"
+#include "preview.h"
+
+// LibJPEG with and without the jpeg_dsp kernels on the preview frame, as
+// the SNAPSHOT.ON compress runs. "stock" runs jfdctint and LibJPEG's colour
+// conversion with an RGB888 row copy, "DCT" swaps in the DSP DCT only,
+// "DCT+565" the colour kernel as well. In host cycles at SystemCoreClock,
+// which say little about the target; build with HOST_DSP=1 for the
+// SMLAD/SADD16 path, emulated and so slower than the plain C here.
+//
+//   bench_jpeg_dsp [-q quality] [-r rounds]
+
+#define BENCH_W         PREVIEW_WIDTH
+#define BENCH_H         PREVIEW_HEIGHT
+#define BENCH_OUT_SIZE  (64U * 1024U)
+
+typedef enum {
+    MODE_STOCK,
+    MODE_DCT,
+    MODE_RGB565,
+    MODE_COUNT
+} dsp_mode_t;
+
+static const char *const mode_names[MODE_COUNT] = { "stock", "DCT", "DCT+565" };
+
+static uint8_t out[BENCH_OUT_SIZE];
+
+static void widen(const uint8_t *px, uint8_t *rgb, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++, px += 2, rgb += 3) {
+        uint32_t v = ((uint32_t)px[0] << 8) | px[1];
+        uint32_t r = (v >> 8) & 0xF8U, g = (v >> 3) & 0xFCU, b = (v << 3) & 0xF8U;
+
+        rgb[0] = (uint8_t)(r | (r >> 5));
+        rgb[1] = (uint8_t)(g | (g >> 6));
+        rgb[2] = (uint8_t)(b | (b >> 5));
+    }
+}
+
+static uint32_t encode(const uint8_t *px, int quality, dsp_mode_t mode)
+{
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    unsigned char *buf = out;
+    unsigned long len = sizeof(out);
+    uint8_t rgb[BENCH_W * 3U];
+    JSAMPROW row;
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    jpeg_mem_dest(&cinfo, &buf, &len);
+    cinfo.image_width = BENCH_W;
+    cinfo.image_height = BENCH_H;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    if (mode != MODE_STOCK) {
+        jpeg_dsp_setup_compress(&cinfo, mode == MODE_RGB565);
+    }
+    while (cinfo.next_scanline < BENCH_H) {
+        const uint8_t *src = px + (size_t)cinfo.next_scanline * BENCH_W * 2U;
+
+        if (mode == MODE_RGB565) {
+            row = (JSAMPROW)src;
+        } else {
+            widen(src, rgb, BENCH_W);
+            row = rgb;
+        }
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    return (uint32_t)len;
+}
+
+int main(int argc, char **argv)
+{
+    static uint16_t scene[BENCH_W * BENCH_H];
+    static uint8_t px[BENCH_W * BENCH_H * 2U];
+    double enc[MODE_COUNT];
+    uint32_t rounds = 1000U, len = 0;
+    int quality = 85;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "q:r:")) != -1) {
+        switch (opt) {
+        case 'q': quality = atoi(optarg); break;
+        case 'r': rounds = (uint32_t)atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-q quality] [-r rounds]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Host_SceneRGB565(scene, BENCH_W, BENCH_H, 1);
+    for (uint32_t i = 0; i < BENCH_W * BENCH_H; i++) {
+        px[2U * i] = (uint8_t)(scene[i] >> 8);
+        px[2U * i + 1U] = (uint8_t)scene[i];
+    }
+
+    for (dsp_mode_t m = MODE_STOCK; m < MODE_COUNT; m++) {
+        uint32_t start = Host_Cycles();
+
+        for (uint32_t r = 0; r < rounds; r++) {
+            len = encode(px, quality, m);
+        }
+        enc[m] = (double)(Host_Cycles() - start) / rounds;
+    }
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+    printf("kernels: SMLAD/SADD16 (emulated, so slower than on the target)\n");
+#else
+    printf("kernels: plain C\n");
+#endif
+    printf("%ux%u scene, q%d, %lu bytes\n", BENCH_W, BENCH_H, quality, (unsigned long)len);
+    for (dsp_mode_t m = MODE_STOCK; m < MODE_COUNT; m++) {
+        printf("%-8s compress %9.0f cycles (%.2fx)\n", mode_names[m], enc[m],
+               enc[MODE_STOCK] / enc[m]);
+    }
+    return 0;
+}
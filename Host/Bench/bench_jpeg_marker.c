@@ -0,0 +1,94 @@
+#include "host.h"
+#include "stdlib.h"
+#include "string.h"
+#include "jpeg_marker.h"
+
+// Marker scans over a whole frame against a byte-at-a-time loop: SOI forward
+// from the start, EOI backward from the end behind the sensor's padding (as
+// stream_finish), and a forward EOI search through the entropy data (as a
+// chunk being drained). In host cycles at SystemCoreClock, which say little
+// about the target; the share of words holding a 0xFF, which go on to the
+// byte check, is what carries over. Build with HOST_DSP=1 for the UADD8/SEL
+// path.
+//
+//   bench_jpeg_marker [frame.jpg]
+
+#define BENCH_ROUNDS    200U
+#define BENCH_PADDING   4096U
+
+static uint32_t find_bytes(const uint8_t *buf, uint32_t len, uint8_t marker)
+{
+    for (uint32_t i = 0; i + 1 < len; i++) {
+        if (buf[i] == 0xFF && buf[i + 1] == marker) return i;
+    }
+    return len;
+}
+
+static uint32_t find_bytes_reverse(const uint8_t *buf, uint32_t len, uint8_t marker)
+{
+    for (uint32_t i = len; i-- > 1; ) {
+        if (buf[i - 1] == 0xFF && buf[i] == marker) return i - 1;
+    }
+    return len;
+}
+
+typedef uint32_t (*scan_fn)(const uint8_t *buf, uint32_t len, uint8_t marker);
+
+static volatile uint32_t sink;
+
+static double run(scan_fn fn, const uint8_t *buf, uint32_t len, uint8_t marker)
+{
+    uint32_t start = Host_Cycles();
+
+    for (uint32_t r = 0; r < BENCH_ROUNDS; r++) {
+        sink += fn(buf, len, marker);
+    }
+    return (double)(Host_Cycles() - start) / BENCH_ROUNDS;
+}
+
+static void report(const char *what, scan_fn fast, scan_fn slow, const uint8_t *buf,
+                   uint32_t len, uint8_t marker)
+{
+    double f = run(fast, buf, len, marker);
+    double s = run(slow, buf, len, marker);
+
+    printf("%-28s %8lu bytes: %10.0f cycles (%.2f/byte), byte loop %10.0f (%.2f/byte), %.1fx\n",
+           what, (unsigned long)len, f, f / len, s, s / len, s / f);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t len;
+    uint8_t *jpeg = (argc > 1) ? Host_LoadFile(argv[1], &len) : Host_SceneJPEG(1600, 1200, 1, 85, &len);
+    uint8_t *frame;
+    uint32_t eoi;
+    uint32_t ff_words = 0;
+
+    if (jpeg == NULL) {
+        fprintf(stderr, "cannot read %s\n", argv[1]);
+        return 2;
+    }
+    frame = calloc(len + BENCH_PADDING, 1);
+    memcpy(frame, jpeg, len);
+    eoi = JPEG_FindMarkerReverse(frame, len, JPEG_MARKER_EOI);
+    for (uint32_t i = 0; i + 4U <= len; i += 4U) {
+        ff_words += (memchr(frame + i, 0xFF, 4) != NULL);
+    }
+    printf("%s: %lu bytes, EOI at %lu, %.1f%% of words hold a 0xFF\n",
+           (argc > 1) ? argv[1] : "scene 1600x1200 q85", (unsigned long)len, (unsigned long)eoi,
+           100.0 * ff_words / (len / 4U));
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+    printf("word test: UADD8/SEL (emulated, so slower than on the target)\n");
+#else
+    printf("word test: plain C\n");
+#endif
+    report("SOI forward", JPEG_FindMarker, find_bytes, frame, len + BENCH_PADDING, JPEG_MARKER_SOI);
+    report("EOI reverse, padded", JPEG_FindMarkerReverse, find_bytes_reverse, frame,
+           len + BENCH_PADDING, JPEG_MARKER_EOI);
+    report("EOI forward, whole frame", JPEG_FindMarker, find_bytes, frame, len + BENCH_PADDING,
+           JPEG_MARKER_EOI);
+    report("EOI forward, 32 KB chunk", JPEG_FindMarker, find_bytes, frame + len / 2U, 32U * 1024U,
+           JPEG_MARKER_EOI);
+    return 0;
+}
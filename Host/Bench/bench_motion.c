@@ -0,0 +1,81 @@
+#include "host.h"
+#include "stdlib.h"
+#include "unistd.h"
+#include "motion.h"
+
+// Motion detection per preview frame, in host time: Motion_BuildGrid,
+// Motion_Compare on its own, and the whole Motion_Process of an armed,
+// warmed-up detector (grid, brightness normalization, compare, background
+// update). Cycles are host nanoseconds at SystemCoreClock, which says
+// little about the target; build with HOST_DSP=1 for the USUB8/SEL/USAD8
+// path, emulated and so slower than the plain C here.
+//
+//   bench_motion [-r rounds]
+
+static double us_per(uint64_t start, uint32_t rounds)
+{
+    return (double)(Host_Now() - start) / 1000.0 / rounds;
+}
+
+static void report(const char *what, double us)
+{
+    printf("%-16s %8.3f us (%6.0f cycles at %lu MHz)\n", what, us,
+           us * (SystemCoreClock / 1000000U), (unsigned long)(SystemCoreClock / 1000000U));
+}
+
+int main(int argc, char **argv)
+{
+    static uint16_t frame[PREVIEW_WIDTH * PREVIEW_HEIGHT];
+    static uint8_t grid[MOTION_CELLS], bg[MOTION_CELLS];
+    uint32_t rounds = 100000U, changed = 0, sad;
+    double build, compare, process;
+    uint64_t start;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:")) != -1) {
+        switch (opt) {
+        case 'r': rounds = (uint32_t)atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-r rounds]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Host_SceneRGB565(frame, PREVIEW_WIDTH, PREVIEW_HEIGHT, 1);
+    Motion_BuildGrid(frame, PREVIEW_WIDTH, PREVIEW_HEIGHT, bg);
+
+    start = Host_Now();
+    for (uint32_t r = 0; r < rounds; r++) {
+        Motion_BuildGrid(frame, PREVIEW_WIDTH, PREVIEW_HEIGHT, grid);
+    }
+    build = us_per(start, rounds);
+
+    grid[0] ^= 0x80U;
+    start = Host_Now();
+    for (uint32_t r = 0; r < rounds; r++) {
+        changed += Motion_Compare(grid, bg, MOTION_CELLS, MOTION_CELL_THRESHOLD, &sad);
+    }
+    compare = us_per(start, rounds);
+
+    Motion_Arm(1);
+    for (uint32_t f = 0; f < MOTION_WARMUP_FRAMES; f++) {
+        Motion_Process(frame);
+    }
+    start = Host_Now();
+    for (uint32_t r = 0; r < rounds; r++) {
+        Motion_Process(frame);
+    }
+    process = us_per(start, rounds);
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+    printf("kernels: USUB8/SEL/USAD8 (emulated, so slower than on the target)\n");
+#else
+    printf("kernels: plain C\n");
+#endif
+    printf("%ux%u frame, %ux%u grid (%lu changed cells counted)\n", PREVIEW_WIDTH, PREVIEW_HEIGHT,
+           MOTION_GRID_W, MOTION_GRID_H, (unsigned long)(changed / rounds));
+    report("Motion_BuildGrid", build);
+    report("Motion_Compare", compare);
+    report("Motion_Process", process);
+    return 0;
+}
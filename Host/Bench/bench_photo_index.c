@@ -0,0 +1,168 @@
+#include "host.h"
+#include "stdlib.h"
+#include "string.h"
+#include "unistd.h"
+#include "capture.h"
+
+// Photo naming on a card that already holds many photos in its root: the
+// first shot after a mount with and without PHOTOID.IDX, and the per-shot
+// cost of opening the file, closing it and keeping the index, in virtual
+// time against the card latencies given. Filling the card is not timed,
+// and is kept for the next run: the photos and index the run adds are
+// deleted at the end.
+//
+//   bench_photo_index [-n files] [-s shots] [-r read_us] [-w write_us] [-b block_us]
+
+#define BENCH_DISK  HOST_OUT_DIR "/bench_photo_index.img"
+
+extern uint32_t photo_id;
+
+static double ms_since(uint64_t start)
+{
+    return (double)(Host_Now() - start) / 1e6;
+}
+
+static void photo_name(char *name, size_t size, uint32_t id)
+{
+    snprintf(name, size, "P%05lu.JPG", (unsigned long)id);
+}
+
+static uint8_t photo_exists(uint32_t id)
+{
+    char name[16];
+
+    photo_name(name, sizeof(name), id);
+    return f_stat(name, NULL) == FR_OK;
+}
+
+static void remount(void)
+{
+    f_mount(NULL, SDPath, 0);
+    if (f_mount(&SDFatFS, SDPath, 1) != FR_OK) {
+        fprintf(stderr, "remount failed\n");
+        exit(1);
+    }
+}
+
+// Mount and name the first photo; reports the time Capture_InitPhotoId took
+static void first_shot(const char *what)
+{
+    uint32_t reads = Host_DiskReads();
+    uint64_t start;
+    double ms;
+
+    remount();
+    start = Host_Now();
+    Capture_InitPhotoId();
+    ms = ms_since(start);
+    printf("%-22s next ID %05lu in %8.1f ms, %6lu reads\n", what, (unsigned long)photo_id, ms,
+           (unsigned long)(Host_DiskReads() - reads));
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t files = 10000U, shots = 64U;
+    uint32_t read_us = 500U, write_us = 1500U, block_us = 20U;
+    double open_ms = 0, close_ms = 0, index_ms = 0, index_max = 0;
+    uint32_t index_writes = 0;
+    uint64_t start;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:r:w:b:")) != -1) {
+        switch (opt) {
+        case 'n': files = (uint32_t)atoi(optarg); break;
+        case 's': shots = (uint32_t)atoi(optarg); break;
+        case 'r': read_us = (uint32_t)atoi(optarg); break;
+        case 'w': write_us = (uint32_t)atoi(optarg); break;
+        case 'b': block_us = (uint32_t)atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-n files] [-s shots] [-r read_us] [-w write_us] [-b block_us]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    // FAT32, so the root directory can hold them all. A card left by the
+    // last run with the same count is reused.
+    if (!Host_DiskOpen(BENCH_DISK, 4U * 1024U * 2048U, 0U, 0U, 0U)) {
+        fprintf(stderr, "cannot open %s\n", BENCH_DISK);
+        return 2;
+    }
+    if (Host_DiskMount() == FR_OK && photo_exists(files - 1U) && !photo_exists(files)) {
+        printf("%lu photos in the root directory (left by the last run)\n", (unsigned long)files);
+    } else {
+        if (Host_DiskFormat(1) != FR_OK) {
+            fprintf(stderr, "cannot format %s\n", BENCH_DISK);
+            return 2;
+        }
+        start = Host_Now();
+        for (uint32_t i = 0; i < files; i++) {
+            FIL f;
+            char name[16];
+
+            photo_name(name, sizeof(name), i);
+            if (f_open(&f, name, FA_CREATE_NEW | FA_WRITE) != FR_OK) {
+                fprintf(stderr, "cannot create %s\n", name);
+                return 1;
+            }
+            f_close(&f);
+        }
+        printf("%lu photos in the root directory (filled in %.1f s)\n", (unsigned long)files,
+               ms_since(start) / 1000.0);
+    }
+    f_unlink("PHOTOID.IDX");
+    printf("card: read %lu us, write %lu us, %lu us per block\n", (unsigned long)read_us,
+           (unsigned long)write_us, (unsigned long)block_us);
+    Host_DiskSetLatency(read_us, write_us, block_us);
+
+    first_shot("mount, no index:");
+
+    for (uint32_t i = 0; i < shots; i++) {
+        FIL f;
+        char name[32];
+        uint32_t id, writes;
+        UINT n;
+        double ms;
+
+        start = Host_Now();
+        if (Capture_OpenPhotoFile(&f, name, sizeof(name), &id) != FR_OK) {
+            fprintf(stderr, "cannot open a photo file\n");
+            return 1;
+        }
+        open_ms += ms_since(start);
+        f_write(&f, "\xFF\xD8\xFF\xD9", 4, &n);
+        start = Host_Now();
+        Capture_ClosePhotoFile(&f, name, id, 1);
+        close_ms += ms_since(start);
+
+        writes = Host_DiskWrites();
+        start = Host_Now();
+        Capture_SavePhotoIndex();
+        ms = ms_since(start);
+        if (Host_DiskWrites() != writes) {
+            index_writes++;
+            index_ms += ms;
+            if (ms > index_max) {
+                index_max = ms;
+            }
+        }
+    }
+    printf("%lu shots: open %.1f ms, close %.1f ms per shot\n", (unsigned long)shots,
+           open_ms / shots, close_ms / shots);
+    printf("index: %lu writes of %.1f ms (max %.1f ms), %.2f ms per shot; %.1f ms per shot when written every shot\n",
+           (unsigned long)index_writes, index_writes ? index_ms / index_writes : 0.0, index_max,
+           index_ms / shots, index_writes ? index_ms / index_writes : 0.0);
+
+    first_shot("mount, with index:");
+
+    // Back to the filled card for the next run
+    Host_DiskSetLatency(0U, 0U, 0U);
+    for (uint32_t id = files; photo_exists(id); id++) {
+        char name[16];
+
+        photo_name(name, sizeof(name), id);
+        f_unlink(name);
+    }
+    f_unlink("PHOTOID.IDX");
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include "host.h"
+#include "stdlib.h"
+#include "string.h"
+#include "unistd.h"
+#include "sd_bench.h"
+
+// The boot-time card benchmark (sd_bench.c) against a disk image with the
+// latencies given: SDBENCH.CSV as the card would hold it, with the time the
+// card model alone accounts for per transfer as a last column, so what the
+// driver adds on top shows. Afterwards the trigger and scratch file must be
+// gone and a file written before the run must read back unchanged, which
+// it would not if the raw I/O strayed outside the scratch file's clusters.
+//
+//   bench_sd [-r read_us] [-w write_us] [-b block_us]
+
+#define BENCH_DISK      HOST_OUT_DIR "/bench_sd.img"
+#define BENCH_SECTORS   (64U * 2048U)   // 64 MB, FAT32
+#define BENCH_KEEP      "KEEP.BIN"
+#define BENCH_KEEP_SIZE (256U * 1024U)
+
+static uint8_t keep[BENCH_KEEP_SIZE];
+static uint8_t back[BENCH_KEEP_SIZE];
+
+static uint8_t write_file(const char *name, const uint8_t *data, UINT len)
+{
+    FIL f;
+    UINT n = 0;
+
+    if (f_open(&f, name, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) {
+        return 0;
+    }
+    f_write(&f, data, len, &n);
+    return f_close(&f) == FR_OK && n == len;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t read_us = 500U, write_us = 1500U, block_us = 20U;
+    uint32_t seed = 1;
+    char line[128];
+    uint64_t start;
+    FRESULT res;
+    FILE *csv;
+    FIL f;
+    UINT n = 0;
+    int ok = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:w:b:")) != -1) {
+        switch (opt) {
+        case 'r': read_us = (uint32_t)atoi(optarg); break;
+        case 'w': write_us = (uint32_t)atoi(optarg); break;
+        case 'b': block_us = (uint32_t)atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-r read_us] [-w write_us] [-b block_us]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (!Host_DiskOpen(BENCH_DISK, BENCH_SECTORS, 0U, 0U, 0U) || Host_DiskFormat(1) != FR_OK) {
+        fprintf(stderr, "cannot set up %s\n", BENCH_DISK);
+        return 2;
+    }
+    for (uint32_t i = 0; i < BENCH_KEEP_SIZE; i++) {
+        seed = seed * 1103515245U + 12345U;
+        keep[i] = (uint8_t)(seed >> 16);
+    }
+    if (!write_file(BENCH_KEEP, keep, BENCH_KEEP_SIZE) || !write_file(SD_BENCH_TRIGGER, keep, 0)) {
+        fprintf(stderr, "cannot write to %s\n", BENCH_DISK);
+        return 2;
+    }
+
+    printf("card: read %lu us, write %lu us, %lu us per block\n", (unsigned long)read_us,
+           (unsigned long)write_us, (unsigned long)block_us);
+    Host_DiskSetLatency(read_us, write_us, block_us);
+    if (!SDBench_Requested()) {
+        fprintf(stderr, "%s not seen\n", SD_BENCH_TRIGGER);
+        return 1;
+    }
+    start = Host_Now();
+    res = SDBench_Run(SD_BENCH_REPORT);
+    printf("SDBench_Run: %d in %.1f s\n", res, (double)(Host_Now() - start) / 1e9);
+    Host_DiskSetLatency(0U, 0U, 0U);
+    ok &= (res == FR_OK);
+
+    // The report, read back through FatFs
+    csv = tmpfile();
+    if (csv != NULL && f_open(&f, SD_BENCH_REPORT, FA_READ) == FR_OK) {
+        while (f_read(&f, line, sizeof(line), &n) == FR_OK && n > 0) {
+            fwrite(line, 1, n, csv);
+        }
+        f_close(&f);
+        rewind(csv);
+        while (fgets(line, sizeof(line), csv) != NULL) {
+            char test[16];
+            unsigned long sectors;
+
+            line[strcspn(line, "\n")] = '\0';
+            if (strncmp(line, "test,", 5) == 0) {
+                printf("%s,model_us\n", line);
+            } else if (sscanf(line, "%15[a-z_],%lu,", test, &sectors) == 2) {
+                printf("%s,%lu\n", line, (unsigned long)((strstr(test, "write") ? write_us : read_us) +
+                                                         sectors * block_us));
+            } else {
+                printf("%s\n", line);
+            }
+        }
+        fclose(csv);
+    } else {
+        printf("no %s\n", SD_BENCH_REPORT);
+        ok = 0;
+    }
+
+    if (f_stat(SD_BENCH_TRIGGER, NULL) == FR_OK || f_stat(SD_BENCH_AREA_FILE, NULL) == FR_OK) {
+        printf("%s or %s left on the card\n", SD_BENCH_TRIGGER, SD_BENCH_AREA_FILE);
+        ok = 0;
+    }
+    n = 0;
+    if (f_open(&f, BENCH_KEEP, FA_READ) == FR_OK) {
+        f_read(&f, back, BENCH_KEEP_SIZE, &n);
+        f_close(&f);
+    }
+    if (n != BENCH_KEEP_SIZE || memcmp(back, keep, BENCH_KEEP_SIZE) != 0) {
+        printf("%s changed by the benchmark\n", BENCH_KEEP);
+        ok = 0;
+    }
+    return ok ? 0 : 1;
+}
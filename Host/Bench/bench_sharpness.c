@@ -0,0 +1,174 @@
+#include "host.h"
+#include "stdlib.h"
+#include "string.h"
+#include "unistd.h"
+#include "libjpeg.h"
+#include "sharpness.h"
+
+// Best-of scoring per candidate frame: Sharpness_ScoreJPEG, which reads the
+// Huffman data itself, against the LibJPEG 1/4-scale luma decode it
+// replaced (the same score, checked), and the Laplacian alone on the
+// decoded plane. Frames are the stand-in camera's JPEGs at the capture
+// sizes, or the files given. Host time at SystemCoreClock, which says
+// little about the target; build with HOST_DSP=1 for the SIMD Laplacian,
+// emulated and so slower than the plain C here.
+//
+//   bench_sharpness [-q quality] [-r rounds] [frame.jpg ...]
+
+typedef struct {
+    const char *name;
+    uint16_t w, h;
+} bench_size_t;
+
+static const bench_size_t sizes[] = {
+    { "VGA", 640, 480 },
+    { "SVGA", 800, 600 },
+    { "XGA", 1024, 768 },
+    { "SXGA", 1280, 1024 },
+    { "UXGA", 1600, 1200 },
+};
+
+static uint8_t plane[SHARPNESS_MAX_WIDTH * 600U];
+static uint32_t plane_w, plane_h;
+
+static void bench_error_exit(j_common_ptr cinfo)
+{
+    char msg[JMSG_LENGTH_MAX];
+
+    (*cinfo->err->format_message)(cinfo, msg);
+    fprintf(stderr, "LibJPEG: %s\n", msg);
+    exit(1);
+}
+
+// The scoring best-of did before: LibJPEG decoding luma at 1/4, three rows
+// at a time. Keeps the plane for the Laplacian-only run.
+static uint32_t score_libjpeg(const uint8_t *jpeg, uint32_t len)
+{
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    Sharpness_AccTypeDef acc = { 0, 0, 0 };
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jerr.error_exit = bench_error_exit;
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, (unsigned char *)jpeg, len);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = 4;
+    cinfo.dct_method = JDCT_IFAST;
+    cinfo.do_fancy_upsampling = FALSE;
+    cinfo.do_block_smoothing = FALSE;
+    cinfo.out_color_space = JCS_GRAYSCALE;
+    jpeg_start_decompress(&cinfo);
+    plane_w = cinfo.output_width;
+    plane_h = cinfo.output_height;
+    if ((size_t)plane_w * plane_h > sizeof(plane)) {
+        jpeg_destroy_decompress(&cinfo);
+        return 0;
+    }
+    while (cinfo.output_scanline < cinfo.output_height) {
+        uint32_t n = cinfo.output_scanline;
+        JSAMPROW row = &plane[n * plane_w];
+
+        jpeg_read_scanlines(&cinfo, &row, 1);
+        if (n >= 2) {
+            Sharpness_AccumulateRow(row - 2U * plane_w, row - plane_w, row, plane_w, &acc);
+        }
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return Sharpness_Variance(&acc);
+}
+
+static void bench(const char *name, const uint8_t *jpeg, uint32_t len, uint32_t rounds)
+{
+    uint32_t score = 0, ref, luma = 0;
+    double us_walk, us_lib, us_luma;
+    uint64_t start;
+
+    ref = score_libjpeg(jpeg, len);
+    if ((size_t)plane_w * plane_h > sizeof(plane)) {
+        printf("%-12s %ux%u at 1/4 is too large for the bench\n", name, plane_w, plane_h);
+        return;
+    }
+    start = Host_Now();
+    for (uint32_t r = 0; r < rounds; r++) {
+        score_libjpeg(jpeg, len);
+    }
+    us_lib = (double)(Host_Now() - start) / 1000.0 / rounds;
+
+    start = Host_Now();
+    for (uint32_t r = 0; r < rounds; r++) {
+        if (!Sharpness_ScoreJPEG(jpeg, len, &score)) {
+            printf("%-12s not scored\n", name);
+            return;
+        }
+    }
+    us_walk = (double)(Host_Now() - start) / 1000.0 / rounds;
+
+    start = Host_Now();
+    for (uint32_t r = 0; r < rounds; r++) {
+        luma += Sharpness_Luma(plane, plane_w, plane_h, plane_w);
+    }
+    us_luma = (double)(Host_Now() - start) / 1000.0 / rounds;
+
+    printf("%-12s %7lu bytes, %3ux%-3u: ScoreJPEG %8.1f us (%.1fx), LibJPEG %8.1f us, "
+           "Laplacian %6.1f us, score %lu%s\n", name, (unsigned long)len, plane_w, plane_h,
+           us_walk, us_lib / us_walk, us_lib, us_luma, (unsigned long)score,
+           (score == ref && luma / rounds == ref) ? "" : " (LibJPEG differs)");
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t rounds = 50U;
+    int quality = 85;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "q:r:")) != -1) {
+        switch (opt) {
+        case 'q': quality = atoi(optarg); break;
+        case 'r': rounds = (uint32_t)atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-q quality] [-r rounds] [frame.jpg ...]\n", argv[0]);
+            return 2;
+        }
+    }
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+    printf("Laplacian: SIMD (emulated, so slower than on the target)\n");
+#else
+    printf("Laplacian: plain C\n");
+#endif
+    if (optind < argc) {
+        for (int i = optind; i < argc; i++) {
+            FILE *f = fopen(argv[i], "rb");
+            uint8_t *buf;
+            long len;
+
+            if (f == NULL || fseek(f, 0, SEEK_END) != 0 || (len = ftell(f)) <= 0) {
+                fprintf(stderr, "cannot read %s\n", argv[i]);
+                return 2;
+            }
+            rewind(f);
+            buf = malloc((size_t)len);
+            if (buf == NULL || fread(buf, 1, (size_t)len, f) != (size_t)len) {
+                fprintf(stderr, "cannot read %s\n", argv[i]);
+                return 2;
+            }
+            fclose(f);
+            bench(argv[i], buf, (uint32_t)len, rounds);
+            free(buf);
+        }
+        return 0;
+    }
+
+    printf("camera scenes at q%d\n", quality);
+    for (uint32_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        uint32_t len;
+        uint8_t *jpeg = Host_SceneJPEG(sizes[s].w, sizes[s].h, 1, quality, &len);
+
+        bench(sizes[s].name, jpeg, len, rounds);
+        free(jpeg);
+    }
+    return 0;
+}
@@ -0,0 +1,123 @@
+#ifndef __HOST_H
+#define __HOST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+#include "stdio.h"
+#include "ff_gen_drv.h"
+
+// Stand-ins for the target peripherals in the host build (make host-test,
+// make host-bench). Peripheral registers are plain memory at their target
+// addresses; the models below read what the firmware programmed there and
+// answer through the real HAL callbacks, from a host signal that PRIMASK
+// masks as it does the interrupts on the target.
+//
+// Time is host time plus whatever HAL_Delay, polled transfers and Stop mode
+// skipped: those jump straight to the next event instead of spinning. The
+// DWT cycle counter and HAL_GetTick follow it, so the modules' own cycle
+// statistics read as on the target, scaled by host speed.
+
+// Disk images and other output go to the build directory (host.mk)
+#ifndef HOST_OUT_DIR
+#define HOST_OUT_DIR "build/host"
+#endif
+
+// Check one condition in a test; failures are counted and reported
+#define HOST_CHECK(cond) \
+    ((cond) ? (void)0 : Host_Fail(__FILE__, __LINE__, #cond))
+
+void Host_Fail(const char *file, int line, const char *cond);
+// 0 if every HOST_CHECK passed, for main() to return
+int Host_Result(void);
+
+// Cycles since start at SystemCoreClock, as the DWT counter on the target
+uint32_t Host_Cycles(void);
+// Microseconds between two Host_Cycles() readings
+double Host_Us(uint32_t start, uint32_t end);
+// Nanoseconds since start
+uint64_t Host_Now(void);
+
+// Interrupt stand-in: 'handler' runs in interrupt context 'us' from now, or
+// as soon as PRIMASK is clear after that
+void Host_IrqAfter(uint32_t us, void (*handler)(void *arg), void *arg);
+// Drop a pending Host_IrqAfter; 0 if there was none
+uint8_t Host_IrqCancel(void (*handler)(void *arg), void *arg);
+// Busy for 'us' as far as the firmware can tell; interrupts due meanwhile run
+void Host_Spend(uint32_t us);
+// Sleep until the next interrupt has run (WFI); 0 if none is pending
+uint8_t Host_WaitForInterrupt(void);
+
+// K1 as the firmware reads it
+void Host_SetKey(uint8_t pressed);
+// Called whenever the firmware samples K1 outside interrupts, once per pass
+// of its main loop: a benchmark drives the unmodified loop from here
+void Host_SetLoopHook(void (*hook)(void));
+
+// Whole file into a malloc'd buffer; NULL if it cannot be read
+uint8_t *Host_LoadFile(const char *path, uint32_t *len);
+
+// Camera: OV2640 registers behind I2C1, frames replayed through DCMI and
+// DMA1 stream 0. JPEG frames go out while DCMI is in JPEG mode, RGB565 ones
+// (high byte first, w x h, cropped and decimated as DCMI is set up)
+// otherwise; both cycle through the list given. Frames start every
+// frame_us and their data is spread over the first 80% of that.
+void Host_CameraSetJPEG(const uint8_t *const *frames, const uint32_t *lens, uint32_t count);
+void Host_CameraSetRGB565(const uint16_t *frames, uint16_t w, uint16_t h, uint32_t count);
+void Host_CameraSetFrameTime(uint32_t frame_us);
+// Frames the sensor has started, and those DCMI took in
+uint32_t Host_CameraFrames(void);
+uint32_t Host_CameraCaptured(void);
+// Synthetic test scene, different noise for each seed: RGB565 (native
+// order) into w x h pixels, or a baseline JPEG at 'quality' (1-100, as
+// LibJPEG scales its tables) in a malloc'd buffer
+void Host_SceneRGB565(uint16_t *pixels, uint16_t w, uint16_t h, uint32_t seed);
+uint8_t *Host_SceneJPEG(uint16_t w, uint16_t h, uint32_t seed, int quality, uint32_t *len);
+
+// SCCB bus: transfers started and bytes sent since start, register file
+// (bank 0: DSP, 1: sensor) and fault injection. A failing transfer is not
+// acknowledged; a stalled bus never finishes an interrupt transfer.
+uint32_t Host_I2CTransactions(void);
+uint32_t Host_I2CBytes(void);
+uint8_t Host_I2CReg(uint8_t bank, uint8_t reg);
+void Host_I2CFailNext(uint32_t count);
+void Host_I2CStall(uint8_t stall);
+
+// LCD: ST7735 controller RAM (RGB565 as sent, at the CASET/RASET addresses
+// the driver uses in its orientation) and full preview frames drawn into it
+// since start
+#define HOST_LCD_RAM_W  162
+#define HOST_LCD_RAM_H  162
+uint32_t Host_LcdFrames(void);
+uint16_t Host_LcdPixel(uint16_t x, uint16_t y);
+// Controller RAM as a binary PPM; 0 on failure
+uint8_t Host_LcdSave(const char *path);
+
+// Disk image behind SDMMC1, in place of the SD card. A read command waits
+// read_us for its first data, a write leaves the card programming for
+// write_us after its last, and every sector takes per_block_us on the bus.
+// Returns 0 if the image cannot be opened.
+uint8_t Host_DiskOpen(const char *path, uint32_t sectors, uint32_t read_us,
+                      uint32_t write_us, uint32_t per_block_us);
+// Latencies from the next command on, e.g. none while a test fills the card
+void Host_DiskSetLatency(uint32_t read_us, uint32_t write_us, uint32_t per_block_us);
+void Host_DiskClose(void);
+// Format the image, setting up SDMMC1 first if MX_SDMMC1_SD_Init has not.
+// With 'mount' it is left mounted for FatFs calls, FatFs linked to the SD
+// driver first if MX_FATFS_Init has not; without, FatFs is left as it was,
+// for the firmware's own start-up to find the card
+FRESULT Host_DiskFormat(uint8_t mount);
+// Mount the image as it is, setting up SDMMC1 and FatFs as Host_DiskFormat
+FRESULT Host_DiskMount(void);
+// Commands and sectors the disk has seen since it was opened
+uint32_t Host_DiskReads(void);
+uint32_t Host_DiskWrites(void);
+uint32_t Host_DiskBlocksWritten(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HOST_H */
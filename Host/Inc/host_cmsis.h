@@ -0,0 +1,267 @@
+#ifndef __HOST_CMSIS_H
+#define __HOST_CMSIS_H
+
+// Forced into every unit of the host build (-include). cmsis_gcc.h is Arm
+// inline assembly throughout, so its include guard is taken here and the
+// parts of it the firmware uses are supplied as host C; then the device
+// headers are pulled in once. Peripheral registers are plain memory mapped
+// at their target addresses (host_hal.c), so register access compiles and
+// runs unchanged. With HOST_DSP=1 the DSP extension is emulated as well, so
+// the SIMD paths of the modules run on the host and can be checked against
+// their plain C fallbacks.
+
+#define __CMSIS_GCC_H
+
+#include "stdint.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define __ASM                       __asm
+#define __INLINE                    inline
+#define __STATIC_INLINE             static inline
+#define __STATIC_FORCEINLINE        __attribute__((always_inline)) static inline
+#define __NO_RETURN                 __attribute__((__noreturn__))
+#define __USED                      __attribute__((used))
+#define __WEAK                      __attribute__((weak))
+#define __PACKED                    __attribute__((packed, aligned(1)))
+#define __PACKED_STRUCT             struct __attribute__((packed, aligned(1)))
+#define __PACKED_UNION              union __attribute__((packed, aligned(1)))
+#define __ALIGNED(x)                __attribute__((aligned(x)))
+#define __RESTRICT                  __restrict
+#define __COMPILER_BARRIER()        __asm volatile("" ::: "memory")
+#define __UNALIGNED_UINT16_READ(addr)       (*(const uint16_t *)(const void *)(addr))
+#define __UNALIGNED_UINT16_WRITE(addr, val) (void)(*(uint16_t *)(void *)(addr) = (val))
+#define __UNALIGNED_UINT32_READ(addr)       (*(const uint32_t *)(const void *)(addr))
+#define __UNALIGNED_UINT32_WRITE(addr, val) (void)(*(uint32_t *)(void *)(addr) = (val))
+
+// Interrupt masking. Stand-in interrupts (Host_IrqAfter) are a host signal
+// that PRIMASK blocks, as on the target.
+uint32_t Host_GetPRIMASK(void);
+void Host_SetPRIMASK(uint32_t primask);
+
+#define __get_PRIMASK()     Host_GetPRIMASK()
+#define __set_PRIMASK(x)    Host_SetPRIMASK(x)
+#define __disable_irq()     Host_SetPRIMASK(1U)
+#define __enable_irq()      Host_SetPRIMASK(0U)
+#define __DSB()             __sync_synchronize()
+#define __DMB()             __sync_synchronize()
+#define __ISB()             __sync_synchronize()
+#define __NOP()             ((void)0)
+#define __WFI()             ((void)0)
+#define __WFE()             ((void)0)
+#define __SEV()             ((void)0)
+#define __BKPT(value)       ((void)(value))
+
+static inline uint32_t __get_FPSCR(void)
+{
+    return 0U;
+}
+
+static inline void __set_FPSCR(uint32_t fpscr)
+{
+    (void)fpscr;
+}
+
+static inline uint8_t __CLZ(uint32_t value)
+{
+    return (value == 0U) ? 32U : (uint8_t)__builtin_clz(value);
+}
+
+static inline uint32_t __ROR(uint32_t op1, uint32_t op2)
+{
+    op2 %= 32U;
+    return (op2 == 0U) ? op1 : (op1 >> op2) | (op1 << (32U - op2));
+}
+
+static inline uint32_t __REV(uint32_t value)
+{
+    return __builtin_bswap32(value);
+}
+
+static inline uint32_t __REV16(uint32_t value)
+{
+    return ((value & 0xFF00FF00U) >> 8) | ((value & 0x00FF00FFU) << 8);
+}
+
+static inline uint32_t __RBIT(uint32_t value)
+{
+    uint32_t r = 0;
+
+    for (int i = 0; i < 32; i++) {
+        r |= ((value >> i) & 1U) << (31 - i);
+    }
+    return r;
+}
+
+static inline int32_t __SSAT(int32_t val, uint32_t sat)
+{
+    int32_t max = (int32_t)((1U << (sat - 1U)) - 1U);
+
+    return (val > max) ? max : (val < -max - 1) ? -max - 1 : val;
+}
+
+static inline uint32_t __USAT(int32_t val, uint32_t sat)
+{
+    uint32_t max = (1U << sat) - 1U;
+
+    return (val < 0) ? 0U : ((uint32_t)val > max) ? max : (uint32_t)val;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#if defined(HOST_DSP) && (HOST_DSP == 1)
+// arm_math.h keeps its plain C paths: only the modules' own SIMD code is
+// under test
+#include "arm_math.h"
+
+#define __ARM_FEATURE_DSP 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// APSR.GE as the last parallel add/subtract left it, for __SEL
+extern uint32_t Host_GE;
+
+static inline uint32_t Host_UADD8(uint32_t x, uint32_t y)
+{
+    uint32_t r = 0;
+
+    Host_GE = 0;
+    for (int i = 0; i < 32; i += 8) {
+        uint32_t s = ((x >> i) & 0xFFU) + ((y >> i) & 0xFFU);
+
+        r |= (s & 0xFFU) << i;
+        Host_GE |= (s >> 8) << (i / 8);
+    }
+    return r;
+}
+
+static inline uint32_t Host_USUB8(uint32_t x, uint32_t y)
+{
+    uint32_t r = 0;
+
+    Host_GE = 0;
+    for (int i = 0; i < 32; i += 8) {
+        int32_t d = (int32_t)((x >> i) & 0xFFU) - (int32_t)((y >> i) & 0xFFU);
+
+        r |= ((uint32_t)d & 0xFFU) << i;
+        Host_GE |= (uint32_t)(d >= 0) << (i / 8);
+    }
+    return r;
+}
+
+static inline uint32_t Host_UHADD8(uint32_t x, uint32_t y)
+{
+    uint32_t r = 0;
+
+    for (int i = 0; i < 32; i += 8) {
+        r |= ((((x >> i) & 0xFFU) + ((y >> i) & 0xFFU)) >> 1) << i;
+    }
+    return r;
+}
+
+static inline uint32_t Host_USAD8(uint32_t x, uint32_t y)
+{
+    uint32_t r = 0;
+
+    for (int i = 0; i < 32; i += 8) {
+        int32_t d = (int32_t)((x >> i) & 0xFFU) - (int32_t)((y >> i) & 0xFFU);
+
+        r += (uint32_t)(d < 0 ? -d : d);
+    }
+    return r;
+}
+
+static inline uint32_t Host_SEL(uint32_t x, uint32_t y)
+{
+    uint32_t r = 0;
+
+    for (int i = 0; i < 4; i++) {
+        r |= (((Host_GE >> i) & 1U) ? x : y) & (0xFFU << (8 * i));
+    }
+    return r;
+}
+
+static inline uint32_t Host_UADD16(uint32_t x, uint32_t y)
+{
+    uint32_t lo = (x & 0xFFFFU) + (y & 0xFFFFU);
+    uint32_t hi = (x >> 16) + (y >> 16);
+
+    Host_GE = ((lo >> 16) ? 0x3U : 0U) | ((hi >> 16) ? 0xCU : 0U);
+    return (lo & 0xFFFFU) | (hi << 16);
+}
+
+static inline uint32_t Host_SADD16(uint32_t x, uint32_t y)
+{
+    int32_t lo = (int16_t)x + (int16_t)y;
+    int32_t hi = (int16_t)(x >> 16) + (int16_t)(y >> 16);
+
+    Host_GE = (lo >= 0 ? 0x3U : 0U) | (hi >= 0 ? 0xCU : 0U);
+    return ((uint32_t)lo & 0xFFFFU) | ((uint32_t)hi << 16);
+}
+
+static inline uint32_t Host_SSUB16(uint32_t x, uint32_t y)
+{
+    int32_t lo = (int16_t)x - (int16_t)y;
+    int32_t hi = (int16_t)(x >> 16) - (int16_t)(y >> 16);
+
+    Host_GE = (lo >= 0 ? 0x3U : 0U) | (hi >= 0 ? 0xCU : 0U);
+    return ((uint32_t)lo & 0xFFFFU) | ((uint32_t)hi << 16);
+}
+
+static inline uint32_t Host_UXTB16(uint32_t x)
+{
+    return x & 0x00FF00FFU;
+}
+
+static inline uint32_t Host_SMLAD(uint32_t x, uint32_t y, uint32_t acc)
+{
+    return acc + (uint32_t)((int16_t)x * (int16_t)y) +
+           (uint32_t)((int16_t)(x >> 16) * (int16_t)(y >> 16));
+}
+
+static inline uint64_t Host_SMLALD(uint32_t x, uint32_t y, uint64_t acc)
+{
+    return acc + (uint64_t)((int64_t)(int16_t)x * (int16_t)y) +
+           (uint64_t)((int64_t)(int16_t)(x >> 16) * (int16_t)(y >> 16));
+}
+
+#define __UADD8     Host_UADD8
+#define __USUB8     Host_USUB8
+#define __UHADD8    Host_UHADD8
+#define __USAD8     Host_USAD8
+#define __SEL       Host_SEL
+#define __UADD16    Host_UADD16
+#define __SADD16    Host_SADD16
+#define __SSUB16    Host_SSUB16
+#define __UXTB16    Host_UXTB16
+#define __SMLAD     Host_SMLAD
+#define __SMLALD    Host_SMLALD
+
+#ifdef __cplusplus
+}
+#endif
+#endif
+
+#include "main.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The cycle counter follows host time at SystemCoreClock
+DWT_Type *Host_DWT(void);
+
+#undef DWT
+#define DWT     Host_DWT()
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __HOST_CMSIS_H */
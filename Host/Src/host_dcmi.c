@@ -0,0 +1,360 @@
+#include "host.h"
+#include "dcmi.h"
+#include "stdlib.h"
+#include "string.h"
+
+// Camera and DMA1 stand-ins. The sensor starts a frame every frame_us;
+// while DCMI is enabled and capturing, the frame's bytes go through the
+// stream DCMI was given, as far as its registers (NDTR, M0AR/M1AR, CT, DBM,
+// CIRC) say, with the transfer-complete callbacks the HAL DMA interrupt
+// would make. DCMI interrupts are raised through the real
+// HAL_DCMI_IRQHandler from RISR/IER, so the firmware's FRAME/VSYNC handling
+// runs unchanged.
+
+#define CAMERA_SLICE        4096U   // bytes handed to DMA per event
+#define CAMERA_ACTIVE_PCT   80U     // share of the frame time carrying data
+
+static const uint8_t *const *cam_jpeg;
+static const uint32_t *cam_jpeg_len;
+static uint32_t cam_jpeg_count;
+static const uint16_t *cam_rgb;
+static uint16_t cam_rgb_w, cam_rgb_h;
+static uint32_t cam_rgb_count;
+static uint32_t cam_frame_us = 33333U;
+static uint8_t cam_running;
+static uint32_t cam_frames, cam_captured;
+
+static uint8_t *cam_out;            // bytes of the frame being sent
+static uint32_t cam_out_size, cam_out_len, cam_out_pos;
+static uint32_t cam_slice_us;
+static uint8_t cam_overrun;         // data lost this frame, OVR raised
+
+static DMA_HandleTypeDef *dma_stream_handle;    // the stream DCMI feeds
+static uint32_t dma_reload;                     // NDTR at each (re)start
+
+static void camera_frame(void *arg);
+static void camera_slice(void *arg);
+
+/* DMA -----------------------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma)
+{
+    ((DMA_Stream_TypeDef *)hdma->Instance)->CR = 0;
+    hdma->ErrorCode = HAL_DMA_ERROR_NONE;
+    hdma->State = HAL_DMA_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_DeInit(DMA_HandleTypeDef *hdma)
+{
+    ((DMA_Stream_TypeDef *)hdma->Instance)->CR = 0;
+    hdma->State = HAL_DMA_STATE_RESET;
+    return HAL_OK;
+}
+
+static HAL_StatusTypeDef dma_start(DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress,
+                                   uint32_t SecondMemAddress, uint32_t DataLength, uint32_t dbm)
+{
+    DMA_Stream_TypeDef *stream = (DMA_Stream_TypeDef *)hdma->Instance;
+
+    if (hdma->State != HAL_DMA_STATE_READY) {
+        return HAL_BUSY;
+    }
+    hdma->State = HAL_DMA_STATE_BUSY;
+    hdma->ErrorCode = HAL_DMA_ERROR_NONE;
+    stream->PAR = SrcAddress;
+    stream->M0AR = DstAddress;
+    stream->M1AR = SecondMemAddress;
+    stream->NDTR = DataLength;
+    stream->CR = (hdma->Init.Mode & DMA_SxCR_CIRC) | dbm | DMA_SxCR_TCIE | DMA_SxCR_EN;
+    if (SrcAddress == (uint32_t)(uintptr_t)&DCMI->DR) {
+        dma_stream_handle = hdma;
+        dma_reload = DataLength;
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress,
+                                   uint32_t DataLength)
+{
+    return dma_start(hdma, SrcAddress, DstAddress, 0, DataLength, 0);
+}
+
+HAL_StatusTypeDef HAL_DMAEx_MultiBufferStart_IT(DMA_HandleTypeDef *hdma, uint32_t SrcAddress,
+                                                uint32_t DstAddress, uint32_t SecondMemAddress,
+                                                uint32_t DataLength)
+{
+    return dma_start(hdma, SrcAddress, DstAddress, SecondMemAddress, DataLength, DMA_SxCR_DBM);
+}
+
+HAL_StatusTypeDef HAL_DMAEx_ChangeMemory(DMA_HandleTypeDef *hdma, uint32_t Address,
+                                         HAL_DMA_MemoryTypeDef memory)
+{
+    DMA_Stream_TypeDef *stream = (DMA_Stream_TypeDef *)hdma->Instance;
+
+    if (memory == MEMORY0) {
+        stream->M0AR = Address;
+    } else {
+        stream->M1AR = Address;
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef *hdma)
+{
+    if (hdma->State != HAL_DMA_STATE_BUSY) {
+        hdma->ErrorCode = HAL_DMA_ERROR_NO_XFER;
+        return HAL_ERROR;
+    }
+    ((DMA_Stream_TypeDef *)hdma->Instance)->CR &= ~DMA_SxCR_EN;
+    hdma->State = HAL_DMA_STATE_READY;
+    return HAL_OK;
+}
+
+// The stream stops at once; the abort callback comes from its interrupt
+static void dma_aborted(void *arg)
+{
+    DMA_HandleTypeDef *hdma = arg;
+
+    hdma->State = HAL_DMA_STATE_READY;
+    if (hdma->XferAbortCallback != NULL) {
+        hdma->XferAbortCallback(hdma);
+    }
+}
+
+HAL_StatusTypeDef HAL_DMA_Abort_IT(DMA_HandleTypeDef *hdma)
+{
+    if (hdma->State != HAL_DMA_STATE_BUSY) {
+        hdma->ErrorCode = HAL_DMA_ERROR_NO_XFER;
+        return HAL_ERROR;
+    }
+    hdma->State = HAL_DMA_STATE_ABORT;
+    ((DMA_Stream_TypeDef *)hdma->Instance)->CR &= ~DMA_SxCR_EN;
+    Host_IrqAfter(1, dma_aborted, hdma);
+    return HAL_OK;
+}
+
+// One word from DCMI into the stream's current target; 0 if the stream is
+// off and the word is lost
+static uint8_t dma_put_word(const uint8_t *word)
+{
+    DMA_HandleTypeDef *hdma = dma_stream_handle;
+    DMA_Stream_TypeDef *stream;
+    void (*cplt)(DMA_HandleTypeDef *hdma);
+    uint32_t addr;
+
+    if (hdma == NULL) {
+        return 0;
+    }
+    stream = (DMA_Stream_TypeDef *)hdma->Instance;
+    if (!(stream->CR & DMA_SxCR_EN) || stream->NDTR == 0U) {
+        return 0;
+    }
+    addr = (stream->CR & DMA_SxCR_CT) ? stream->M1AR : stream->M0AR;
+    memcpy((uint8_t *)(uintptr_t)addr + (dma_reload - stream->NDTR) * 4U, word, 4);
+    if (--stream->NDTR != 0U) {
+        return 1;
+    }
+
+    // Target full: switch or reload, then the transfer-complete interrupt
+    if (stream->CR & DMA_SxCR_DBM) {
+        stream->CR ^= DMA_SxCR_CT;
+        stream->NDTR = dma_reload;
+        cplt = (stream->CR & DMA_SxCR_CT) ? hdma->XferCpltCallback : hdma->XferM1CpltCallback;
+    } else if (stream->CR & DMA_SxCR_CIRC) {
+        stream->NDTR = dma_reload;
+        cplt = hdma->XferCpltCallback;
+    } else {
+        stream->CR &= ~DMA_SxCR_EN;
+        hdma->State = HAL_DMA_STATE_READY;
+        cplt = hdma->XferCpltCallback;
+    }
+    if (cplt != NULL) {
+        cplt(hdma);
+    }
+    return 1;
+}
+
+/* DCMI ----------------------------------------------------------------------*/
+
+// Set a raw flag and take the interrupt if it is enabled. The handler
+// acknowledges through ICR, which is applied afterwards.
+static void dcmi_raise(uint32_t flag)
+{
+    DCMI->RISR = (DCMI->RISR & ~DCMI->ICR) | flag;
+    DCMI->ICR = 0;
+    DCMI->MISR = DCMI->RISR & DCMI->IER;
+    if (DCMI->MISR & flag) {
+        HAL_DCMI_IRQHandler(&hdcmi);
+    }
+    DCMI->RISR &= ~DCMI->ICR;
+    DCMI->ICR = 0;
+    DCMI->MISR = DCMI->RISR & DCMI->IER;
+}
+
+static uint8_t *camera_reserve(uint32_t len)
+{
+    if (len > cam_out_size) {
+        cam_out = realloc(cam_out, len);
+        cam_out_size = len;
+    }
+    return cam_out;
+}
+
+// One RGB565 frame through the crop window and byte/line selection
+static void camera_build_rgb(const uint16_t *pixels)
+{
+    uint32_t cr = DCMI->CR;
+    uint32_t line_bytes = cam_rgb_w * 2U;
+    uint32_t x0 = 0, y0 = 0, nx = line_bytes, ny = cam_rgb_h;
+    uint32_t bsm = (cr & DCMI_CR_BSM) >> DCMI_CR_BSM_Pos;
+    uint32_t oebs = (cr & DCMI_CR_OEBS) ? 1U : 0U;
+    uint32_t oels = (cr & DCMI_CR_OELS) ? 1U : 0U;
+    uint8_t *out;
+
+    if (cr & DCMI_CR_CROP) {
+        x0 = (DCMI->CWSTRTR & DCMI_CWSTRT_HOFFCNT) >> DCMI_CWSTRT_HOFFCNT_Pos;
+        y0 = (DCMI->CWSTRTR & DCMI_CWSTRT_VST) >> DCMI_CWSTRT_VST_Pos;
+        nx = ((DCMI->CWSIZER & DCMI_CWSIZE_CAPCNT) >> DCMI_CWSIZE_CAPCNT_Pos) + 1U;
+        ny = ((DCMI->CWSIZER & DCMI_CWSIZE_VLINE) >> DCMI_CWSIZE_VLINE_Pos) + 1U;
+    }
+    out = camera_reserve(line_bytes * cam_rgb_h + 4U);
+    cam_out_len = 0;
+    for (uint32_t j = 0; j < ny && y0 + j < cam_rgb_h; j++) {
+        const uint16_t *line = pixels + (y0 + j) * cam_rgb_w;
+
+        if ((cr & DCMI_CR_LSM) && (j & 1U) != oels) {
+            continue;
+        }
+        for (uint32_t k = 0; k < nx && x0 + k < line_bytes; k++) {
+            uint32_t b = x0 + k;
+            uint8_t keep;
+
+            switch (bsm) {
+            case 1:  keep = (k & 1U) == oebs; break;            // 1 of 2
+            case 2:  keep = (k & 3U) == oebs; break;            // 1 of 4
+            case 3:  keep = ((k & 3U) >> 1) == oebs; break;     // 2 of 4
+            default: keep = 1; break;
+            }
+            if (keep) {
+                out[cam_out_len++] = (b & 1U) ? (uint8_t)line[b / 2U] : (uint8_t)(line[b / 2U] >> 8);
+            }
+        }
+    }
+}
+
+// Frame start: the next recorded frame, if DCMI is taking one
+static void camera_frame(void *arg)
+{
+    uint32_t cr = DCMI->CR;
+    uint32_t frame = cam_frames++;
+
+    (void)arg;
+    Host_IrqAfter(cam_frame_us, camera_frame, NULL);
+
+    if (cam_out_pos < cam_out_len) {
+        return;     // the previous frame is still going out
+    }
+    cam_out_len = cam_out_pos = 0;
+    if (!(cr & DCMI_CR_ENABLE) || !(cr & DCMI_CR_CAPTURE)) {
+        return;
+    }
+    if (cr & DCMI_CR_JPEG) {
+        uint32_t n;
+
+        if (cam_jpeg_count == 0U) {
+            return;
+        }
+        n = frame % cam_jpeg_count;
+        memcpy(camera_reserve(cam_jpeg_len[n] + 4U), cam_jpeg[n], cam_jpeg_len[n]);
+        cam_out_len = cam_jpeg_len[n];
+    } else {
+        if (cam_rgb_count == 0U) {
+            return;
+        }
+        camera_build_rgb(cam_rgb + (frame % cam_rgb_count) * cam_rgb_w * cam_rgb_h);
+    }
+    // DCMI packs whole words; the sensor pads the last one
+    while (cam_out_len & 3U) {
+        cam_out[cam_out_len++] = 0;
+    }
+    if (cam_out_len == 0U) {
+        return;
+    }
+    cam_captured++;
+    cam_overrun = 0;
+    cam_slice_us = (uint32_t)((uint64_t)cam_frame_us * CAMERA_ACTIVE_PCT / 100U *
+                              CAMERA_SLICE / cam_out_len);
+    dcmi_raise(DCMI_RIS_VSYNC_RIS);
+    Host_IrqAfter(cam_slice_us, camera_slice, NULL);
+}
+
+// The next slice of the frame through DMA; FRAME after the last
+static void camera_slice(void *arg)
+{
+    uint32_t end = cam_out_pos + CAMERA_SLICE;
+
+    (void)arg;
+    if (!(DCMI->CR & DCMI_CR_ENABLE)) {
+        cam_out_pos = cam_out_len;  // stopped mid-frame: the rest is gone
+        return;
+    }
+    if (end > cam_out_len) {
+        end = cam_out_len;
+    }
+    for (; cam_out_pos < end; cam_out_pos += 4U) {
+        if (!dma_put_word(cam_out + cam_out_pos) && !cam_overrun) {
+            cam_overrun = 1;
+            dcmi_raise(DCMI_RIS_OVR_RIS);
+        }
+    }
+    if (cam_out_pos < cam_out_len) {
+        Host_IrqAfter(cam_slice_us, camera_slice, NULL);
+        return;
+    }
+    // Snapshot mode captures one frame
+    if (DCMI->CR & DCMI_CR_CM) {
+        DCMI->CR &= ~DCMI_CR_CAPTURE;
+    }
+    dcmi_raise(DCMI_RIS_FRAME_RIS);
+}
+
+static void camera_run(void)
+{
+    if (!cam_running) {
+        cam_running = 1;
+        Host_IrqAfter(cam_frame_us, camera_frame, NULL);
+    }
+}
+
+void Host_CameraSetJPEG(const uint8_t *const *frames, const uint32_t *lens, uint32_t count)
+{
+    cam_jpeg = frames;
+    cam_jpeg_len = lens;
+    cam_jpeg_count = count;
+    camera_run();
+}
+
+void Host_CameraSetRGB565(const uint16_t *frames, uint16_t w, uint16_t h, uint32_t count)
+{
+    cam_rgb = frames;
+    cam_rgb_w = w;
+    cam_rgb_h = h;
+    cam_rgb_count = count;
+    camera_run();
+}
+
+void Host_CameraSetFrameTime(uint32_t frame_us)
+{
+    cam_frame_us = frame_us;
+}
+
+uint32_t Host_CameraFrames(void)
+{
+    return cam_frames;
+}
+
+uint32_t Host_CameraCaptured(void)
+{
+    return cam_captured;
+}
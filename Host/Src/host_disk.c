@@ -0,0 +1,339 @@
+#include "host.h"
+#include "sdmmc.h"
+#include "fatfs.h"
+#include "string.h"
+#include "stdlib.h"
+#include "fcntl.h"
+#include "unistd.h"
+
+// SD card behind SDMMC1 as a disk image file. The HAL_SD calls the BSP
+// driver makes are answered from the file with the latencies given to
+// Host_DiskOpen; DMA ones complete through HAL_SD_TxCpltCallback /
+// HAL_SD_RxCpltCallback. SDMMC1's IDMA only reaches AXI SRAM (and the
+// flash/QSPI/FMC regions), so a buffer elsewhere ends in an IDMA error as
+// it would on the target.
+
+#define DISK_BLOCK      512U
+
+static int disk_fd = -1;
+static uint32_t disk_sectors;
+static uint32_t disk_read_us, disk_write_us, disk_block_us;
+static uint32_t disk_reads, disk_writes, disk_blocks_written;
+static uint64_t disk_busy_until;    // Host_Now() the card stops programming
+
+static struct {
+    SD_HandleTypeDef *hsd;
+    uint8_t *data;
+    uint32_t block, count;
+} disk_xfer;
+
+static uint8_t disk_dma_reachable(const void *p)
+{
+    uintptr_t a = (uintptr_t)p;
+
+    return a >= D1_AXISRAM_BASE && a < D1_AXISRAM_BASE + 0x80000U;
+}
+
+static uint8_t disk_io(uint8_t write, uint8_t *data, uint32_t block, uint32_t count)
+{
+    size_t len = (size_t)count * DISK_BLOCK;
+    off_t off = (off_t)block * DISK_BLOCK;
+
+    if (disk_fd < 0 || block + count > disk_sectors) {
+        return 0;
+    }
+    if (write) {
+        disk_writes++;
+        disk_blocks_written += count;
+        return pwrite(disk_fd, data, len, off) == (ssize_t)len;
+    }
+    disk_reads++;
+    return pread(disk_fd, data, len, off) == (ssize_t)len;
+}
+
+// The card is still programming the last write
+static void disk_wait_ready(void)
+{
+    uint64_t now = Host_Now();
+
+    if (disk_busy_until > now) {
+        Host_Spend((uint32_t)((disk_busy_until - now) / 1000U));
+    }
+}
+
+HAL_StatusTypeDef HAL_SD_Init(SD_HandleTypeDef *hsd)
+{
+    if (disk_fd < 0) {
+        hsd->ErrorCode = HAL_SD_ERROR_REQUEST_NOT_APPLICABLE;
+        hsd->State = HAL_SD_STATE_RESET;
+        return HAL_ERROR;
+    }
+    hsd->SdCard.CardType = CARD_SDHC_SDXC;
+    hsd->SdCard.CardVersion = CARD_V2_X;
+    hsd->SdCard.Class = 0x5B5U;
+    hsd->SdCard.RelCardAdd = 1U;
+    hsd->SdCard.BlockNbr = disk_sectors;
+    hsd->SdCard.BlockSize = DISK_BLOCK;
+    hsd->SdCard.LogBlockNbr = disk_sectors;
+    hsd->SdCard.LogBlockSize = DISK_BLOCK;
+    hsd->SdCard.CardSpeed = CARD_HIGH_SPEED;
+    hsd->ErrorCode = HAL_SD_ERROR_NONE;
+    hsd->Context = SD_CONTEXT_NONE;
+    hsd->State = HAL_SD_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SD_ConfigWideBusOperation(SD_HandleTypeDef *hsd, uint32_t WideMode)
+{
+    hsd->Init.BusWide = WideMode;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SD_ConfigSpeedBusOperation(SD_HandleTypeDef *hsd, uint32_t SpeedMode)
+{
+    (void)hsd;
+    (void)SpeedMode;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SD_GetCardInfo(const SD_HandleTypeDef *hsd, HAL_SD_CardInfoTypeDef *pCardInfo)
+{
+    pCardInfo->CardType = hsd->SdCard.CardType;
+    pCardInfo->CardVersion = hsd->SdCard.CardVersion;
+    pCardInfo->Class = hsd->SdCard.Class;
+    pCardInfo->RelCardAdd = hsd->SdCard.RelCardAdd;
+    pCardInfo->BlockNbr = hsd->SdCard.BlockNbr;
+    pCardInfo->BlockSize = hsd->SdCard.BlockSize;
+    pCardInfo->LogBlockNbr = hsd->SdCard.LogBlockNbr;
+    pCardInfo->LogBlockSize = hsd->SdCard.LogBlockSize;
+    pCardInfo->CardSpeed = hsd->SdCard.CardSpeed;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SD_GetCardCID(const SD_HandleTypeDef *hsd, HAL_SD_CardCIDTypeDef *pCID)
+{
+    (void)hsd;
+    memset(pCID, 0, sizeof(*pCID));
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SD_GetCardCSD(SD_HandleTypeDef *hsd, HAL_SD_CardCSDTypeDef *pCSD)
+{
+    (void)hsd;
+    memset(pCSD, 0, sizeof(*pCSD));
+    return HAL_OK;
+}
+
+HAL_SD_CardStateTypeDef HAL_SD_GetCardState(SD_HandleTypeDef *hsd)
+{
+    (void)hsd;
+    return (Host_Now() < disk_busy_until) ? HAL_SD_CARD_PROGRAMMING : HAL_SD_CARD_TRANSFER;
+}
+
+HAL_StatusTypeDef HAL_SD_ReadBlocks(SD_HandleTypeDef *hsd, uint8_t *pData, uint32_t BlockAdd,
+                                    uint32_t NumberOfBlocks, uint32_t Timeout)
+{
+    (void)Timeout;
+    if (hsd->State != HAL_SD_STATE_READY) {
+        hsd->ErrorCode |= HAL_SD_ERROR_BUSY;
+        return HAL_ERROR;
+    }
+    disk_wait_ready();
+    Host_Spend(disk_read_us + NumberOfBlocks * disk_block_us);
+    if (!disk_io(0, pData, BlockAdd, NumberOfBlocks)) {
+        hsd->ErrorCode |= HAL_SD_ERROR_ADDR_OUT_OF_RANGE;
+        return HAL_ERROR;
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SD_WriteBlocks(SD_HandleTypeDef *hsd, const uint8_t *pData, uint32_t BlockAdd,
+                                     uint32_t NumberOfBlocks, uint32_t Timeout)
+{
+    (void)Timeout;
+    if (hsd->State != HAL_SD_STATE_READY) {
+        hsd->ErrorCode |= HAL_SD_ERROR_BUSY;
+        return HAL_ERROR;
+    }
+    disk_wait_ready();
+    Host_Spend(NumberOfBlocks * disk_block_us);
+    if (!disk_io(1, (uint8_t *)pData, BlockAdd, NumberOfBlocks)) {
+        hsd->ErrorCode |= HAL_SD_ERROR_ADDR_OUT_OF_RANGE;
+        return HAL_ERROR;
+    }
+    disk_busy_until = Host_Now() + (uint64_t)disk_write_us * 1000U;
+    return HAL_OK;
+}
+
+static void disk_dma_done(void *arg)
+{
+    SD_HandleTypeDef *hsd = arg;
+    uint8_t write = (hsd->Context & SD_CONTEXT_WRITE_SINGLE_BLOCK) ||
+                    (hsd->Context & SD_CONTEXT_WRITE_MULTIPLE_BLOCK);
+    uint8_t ok = disk_dma_reachable(disk_xfer.data) &&
+                 disk_io(write, disk_xfer.data, disk_xfer.block, disk_xfer.count);
+
+    hsd->State = HAL_SD_STATE_READY;
+    hsd->Context = SD_CONTEXT_NONE;
+    if (!ok) {
+        hsd->ErrorCode |= disk_dma_reachable(disk_xfer.data) ? HAL_SD_ERROR_ADDR_OUT_OF_RANGE
+                                                            : HAL_SD_ERROR_DMA;
+        HAL_SD_ErrorCallback(hsd);
+    } else if (write) {
+        disk_busy_until = Host_Now() + (uint64_t)disk_write_us * 1000U;
+        HAL_SD_TxCpltCallback(hsd);
+    } else {
+        HAL_SD_RxCpltCallback(hsd);
+    }
+}
+
+static HAL_StatusTypeDef disk_dma_start(SD_HandleTypeDef *hsd, uint8_t *pData, uint32_t BlockAdd,
+                                        uint32_t NumberOfBlocks, uint32_t context, uint32_t us)
+{
+    uint64_t now = Host_Now();
+
+    if (hsd->State != HAL_SD_STATE_READY) {
+        hsd->ErrorCode |= HAL_SD_ERROR_BUSY;
+        return HAL_BUSY;
+    }
+    hsd->ErrorCode = HAL_SD_ERROR_NONE;
+    hsd->State = HAL_SD_STATE_BUSY;
+    hsd->Context = context | SD_CONTEXT_DMA;
+    disk_xfer.hsd = hsd;
+    disk_xfer.data = pData;
+    disk_xfer.block = BlockAdd;
+    disk_xfer.count = NumberOfBlocks;
+    // A command to a programming card is held until it is ready
+    if (disk_busy_until > now) {
+        us += (uint32_t)((disk_busy_until - now) / 1000U);
+    }
+    Host_IrqAfter(us, disk_dma_done, hsd);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SD_ReadBlocks_DMA(SD_HandleTypeDef *hsd, uint8_t *pData, uint32_t BlockAdd,
+                                        uint32_t NumberOfBlocks)
+{
+    return disk_dma_start(hsd, pData, BlockAdd, NumberOfBlocks,
+                          NumberOfBlocks > 1U ? SD_CONTEXT_READ_MULTIPLE_BLOCK : SD_CONTEXT_READ_SINGLE_BLOCK,
+                          disk_read_us + NumberOfBlocks * disk_block_us);
+}
+
+HAL_StatusTypeDef HAL_SD_WriteBlocks_DMA(SD_HandleTypeDef *hsd, const uint8_t *pData, uint32_t BlockAdd,
+                                         uint32_t NumberOfBlocks)
+{
+    return disk_dma_start(hsd, (uint8_t *)pData, BlockAdd, NumberOfBlocks,
+                          NumberOfBlocks > 1U ? SD_CONTEXT_WRITE_MULTIPLE_BLOCK : SD_CONTEXT_WRITE_SINGLE_BLOCK,
+                          NumberOfBlocks * disk_block_us);
+}
+
+HAL_StatusTypeDef HAL_SD_Erase(SD_HandleTypeDef *hsd, uint32_t BlockStartAdd, uint32_t BlockEndAdd)
+{
+    (void)BlockStartAdd;
+    (void)BlockEndAdd;
+    if (hsd->State != HAL_SD_STATE_READY) {
+        hsd->ErrorCode |= HAL_SD_ERROR_BUSY;
+        return HAL_ERROR;
+    }
+    disk_wait_ready();
+    disk_busy_until = Host_Now() + (uint64_t)disk_write_us * 1000U;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SD_Abort(SD_HandleTypeDef *hsd)
+{
+    Host_IrqCancel(disk_dma_done, hsd);
+    hsd->State = HAL_SD_STATE_READY;
+    hsd->Context = SD_CONTEXT_NONE;
+    return HAL_OK;
+}
+
+uint8_t Host_DiskOpen(const char *path, uint32_t sectors, uint32_t read_us,
+                      uint32_t write_us, uint32_t per_block_us)
+{
+    Host_DiskClose();
+    disk_fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (disk_fd < 0) {
+        return 0;
+    }
+    if (ftruncate(disk_fd, (off_t)sectors * DISK_BLOCK) != 0) {
+        Host_DiskClose();
+        return 0;
+    }
+    disk_sectors = sectors;
+    disk_read_us = read_us;
+    disk_write_us = write_us;
+    disk_block_us = per_block_us;
+    disk_reads = disk_writes = disk_blocks_written = 0;
+    disk_busy_until = 0;
+    return 1;
+}
+
+void Host_DiskSetLatency(uint32_t read_us, uint32_t write_us, uint32_t per_block_us)
+{
+    disk_read_us = read_us;
+    disk_write_us = write_us;
+    disk_block_us = per_block_us;
+}
+
+void Host_DiskClose(void)
+{
+    if (disk_fd >= 0) {
+        close(disk_fd);
+        disk_fd = -1;
+    }
+}
+
+// SDMMC1 set up and FatFs linked to the SD driver, if the firmware has not
+// yet; 1 if FatFs was linked here
+static uint8_t disk_fatfs_setup(void)
+{
+    if (hsd1.Instance == NULL) {
+        MX_SDMMC1_SD_Init();
+    }
+    if (SDPath[0] == '\0') {
+        MX_FATFS_Init();
+        return 1;
+    }
+    return 0;
+}
+
+FRESULT Host_DiskFormat(uint8_t mount)
+{
+    uint8_t *work = malloc(_MAX_SS * 8);
+    uint8_t linked = disk_fatfs_setup();
+    FRESULT res;
+
+    res = f_mkfs(SDPath, FM_ANY, 0, work, _MAX_SS * 8);
+    free(work);
+    if (res == FR_OK && mount) {
+        return f_mount(&SDFatFS, SDPath, 1);
+    }
+    if (linked) {
+        // As it was, for the firmware's own MX_FATFS_Init
+        FATFS_UnLinkDriver(SDPath);
+        SDPath[0] = '\0';
+    }
+    return res;
+}
+
+FRESULT Host_DiskMount(void)
+{
+    disk_fatfs_setup();
+    return f_mount(&SDFatFS, SDPath, 1);
+}
+
+uint32_t Host_DiskReads(void)
+{
+    return disk_reads;
+}
+
+uint32_t Host_DiskWrites(void)
+{
+    return disk_writes;
+}
+
+uint32_t Host_DiskBlocksWritten(void)
+{
+    return disk_blocks_written;
+}
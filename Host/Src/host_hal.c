@@ -0,0 +1,593 @@
+#include "host.h"
+#include "lptim.h"
+#include "stdlib.h"
+#include "string.h"
+#include "signal.h"
+#include "time.h"
+#include "malloc.h"
+#include "unistd.h"
+#include "execinfo.h"
+#include "sys/mman.h"
+#include "sys/time.h"
+
+// Core of the host build: the peripheral address space, time, the
+// interrupt stand-in and the HAL parts that only need to say yes. The
+// peripheral models are in host_dcmi.c, host_i2c.c, host_spi.c and
+// host_disk.c.
+
+#define HOST_EVENTS     64
+
+typedef struct {
+    uint64_t due;                   // Host_Now() to run at
+    uint64_t seq;                   // order among events due together
+    void (*handler)(void *arg);
+    void *arg;
+} Host_EventTypeDef;
+
+uint32_t SystemCoreClock = 480000000U;
+__IO uint32_t uwTick;               // ms added by the firmware itself (Stop mode)
+
+static Host_EventTypeDef host_events[HOST_EVENTS];
+static uint32_t host_num_events;
+static uint64_t host_event_seq;
+static struct timespec host_t0;
+static volatile uint64_t host_skip_ns;  // time jumped over instead of spun
+static uint64_t host_stop_ns;           // of that, spent in Stop mode
+static volatile uint32_t host_primask;
+static volatile uint8_t host_in_irq;
+static void (*host_loop_hook)(void);
+static uint8_t host_in_hook;
+static uint32_t host_failures;
+uint32_t Host_GE;                   // APSR.GE of the DSP emulation (host_cmsis.h)
+
+static void host_alarm(int sig);
+
+#define HOST_AXISRAM_SIZE   0x80000U
+extern uint8_t __sram1_end[];       // host.ld
+
+// No debugger on a fault, as on the target: say where it happened
+static void host_fault(int sig)
+{
+    void *trace[32];
+    int depth = backtrace(trace, 32);
+
+    fprintf(stderr, "host: signal %d\n", sig);
+    backtrace_symbols_fd(trace, depth, STDERR_FILENO);
+    _exit(128 + sig);
+}
+
+// Peripherals and core registers become plain memory at their addresses,
+// before any constructor of the firmware could touch them
+__attribute__((constructor(101))) static void host_init(void)
+{
+    struct sigaction sa;
+
+    // host.ld lays .data, .bss and .sram1 out from the start of AXI SRAM as
+    // the target does; past its end the DMA checks would not match the target
+    if ((uintptr_t)__sram1_end > D1_AXISRAM_BASE + HOST_AXISRAM_SIZE) {
+        fprintf(stderr, "host: AXI SRAM overflowed by %lu bytes\n",
+                (unsigned long)((uintptr_t)__sram1_end - D1_AXISRAM_BASE - HOST_AXISRAM_SIZE));
+        exit(2);
+    }
+    // Reports up to a fault are not lost in the buffer
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    if (mmap((void *)PERIPH_BASE, 0x20000000U, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE | MAP_NORESERVE,
+             -1, 0) != (void *)PERIPH_BASE ||
+        mmap((void *)0xE0000000U, 0x100000U, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0) != (void *)0xE0000000U) {
+        perror("host: peripheral space");
+        exit(2);
+    }
+    // DMA registers hold 32-bit addresses: keep every allocation below 4 GB
+    mallopt(M_MMAP_MAX, 0);
+
+    // Status bits the firmware waits on
+    PWR->D3CR |= PWR_D3CR_VOSRDY;
+
+    clock_gettime(CLOCK_MONOTONIC, &host_t0);
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = host_alarm;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGALRM, &sa, NULL);
+    signal(SIGSEGV, host_fault);
+    signal(SIGBUS, host_fault);
+    signal(SIGABRT, host_fault);
+}
+
+uint64_t Host_Now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)(ts.tv_sec - host_t0.tv_sec) * 1000000000ULL +
+           (uint64_t)(ts.tv_nsec - host_t0.tv_nsec) + host_skip_ns;
+}
+
+static void host_block(sigset_t *old)
+{
+    sigset_t set;
+
+    sigemptyset(&set);
+    sigaddset(&set, SIGALRM);
+    sigprocmask(SIG_BLOCK, &set, old);
+}
+
+static void host_restore(const sigset_t *old)
+{
+    sigprocmask(SIG_SETMASK, old, NULL);
+}
+
+// Earliest pending event; signals blocked
+static Host_EventTypeDef *host_next_event(void)
+{
+    Host_EventTypeDef *next = NULL;
+
+    for (uint32_t i = 0; i < host_num_events; i++) {
+        Host_EventTypeDef *e = &host_events[i];
+
+        if (next == NULL || e->due < next->due || (e->due == next->due && e->seq < next->seq)) {
+            next = e;
+        }
+    }
+    return next;
+}
+
+// The timer goes off when the earliest event is due; signals blocked
+static void host_rearm(void)
+{
+    Host_EventTypeDef *next = host_next_event();
+    struct itimerval it;
+
+    memset(&it, 0, sizeof(it));
+    if (next != NULL) {
+        uint64_t now = Host_Now();
+        uint64_t wait = (next->due > now) ? (next->due - now) / 1000U : 0U;
+
+        if (wait == 0U) {
+            wait = 1U;
+        }
+        it.it_value.tv_sec = (time_t)(wait / 1000000U);
+        it.it_value.tv_usec = (suseconds_t)(wait % 1000000U);
+    }
+    setitimer(ITIMER_REAL, &it, NULL);
+}
+
+// Run every event that is due, in order, as interrupts; signals blocked
+static void host_run_due(void)
+{
+    uint8_t in_irq = host_in_irq;
+    uint32_t ge = Host_GE;          // stacked with the APSR on exception entry
+
+    host_in_irq = 1;
+    for (;;) {
+        Host_EventTypeDef *e = host_next_event();
+        Host_EventTypeDef run;
+
+        if (e == NULL || e->due > Host_Now()) {
+            break;
+        }
+        run = *e;
+        *e = host_events[--host_num_events];
+        run.handler(run.arg);
+    }
+    Host_GE = ge;
+    host_in_irq = in_irq;
+}
+
+static void host_alarm(int sig)
+{
+    (void)sig;
+    host_run_due();
+    host_rearm();
+}
+
+void Host_IrqAfter(uint32_t us, void (*handler)(void *arg), void *arg)
+{
+    sigset_t old;
+
+    host_block(&old);
+    if (host_num_events == HOST_EVENTS) {
+        fprintf(stderr, "host: too many pending interrupts\n");
+        abort();
+    }
+    host_events[host_num_events].due = Host_Now() + (uint64_t)us * 1000U;
+    host_events[host_num_events].seq = host_event_seq++;
+    host_events[host_num_events].handler = handler;
+    host_events[host_num_events].arg = arg;
+    host_num_events++;
+    host_rearm();
+    host_restore(&old);
+}
+
+uint8_t Host_IrqCancel(void (*handler)(void *arg), void *arg)
+{
+    uint8_t found = 0;
+    sigset_t old;
+
+    host_block(&old);
+    for (uint32_t i = 0; i < host_num_events; i++) {
+        if (host_events[i].handler == handler && host_events[i].arg == arg) {
+            host_events[i] = host_events[--host_num_events];
+            found = 1;
+            break;
+        }
+    }
+    host_rearm();
+    host_restore(&old);
+    return found;
+}
+
+void Host_Spend(uint32_t us)
+{
+    uint64_t target = Host_Now() + (uint64_t)us * 1000U;
+    sigset_t old;
+
+    host_block(&old);
+    for (;;) {
+        Host_EventTypeDef *next = host_next_event();
+        uint64_t now = Host_Now();
+
+        // Masked, or already in an interrupt: nothing can preempt
+        if (next == NULL || next->due > target || host_primask || host_in_irq) {
+            if (target > now) {
+                host_skip_ns += target - now;
+            }
+            break;
+        }
+        if (next->due > now) {
+            host_skip_ns += next->due - now;
+        }
+        host_run_due();
+    }
+    host_rearm();
+    host_restore(&old);
+}
+
+uint8_t Host_WaitForInterrupt(void)
+{
+    Host_EventTypeDef *next;
+    sigset_t old;
+    uint64_t now;
+
+    host_block(&old);
+    next = host_next_event();
+    if (next == NULL) {
+        host_restore(&old);
+        return 0;
+    }
+    now = Host_Now();
+    if (next->due > now) {
+        host_skip_ns += next->due - now;
+    }
+    // A masked interrupt still wakes the core; it is taken on unmasking
+    if (!host_primask && !host_in_irq) {
+        host_run_due();
+    }
+    host_rearm();
+    host_restore(&old);
+    return 1;
+}
+
+uint32_t Host_GetPRIMASK(void)
+{
+    return host_primask;
+}
+
+void Host_SetPRIMASK(uint32_t primask)
+{
+    sigset_t set;
+
+    host_primask = primask & 1U;
+    // Inside an interrupt the signal stays blocked until it returns
+    if (host_in_irq) {
+        return;
+    }
+    sigemptyset(&set);
+    sigaddset(&set, SIGALRM);
+    sigprocmask(host_primask ? SIG_BLOCK : SIG_UNBLOCK, &set, NULL);
+}
+
+// CYCCNT follows Host_Now(); a value the firmware wrote (reset to 0) is
+// noticed on the next access and counted on from
+DWT_Type *Host_DWT(void)
+{
+    static DWT_Type dwt;
+    static uint32_t last, offset;
+    uint32_t now = (uint32_t)(Host_Now() * (SystemCoreClock / 1000000U) / 1000U);
+
+    if (dwt.CYCCNT != last) {
+        offset = now - dwt.CYCCNT;
+    }
+    dwt.CYCCNT = now - offset;
+    last = dwt.CYCCNT;
+    return &dwt;
+}
+
+uint32_t Host_Cycles(void)
+{
+    return DWT->CYCCNT;
+}
+
+double Host_Us(uint32_t start, uint32_t end)
+{
+    return (double)(end - start) / (SystemCoreClock / 1000000U);
+}
+
+void Host_SetKey(uint8_t pressed)
+{
+    // K1 pulls PC13 up against its pull-down
+    if (pressed) {
+        KEY_GPIO_Port->IDR |= KEY_Pin;
+    } else {
+        KEY_GPIO_Port->IDR &= ~KEY_Pin;
+    }
+}
+
+void Host_SetLoopHook(void (*hook)(void))
+{
+    host_loop_hook = hook;
+}
+
+void Host_Fail(const char *file, int line, const char *cond)
+{
+    fprintf(stderr, "%s:%d: check failed: %s\n", file, line, cond);
+    host_failures++;
+}
+
+int Host_Result(void)
+{
+    if (host_failures) {
+        fprintf(stderr, "%lu check(s) failed\n", (unsigned long)host_failures);
+    }
+    return host_failures ? 1 : 0;
+}
+
+uint8_t *Host_LoadFile(const char *path, uint32_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    uint8_t *buf = NULL;
+    long size;
+
+    if (f == NULL) {
+        return NULL;
+    }
+    if (fseek(f, 0, SEEK_END) == 0 && (size = ftell(f)) > 0 && fseek(f, 0, SEEK_SET) == 0) {
+        buf = malloc((size_t)size);
+        if (buf != NULL && fread(buf, 1, (size_t)size, f) != (size_t)size) {
+            free(buf);
+            buf = NULL;
+        }
+        *len = (uint32_t)size;
+    }
+    fclose(f);
+    return buf;
+}
+
+// main.c's own Error_Handler blinks forever: stop the program instead
+void Error_Handler(void)
+{
+    fprintf(stderr, "host: Error_Handler\n");
+    abort();
+}
+
+/* HAL core ------------------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_Init(void)
+{
+    return HAL_OK;
+}
+
+// SysTick stops in Stop mode; timelapse.c adds the sleep to uwTick itself
+uint32_t HAL_GetTick(void)
+{
+    return uwTick + (uint32_t)((Host_Now() - host_stop_ns) / 1000000U);
+}
+
+void HAL_Delay(uint32_t Delay)
+{
+    Host_Spend(Delay * 1000U);
+}
+
+void HAL_SuspendTick(void)
+{
+}
+
+void HAL_ResumeTick(void)
+{
+}
+
+uint32_t HAL_GetDEVID(void)
+{
+    return 0x450U;
+}
+
+/* RCC and PWR ---------------------------------------------------------------*/
+
+HAL_StatusTypeDef HAL_RCC_OscConfig(RCC_OscInitTypeDef *RCC_OscInitStruct)
+{
+    (void)RCC_OscInitStruct;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_RCC_ClockConfig(const RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t FLatency)
+{
+    (void)RCC_ClkInitStruct;
+    (void)FLatency;
+    return HAL_OK;
+}
+
+void HAL_RCC_MCOConfig(uint32_t RCC_MCOx, uint32_t RCC_MCOSource, uint32_t RCC_MCODiv)
+{
+    (void)RCC_MCOx;
+    (void)RCC_MCOSource;
+    (void)RCC_MCODiv;
+}
+
+HAL_StatusTypeDef HAL_RCCEx_PeriphCLKConfig(RCC_PeriphCLKInitTypeDef *PeriphClkInit)
+{
+    (void)PeriphClkInit;
+    return HAL_OK;
+}
+
+// The kernel clocks as SystemClock_Config leaves them
+uint32_t HAL_RCCEx_GetPeriphCLKFreq(uint64_t PeriphClk)
+{
+    return (PeriphClk == RCC_PERIPHCLK_SDMMC) ? 200000000U : 120000000U;
+}
+
+HAL_StatusTypeDef HAL_PWREx_ConfigSupply(uint32_t SupplySource)
+{
+    (void)SupplySource;
+    return HAL_OK;
+}
+
+// Asleep until the next interrupt, with the tick stopped
+void HAL_PWR_EnterSTOPMode(uint32_t Regulator, uint8_t STOPEntry)
+{
+    uint64_t start = Host_Now();
+
+    (void)Regulator;
+    (void)STOPEntry;
+    Host_WaitForInterrupt();
+    host_stop_ns += Host_Now() - start;
+}
+
+/* GPIO ----------------------------------------------------------------------*/
+
+// Pins are their IDR/ODR bits: the LCD model reads RS and CS from ODR
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, const GPIO_InitTypeDef *GPIO_Init)
+{
+    (void)GPIOx;
+    (void)GPIO_Init;
+}
+
+void HAL_GPIO_DeInit(GPIO_TypeDef *GPIOx, uint32_t GPIO_Pin)
+{
+    (void)GPIOx;
+    (void)GPIO_Pin;
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(const GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+    if (GPIOx == KEY_GPIO_Port && GPIO_Pin == KEY_Pin && host_loop_hook != NULL &&
+        !host_in_irq && !host_in_hook) {
+        host_in_hook = 1;
+        host_loop_hook();
+        host_in_hook = 0;
+    }
+    return (GPIOx->IDR & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+    if (PinState != GPIO_PIN_RESET) {
+        GPIOx->ODR |= GPIO_Pin;
+    } else {
+        GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+    }
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+    GPIOx->ODR ^= GPIO_Pin;
+}
+
+/* TIM and LPTIM -------------------------------------------------------------*/
+
+// The XCLK and backlight PWM have nothing to model
+HAL_StatusTypeDef HAL_TIM_PWM_Init(TIM_HandleTypeDef *htim)
+{
+    htim->State = HAL_TIM_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_DeInit(TIM_HandleTypeDef *htim)
+{
+    htim->State = HAL_TIM_STATE_RESET;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_ConfigChannel(TIM_HandleTypeDef *htim, const TIM_OC_InitTypeDef *sConfig,
+                                            uint32_t Channel)
+{
+    (void)htim;
+    (void)sConfig;
+    (void)Channel;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+    (void)htim;
+    (void)Channel;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIMEx_PWMN_Start(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+    (void)htim;
+    (void)Channel;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef *htim)
+{
+    htim->State = HAL_TIM_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_DeInit(TIM_HandleTypeDef *htim)
+{
+    htim->State = HAL_TIM_STATE_RESET;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim)
+{
+    (void)htim;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIMEx_MasterConfigSynchronization(TIM_HandleTypeDef *htim,
+                                                        const TIM_MasterConfigTypeDef *sMasterConfig)
+{
+    (void)htim;
+    (void)sMasterConfig;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIMEx_ConfigBreakDeadTime(TIM_HandleTypeDef *htim,
+                                                const TIM_BreakDeadTimeConfigTypeDef *sBreakDeadTimeConfig)
+{
+    (void)htim;
+    (void)sBreakDeadTimeConfig;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_LPTIM_Init(LPTIM_HandleTypeDef *hlptim)
+{
+    hlptim->State = HAL_LPTIM_STATE_READY;
+    return HAL_OK;
+}
+
+static void host_lptim_match(void *arg)
+{
+    HAL_LPTIM_AutoReloadMatchCallback((LPTIM_HandleTypeDef *)arg);
+}
+
+// Counts LPTIM1_TICK_HZ from the LSI up to Period, then interrupts
+HAL_StatusTypeDef HAL_LPTIM_Counter_Start_IT(LPTIM_HandleTypeDef *hlptim, uint32_t Period)
+{
+    Host_IrqCancel(host_lptim_match, hlptim);
+    Host_IrqAfter((uint32_t)((uint64_t)Period * 1000000U / LPTIM1_TICK_HZ), host_lptim_match, hlptim);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_LPTIM_Counter_Stop_IT(LPTIM_HandleTypeDef *hlptim)
+{
+    Host_IrqCancel(host_lptim_match, hlptim);
+    return HAL_OK;
+}
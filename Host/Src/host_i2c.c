@@ -0,0 +1,241 @@
+#include "host.h"
+#include "i2c.h"
+#include "camera.h"
+#include "string.h"
+
+// OV2640 behind I2C1. Register 0xFF selects the bank (0: DSP, 1: sensor)
+// and writes auto-increment the address, as the sensor does; a one-byte
+// write sets the address the next read starts from. The bus runs at about
+// 100 kHz: a polled transfer takes its bus time out of the caller, an
+// interrupt one completes through HAL_I2C_MasterTxCpltCallback or
+// HAL_I2C_ErrorCallback after it.
+
+#define SCCB_START_US   20U     // start, address byte and stop
+#define SCCB_BYTE_US    90U     // nine bit times
+
+static uint8_t sccb_regs[2][256];
+static uint8_t sccb_bank, sccb_addr;
+static uint8_t sccb_init;
+static uint32_t sccb_transactions, sccb_bytes;
+static uint32_t sccb_fail;
+static uint8_t sccb_stall;
+
+static struct {
+    I2C_HandleTypeDef *hi2c;
+    uint8_t buf[64];
+    uint16_t len;
+    uint8_t ok;
+} sccb_it;
+
+// Power-on values the drivers look at
+static void sccb_reset(void)
+{
+    memset(sccb_regs, 0, sizeof(sccb_regs));
+    sccb_regs[1][0x0A] = 0x26;  // PIDH
+    sccb_regs[1][0x0B] = 0x42;  // PIDL
+    sccb_regs[1][0x1C] = 0x7F;  // MIDH
+    sccb_regs[1][0x1D] = 0xA2;  // MIDL
+    sccb_bank = 0;
+    sccb_init = 1;
+}
+
+static void sccb_write(const uint8_t *buf, uint16_t len)
+{
+    if (!sccb_init) {
+        sccb_reset();
+    }
+    sccb_addr = buf[0];
+    for (uint16_t i = 1; i < len; i++, sccb_addr++) {
+        if (sccb_addr == 0xFF) {
+            sccb_bank = buf[i] & 1U;
+        } else if (sccb_bank == 1U && sccb_addr == 0x12 && (buf[i] & 0x80U)) {
+            sccb_reset();   // COM7 SRST
+            sccb_bank = 1;
+        } else {
+            sccb_regs[sccb_bank][sccb_addr] = buf[i];
+        }
+    }
+}
+
+// Whether the sensor acknowledges this transfer
+static uint8_t sccb_ack(uint16_t DevAddress, uint16_t Size)
+{
+    sccb_transactions++;
+    sccb_bytes += Size;
+    if (sccb_fail) {
+        sccb_fail--;
+        return 0;
+    }
+    return (DevAddress & 0xFEU) == OV2640_ADDRESS;
+}
+
+static uint32_t sccb_us(uint16_t Size)
+{
+    return SCCB_START_US + Size * SCCB_BYTE_US;
+}
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef *hi2c)
+{
+    hi2c->State = HAL_I2C_STATE_READY;
+    hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2CEx_ConfigAnalogFilter(I2C_HandleTypeDef *hi2c, uint32_t AnalogFilter)
+{
+    (void)hi2c;
+    (void)AnalogFilter;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2CEx_ConfigDigitalFilter(I2C_HandleTypeDef *hi2c, uint32_t DigitalFilter)
+{
+    (void)hi2c;
+    (void)DigitalFilter;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData,
+                                          uint16_t Size, uint32_t Timeout)
+{
+    if (hi2c->State != HAL_I2C_STATE_READY) {
+        return HAL_BUSY;
+    }
+    if (sccb_stall) {
+        sccb_transactions++;
+        HAL_Delay(Timeout);
+        hi2c->ErrorCode = HAL_I2C_ERROR_TIMEOUT;
+        return HAL_ERROR;
+    }
+    Host_Spend(sccb_us(Size));
+    if (!sccb_ack(DevAddress, Size)) {
+        hi2c->ErrorCode = HAL_I2C_ERROR_AF;
+        return HAL_ERROR;
+    }
+    hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+    sccb_write(pData, Size);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Receive(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData,
+                                         uint16_t Size, uint32_t Timeout)
+{
+    if (hi2c->State != HAL_I2C_STATE_READY) {
+        return HAL_BUSY;
+    }
+    if (sccb_stall) {
+        sccb_transactions++;
+        HAL_Delay(Timeout);
+        hi2c->ErrorCode = HAL_I2C_ERROR_TIMEOUT;
+        return HAL_ERROR;
+    }
+    Host_Spend(sccb_us(Size));
+    if (!sccb_ack(DevAddress, 0)) {
+        hi2c->ErrorCode = HAL_I2C_ERROR_AF;
+        return HAL_ERROR;
+    }
+    if (!sccb_init) {
+        sccb_reset();
+    }
+    hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+    for (uint16_t i = 0; i < Size; i++) {
+        pData[i] = sccb_regs[sccb_bank][sccb_addr++];
+    }
+    return HAL_OK;
+}
+
+static void sccb_it_done(void *arg)
+{
+    I2C_HandleTypeDef *hi2c = arg;
+
+    hi2c->State = HAL_I2C_STATE_READY;
+    if (sccb_it.ok) {
+        hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+        sccb_write(sccb_it.buf, sccb_it.len);
+        HAL_I2C_MasterTxCpltCallback(hi2c);
+    } else {
+        hi2c->ErrorCode = HAL_I2C_ERROR_AF;
+        HAL_I2C_ErrorCallback(hi2c);
+    }
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData,
+                                             uint16_t Size)
+{
+    if (hi2c->State != HAL_I2C_STATE_READY) {
+        return HAL_BUSY;
+    }
+    if (Size > sizeof(sccb_it.buf)) {
+        return HAL_ERROR;
+    }
+    hi2c->State = HAL_I2C_STATE_BUSY_TX;
+    sccb_it.hi2c = hi2c;
+    sccb_it.len = Size;
+    memcpy(sccb_it.buf, pData, Size);
+    if (sccb_stall) {
+        sccb_transactions++;
+        return HAL_OK;  // never finishes
+    }
+    sccb_it.ok = sccb_ack(DevAddress, Size);
+    Host_IrqAfter(sccb_us(sccb_it.ok ? Size : 0), sccb_it_done, hi2c);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Abort_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress)
+{
+    (void)DevAddress;
+    Host_IrqCancel(sccb_it_done, hi2c);
+    hi2c->State = HAL_I2C_STATE_READY;
+    hi2c->ErrorCode = HAL_I2C_ERROR_NONE;
+    return HAL_OK;
+}
+
+// 16-bit register addresses are OV5640 only, which is not fitted
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                    uint16_t MemAddSize, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+    (void)DevAddress;
+    (void)MemAddress;
+    (void)MemAddSize;
+    (void)pData;
+    (void)Timeout;
+    Host_Spend(sccb_us(Size + 2U));
+    sccb_transactions++;
+    sccb_bytes += Size + 2U;
+    hi2c->ErrorCode = HAL_I2C_ERROR_AF;
+    return HAL_ERROR;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint16_t MemAddress,
+                                   uint16_t MemAddSize, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+    return HAL_I2C_Mem_Write(hi2c, DevAddress, MemAddress, MemAddSize, pData, Size, Timeout);
+}
+
+uint32_t Host_I2CTransactions(void)
+{
+    return sccb_transactions;
+}
+
+uint32_t Host_I2CBytes(void)
+{
+    return sccb_bytes;
+}
+
+uint8_t Host_I2CReg(uint8_t bank, uint8_t reg)
+{
+    if (!sccb_init) {
+        sccb_reset();
+    }
+    return sccb_regs[bank & 1U][reg];
+}
+
+void Host_I2CFailNext(uint32_t count)
+{
+    sccb_fail = count;
+}
+
+void Host_I2CStall(uint8_t stall)
+{
+    sccb_stall = stall;
+}
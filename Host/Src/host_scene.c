@@ -0,0 +1,352 @@
+#include "host.h"
+#include "stdlib.h"
+#include "string.h"
+#include "math.h"
+
+// Test scene for the camera: a lit gradient with bars, edges and some sensor
+// noise, so JPEG sizes and image statistics land where a real scene's do
+// rather than at the extremes of a flat or random frame.
+//
+// The JPEG comes from a small baseline encoder of its own (YCbCr 4:4:4,
+// standard tables): the firmware's LibJPEG runs in a 32 KB arena sized for
+// its own uses, which a sensor-sized frame does not fit.
+
+static const uint8_t scene_zigzag[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+};
+
+// Annex K tables, natural order
+static const uint8_t scene_quant[2][64] = {
+    { 16, 11, 10, 16,  24,  40,  51,  61, 12, 12, 14, 19,  26,  58,  60,  55,
+      14, 13, 16, 24,  40,  57,  69,  56, 14, 17, 22, 29,  51,  87,  80,  62,
+      18, 22, 37, 56,  68, 109, 103,  77, 24, 35, 55, 64,  81, 104, 113,  92,
+      49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103,  99 },
+    { 17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+      24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+      99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+      99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99 },
+};
+
+static const uint8_t scene_dc_bits[2][16] = {
+    { 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 },
+};
+static const uint8_t scene_dc_vals[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+static const uint8_t scene_ac_bits[2][16] = {
+    { 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d },
+    { 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 },
+};
+static const uint8_t scene_ac_vals[2][162] = {
+    { 0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+      0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+      0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+      0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+      0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+      0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+      0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+      0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+      0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+      0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+      0xf9, 0xfa },
+    { 0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+      0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+      0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+      0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+      0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+      0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+      0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+      0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+      0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+      0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+      0xf9, 0xfa },
+};
+
+typedef struct {
+    uint16_t code[256];
+    uint8_t size[256];
+} scene_huff_t;
+
+typedef struct {
+    uint8_t *buf;
+    uint32_t len, cap;
+    uint32_t bits;          // pending bits, the last 'nbits' of it
+    uint32_t nbits;
+} scene_out_t;
+
+static void scene_rgb(uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t seed, uint8_t rgb[3])
+{
+    uint32_t n = (x * 1103515245U + y * 12345U + seed * 2654435761U) >> 27;  // 0..31
+    uint32_t r = x * 255U / w;
+    uint32_t g = y * 255U / h;
+    uint32_t b = 128U;
+
+    // Vertical bars across the middle third, a dark square in the corner
+    if (y > h / 3U && y < 2U * h / 3U && ((x * 8U / w) & 1U)) {
+        r = 255U - r;
+        b = 224U;
+    }
+    if (x < w / 4U && y < h / 4U) {
+        r = g = b = 24U;
+    }
+    rgb[0] = (uint8_t)((r + n > 255U) ? 255U : r + n);
+    rgb[1] = (uint8_t)((g + n > 255U) ? 255U : g + n);
+    rgb[2] = (uint8_t)((b + n > 255U) ? 255U : b + n);
+}
+
+void Host_SceneRGB565(uint16_t *pixels, uint16_t w, uint16_t h, uint32_t seed)
+{
+    uint8_t rgb[3];
+
+    for (uint32_t y = 0; y < h; y++) {
+        for (uint32_t x = 0; x < w; x++) {
+            scene_rgb(x, y, w, h, seed, rgb);
+            pixels[y * w + x] = (uint16_t)(((rgb[0] & 0xF8U) << 8) | ((rgb[1] & 0xFCU) << 3) | (rgb[2] >> 3));
+        }
+    }
+}
+
+static void scene_byte(scene_out_t *out, uint8_t b)
+{
+    if (out->len == out->cap) {
+        out->cap = out->cap ? out->cap * 2U : 65536U;
+        out->buf = realloc(out->buf, out->cap);
+        if (out->buf == NULL) {
+            perror("host: scene");
+            exit(2);
+        }
+    }
+    out->buf[out->len++] = b;
+}
+
+static void scene_word(scene_out_t *out, uint16_t w)
+{
+    scene_byte(out, (uint8_t)(w >> 8));
+    scene_byte(out, (uint8_t)w);
+}
+
+// Entropy-coded bits, a zero byte stuffed after every 0xFF
+static void scene_bits(scene_out_t *out, uint32_t code, uint32_t size)
+{
+    if (size == 0U) {
+        return;
+    }
+    out->bits = (out->bits << size) | (code & ((1U << size) - 1U));
+    out->nbits += size;
+    while (out->nbits >= 8U) {
+        uint8_t b = (uint8_t)(out->bits >> (out->nbits - 8U));
+
+        scene_byte(out, b);
+        if (b == 0xFFU) {
+            scene_byte(out, 0);
+        }
+        out->nbits -= 8U;
+    }
+}
+
+static void scene_huff_build(scene_huff_t *huff, const uint8_t bits[16], const uint8_t *vals)
+{
+    uint32_t code = 0, k = 0;
+
+    for (uint32_t len = 1; len <= 16U; len++) {
+        for (uint32_t i = 0; i < bits[len - 1U]; i++, k++) {
+            huff->code[vals[k]] = (uint16_t)code++;
+            huff->size[vals[k]] = (uint8_t)len;
+        }
+        code <<= 1;
+    }
+}
+
+static void scene_dht(scene_out_t *out, uint8_t cls_id, const uint8_t bits[16], const uint8_t *vals)
+{
+    uint32_t n = 0;
+
+    for (uint32_t i = 0; i < 16U; i++) {
+        n += bits[i];
+    }
+    scene_word(out, 0xFFC4);
+    scene_word(out, (uint16_t)(3U + 16U + n));
+    scene_byte(out, cls_id);
+    for (uint32_t i = 0; i < 16U; i++) {
+        scene_byte(out, bits[i]);
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        scene_byte(out, vals[i]);
+    }
+}
+
+// Magnitude category and the bits sent for it, as in F.1.2.1
+static uint32_t scene_category(int v, uint32_t *bits)
+{
+    uint32_t a = (uint32_t)(v < 0 ? -v : v);
+    uint32_t n = 0;
+
+    while (a >> n) {
+        n++;
+    }
+    *bits = (uint32_t)(v < 0 ? v - 1 : v);
+    return n;
+}
+
+static void scene_block(scene_out_t *out, const float block[64], const uint16_t quant[64],
+                        const scene_huff_t *dc, const scene_huff_t *ac, int *prev_dc)
+{
+    static float cosines[8][8];
+    static uint8_t cosines_ready;
+    float tmp[64];
+    int coef[64];
+    uint32_t run = 0, bits, n;
+
+    if (!cosines_ready) {
+        for (uint32_t u = 0; u < 8U; u++) {
+            for (uint32_t x = 0; x < 8U; x++) {
+                cosines[u][x] = cosf((float)((2U * x + 1U) * u) * 3.14159265f / 16.0f) *
+                                (u == 0U ? 0.70710678f : 1.0f) * 0.5f;
+            }
+        }
+        cosines_ready = 1;
+    }
+    // Separable forward DCT: rows, then columns
+    for (uint32_t y = 0; y < 8U; y++) {
+        for (uint32_t u = 0; u < 8U; u++) {
+            float s = 0.0f;
+
+            for (uint32_t x = 0; x < 8U; x++) {
+                s += block[y * 8U + x] * cosines[u][x];
+            }
+            tmp[y * 8U + u] = s;
+        }
+    }
+    for (uint32_t v = 0; v < 8U; v++) {
+        for (uint32_t u = 0; u < 8U; u++) {
+            float s = 0.0f;
+
+            for (uint32_t y = 0; y < 8U; y++) {
+                s += tmp[y * 8U + u] * cosines[v][y];
+            }
+            coef[v * 8U + u] = (int)lrintf(s / (float)quant[v * 8U + u]);
+        }
+    }
+
+    n = scene_category(coef[0] - *prev_dc, &bits);
+    *prev_dc = coef[0];
+    scene_bits(out, dc->code[n], dc->size[n]);
+    scene_bits(out, bits, n);
+    for (uint32_t k = 1; k < 64U; k++) {
+        int v = coef[scene_zigzag[k]];
+
+        if (v == 0) {
+            run++;
+            continue;
+        }
+        while (run > 15U) {
+            scene_bits(out, ac->code[0xF0], ac->size[0xF0]);
+            run -= 16U;
+        }
+        n = scene_category(v, &bits);
+        scene_bits(out, ac->code[(run << 4) | n], ac->size[(run << 4) | n]);
+        scene_bits(out, bits, n);
+        run = 0;
+    }
+    if (run > 0U) {
+        scene_bits(out, ac->code[0x00], ac->size[0x00]);
+    }
+}
+
+uint8_t *Host_SceneJPEG(uint16_t w, uint16_t h, uint32_t seed, int quality, uint32_t *len)
+{
+    scene_out_t out = { 0 };
+    scene_huff_t dc[2], ac[2];
+    uint16_t quant[2][64];
+    uint32_t scale;
+    int prev_dc[3] = { 0, 0, 0 };
+    uint8_t rgb[3];
+    float block[3][64];
+
+    *len = 0;
+    if (w == 0U || h == 0U || quality < 1 || quality > 100) {
+        return NULL;
+    }
+    scale = (quality < 50) ? 5000U / (uint32_t)quality : 200U - 2U * (uint32_t)quality;
+    for (uint32_t t = 0; t < 2U; t++) {
+        for (uint32_t i = 0; i < 64U; i++) {
+            uint32_t q = (scene_quant[t][i] * scale + 50U) / 100U;
+
+            quant[t][i] = (uint16_t)(q < 1U ? 1U : q > 255U ? 255U : q);
+        }
+        scene_huff_build(&dc[t], scene_dc_bits[t], scene_dc_vals);
+        scene_huff_build(&ac[t], scene_ac_bits[t], scene_ac_vals[t]);
+    }
+
+    scene_word(&out, 0xFFD8);                       // SOI
+    scene_word(&out, 0xFFE0);                       // APP0 JFIF 1.01
+    scene_word(&out, 16);
+    scene_byte(&out, 'J');
+    scene_byte(&out, 'F');
+    scene_byte(&out, 'I');
+    scene_byte(&out, 'F');
+    scene_byte(&out, 0);
+    scene_word(&out, 0x0101);
+    scene_byte(&out, 0);
+    scene_word(&out, 1);
+    scene_word(&out, 1);
+    scene_word(&out, 0);
+    for (uint32_t t = 0; t < 2U; t++) {             // DQT
+        scene_word(&out, 0xFFDB);
+        scene_word(&out, 67);
+        scene_byte(&out, (uint8_t)t);
+        for (uint32_t i = 0; i < 64U; i++) {
+            scene_byte(&out, (uint8_t)quant[t][scene_zigzag[i]]);
+        }
+    }
+    scene_word(&out, 0xFFC0);                       // SOF0, 4:4:4
+    scene_word(&out, 17);
+    scene_byte(&out, 8);
+    scene_word(&out, h);
+    scene_word(&out, w);
+    scene_byte(&out, 3);
+    for (uint8_t c = 0; c < 3U; c++) {
+        scene_byte(&out, (uint8_t)(c + 1U));
+        scene_byte(&out, 0x11);
+        scene_byte(&out, c ? 1U : 0U);
+    }
+    for (uint8_t t = 0; t < 2U; t++) {              // DHT
+        scene_dht(&out, t, scene_dc_bits[t], scene_dc_vals);
+        scene_dht(&out, (uint8_t)(0x10U | t), scene_ac_bits[t], scene_ac_vals[t]);
+    }
+    scene_word(&out, 0xFFDA);                       // SOS
+    scene_word(&out, 12);
+    scene_byte(&out, 3);
+    for (uint8_t c = 0; c < 3U; c++) {
+        scene_byte(&out, (uint8_t)(c + 1U));
+        scene_byte(&out, c ? 0x11U : 0x00U);
+    }
+    scene_byte(&out, 0);
+    scene_byte(&out, 63);
+    scene_byte(&out, 0);
+
+    for (uint32_t by = 0; by < h; by += 8U) {
+        for (uint32_t bx = 0; bx < w; bx += 8U) {
+            for (uint32_t i = 0; i < 64U; i++) {
+                // Edge pixels repeat into the padding
+                uint32_t x = bx + (i & 7U), y = by + (i >> 3);
+
+                scene_rgb(x < w ? x : w - 1U, y < h ? y : h - 1U, w, h, seed, rgb);
+                block[0][i] = 0.299f * rgb[0] + 0.587f * rgb[1] + 0.114f * rgb[2] - 128.0f;
+                block[1][i] = -0.168736f * rgb[0] - 0.331264f * rgb[1] + 0.5f * rgb[2];
+                block[2][i] = 0.5f * rgb[0] - 0.418688f * rgb[1] - 0.081312f * rgb[2];
+            }
+            for (uint32_t c = 0; c < 3U; c++) {
+                scene_block(&out, block[c], quant[c ? 1 : 0], &dc[c ? 1 : 0], &ac[c ? 1 : 0], &prev_dc[c]);
+            }
+        }
+    }
+    scene_bits(&out, 0x7FU, (8U - out.nbits) & 7U); // last byte padded with ones
+    scene_word(&out, 0xFFD9);                       // EOI
+
+    *len = out.len;
+    return out.buf;
+}
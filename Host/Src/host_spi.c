@@ -0,0 +1,199 @@
+#include "host.h"
+#include "spi.h"
+#include "preview.h"
+#include "st7735.h"
+#include "string.h"
+#include "stdlib.h"
+
+// ST7735 behind SPI4. Bytes are decoded as the controller does, with RS
+// (LCD_WR_RS, low for a command) read from its ODR bit: CASET/RASET set the
+// window and RAMWR fills it, high byte of each pixel first, into a copy of
+// the controller RAM. SPI4 runs at 15 MHz (APB2 / 8); a polled transfer
+// takes its bus time out of the caller, a DMA one completes through
+// HAL_SPI_TxCpltCallback after it.
+
+#define LCD_SPI_HZ      15000000U
+
+// On the heap: host-only state stays out of the target's AXI SRAM budget
+static uint16_t (*lcd_ram)[HOST_LCD_RAM_W];
+static uint8_t lcd_cmd;
+static uint8_t lcd_args[4];
+static uint32_t lcd_nargs;
+static uint16_t lcd_xs, lcd_xe, lcd_ys, lcd_ye;
+static uint16_t lcd_x, lcd_y;
+static uint8_t lcd_hi, lcd_have_hi;
+static uint32_t lcd_written;            // pixels since RAMWR
+static uint32_t lcd_frames;
+
+static struct {
+    uint8_t *data;
+    uint16_t len;
+    uint8_t rs;
+} lcd_dma;
+
+__attribute__((constructor)) static void lcd_init(void)
+{
+    lcd_ram = calloc(HOST_LCD_RAM_H, sizeof(*lcd_ram));
+}
+
+static void lcd_pixel(uint16_t pixel)
+{
+    if (lcd_y > lcd_ye) {
+        return;     // window full: the controller drops the rest
+    }
+    if (lcd_x < HOST_LCD_RAM_W && lcd_y < HOST_LCD_RAM_H) {
+        lcd_ram[lcd_y][lcd_x] = pixel;
+    }
+    if (++lcd_x > lcd_xe) {
+        lcd_x = lcd_xs;
+        lcd_y++;
+    }
+    // A whole preview-sized window is a displayed frame
+    if (++lcd_written == (uint32_t)(lcd_xe - lcd_xs + 1U) * (lcd_ye - lcd_ys + 1U) &&
+        lcd_written >= PREVIEW_WIDTH * PREVIEW_HEIGHT) {
+        lcd_frames++;
+    }
+}
+
+static void lcd_bytes(const uint8_t *data, uint32_t len, uint8_t rs)
+{
+    for (uint32_t i = 0; i < len; i++) {
+        uint8_t b = data[i];
+
+        if (!rs) {
+            lcd_cmd = b;
+            lcd_nargs = 0;
+            if (b == ST7735_WRITE_RAM) {
+                lcd_x = lcd_xs;
+                lcd_y = lcd_ys;
+                lcd_have_hi = 0;
+                lcd_written = 0;
+            }
+            continue;
+        }
+        if (lcd_cmd == ST7735_WRITE_RAM) {
+            if (lcd_have_hi) {
+                lcd_pixel((uint16_t)(lcd_hi << 8) | b);
+            } else {
+                lcd_hi = b;
+            }
+            lcd_have_hi ^= 1U;
+        } else if (lcd_cmd == ST7735_CASET || lcd_cmd == ST7735_RASET) {
+            if (lcd_nargs < 4U) {
+                lcd_args[lcd_nargs++] = b;
+            }
+            if (lcd_nargs == 4U) {
+                uint16_t s = (uint16_t)(lcd_args[0] << 8) | lcd_args[1];
+                uint16_t e = (uint16_t)(lcd_args[2] << 8) | lcd_args[3];
+
+                if (lcd_cmd == ST7735_CASET) {
+                    lcd_xs = s;
+                    lcd_xe = e;
+                } else {
+                    lcd_ys = s;
+                    lcd_ye = e;
+                }
+            }
+        }
+    }
+}
+
+static uint8_t lcd_selected(uint8_t *rs)
+{
+    *rs = (LCD_WR_RS_GPIO_Port->ODR & LCD_WR_RS_Pin) ? 1U : 0U;
+    return (LCD_CS_GPIO_Port->ODR & LCD_CS_Pin) == 0U;
+}
+
+static uint32_t spi_us(uint32_t len)
+{
+    return (uint32_t)((uint64_t)len * 8U * 1000000U / LCD_SPI_HZ);
+}
+
+HAL_StatusTypeDef HAL_SPI_Init(SPI_HandleTypeDef *hspi)
+{
+    hspi->State = HAL_SPI_STATE_READY;
+    hspi->ErrorCode = HAL_SPI_ERROR_NONE;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef *hspi, const uint8_t *pData, uint16_t Size,
+                                   uint32_t Timeout)
+{
+    uint8_t rs;
+
+    (void)Timeout;
+    if (hspi->State != HAL_SPI_STATE_READY) {
+        return HAL_BUSY;
+    }
+    Host_Spend(spi_us(Size));
+    if (lcd_selected(&rs)) {
+        lcd_bytes(pData, Size, rs);
+    }
+    return HAL_OK;
+}
+
+// Nothing to read back: the panel's MISO is not wired
+HAL_StatusTypeDef HAL_SPI_Receive(SPI_HandleTypeDef *hspi, uint8_t *pData, uint16_t Size, uint32_t Timeout)
+{
+    (void)Timeout;
+    if (hspi->State != HAL_SPI_STATE_READY) {
+        return HAL_BUSY;
+    }
+    Host_Spend(spi_us(Size));
+    memset(pData, 0, Size);
+    return HAL_OK;
+}
+
+// The controller sees the data as DMA reads it, by the time it completes
+static void spi_dma_done(void *arg)
+{
+    SPI_HandleTypeDef *hspi = arg;
+
+    lcd_bytes(lcd_dma.data, lcd_dma.len, lcd_dma.rs);
+    hspi->State = HAL_SPI_STATE_READY;
+    HAL_SPI_TxCpltCallback(hspi);
+}
+
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef *hspi, const uint8_t *pData, uint16_t Size)
+{
+    uint8_t rs;
+
+    if (hspi->State != HAL_SPI_STATE_READY) {
+        return HAL_BUSY;
+    }
+    hspi->State = HAL_SPI_STATE_BUSY_TX;
+    lcd_dma.data = lcd_selected(&rs) ? (uint8_t *)pData : NULL;
+    lcd_dma.len = (lcd_dma.data != NULL) ? Size : 0U;
+    lcd_dma.rs = rs;
+    Host_IrqAfter(spi_us(Size), spi_dma_done, hspi);
+    return HAL_OK;
+}
+
+uint32_t Host_LcdFrames(void)
+{
+    return lcd_frames;
+}
+
+uint16_t Host_LcdPixel(uint16_t x, uint16_t y)
+{
+    return (x < HOST_LCD_RAM_W && y < HOST_LCD_RAM_H) ? lcd_ram[y][x] : 0U;
+}
+
+uint8_t Host_LcdSave(const char *path)
+{
+    FILE *f = fopen(path, "wb");
+
+    if (f == NULL) {
+        return 0;
+    }
+    fprintf(f, "P6\n%d %d\n255\n", HOST_LCD_RAM_W, HOST_LCD_RAM_H);
+    for (uint32_t y = 0; y < HOST_LCD_RAM_H; y++) {
+        for (uint32_t x = 0; x < HOST_LCD_RAM_W; x++) {
+            uint16_t p = lcd_ram[y][x];
+            uint8_t rgb[3] = { (uint8_t)((p >> 8) & 0xF8U), (uint8_t)((p >> 3) & 0xFCU), (uint8_t)(p << 3) };
+
+            fwrite(rgb, 1, 3, f);
+        }
+    }
+    return fclose(f) == 0;
+}
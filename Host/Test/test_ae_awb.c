@@ -0,0 +1,154 @@
+#include "host.h"
+#include "stdlib.h"
+#include "string.h"
+#include "math.h"
+#include "ae_awb.h"
+
+// AeAwb_ComputeStats against the same statistics in floating point: every
+// AE_STEP-th pixel of every AE_STEP-th row, channels scaled to 0..1 and
+// BT.601 luma. Means and the maximum must agree to 1/256 of full scale (one
+// step of the 0..255 level the exposure loop works in), colour means to
+// 1/2048, and each sample must land in the histogram bin of its float luma,
+// or a neighbour when that is within rounding of the edge between them.
+
+#define TEST_W          PREVIEW_WIDTH
+#define TEST_H          PREVIEW_HEIGHT
+#define TEST_TOL_Y      128     // Q15
+#define TEST_TOL_RGB    16      // Q15
+#define TEST_EDGE       0.002   // of full scale, for histogram bins
+
+// DCMI stores the high byte first; the host is little-endian
+static uint16_t swap(uint16_t v)
+{
+    return (uint16_t)((v >> 8) | (v << 8));
+}
+
+static double luma(uint16_t px, double *r, double *g, double *b)
+{
+    *r = (double)(px >> 11) / 31.0;
+    *g = (double)((px >> 5) & 0x3FU) / 63.0;
+    *b = (double)(px & 0x1FU) / 31.0;
+    return 0.299 * *r + 0.587 * *g + 0.114 * *b;
+}
+
+static uint32_t bin(double y)
+{
+    int32_t i = (int32_t)floor(y * AE_HIST_BINS);
+
+    return (uint32_t)(i < 0 ? 0 : (i >= AE_HIST_BINS ? AE_HIST_BINS - 1 : i));
+}
+
+static uint8_t near(int32_t q15, double ref, int32_t tol)
+{
+    return fabs((double)q15 - ref * 32767.0) <= (double)tol;
+}
+
+// 'frame' in native order; w x h. Quiet (what NULL) unless it fails.
+static void check_frame(const char *what, const uint16_t *frame, uint16_t w, uint16_t h)
+{
+    static uint16_t dcmi[TEST_W * TEST_H];
+    uint32_t lo[AE_HIST_BINS] = { 0 }, hi[AE_HIST_BINS] = { 0 };
+    double sum_y = 0, sum_r = 0, sum_g = 0, sum_b = 0, max_y = -1, at_max = 0;
+    AeAwb_StatsTypeDef st;
+    uint32_t n = 0, hist_ok = 1;
+    uint8_t ok;
+
+    for (uint32_t i = 0; i < (uint32_t)w * h; i++) {
+        dcmi[i] = swap(frame[i]);
+    }
+    AeAwb_ComputeStats(dcmi, w, h, &st);
+
+    for (uint32_t y = 0; y < h; y += AE_STEP) {
+        for (uint32_t x = 0; x < w; x += AE_STEP, n++) {
+            double r, g, b, l = luma(frame[y * w + x], &r, &g, &b);
+            uint32_t b0 = bin(l - TEST_EDGE), b1 = bin(l + TEST_EDGE);
+
+            sum_y += l;
+            sum_r += r;
+            sum_g += g;
+            sum_b += b;
+            if (l > max_y) {
+                max_y = l;
+            }
+            if (n == st.max_index) {
+                at_max = l;
+            }
+            // Sure of the bin if both ends of the rounding agree
+            if (b0 == b1) {
+                lo[b0]++;
+            }
+            for (uint32_t k = b0; k <= b1; k++) {
+                hi[k]++;
+            }
+        }
+    }
+    for (uint32_t k = 0; k < AE_HIST_BINS; k++) {
+        hist_ok &= (st.hist[k] >= lo[k] && st.hist[k] <= hi[k]);
+    }
+
+    ok = (st.samples == n);
+    ok &= near(st.mean_y, sum_y / n, TEST_TOL_Y) && near(st.max_y, max_y, TEST_TOL_Y);
+    ok &= near(st.max_y, at_max, TEST_TOL_Y);
+    ok &= near(st.mean_r, sum_r / n, TEST_TOL_RGB) && near(st.mean_g, sum_g / n, TEST_TOL_RGB);
+    ok &= near(st.mean_b, sum_b / n, TEST_TOL_RGB);
+    ok &= hist_ok;
+    HOST_CHECK(ok);
+    if (what == NULL && ok) {
+        return;
+    }
+    printf("%-10s %3ux%-3u %3u samples: Y mean %5d (float %7.1f) max %5d (%7.1f), "
+           "RGB %5d %5d %5d (%7.1f %7.1f %7.1f), histogram %s%s\n",
+           what ? what : "ramp", w, h, st.samples,
+           st.mean_y, sum_y / n * 32767.0, st.max_y, max_y * 32767.0,
+           st.mean_r, st.mean_g, st.mean_b, sum_r / n * 32767.0, sum_g / n * 32767.0,
+           sum_b / n * 32767.0, hist_ok ? "ok" : "differs", ok ? "" : "  MISMATCH");
+}
+
+static void flat(const char *what, uint16_t *frame, uint16_t px)
+{
+    for (uint32_t i = 0; i < TEST_W * TEST_H; i++) {
+        frame[i] = px;
+    }
+    check_frame(what, frame, TEST_W, TEST_H);
+}
+
+int main(void)
+{
+    static uint16_t frame[TEST_W * TEST_H];
+    uint32_t seed = 1;
+
+    for (uint32_t s = 1; s <= 4; s++) {
+        char what[16];
+
+        Host_SceneRGB565(frame, TEST_W, TEST_H, s);
+        snprintf(what, sizeof(what), "scene %lu", (unsigned long)s);
+        check_frame(what, frame, TEST_W, TEST_H);
+    }
+    // A smaller window takes fewer samples, and ragged edges
+    check_frame("scene 4", frame, 37, 21);
+
+    flat("black", frame, 0x0000);
+    flat("white", frame, 0xFFFF);
+    flat("red", frame, 0xF800);
+    flat("green", frame, 0x07E0);
+    flat("blue", frame, 0x001F);
+    flat("grey", frame, 0x8410);
+
+    // Every RGB565 value once across the samples of a few frames
+    for (uint32_t base = 0; base < 0x10000U; base += AE_MAX_SAMPLES) {
+        for (uint32_t i = 0; i < TEST_W * TEST_H; i++) {
+            uint32_t sample = (i / TEST_W / AE_STEP) * (TEST_W / AE_STEP) + (i % TEST_W) / AE_STEP;
+
+            frame[i] = (uint16_t)(base + sample);
+        }
+        check_frame((base % (16U * AE_MAX_SAMPLES) == 0U) ? "ramp" : NULL, frame, TEST_W, TEST_H);
+    }
+
+    for (uint32_t i = 0; i < TEST_W * TEST_H; i++) {
+        seed = seed * 1103515245U + 12345U;
+        frame[i] = (uint16_t)(seed >> 16);
+    }
+    check_frame("noise", frame, TEST_W, TEST_H);
+
+    return Host_Result();
+}
@@ -0,0 +1,170 @@
+#include "host.h"
+#include "string.h"
+#include "i2c.h"
+#include "camera.h"
+
+// The register layer's queue against the SCCB stand-in, counting the
+// transfers that reach the bus: runs of consecutive registers coalesced
+// into one auto-increment burst while the bus is busy, unchanged values
+// skipped, the cache entries of a failed transfer dropped so a retry goes
+// out, and a stalled bus given up on at the handle's timeout.
+
+#define TEST_TIMEOUT_MS 100U
+
+static Camera_HandleTypeDef cam;
+
+static uint32_t bus_since(uint32_t start)
+{
+    return Host_I2CTransactions() - start;
+}
+
+static uint8_t cached(uint16_t reg)
+{
+    uint8_t val;
+
+    return Camera_RegLookup(&cam, reg, &val) == Camera_OK;
+}
+
+// 16 consecutive registers: the first goes out at once, the other 15 wait
+// behind it as one burst (14 of them merged into the second's transfer);
+// without auto-increment each is a transfer
+static void test_coalesce(uint8_t burst)
+{
+    Camera_RegStatsTypeDef before, after;
+    uint32_t start = Host_I2CTransactions();
+    uint8_t base = burst ? 0x10 : 0x30;
+
+    cam.reg_burst = burst;
+    Camera_RegGetStats(&before);
+    for (uint8_t i = 0; i < 16; i++) {
+        HOST_CHECK(Camera_RegWrite(&cam, base + i, 0xA0 + i, CAMERA_REG_CACHED) == Camera_OK);
+    }
+    HOST_CHECK(Camera_RegFlush(&cam) == Camera_OK);
+    Camera_RegGetStats(&after);
+
+    HOST_CHECK(bus_since(start) == (burst ? 2U : 16U));
+    HOST_CHECK(after.coalesced - before.coalesced == (burst ? 14U : 0U));
+    HOST_CHECK(after.transactions - before.transactions == bus_since(start));
+    for (uint8_t i = 0; i < 16; i++) {
+        HOST_CHECK(Host_I2CReg(0, base + i) == 0xA0 + i);
+    }
+    printf("16 consecutive writes, auto-increment %s: %lu transfers\n", burst ? "on" : "off",
+           (unsigned long)bus_since(start));
+
+    // The same values again never reach the bus; VOLATILE ones always do
+    start = Host_I2CTransactions();
+    Camera_RegGetStats(&before);
+    for (uint8_t i = 0; i < 16; i++) {
+        Camera_RegWrite(&cam, base + i, 0xA0 + i, CAMERA_REG_CACHED);
+    }
+    HOST_CHECK(Camera_RegFlush(&cam) == Camera_OK);
+    Camera_RegGetStats(&after);
+    HOST_CHECK(bus_since(start) == 0U);
+    HOST_CHECK(after.skipped - before.skipped == 16U);
+    Camera_RegWrite(&cam, base, 0xA0, CAMERA_REG_VOLATILE);
+    HOST_CHECK(Camera_RegFlush(&cam) == Camera_OK);
+    HOST_CHECK(bus_since(start) == 1U);
+    HOST_CHECK(!cached(base));
+}
+
+// Out of order registers are separate transfers, and a queue longer than
+// CAMERA_REG_QUEUE_LEN drains into the bus instead of dropping writes
+static void test_queue_full(void)
+{
+    uint32_t start = Host_I2CTransactions();
+    uint32_t n = 2U * CAMERA_REG_QUEUE_LEN + 5U;
+
+    cam.reg_burst = 1;
+    for (uint32_t i = 0; i < n; i++) {
+        Camera_RegWrite(&cam, (uint8_t)(0x80 + 2U * (i % 64U)), (uint8_t)i, CAMERA_REG_CACHED);
+    }
+    HOST_CHECK(Camera_RegFlush(&cam) == Camera_OK);
+    HOST_CHECK(bus_since(start) == n);
+    for (uint32_t i = n - 64U; i < n; i++) {
+        HOST_CHECK(Host_I2CReg(0, (uint8_t)(0x80 + 2U * (i % 64U))) == (uint8_t)i);
+    }
+}
+
+// A transfer the sensor does not acknowledge fails the flush and drops its
+// registers from the cache, a whole burst at once, so the retry is sent
+static void test_failure(void)
+{
+    uint32_t start;
+
+    cam.reg_burst = 1;
+    // Bus busy with 0x50 while 0x58..0x5B queue up as one burst, which fails
+    Camera_RegWrite(&cam, 0x50, 0x01, CAMERA_REG_CACHED);
+    Host_I2CFailNext(1);    // counts from the next transfer to start
+    for (uint8_t i = 0; i < 4; i++) {
+        Camera_RegWrite(&cam, 0x58 + i, 0x11 + i, CAMERA_REG_CACHED);
+    }
+    HOST_CHECK(Camera_RegFlush(&cam) == camera_ERROR);
+    HOST_CHECK(Camera_RegFlush(&cam) == Camera_OK);     // the error is reported once
+    HOST_CHECK(Host_I2CReg(0, 0x50) == 0x01 && cached(0x50));
+    for (uint8_t i = 0; i < 4; i++) {
+        HOST_CHECK(Host_I2CReg(0, 0x58 + i) != 0x11 + i);
+        HOST_CHECK(!cached(0x58 + i));
+    }
+
+    start = Host_I2CTransactions();
+    for (uint8_t i = 0; i < 4; i++) {
+        Camera_RegWrite(&cam, 0x58 + i, 0x11 + i, CAMERA_REG_CACHED);
+    }
+    HOST_CHECK(Camera_RegFlush(&cam) == Camera_OK);
+    HOST_CHECK(bus_since(start) == 2U);
+    for (uint8_t i = 0; i < 4; i++) {
+        HOST_CHECK(Host_I2CReg(0, 0x58 + i) == 0x11 + i && cached(0x58 + i));
+    }
+
+    // Reads are polled: a failed address phase fails the read, which is not
+    // cached, instead of returning whatever register the sensor points at
+    uint8_t val = 0;
+    Host_I2CFailNext(1);
+    HOST_CHECK(Camera_RegRead(&cam, 0x58, &val, CAMERA_REG_VOLATILE) == camera_ERROR);
+    HOST_CHECK(Camera_RegRead(&cam, 0x5A, &val, CAMERA_REG_VOLATILE) == Camera_OK && val == 0x13);
+}
+
+// A bus that never finishes: the flush gives up after the handle's timeout,
+// aborts the transfer and forgets everything still queued
+static void test_stall(void)
+{
+    uint32_t tick;
+    uint32_t start;
+
+    cam.reg_burst = 1;
+    Host_I2CStall(1);
+    Camera_RegWrite(&cam, 0x60, 0x21, CAMERA_REG_CACHED);
+    Camera_RegWrite(&cam, 0x62, 0x22, CAMERA_REG_CACHED);
+    Camera_RegWrite(&cam, 0x63, 0x23, CAMERA_REG_CACHED);
+    tick = HAL_GetTick();
+    HOST_CHECK(Camera_RegFlush(&cam) == camera_ERROR);
+    tick = HAL_GetTick() - tick;
+    HOST_CHECK(tick >= TEST_TIMEOUT_MS && tick <= TEST_TIMEOUT_MS + 20U);
+    HOST_CHECK(!cached(0x60) && !cached(0x62) && !cached(0x63));
+    HOST_CHECK(hi2c1.State == HAL_I2C_STATE_READY);
+    printf("stalled bus given up after %lu ms\n", (unsigned long)tick);
+
+    Host_I2CStall(0);
+    start = Host_I2CTransactions();
+    Camera_RegWrite(&cam, 0x60, 0x21, CAMERA_REG_CACHED);
+    Camera_RegWrite(&cam, 0x62, 0x22, CAMERA_REG_CACHED);
+    Camera_RegWrite(&cam, 0x63, 0x23, CAMERA_REG_CACHED);
+    HOST_CHECK(Camera_RegFlush(&cam) == Camera_OK);
+    HOST_CHECK(bus_since(start) == 2U);
+    HOST_CHECK(Host_I2CReg(0, 0x60) == 0x21 && Host_I2CReg(0, 0x63) == 0x23);
+}
+
+int main(void)
+{
+    MX_I2C1_Init();
+    cam.hi2c = &hi2c1;
+    cam.addr = OV2640_ADDRESS;
+    cam.timeout = TEST_TIMEOUT_MS;
+
+    test_coalesce(1);
+    test_coalesce(0);
+    test_queue_full();
+    test_failure();
+    test_stall();
+    return Host_Result();
+}
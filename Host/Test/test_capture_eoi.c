@@ -0,0 +1,199 @@
+#include "host.h"
+#include "stdlib.h"
+#include "string.h"
+#include "capture.h"
+
+// Streaming capture trims the file at EOI, which may sit anywhere relative
+// to the 32 KB chunks DMA fills: ending one exactly, split across two with
+// 0xFF last in one and 0xD9 first in the next, or starting one. Each frame
+// is a real JPEG padded with COM segments to put EOI there, behind bytes the
+// sensor sends before SOI and followed by padding after EOI; the saved file
+// must be SOI..EOI exactly.
+
+#define TEST_DISK       HOST_OUT_DIR "/test_capture_eoi.img"
+#define TEST_TIMEOUT_MS 60000U
+#define TEST_CHUNK      (32U * 1024U)   // STREAM_CHUNK_SIZE in capture.c
+
+int Firmware_Main(void);
+
+typedef struct {
+    uint32_t chunk;     // EOI near the start of this chunk of the frame
+    int32_t at;         // offset of its 0xFF from that chunk's start
+    uint32_t pre;       // bytes before SOI
+    uint32_t post;      // bytes after EOI
+} Case_TypeDef;
+
+static const Case_TypeDef cases[] = {
+    { 1, -2, 0, 0 },    // EOI ends chunk 0, frame ends with it
+    { 1, -1, 0, 0 },    // split, 0xD9 alone in the last chunk
+    { 1,  0, 0, 0 },    // EOI starts the last chunk
+    { 2, -2, 6, 300 },
+    { 2, -1, 6, 300 },  // split, padding after it
+    { 2,  0, 6, 300 },
+    { 3, -1, 1, 3 },
+    { 3, -1, 0, 40000 },    // padding fills chunks: nothing from EOI on is drained
+    { 2, -1000, 0, 70000 },
+};
+#define NUM_CASES (sizeof(cases) / sizeof(cases[0]))
+
+static uint8_t *base;
+static uint32_t base_len;
+static uint8_t *frame;
+static uint32_t frame_len;
+static uint8_t *jpeg;       // SOI..EOI of the frame
+static uint32_t jpeg_len;
+
+// The base image with COM segments after SOI to make it 'len' bytes
+static uint8_t build_jpeg(uint8_t *out, uint32_t len)
+{
+    uint32_t extra = len - base_len;
+    uint32_t pos = 2;
+
+    if (len < base_len || (extra > 0U && extra < 4U)) {
+        return 0;
+    }
+    memcpy(out, base, 2);
+    while (extra > 0U) {
+        // A segment carries 2 to 65535 length bytes; never leave 1 to 3 over
+        uint32_t seg = (extra > 65537U) ? 65537U : extra;
+
+        if (extra - seg > 0U && extra - seg < 4U) {
+            seg -= 4U;
+        }
+        out[pos] = 0xFF;
+        out[pos + 1] = 0xFE;
+        out[pos + 2] = (uint8_t)((seg - 2U) >> 8);
+        out[pos + 3] = (uint8_t)(seg - 2U);
+        memset(out + pos + 4, 'x', seg - 4U);
+        pos += seg;
+        extra -= seg;
+    }
+    memcpy(out + pos, base + 2, base_len - 2U);
+    return 1;
+}
+
+static void setup_case(const Case_TypeDef *c)
+{
+    // 0xFF of EOI at pre + jpeg_len - 2
+    jpeg_len = (uint32_t)((int32_t)(c->chunk * TEST_CHUNK) + c->at) + 2U - c->pre;
+    frame_len = c->pre + jpeg_len + c->post;
+    free(frame);
+    frame = malloc(frame_len);
+    jpeg = frame + c->pre;
+    memset(frame, 0x00, c->pre);
+    HOST_CHECK(build_jpeg(jpeg, jpeg_len));
+    memset(jpeg + jpeg_len, 0x00, c->post);
+    HOST_CHECK(jpeg[jpeg_len - 2] == 0xFF && jpeg[jpeg_len - 1] == 0xD9);
+    Host_CameraSetJPEG((const uint8_t *const *)&frame, &frame_len, 1);
+}
+
+static void check_file(const Case_TypeDef *c)
+{
+    const char *name = Capture_LastFilename();
+    const uint8_t *last;
+    uint32_t last_len = 0;
+    uint8_t *buf = malloc(jpeg_len + 1U);
+    UINT n = 0;
+    FIL f;
+    uint8_t ok = 0;
+
+    if (name != NULL && f_open(&f, name, FA_READ) == FR_OK) {
+        ok = f_read(&f, buf, jpeg_len + 1U, &n) == FR_OK && n == jpeg_len &&
+             memcmp(buf, jpeg, jpeg_len) == 0;
+        f_close(&f);
+    }
+    last = Capture_LastJPEG(&last_len);
+    printf("EOI at chunk %lu%+ld, %lu before SOI, %lu after EOI: %lu bytes saved, %s, scan %lu cycles\n",
+           (unsigned long)c->chunk, (long)c->at, (unsigned long)c->pre, (unsigned long)c->post,
+           (unsigned long)n, ok ? "match" : "MISMATCH", (unsigned long)Capture_LastScanCycles());
+    HOST_CHECK(ok);
+    // Without a wrap of the ring it is still whole in the buffer
+    HOST_CHECK(last != NULL && last_len == jpeg_len && memcmp(last, jpeg, jpeg_len) == 0);
+    free(buf);
+}
+
+typedef enum {
+    STEP_BOOT_PRESS,
+    STEP_BOOT_RELEASE,
+    STEP_SETTLE,
+    STEP_PRESS,
+    STEP_RELEASE,
+    STEP_SAVING,
+} step_t;
+
+static step_t step;
+static uint32_t step_tick;
+static uint32_t current;
+
+static void next(step_t s)
+{
+    step = s;
+    step_tick = HAL_GetTick();
+}
+
+static void loop_hook(void)
+{
+    uint32_t now = HAL_GetTick();
+
+    if (now > TEST_TIMEOUT_MS) {
+        printf("timed out in step %d, case %lu\n", step, (unsigned long)current);
+        HOST_CHECK(0);
+        exit(Host_Result());
+    }
+
+    switch (step) {
+    case STEP_BOOT_PRESS:
+        Host_SetKey(1);
+        next(STEP_BOOT_RELEASE);
+        break;
+    case STEP_BOOT_RELEASE:
+        Host_SetKey(0);
+        next(STEP_SETTLE);
+        break;
+    case STEP_SETTLE:
+        // Past the double-press window of the last shot, too
+        if (now - step_tick >= 300U) {
+            setup_case(&cases[current]);
+            next(STEP_PRESS);
+        }
+        break;
+    case STEP_PRESS:
+        Host_SetKey(1);
+        next(STEP_RELEASE);
+        break;
+    case STEP_RELEASE:
+        if (now - step_tick >= 50U) {
+            Host_SetKey(0);
+            next(STEP_SAVING);
+        }
+        break;
+    case STEP_SAVING:
+        if (Capture_GetState() == CAPTURE_STATE_IDLE && now != step_tick) {
+            HOST_CHECK(Capture_LastResult());
+            check_file(&cases[current]);
+            if (++current == NUM_CASES) {
+                exit(Host_Result());
+            }
+            next(STEP_SETTLE);
+        }
+        break;
+    }
+}
+
+int main(void)
+{
+    static uint16_t preview[160 * 120];
+
+    HOST_CHECK(Host_DiskOpen(TEST_DISK, 128U * 2048U, 100U, 200U, 2U));
+    HOST_CHECK(Host_DiskFormat(0) == FR_OK);
+
+    base = Host_SceneJPEG(320, 240, 1, 75, &base_len);
+    HOST_CHECK(base != NULL && base_len + 4U <= TEST_CHUNK - 2U);
+
+    Host_SceneRGB565(preview, 160, 120, 1);
+    Host_CameraSetRGB565(preview, 160, 120, 1);
+
+    Host_SetLoopHook(loop_hook);
+    Firmware_Main();
+    return 1;
+}
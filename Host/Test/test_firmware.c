@@ -0,0 +1,178 @@
+#include "host.h"
+#include "stdlib.h"
+#include "string.h"
+#include "capture.h"
+#include "burst.h"
+#include "review.h"
+
+// The whole firmware, main() unmodified, against the host peripherals:
+// start-up with K1, preview on the LCD, one photo on a short press, shown
+// for review, and a burst on a long one, each checked on the disk image
+// afterwards.
+
+#define TEST_DISK       HOST_OUT_DIR "/test_firmware.img"
+#define TEST_TIMEOUT_MS 60000U
+
+int Firmware_Main(void);
+
+static uint8_t *scene;
+static uint32_t scene_len;
+
+typedef enum {
+    STEP_BOOT_PRESS,    // start-up loop waits for K1
+    STEP_BOOT_RELEASE,  // same pin is the card detect, present when released
+    STEP_PREVIEW,       // preview running, nothing captured unasked
+    STEP_SHOT,          // short press: one photo on release
+    STEP_SHOT_DONE,
+    STEP_BURST,         // long press: a burst
+    STEP_BURST_DONE,
+} step_t;
+
+static step_t step;
+static uint32_t step_tick;
+static uint32_t lcd_start;
+static uint32_t lcd_shot;       // LCD frames once the capture is running
+static uint8_t shot_state;      // 0 released, 1 capturing, 2 done
+
+static uint32_t count_photos(void)
+{
+    DIR dir;
+    FILINFO fno;
+    uint32_t n = 0;
+
+    if (f_opendir(&dir, "") != FR_OK) {
+        return 0;
+    }
+    while (f_readdir(&dir, &fno) == FR_OK && fno.fname[0] != '\0') {
+        if (strstr(fno.fname, ".JPG") != NULL || strstr(fno.fname, ".jpeg") != NULL) {
+            n++;
+        }
+    }
+    f_closedir(&dir);
+    return n;
+}
+
+// The saved photo is the frame the camera sent, byte for byte
+static void check_photo(const char *name)
+{
+    FIL f;
+    UINT n = 0;
+    uint8_t *buf = malloc(scene_len + 1U);
+
+    HOST_CHECK(name != NULL);
+    if (name == NULL || buf == NULL) {
+        free(buf);
+        return;
+    }
+    HOST_CHECK(f_open(&f, name, FA_READ) == FR_OK);
+    HOST_CHECK(f_read(&f, buf, scene_len + 1U, &n) == FR_OK);
+    f_close(&f);
+    HOST_CHECK(n == scene_len);
+    HOST_CHECK(memcmp(buf, scene, scene_len) == 0);
+    free(buf);
+}
+
+static void next(step_t s)
+{
+    step = s;
+    step_tick = HAL_GetTick();
+}
+
+static void loop_hook(void)
+{
+    uint32_t now = HAL_GetTick();
+
+    if (now > TEST_TIMEOUT_MS) {
+        printf("timed out in step %d\n", step);
+        HOST_CHECK(0);
+        exit(Host_Result());
+    }
+
+    switch (step) {
+    case STEP_BOOT_PRESS:
+        Host_SetKey(1);
+        next(STEP_BOOT_RELEASE);
+        break;
+    case STEP_BOOT_RELEASE:
+        Host_SetKey(0);
+        lcd_start = Host_LcdFrames();
+        next(STEP_PREVIEW);
+        break;
+    case STEP_PREVIEW:
+        // The start-up press must not turn into a photo or a burst
+        HOST_CHECK(Capture_GetState() == CAPTURE_STATE_IDLE);
+        if (now - step_tick >= 2000U) {
+            HOST_CHECK(Host_LcdFrames() - lcd_start >= 20U);
+            HOST_CHECK(count_photos() == 0U);
+            Host_SetKey(1);
+            next(STEP_SHOT);
+        }
+        break;
+    case STEP_SHOT:
+        if (now - step_tick >= 100U) {
+            Host_SetKey(0);
+            next(STEP_SHOT_DONE);
+        }
+        break;
+    case STEP_SHOT_DONE:
+        // No preview while the JPEG is taken, nor once the review (drawn in
+        // bands, so not counted as a frame) holds the LCD
+        if (shot_state == 0U && Capture_GetState() != CAPTURE_STATE_IDLE) {
+            shot_state = 1;
+            lcd_shot = Host_LcdFrames();
+        } else if (shot_state == 1U && Capture_GetState() == CAPTURE_STATE_IDLE) {
+            shot_state = 2;
+            printf("%lu LCD frames from capture to review\n", (unsigned long)(Host_LcdFrames() - lcd_shot));
+            HOST_CHECK(Host_LcdFrames() == lcd_shot);
+            HOST_CHECK(Review_LastCycles() > 0U);
+            lcd_shot = Host_LcdFrames();
+        }
+        // Pressing again within the double-press window would step the
+        // capture profile instead of starting a burst
+        if (shot_state == 2U && now - step_tick >= 300U) {
+            HOST_CHECK(Host_LcdFrames() == lcd_shot);
+            HOST_CHECK(Capture_LastResult());
+            check_photo(Capture_LastFilename());
+            HOST_CHECK(count_photos() == 1U);
+            Host_SetKey(1);
+            next(STEP_BURST);
+        }
+        break;
+    case STEP_BURST:
+        // Burst_Capture blocks the loop, so the release is seen after it
+        if (now - step_tick >= 1000U) {
+            Host_SetKey(0);
+            next(STEP_BURST_DONE);
+        }
+        break;
+    case STEP_BURST_DONE:
+        if (now - step_tick >= 500U) {
+            HOST_CHECK(count_photos() > 2U);
+            printf("%lu preview frames, %lu photos\n", (unsigned long)(Host_LcdFrames() - lcd_start),
+                   (unsigned long)count_photos());
+            exit(Host_Result());
+        }
+        break;
+    }
+}
+
+int main(void)
+{
+    const uint8_t *frames[1];
+
+    HOST_CHECK(Host_DiskOpen(TEST_DISK, 128U * 2048U, 100U, 200U, 2U));
+    HOST_CHECK(Host_DiskFormat(0) == FR_OK);
+
+    scene = Host_SceneJPEG(640, 480, 1, 80, &scene_len);
+    HOST_CHECK(scene != NULL);
+    frames[0] = scene;
+    Host_CameraSetJPEG(frames, &scene_len, 1);
+
+    static uint16_t preview[160 * 120];
+    Host_SceneRGB565(preview, 160, 120, 1);
+    Host_CameraSetRGB565(preview, 160, 120, 1);
+
+    Host_SetLoopHook(loop_hook);
+    Firmware_Main();
+    return 1;
+}
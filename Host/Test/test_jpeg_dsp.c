@@ -0,0 +1,160 @@
+#include "host.h"
+#include "stdlib.h"
+#include "string.h"
+#include "libjpeg.h"
+#include "jpeg_dsp.h"
+
+// The jpeg_dsp kernels against LibJPEG's own ISLOW DCT (jfdctint.c) and
+// colour conversion, through the library itself: the same image compressed
+// with and without them must give the same bytes. Photo-like scenes and
+// noise at quality 100, whose coefficients come closest to the 16-bit lanes,
+// in 4:2:0 as jpeg_encode writes them and 4:4:4.
+
+#define TEST_OUT_SIZE   (64U * 1024U)
+
+typedef enum {
+    MODE_STOCK,     // jfdctint, RGB888 rows
+    MODE_DCT,       // DSP DCT, RGB888 rows
+    MODE_RGB565,    // DSP DCT and RGB565 rows
+} dsp_mode_t;
+
+static const char *const mode_names[] = { "stock", "DSP DCT", "DSP DCT + RGB565" };
+
+static uint8_t out[TEST_OUT_SIZE];
+
+// This port's error_exit returns and LibJPEG carries on; stop instead
+static void test_error_exit(j_common_ptr cinfo)
+{
+    char msg[JMSG_LENGTH_MAX];
+
+    (*cinfo->err->format_message)(cinfo, msg);
+    printf("LibJPEG: %s\n", msg);
+    HOST_CHECK(0);
+    exit(Host_Result());
+}
+
+// RGB565 as jpeg_dsp widens it, so the stock path sees the same samples
+static void widen(const uint8_t *px, uint8_t *rgb, uint32_t n)
+{
+    for (uint32_t i = 0; i < n; i++, px += 2, rgb += 3) {
+        uint32_t v = ((uint32_t)px[0] << 8) | px[1];
+        uint32_t r = (v >> 8) & 0xF8U, g = (v >> 3) & 0xFCU, b = (v << 3) & 0xF8U;
+
+        rgb[0] = (uint8_t)(r | (r >> 5));
+        rgb[1] = (uint8_t)(g | (g >> 6));
+        rgb[2] = (uint8_t)(b | (b >> 5));
+    }
+}
+
+// Compress big-endian RGB565 pixels into out[] with samp x samp luma;
+// returns the length
+static uint32_t encode(const uint8_t *px, uint32_t w, uint32_t h, int quality, int samp,
+                       dsp_mode_t mode)
+{
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    unsigned char *buf = out;
+    unsigned long len = sizeof(out);
+    uint8_t *rgb = malloc(w * 3U);
+    JSAMPROW row;
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jerr.error_exit = test_error_exit;
+    jpeg_create_compress(&cinfo);
+    jpeg_mem_dest(&cinfo, &buf, &len);
+    cinfo.image_width = w;
+    cinfo.image_height = h;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    cinfo.comp_info[0].h_samp_factor = cinfo.comp_info[0].v_samp_factor = samp;
+    cinfo.dct_method = JDCT_ISLOW;
+    jpeg_start_compress(&cinfo, TRUE);
+    if (mode != MODE_STOCK) {
+        HOST_CHECK(jpeg_dsp_setup_compress(&cinfo, mode == MODE_RGB565) == (mode == MODE_RGB565));
+    }
+    while (cinfo.next_scanline < h) {
+        const uint8_t *src = px + (size_t)cinfo.next_scanline * w * 2U;
+
+        if (mode == MODE_RGB565) {
+            row = (JSAMPROW)src;
+        } else {
+            widen(src, rgb, w);
+            row = rgb;
+        }
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    free(rgb);
+    HOST_CHECK(buf == out);
+    return (uint32_t)len;
+}
+
+static void check_image(const char *what, const uint8_t *px, uint32_t w, uint32_t h, int quality,
+                        int samp)
+{
+    uint8_t *stock_jpeg;
+    uint32_t stock_len, len;
+    uint8_t same = 1;
+
+    stock_len = encode(px, w, h, quality, samp, MODE_STOCK);
+    stock_jpeg = malloc(stock_len);
+    memcpy(stock_jpeg, out, stock_len);
+    for (dsp_mode_t m = MODE_DCT; m <= MODE_RGB565; m++) {
+        len = encode(px, w, h, quality, samp, m);
+        if (len != stock_len || memcmp(out, stock_jpeg, len) != 0) {
+            printf("%s q%d: %s compress differs from stock\n", what, quality, mode_names[m]);
+            same = 0;
+        }
+    }
+    HOST_CHECK(same);
+    printf("%-6s %3lux%-3lu %s q%-3d %6lu bytes: %s\n", what, (unsigned long)w, (unsigned long)h,
+           samp == 1 ? "4:4:4" : "4:2:0", quality, (unsigned long)stock_len,
+           same ? "compress matches" : "MISMATCH");
+    free(stock_jpeg);
+}
+
+int main(void)
+{
+    static const int qualities[] = { 50, 85, 100 };
+    uint32_t w = 160, h = 80;
+    uint16_t *scene = malloc((size_t)w * h * 2U);
+    uint8_t *px = malloc((size_t)w * h * 2U);
+    uint32_t seed = 1;
+
+    for (uint32_t s = 1; s <= 2; s++) {
+        Host_SceneRGB565(scene, (uint16_t)w, (uint16_t)h, s);
+        // High byte first, as DCMI stores it
+        for (uint32_t i = 0; i < w * h; i++) {
+            px[2U * i] = (uint8_t)(scene[i] >> 8);
+            px[2U * i + 1U] = (uint8_t)scene[i];
+        }
+        for (uint32_t q = 0; q < sizeof(qualities) / sizeof(qualities[0]); q++) {
+            check_image("scene", px, w, h, qualities[q], 2);
+            check_image("scene", px, w, h, qualities[q], 1);
+        }
+    }
+
+    // Noise: every coefficient busy. Odd sizes take LibJPEG's edge padding.
+    for (uint32_t i = 0; i < w * h * 2U; i++) {
+        seed = seed * 1103515245U + 12345U;
+        px[i] = (uint8_t)(seed >> 16);
+    }
+    for (int samp = 2; samp >= 1; samp--) {
+        check_image("noise", px, 160, 80, 100, samp);
+        check_image("noise", px, 37, 21, 100, samp);
+        check_image("noise", px, 37, 21, 30, samp);
+    }
+
+    // Flat extremes: no AC energy, DC at either end
+    memset(px, 0x00, w * h * 2U);
+    check_image("black", px, 64, 16, 100, 1);
+    memset(px, 0xFF, w * h * 2U);
+    check_image("white", px, 64, 16, 100, 1);
+
+    free(scene);
+    free(px);
+    return Host_Result();
+}
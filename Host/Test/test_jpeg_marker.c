@@ -0,0 +1,138 @@
+#include "host.h"
+#include "stdlib.h"
+#include "string.h"
+#include "jpeg_marker.h"
+
+// JPEG_FindMarker/JPEG_FindMarkerReverse against a byte-by-byte scan, at
+// every alignment and short length and over a whole frame, with 0xFF bytes
+// around and inside the word boundaries the scans step over.
+
+static uint32_t find_ref(const uint8_t *buf, uint32_t len, uint8_t marker)
+{
+    for (uint32_t i = 0; i + 1 < len; i++) {
+        if (buf[i] == 0xFF && buf[i + 1] == marker) return i;
+    }
+    return len;
+}
+
+static uint32_t find_reverse_ref(const uint8_t *buf, uint32_t len, uint8_t marker)
+{
+    for (uint32_t i = len; i-- > 1; ) {
+        if (buf[i - 1] == 0xFF && buf[i] == marker) return i - 1;
+    }
+    return len;
+}
+
+static uint32_t rng = 1;
+
+static uint32_t rand32(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+// Entropy-coded-like bytes, with 0xFF (stuffed or not) once in 'ff_every'
+static void fill(uint8_t *buf, uint32_t len, uint32_t ff_every)
+{
+    for (uint32_t i = 0; i < len; i++) {
+        uint32_t r = rand32();
+
+        buf[i] = (r % ff_every == 0U) ? 0xFF : (uint8_t)(r >> 8);
+        if (buf[i] == 0xFF) {
+            continue;
+        }
+        // Markers are rare: most become other bytes
+        if (buf[i] == JPEG_MARKER_EOI || buf[i] == JPEG_MARKER_SOI) {
+            buf[i] = (r & 0x10000U) ? buf[i] : 0x00;
+        }
+    }
+}
+
+static uint32_t mismatches;
+
+static void check(const uint8_t *buf, uint32_t len, uint8_t marker)
+{
+    uint32_t f = JPEG_FindMarker(buf, len, marker);
+    uint32_t r = JPEG_FindMarkerReverse(buf, len, marker);
+
+    if (f != find_ref(buf, len, marker) || r != find_reverse_ref(buf, len, marker)) {
+        if (mismatches++ < 5U) {
+            printf("len %lu at %p: forward %lu (want %lu), reverse %lu (want %lu)\n",
+                   (unsigned long)len, (const void *)buf, (unsigned long)f,
+                   (unsigned long)find_ref(buf, len, marker), (unsigned long)r,
+                   (unsigned long)find_reverse_ref(buf, len, marker));
+        }
+    }
+}
+
+int main(void)
+{
+    static uint8_t buf[4096 + 8];
+    uint32_t frame_len;
+    uint8_t *frame;
+
+    // Short buffers at every alignment, random and with every placement of
+    // one pair, an unpaired 0xFF and runs of 0xFF
+    for (uint32_t align = 0; align < 4; align++) {
+        uint8_t *p = buf + align;
+
+        for (uint32_t len = 0; len <= 40; len++) {
+            for (uint32_t round = 0; round < 200; round++) {
+                fill(p, len, (round & 1U) ? 3U : 16U);
+                check(p, len, JPEG_MARKER_EOI);
+                check(p, len, JPEG_MARKER_SOI);
+            }
+            for (uint32_t at = 0; at + 1 < len; at++) {
+                memset(p, 0, len);
+                p[at] = 0xFF;
+                p[at + 1] = JPEG_MARKER_EOI;
+                check(p, len, JPEG_MARKER_EOI);
+                p[at + 1] = 0x00;
+                check(p, len, JPEG_MARKER_EOI);
+                memset(p, 0xFF, at + 1);
+                p[at + 1] = JPEG_MARKER_EOI;
+                check(p, len, JPEG_MARKER_EOI);
+            }
+            if (len > 0U) {
+                memset(p, 0, len);
+                p[len - 1] = 0xFF;  // the pair would end past the buffer
+                p[len] = JPEG_MARKER_EOI;
+                check(p, len, JPEG_MARKER_EOI);
+            }
+        }
+    }
+
+    // Longer random buffers with several pairs
+    for (uint32_t round = 0; round < 2000; round++) {
+        uint32_t align = rand32() & 3U;
+        uint32_t len = rand32() % 4096U;
+
+        fill(buf + align, len, 1U + rand32() % 64U);
+        check(buf + align, len, JPEG_MARKER_EOI);
+        check(buf + align, len, JPEG_MARKER_SOI);
+    }
+
+    // A whole frame: SOI at the start and EOI at the end are found, not
+    // anything in the tables or the stuffed entropy data between
+    frame = Host_SceneJPEG(640, 480, 1, 80, &frame_len);
+    HOST_CHECK(frame != NULL);
+    if (frame != NULL) {
+        HOST_CHECK(JPEG_FindMarker(frame, frame_len, JPEG_MARKER_SOI) == 0U);
+        HOST_CHECK(JPEG_FindMarker(frame, frame_len, JPEG_MARKER_EOI) == frame_len - 2U);
+        HOST_CHECK(JPEG_FindMarkerReverse(frame, frame_len, JPEG_MARKER_EOI) == frame_len - 2U);
+        for (uint32_t cut = frame_len - 8U; cut <= frame_len; cut++) {
+            check(frame, cut, JPEG_MARKER_EOI);
+        }
+        free(frame);
+    }
+
+    HOST_CHECK(mismatches == 0U);
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+    printf("UADD8/SEL scan: %lu mismatches\n", (unsigned long)mismatches);
+#else
+    printf("plain C scan: %lu mismatches\n", (unsigned long)mismatches);
+#endif
+    return Host_Result();
+}
@@ -0,0 +1,209 @@
+#include "host.h"
+#include "stdlib.h"
+#include "string.h"
+#include "motion.h"
+#include "ae_awb.h"
+
+// Motion detection on synthetic clips at 15 frames per second of virtual
+// time: a still scene with sensor noise, the light changing at once and as
+// the exposure loop would follow it, the whole view changing, an object too
+// small to count, and one large enough crossing the frame, from the end of
+// the warm-up and in view from its start. Only the large object may fire, never
+// during the warm-up and no more often than MOTION_HOLDOFF_MS allows.
+// Motion_BuildGrid and Motion_Compare are checked against plain loops
+// first, so the HOST_DSP=1 build covers the USUB8/SEL/USAD8 path.
+
+#define TEST_W          PREVIEW_WIDTH
+#define TEST_H          PREVIEW_HEIGHT
+#define TEST_FRAME_MS   66U
+#define TEST_FRAMES     60U         // 4 s per clip
+#define TEST_NOISE      8           // +-levels per channel and pixel
+
+static uint16_t scene[TEST_W * TEST_H];
+static uint16_t frame[TEST_W * TEST_H];     // as the DCMI stores it
+static uint32_t rng = 1;
+
+static uint32_t rand32(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static uint16_t swap(uint16_t v)
+{
+    return (uint16_t)((v >> 8) | (v << 8));
+}
+
+static uint32_t channel(uint32_t v, uint32_t gain)
+{
+    int32_t c = (int32_t)(v * gain / 256U) + (int32_t)(rand32() % (2U * TEST_NOISE + 1U)) - TEST_NOISE;
+
+    return (uint32_t)(c < 0 ? 0 : (c > 255 ? 255 : c));
+}
+
+// Native RGB565 with each channel scaled by gain/256, and fresh noise
+static uint16_t expose(uint16_t px, uint32_t gain)
+{
+    uint32_t r = channel((px >> 8) & 0xF8U, gain), g = channel((px >> 3) & 0xFCU, gain);
+    uint32_t b = channel((px << 3) & 0xF8U, gain);
+
+    return (uint16_t)(((r & 0xF8U) << 8) | ((g & 0xFCU) << 3) | (b >> 3));
+}
+
+static void check_kernels(void)
+{
+    static uint8_t grid[MOTION_CELLS], bg[MOTION_CELLS], ref[MOTION_CELLS];
+    uint8_t ok = 1;
+
+    for (uint32_t i = 0; i < TEST_W * TEST_H; i++) {
+        frame[i] = (uint16_t)rand32();
+    }
+    Motion_BuildGrid(frame, TEST_W, TEST_H, grid);
+    for (uint32_t c = 0; c < MOTION_CELLS; c++) {
+        uint32_t gx = c % MOTION_GRID_W, gy = c / MOTION_GRID_W, sum = 0, n = 0;
+
+        for (uint32_t y = 0; y < MOTION_CELL_H; y += 2) {
+            for (uint32_t x = 0; x < MOTION_CELL_W; x += 2, n++) {
+                uint16_t px = swap(frame[(gy * MOTION_CELL_H + y) * TEST_W + gx * MOTION_CELL_W + x]);
+
+                sum += (77U * ((px >> 8) & 0xF8U) + 150U * ((px >> 3) & 0xFCU) +
+                        29U * ((px << 3) & 0xF8U)) >> 8;
+            }
+        }
+        ref[c] = (uint8_t)(sum / n);
+    }
+    ok &= (memcmp(grid, ref, sizeof(ref)) == 0);
+
+    for (uint32_t round = 0; round < 1000U; round++) {
+        uint8_t threshold = (uint8_t)(round % 256U);
+        uint32_t changed = 0, sad = 0, got_sad = UINT32_MAX, got;
+
+        for (uint32_t c = 0; c < MOTION_CELLS; c++) {
+            uint32_t r = rand32();
+
+            grid[c] = (uint8_t)r;
+            // Some cells equal or close, where the comparison turns
+            bg[c] = (round & 1U) ? (uint8_t)(r + ((r >> 8) % 32U) - 16U) : (uint8_t)(r >> 16);
+            changed += (uint32_t)abs(grid[c] - bg[c]) >= threshold;
+            sad += (uint32_t)abs(grid[c] - bg[c]);
+        }
+        got = Motion_Compare(grid, bg, MOTION_CELLS, threshold, &got_sad);
+        ok &= (got == changed && got_sad == sad);
+    }
+    HOST_CHECK(ok);
+    printf("grid and compare kernels: %s\n", ok ? "match" : "MISMATCH");
+}
+
+typedef enum {
+    CLIP_STILL,
+    CLIP_LIGHT_STEP,    // light halves between two frames
+    CLIP_LIGHT_AE,      // ... and the exposure loop brings it back
+    CLIP_VIEW,          // the camera turned: a different view
+    CLIP_SMALL,         // one cell's worth of object
+    CLIP_OBJECT,        // a 32x24 object crossing once the background is built
+    CLIP_WARMUP,        // one in view from the first frame after a restart
+} clip_t;
+
+static const char *const clip_names[] = {
+    "still", "light step", "light + AE", "new view", "small object", "object", "object at start"
+};
+
+// Frame 'f' of a clip
+static void make_frame(clip_t clip, uint32_t f)
+{
+    uint32_t gain = 256U;
+    int32_t ox = -1, oy = 0, ow = 0, oh = 0;
+
+    if ((clip == CLIP_LIGHT_STEP || clip == CLIP_LIGHT_AE) && f >= 20U) {
+        gain = 128U;
+        if (clip == CLIP_LIGHT_AE) {
+            // Halfway back every 100 ms, as ae_awb moves the exposure
+            for (uint32_t t = 0; t < (f - 20U) * TEST_FRAME_MS / AE_UPDATE_MS; t++) {
+                gain += (256U - gain) / 2U;
+            }
+        }
+    }
+    if (clip == CLIP_SMALL) {
+        ox = 40 + (int32_t)f;
+        oy = 36;
+        ow = oh = 6;
+    } else if (clip == CLIP_OBJECT && f >= MOTION_WARMUP_FRAMES) {
+        ox = (int32_t)((f - MOTION_WARMUP_FRAMES) * (TEST_W + 32U) /
+                       (TEST_FRAMES - MOTION_WARMUP_FRAMES)) - 32;
+        oy = 28;
+        ow = 32;
+        oh = 24;
+    } else if (clip == CLIP_WARMUP) {
+        ox = 40 + 2 * (int32_t)f;
+        oy = 28;
+        ow = 32;
+        oh = 24;
+    }
+    for (int32_t y = 0; y < TEST_H; y++) {
+        for (int32_t x = 0; x < TEST_W; x++) {
+            int32_t sx = (clip == CLIP_VIEW && f >= 20U) ? TEST_W - 1 - x : x;
+            uint16_t px = expose(scene[y * TEST_W + sx], gain);
+
+            if (x >= ox && x < ox + ow && y >= oy && y < oy + oh) {
+                px = 0x0841;    // near black
+            }
+            frame[y * TEST_W + x] = swap(px);
+        }
+    }
+}
+
+// Triggers fired over a clip
+static uint32_t play(clip_t clip)
+{
+    uint32_t fired = 0, warmup_fired = 0, max_changed = 0;
+
+    // Apart from the last clip's triggers, and a fresh background
+    HAL_Delay(MOTION_HOLDOFF_MS);
+    Motion_Start();
+    for (uint32_t f = 0; f < TEST_FRAMES; f++) {
+        uint8_t fire;
+
+        make_frame(clip, f);
+        fire = Motion_Process(frame);
+        fired += fire;
+        if (f < MOTION_WARMUP_FRAMES) {
+            warmup_fired += fire;
+        }
+        if (Motion_GetStats()->changed > max_changed) {
+            max_changed = Motion_GetStats()->changed;
+        }
+        HAL_Delay(TEST_FRAME_MS);
+    }
+    HOST_CHECK(warmup_fired == 0U);
+    printf("%-16s %2lu triggers, at most %3lu of %u cells changed\n", clip_names[clip],
+           (unsigned long)fired, (unsigned long)max_changed, MOTION_CELLS);
+    return fired;
+}
+
+int main(void)
+{
+    uint32_t n, most = (TEST_FRAMES * TEST_FRAME_MS + MOTION_HOLDOFF_MS - 1U) / MOTION_HOLDOFF_MS;
+
+    check_kernels();
+    Host_SceneRGB565(scene, TEST_W, TEST_H, 1);
+
+    Motion_Arm(1);
+    HOST_CHECK(play(CLIP_STILL) == 0U);
+    HOST_CHECK(play(CLIP_LIGHT_STEP) == 0U);
+    HOST_CHECK(play(CLIP_LIGHT_AE) == 0U);
+    HOST_CHECK(play(CLIP_VIEW) == 0U);
+    HOST_CHECK(play(CLIP_SMALL) == 0U);
+    n = play(CLIP_OBJECT);
+    HOST_CHECK(n >= 1U && n <= most);
+    n = play(CLIP_WARMUP);
+    HOST_CHECK(n >= 1U && n <= most);
+    HOST_CHECK(Motion_GetStats()->triggers >= 2U);
+
+    Motion_Arm(0);
+    make_frame(CLIP_OBJECT, 30);
+    HOST_CHECK(Motion_Process(frame) == 0U);
+
+    return Host_Result();
+}
@@ -0,0 +1,109 @@
+#include "host.h"
+#include "stdlib.h"
+#include "string.h"
+#include "capture.h"
+
+// PHOTOID.IDX through a run of shots and remounts: it always holds an ID no
+// photo has taken, is rewritten once per CAPTURE_PHOTO_INDEX_STEP shots,
+// and a remount neither reuses a name nor rescans the card. A missing index
+// falls back to the scan, and a stale one to skipping taken names.
+
+#define TEST_DISK   HOST_OUT_DIR "/test_photo_index.img"
+
+extern uint32_t photo_id;
+
+static uint32_t read_index(void)
+{
+    FIL f;
+    char buf[12] = { 0 };
+    UINT n = 0;
+
+    if (f_open(&f, "PHOTOID.IDX", FA_READ) != FR_OK) {
+        return UINT32_MAX;
+    }
+    f_read(&f, buf, sizeof(buf) - 1U, &n);
+    f_close(&f);
+    return (uint32_t)strtoul(buf, NULL, 10);
+}
+
+static void write_index(uint32_t id)
+{
+    FIL f;
+    char buf[12];
+    UINT n;
+    int len = snprintf(buf, sizeof(buf), "%05lu\n", (unsigned long)id);
+
+    HOST_CHECK(f_open(&f, "PHOTOID.IDX", FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+    f_write(&f, buf, (UINT)len, &n);
+    f_close(&f);
+}
+
+static void remount(void)
+{
+    f_mount(NULL, SDPath, 0);
+    HOST_CHECK(f_mount(&SDFatFS, SDPath, 1) == FR_OK);
+}
+
+// One photo as the capture modules take it; returns its ID
+static uint32_t shot(void)
+{
+    FIL f;
+    char name[32];
+    uint32_t id = UINT32_MAX;
+    UINT n;
+
+    HOST_CHECK(Capture_OpenPhotoFile(&f, name, sizeof(name), &id) == FR_OK);
+    HOST_CHECK(f_write(&f, "\xFF\xD8\xFF\xD9", 4, &n) == FR_OK);
+    Capture_ClosePhotoFile(&f, name, id, 1);
+    Capture_SavePhotoIndex();
+    return id;
+}
+
+int main(void)
+{
+    uint32_t index, last = 0, writes = 0, id;
+    const uint32_t shots = 3U * CAPTURE_PHOTO_INDEX_STEP + 5U;
+
+    HOST_CHECK(Host_DiskOpen(TEST_DISK, 64U * 2048U, 0U, 0U, 0U));
+    HOST_CHECK(Host_DiskFormat(1) == FR_OK);
+
+    // Fresh card: IDs from 0, the index ahead of every photo taken
+    index = UINT32_MAX;
+    for (uint32_t i = 0; i < shots; i++) {
+        id = shot();
+        HOST_CHECK(id == i);
+        if (read_index() != index) {
+            index = read_index();
+            writes++;
+        }
+        HOST_CHECK(index != UINT32_MAX && index >= photo_id);
+        last = id;
+    }
+    printf("%lu shots, %lu index writes\n", (unsigned long)shots, (unsigned long)writes);
+    HOST_CHECK(writes <= shots / CAPTURE_PHOTO_INDEX_STEP + 1U);
+
+    // Remount: numbering resumes at the reservation, from the index alone
+    remount();
+    id = shot();
+    HOST_CHECK(id > last && id == index);
+    last = id;
+
+    // No index: the directory scan finds the next free ID
+    f_unlink("PHOTOID.IDX");
+    remount();
+    id = shot();
+    HOST_CHECK(id == last + 1U);
+    last = id;
+    HOST_CHECK(read_index() > last);
+
+    // An index behind the card (restored, or edited on a PC): taken names
+    // are skipped up to the first free one, here the rest of the
+    // reservation the first remount left unused
+    write_index(3);
+    remount();
+    id = shot();
+    HOST_CHECK(id == shots);
+    HOST_CHECK(read_index() > id);
+
+    return Host_Result();
+}
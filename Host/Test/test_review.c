@@ -0,0 +1,308 @@
+#include "host.h"
+#include "stdlib.h"
+#include "string.h"
+#include "libjpeg.h"
+#include "gpio.h"
+#include "dma.h"
+#include "spi.h"
+#include "tim.h"
+#include "lcd.h"
+#include "review.h"
+
+// Review_ShowJPEG and Review_ShowFile draw a photo at 1/8 scale from its
+// Huffman data alone (jpeg_walk). The panel must end up with exactly what
+// LibJPEG's own 1/8 decode without fancy upsampling gives, fitted to the
+// panel width and cropped to the middle rows, for the samplings, restart
+// intervals and sizes the sensor or jpeg_encode may write: from memory, and
+// from a file read through the capture buffer a window at a time. Broken
+// files must be refused, and a truncated one may only draw what it holds.
+
+#define TEST_DISK       HOST_OUT_DIR "/test_review.img"
+#define TEST_FILE       "REVIEW.JPG"
+#define TEST_W          320
+#define TEST_H          240
+#define TEST_OUT_SIZE   (1024U * 1024U)
+
+typedef struct {
+    const char *name;
+    int ncomp;
+    int h_samp, v_samp;         // luma
+    unsigned int restart;       // MCUs, 0 for none
+} layout_t;
+
+static const layout_t layouts[] = {
+    { "4:2:0",       3, 2, 2, 0 },
+    { "4:2:2",       3, 2, 1, 0 },
+    { "4:4:4",       3, 1, 1, 0 },
+    { "gray",        1, 1, 1, 0 },
+    { "4:2:2 RST3",  3, 2, 1, 3 },
+    { "4:2:0 RST1",  3, 2, 2, 1 },
+};
+
+static uint8_t out[TEST_OUT_SIZE];
+static uint8_t ref[REVIEW_MAX_SRC_WIDTH * 256U * 3U];  // RGB888 at 1/8
+static uint32_t ref_w, ref_h;
+static uint16_t lcd_x0, lcd_y0;                         // panel (0, 0) in controller RAM
+
+// This port's error_exit returns and LibJPEG carries on; stop instead
+static void test_error_exit(j_common_ptr cinfo)
+{
+    char msg[JMSG_LENGTH_MAX];
+
+    (*cinfo->err->format_message)(cinfo, msg);
+    printf("LibJPEG: %s\n", msg);
+    HOST_CHECK(0);
+    exit(Host_Result());
+}
+
+// Compress the top-left w x h of an RGB888 TEST_W-wide image into out[]
+static uint32_t encode(const uint8_t *rgb, uint32_t w, uint32_t h, int quality, const layout_t *l)
+{
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    unsigned char *buf = out;
+    unsigned long len = sizeof(out);
+    uint8_t gray[TEST_W];
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jerr.error_exit = test_error_exit;
+    jpeg_create_compress(&cinfo);
+    jpeg_mem_dest(&cinfo, &buf, &len);
+    cinfo.image_width = w;
+    cinfo.image_height = h;
+    cinfo.input_components = l->ncomp;
+    cinfo.in_color_space = (l->ncomp == 1) ? JCS_GRAYSCALE : JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    cinfo.comp_info[0].h_samp_factor = l->h_samp;
+    cinfo.comp_info[0].v_samp_factor = l->v_samp;
+    cinfo.restart_interval = l->restart;
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < h) {
+        JSAMPROW row = (JSAMPROW)&rgb[(size_t)cinfo.next_scanline * TEST_W * 3U];
+
+        if (l->ncomp == 1) {
+            for (uint32_t x = 0; x < w; x++) {
+                gray[x] = row[3U * x + 1U];
+            }
+            row = gray;
+        }
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    HOST_CHECK(buf == out);
+    return (uint32_t)len;
+}
+
+// LibJPEG's 1/8 decode into ref[], as RGB: the 1x1 IDCT for luma, chroma
+// scaled up by its IDCT instead of upsampled
+static void reference(const uint8_t *jpeg, uint32_t len)
+{
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jerr.error_exit = test_error_exit;
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, (unsigned char *)jpeg, len);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = 8;
+    cinfo.dct_method = JDCT_IFAST;
+    cinfo.do_fancy_upsampling = FALSE;
+    cinfo.do_block_smoothing = FALSE;
+    cinfo.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&cinfo);
+    ref_w = cinfo.output_width;
+    ref_h = cinfo.output_height;
+    HOST_CHECK(ref_w <= REVIEW_MAX_SRC_WIDTH && ref_w * ref_h * 3U <= sizeof(ref));
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = &ref[(size_t)cinfo.output_scanline * ref_w * 3U];
+
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+}
+
+// Fill the panel with one colour, polled, a row at a time. Through full
+// windows: the driver's cursor moves set only where a window starts.
+static void clear(uint16_t colour)
+{
+    static uint8_t row[2 * REVIEW_MAX_WIDTH];
+
+    for (uint32_t x = 0; x < ST7735Ctx.Width; x++) {
+        row[2 * x] = (uint8_t)(colour >> 8);
+        row[2 * x + 1] = (uint8_t)colour;
+    }
+    for (uint32_t y = 0; y < ST7735Ctx.Height; y++) {
+        ST7735_LCD_Driver.FillRGBRect(&st7735_pObj, 0, y, row, ST7735Ctx.Width, 1);
+    }
+}
+
+// Panel pixels that differ from ref[] fitted and cropped as the review
+// does; those outside the rows it covers must still be 'clear'
+static uint32_t lcd_diff(uint16_t clear_colour)
+{
+    uint32_t lcd_w = ST7735Ctx.Width, lcd_h = ST7735Ctx.Height, diff = 0;
+    uint32_t step = (ref_w << 16) / lcd_w;
+    uint32_t fit_h = (ref_h << 16) / step;
+    uint32_t rows = (fit_h < lcd_h) ? fit_h : lcd_h;
+    uint32_t top = (fit_h - rows) / 2U;
+
+    for (uint32_t y = 0; y < lcd_h; y++) {
+        for (uint32_t x = 0; x < lcd_w; x++) {
+            uint16_t want = clear_colour;
+
+            if (y < rows) {
+                const uint8_t *p = &ref[((((top + y) * step) >> 16) * ref_w + ((x * step) >> 16)) * 3U];
+
+                want = (uint16_t)(((p[0] & 0xF8U) << 8) | ((p[1] & 0xFCU) << 3) | (p[2] >> 3));
+            }
+            diff += Host_LcdPixel((uint16_t)(lcd_x0 + x), (uint16_t)(lcd_y0 + y)) != want;
+        }
+    }
+    return diff;
+}
+
+static void save_file(const uint8_t *data, uint32_t len)
+{
+    FIL f;
+    UINT n = 0;
+
+    HOST_CHECK(f_open(&f, TEST_FILE, FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+    HOST_CHECK(f_write(&f, data, len, &n) == FR_OK && n == len);
+    HOST_CHECK(f_close(&f) == FR_OK);
+}
+
+// Both sources against LibJPEG
+static void check_same(const char *what, const uint8_t *jpeg, uint32_t len)
+{
+    uint32_t mem_diff, file_diff;
+    uint8_t mem_ok, file_ok;
+
+    reference(jpeg, len);
+    clear(0x0821);
+    mem_ok = Review_ShowJPEG(jpeg, len);
+    mem_diff = lcd_diff(0x0821);
+    HOST_CHECK(mem_ok && mem_diff == 0U && Review_LastCycles() > 0U);
+
+    save_file(jpeg, len);
+    clear(0x0821);
+    file_ok = Review_ShowFile(TEST_FILE);
+    file_diff = lcd_diff(0x0821);
+    HOST_CHECK(file_ok && file_diff == 0U);
+
+    printf("%-28s %7lu bytes, %3lux%-3lu: memory %s, file %s%s\n", what, (unsigned long)len,
+           (unsigned long)ref_w, (unsigned long)ref_h,
+           mem_ok ? (mem_diff ? "DIFFERS" : "same") : "REFUSED",
+           file_ok ? (file_diff ? "DIFFERS" : "same") : "REFUSED",
+           (len > REVIEW_READ_SIZE) ? " (several reads)" : "");
+}
+
+int main(void)
+{
+    static uint16_t scene[TEST_W * TEST_H];
+    static uint8_t rgb[TEST_W * TEST_H * 3U];
+    static const uint32_t sizes[][2] = { { TEST_W, TEST_H }, { 157, 93 }, { 9, 7 }, { 320, 24 } };
+    static const uint32_t cameras[][2] = { { 1600, 1200 }, { 640, 480 }, { 2592, 1944 } };
+    uint8_t pixel[2] = { 0xF8, 0x1F };
+    uint32_t len;
+    uint8_t *jpeg;
+    char what[64];
+
+    MX_GPIO_Init();
+    MX_DMA_Init();
+    MX_SPI4_Init();
+    MX_TIM1_Init();
+    LCD_Test();
+    // Where panel (0, 0) lands in the controller's RAM
+    clear(0x0000);
+    LCD_FillRGBRect_DMA(0, 0, pixel, 1, 1, NULL);
+    LCD_WaitTransfer();
+    for (uint16_t y = 0; y < HOST_LCD_RAM_H; y++) {
+        for (uint16_t x = 0; x < HOST_LCD_RAM_W; x++) {
+            if (Host_LcdPixel(x, y) == 0xF81FU) {
+                lcd_x0 = x;
+                lcd_y0 = y;
+            }
+        }
+    }
+    printf("panel %ux%u at %u,%u in the controller\n", ST7735Ctx.Width, ST7735Ctx.Height,
+           lcd_x0, lcd_y0);
+
+    HOST_CHECK(Host_DiskOpen(TEST_DISK, 64U * 2048U, 0U, 0U, 0U));
+    HOST_CHECK(Host_DiskFormat(1) == FR_OK);
+
+    Host_SceneRGB565(scene, TEST_W, TEST_H, 1);
+    for (uint32_t i = 0; i < TEST_W * TEST_H; i++) {
+        uint32_t r = (scene[i] >> 8) & 0xF8U, g = (scene[i] >> 3) & 0xFCU, b = (scene[i] << 3) & 0xF8U;
+
+        rgb[3U * i] = (uint8_t)(r | (r >> 5));
+        rgb[3U * i + 1U] = (uint8_t)(g | (g >> 6));
+        rgb[3U * i + 2U] = (uint8_t)(b | (b >> 5));
+    }
+
+    for (uint32_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+        for (uint32_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            for (int quality = 50; quality <= 100; quality += 50) {
+                len = encode(rgb, sizes[s][0], sizes[s][1], quality, &layouts[l]);
+                snprintf(what, sizeof(what), "%s %lux%lu q%d", layouts[l].name,
+                         (unsigned long)sizes[s][0], (unsigned long)sizes[s][1], quality);
+                check_same(what, out, len);
+            }
+        }
+    }
+
+    // The stand-in camera's own encoder, up to the widest frame
+    for (uint32_t c = 0; c < sizeof(cameras) / sizeof(cameras[0]); c++) {
+        jpeg = Host_SceneJPEG((uint16_t)cameras[c][0], (uint16_t)cameras[c][1], 2, 80, &len);
+        HOST_CHECK(jpeg != NULL && len <= sizeof(out));
+        snprintf(what, sizeof(what), "camera %lux%lu q80", (unsigned long)cameras[c][0],
+                 (unsigned long)cameras[c][1]);
+        check_same(what, jpeg, len);
+        free(jpeg);
+    }
+
+    // Truncated anywhere: refused, or drawn as from the whole file when the
+    // rows it shows were all there. Every 11th cut, as each draw takes the
+    // panel's SPI time. The cut also has to survive a file read.
+    {
+        uint32_t full, drawn = 0, bad = 0;
+
+        full = encode(rgb, 157, 93, 75, &layouts[4]);
+        reference(out, full);
+        for (uint32_t cut = 0; cut < full; cut += 11U) {
+            clear(0x0821);
+            if (Review_ShowJPEG(out, cut)) {
+                drawn++;
+                bad += lcd_diff(0x0821) != 0U;
+            }
+        }
+        HOST_CHECK(bad == 0U);
+        save_file(out, full / 2U);
+        HOST_CHECK(!Review_ShowFile(TEST_FILE));
+        printf("%-28s %7lu cuts, %lu drawn, %lu wrong\n", "truncated 4:2:2 RST3",
+               (unsigned long)((full + 10U) / 11U), (unsigned long)drawn, (unsigned long)bad);
+    }
+
+    // Refused: not a JPEG, no file, progressive, wider than the rows
+    len = encode(rgb, TEST_W, TEST_H, 85, &layouts[1]);
+    HOST_CHECK(!Review_ShowJPEG(out + 2, len - 2));
+    HOST_CHECK(!Review_ShowJPEG(NULL, len));
+    HOST_CHECK(!Review_ShowFile("NONE.JPG"));
+    for (uint32_t i = 2; i + 1 < len; i++) {
+        if (out[i] == 0xFF && out[i + 1] == 0xC0) {
+            out[i + 1] = 0xC2;
+            HOST_CHECK(!Review_ShowJPEG(out, len));
+            break;
+        }
+    }
+    jpeg = Host_SceneJPEG(2720, 16, 2, 80, &len);
+    HOST_CHECK(jpeg != NULL && !Review_ShowJPEG(jpeg, len));
+    free(jpeg);
+
+    Host_DiskClose();
+    return Host_Result();
+}
@@ -0,0 +1,165 @@
+#include "host.h"
+#include "stdlib.h"
+#include "string.h"
+#include "fcntl.h"
+#include "unistd.h"
+#include "sdmmc.h"
+#include "sd_diskio.h"
+#include "capture.h"
+
+// sd_diskio's two paths against the disk image. A buffer in AXI SRAM, word
+// aligned for writes and cache-line aligned for reads, goes to SDMMC1's DMA
+// as it is, in one command. Anything else (misaligned, or in DTCM or D2
+// SRAM, which the IDMA cannot reach: the host disk fails such a transfer as
+// the target does) bounces through the scratch buffer, SD_SCRATCH_BLOCKS
+// per command. Either way the image must hold what was written, reads must
+// return it, and the bytes around the buffer must stay as they were.
+
+#define TEST_DISK       HOST_OUT_DIR "/test_sd_diskio.img"
+#define TEST_SECTORS    4096U
+#define TEST_BLOCK      512U
+#define TEST_SCRATCH    16U     // SD_SCRATCH_BLOCKS in sd_diskio.c
+#define TEST_MAX_BLOCKS 40U
+#define TEST_GUARD      64U
+#define TEST_AREA       (TEST_GUARD + TEST_MAX_BLOCKS * TEST_BLOCK + TEST_GUARD)
+
+__attribute__((section(".dtcm"), aligned(32)))
+static uint8_t test_dtcm[TEST_AREA];
+__attribute__((section(".ram_d2"), aligned(32)))
+static uint8_t test_d2[TEST_AREA];
+
+typedef struct {
+    const char *name;
+    uint8_t *area;      // TEST_AREA bytes; the buffer starts TEST_GUARD in
+    uint32_t offset;    // added to that start
+    uint8_t direct_read, direct_write;
+} Case_TypeDef;
+
+static int image_fd = -1;
+
+static uint8_t pattern(uint32_t seed, uint32_t sector, uint32_t i)
+{
+    uint32_t x = (seed * 2654435761U) ^ (sector * 40503U) ^ (i * 2246822519U);
+
+    return (uint8_t)(x >> 13);
+}
+
+static void fill(uint8_t *p, uint32_t seed, uint32_t sector, uint32_t count)
+{
+    for (uint32_t b = 0; b < count; b++) {
+        for (uint32_t i = 0; i < TEST_BLOCK; i++) {
+            p[b * TEST_BLOCK + i] = pattern(seed, sector + b, i);
+        }
+    }
+}
+
+// Blocks that differ from the pattern
+static uint32_t compare(const uint8_t *p, uint32_t seed, uint32_t sector, uint32_t count)
+{
+    uint32_t bad = 0;
+
+    for (uint32_t b = 0; b < count; b++) {
+        for (uint32_t i = 0; i < TEST_BLOCK; i++) {
+            if (p[b * TEST_BLOCK + i] != pattern(seed, sector + b, i)) {
+                bad++;
+                break;
+            }
+        }
+    }
+    return bad;
+}
+
+// Bytes of the area outside [start, start + len) that are not 0xA5
+static uint32_t guard_damage(const uint8_t *area, uint32_t start, uint32_t len)
+{
+    uint32_t bad = 0;
+
+    for (uint32_t i = 0; i < TEST_AREA; i++) {
+        bad += (i < start || i >= start + len) && area[i] != 0xA5U;
+    }
+    return bad;
+}
+
+static uint32_t commands(uint8_t direct, uint32_t count)
+{
+    return direct ? 1U : (count + TEST_SCRATCH - 1U) / TEST_SCRATCH;
+}
+
+static void check_case(const Case_TypeDef *c, uint32_t sector, uint32_t count, uint32_t seed)
+{
+    uint32_t start = TEST_GUARD + c->offset, len = count * TEST_BLOCK;
+    uint8_t *buf = c->area + start;
+    uint8_t *image = malloc(len);
+    uint32_t reads, writes, read_bad, write_bad, damage;
+    DRESULT rres, wres;
+
+    // Read: the image as written behind the driver's back
+    fill(image, seed, sector, count);
+    HOST_CHECK(pwrite(image_fd, image, len, (off_t)sector * TEST_BLOCK) == (ssize_t)len);
+    memset(c->area, 0xA5, TEST_AREA);
+    reads = Host_DiskReads();
+    rres = SD_Driver.disk_read(0, buf, sector, count);
+    reads = Host_DiskReads() - reads;
+    read_bad = compare(buf, seed, sector, count);
+    damage = guard_damage(c->area, start, len);
+
+    // Write: a different pattern, read back from the image file
+    memset(c->area, 0xA5, TEST_AREA);
+    fill(buf, seed + 1U, sector, count);
+    writes = Host_DiskWrites();
+    wres = SD_Driver.disk_write(0, buf, sector, count);
+    writes = Host_DiskWrites() - writes;
+    HOST_CHECK(pread(image_fd, image, len, (off_t)sector * TEST_BLOCK) == (ssize_t)len);
+    write_bad = compare(image, seed + 1U, sector, count);
+    damage += guard_damage(c->area, start, len);
+
+    HOST_CHECK(rres == RES_OK && read_bad == 0U && reads == commands(c->direct_read, count));
+    HOST_CHECK(wres == RES_OK && write_bad == 0U && writes == commands(c->direct_write, count));
+    HOST_CHECK(damage == 0U);
+    printf("%-14s %2lu blocks: read %s in %lu commands, write %s in %lu, %lu bad, %lu guard bytes hit\n",
+           c->name, (unsigned long)count, c->direct_read ? "direct " : "bounced",
+           (unsigned long)reads, c->direct_write ? "direct " : "bounced", (unsigned long)writes,
+           (unsigned long)(read_bad + write_bad), (unsigned long)damage);
+    free(image);
+}
+
+int main(void)
+{
+    static const uint32_t counts[] = { 1, 3, TEST_SCRATCH, TEST_SCRATCH + 1U, TEST_MAX_BLOCKS };
+    uint32_t size, sector = 64, seed = 1;
+    uint8_t *axi = Capture_Buffer(&size);
+    const Case_TypeDef cases[] = {
+        { "AXI",           axi,       0, 1, 1 },
+        { "AXI +4",        axi,       4, 0, 1 },    // word aligned, not line aligned
+        { "AXI +1",        axi,       1, 0, 0 },
+        { "D2 SRAM",       test_d2,   0, 0, 0 },
+        { "DTCM",          test_dtcm, 0, 0, 0 },
+        { "DTCM +4",       test_dtcm, 4, 0, 0 },
+    };
+    uint8_t *buf;
+
+    HOST_CHECK(size >= TEST_AREA && ((uintptr_t)axi & 0x1FU) == 0U);
+    HOST_CHECK(Host_DiskOpen(TEST_DISK, TEST_SECTORS, 20U, 50U, 2U));
+    image_fd = open(TEST_DISK, O_RDWR);
+    HOST_CHECK(image_fd >= 0);
+    MX_SDMMC1_SD_Init();
+    HOST_CHECK(SD_Driver.disk_initialize(0) == 0U);
+
+    for (uint32_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        for (uint32_t n = 0; n < sizeof(counts) / sizeof(counts[0]); n++) {
+            check_case(&cases[c], sector, counts[n], seed++);
+            sector += counts[n];
+        }
+    }
+
+    // Past the end of the card: refused on either path
+    for (uint32_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c += 3) {
+        buf = cases[c].area + TEST_GUARD + cases[c].offset;
+        HOST_CHECK(SD_Driver.disk_read(0, buf, TEST_SECTORS - TEST_SCRATCH, TEST_MAX_BLOCKS) != RES_OK);
+        HOST_CHECK(SD_Driver.disk_write(0, buf, TEST_SECTORS - TEST_SCRATCH, TEST_MAX_BLOCKS) != RES_OK);
+    }
+
+    close(image_fd);
+    Host_DiskClose();
+    return Host_Result();
+}
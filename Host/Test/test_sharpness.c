@@ -0,0 +1,321 @@
+#include "host.h"
+#include "stdlib.h"
+#include "string.h"
+#include "libjpeg.h"
+#include "sharpness.h"
+
+// Sharpness_ScoreJPEG reads the Huffman data itself; its score must be the
+// one LibJPEG's own 1/4-scale luma decode gives through the same Laplacian,
+// for the samplings, restart intervals and odd sizes a sensor or jpeg_encode
+// may write. Blurring a scene must lower the score, and files it cannot
+// read must be refused: truncated ones, corrupt headers and tables, and
+// random damage, none of which may take it outside the file or its tables.
+
+#define TEST_W          320
+#define TEST_H          240
+#define TEST_OUT_SIZE   (512U * 1024U)
+
+typedef struct {
+    const char *name;
+    int ncomp;
+    int h_samp, v_samp;         // luma
+    unsigned int restart;       // MCUs, 0 for none
+} layout_t;
+
+static const layout_t layouts[] = {
+    { "4:2:0",       3, 2, 2, 0 },
+    { "4:2:2",       3, 2, 1, 0 },
+    { "4:4:4",       3, 1, 1, 0 },
+    { "gray",        1, 1, 1, 0 },
+    { "4:2:2 RST3",  3, 2, 1, 3 },
+    { "4:2:0 RST1",  3, 2, 2, 1 },
+};
+
+static uint8_t out[TEST_OUT_SIZE];
+
+// This port's error_exit returns and LibJPEG carries on; stop instead
+static void test_error_exit(j_common_ptr cinfo)
+{
+    char msg[JMSG_LENGTH_MAX];
+
+    (*cinfo->err->format_message)(cinfo, msg);
+    printf("LibJPEG: %s\n", msg);
+    HOST_CHECK(0);
+    exit(Host_Result());
+}
+
+// Compress the top-left w x h of an RGB888 TEST_W-wide image into out[]
+static uint32_t encode(const uint8_t *rgb, uint32_t w, uint32_t h, int quality, const layout_t *l)
+{
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    unsigned char *buf = out;
+    unsigned long len = sizeof(out);
+    uint8_t gray[TEST_W];
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jerr.error_exit = test_error_exit;
+    jpeg_create_compress(&cinfo);
+    jpeg_mem_dest(&cinfo, &buf, &len);
+    cinfo.image_width = w;
+    cinfo.image_height = h;
+    cinfo.input_components = l->ncomp;
+    cinfo.in_color_space = (l->ncomp == 1) ? JCS_GRAYSCALE : JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    cinfo.comp_info[0].h_samp_factor = l->h_samp;
+    cinfo.comp_info[0].v_samp_factor = l->v_samp;
+    cinfo.restart_interval = l->restart;
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < h) {
+        JSAMPROW row = (JSAMPROW)&rgb[(size_t)cinfo.next_scanline * TEST_W * 3U];
+
+        if (l->ncomp == 1) {
+            for (uint32_t x = 0; x < w; x++) {
+                gray[x] = row[3U * x + 1U];
+            }
+            row = gray;
+        }
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    HOST_CHECK(buf == out);
+    return (uint32_t)len;
+}
+
+// What Sharpness_ScoreJPEG computed before it did its own reading: LibJPEG
+// decoding luma only at 1/4, three rows at a time
+static uint32_t reference(const uint8_t *jpeg, uint32_t len)
+{
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    Sharpness_AccTypeDef acc = { 0, 0, 0 };
+    JSAMPARRAY rows;
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jerr.error_exit = test_error_exit;
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, (unsigned char *)jpeg, len);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = 4;
+    cinfo.dct_method = JDCT_IFAST;
+    cinfo.do_fancy_upsampling = FALSE;
+    cinfo.do_block_smoothing = FALSE;
+    cinfo.out_color_space = JCS_GRAYSCALE;
+    jpeg_start_decompress(&cinfo);
+    rows = (*cinfo.mem->alloc_sarray)((j_common_ptr)&cinfo, JPOOL_IMAGE, cinfo.output_width, 3);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        uint32_t n = cinfo.output_scanline;
+
+        jpeg_read_scanlines(&cinfo, &rows[n % 3], 1);
+        if (n >= 2) {
+            Sharpness_AccumulateRow(rows[(n - 2) % 3], rows[(n - 1) % 3], rows[n % 3],
+                                    cinfo.output_width, &acc);
+        }
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return Sharpness_Variance(&acc);
+}
+
+static uint32_t check_same(const char *what, const uint8_t *jpeg, uint32_t len)
+{
+    uint32_t score = UINT32_MAX, ref = reference(jpeg, len);
+    uint8_t ok = Sharpness_ScoreJPEG(jpeg, len, &score);
+
+    HOST_CHECK(ok && score == ref);
+    printf("%-28s %6lu bytes: score %6lu, LibJPEG %6lu%s\n", what, (unsigned long)len,
+           (unsigned long)score, (unsigned long)ref, (ok && score == ref) ? "" : "  MISMATCH");
+    return score;
+}
+
+// Offset of the first header segment with this marker, 0 if there is none
+// before the scan
+static uint32_t find_segment(const uint8_t *jpeg, uint32_t len, uint8_t marker)
+{
+    uint32_t pos = 2;
+
+    while (pos + 4 <= len && jpeg[pos] == 0xFF) {
+        if (jpeg[pos + 1] == marker) {
+            return pos;
+        }
+        if (jpeg[pos + 1] == 0xDA) {
+            break;
+        }
+        pos += 2U + (((uint32_t)jpeg[pos + 2] << 8) | jpeg[pos + 3]);
+    }
+    return 0;
+}
+
+// Each damaged copy of out[] must be refused, and an intact one must still
+// score as before
+static void check_refused(const char *what, uint32_t len, uint8_t marker, uint32_t offset,
+                          const uint8_t *patch, uint32_t n)
+{
+    static uint8_t copy[TEST_OUT_SIZE];
+    uint32_t score, full, seg = find_segment(out, len, marker);
+    uint8_t ok;
+
+    HOST_CHECK(seg != 0 && Sharpness_ScoreJPEG(out, len, &full));
+    memcpy(copy, out, len);
+    memcpy(&copy[seg + offset], patch, n);
+    ok = Sharpness_ScoreJPEG(copy, len, &score);
+    HOST_CHECK(!ok);
+    HOST_CHECK(Sharpness_ScoreJPEG(out, len, &score) && score == full);
+    printf("%-28s %s\n", what, ok ? "ACCEPTED" : "refused");
+}
+
+// Box blur of radius r, in place
+static void blur(uint8_t *rgb, uint32_t r)
+{
+    static uint8_t tmp[TEST_W * TEST_H * 3U];
+
+    for (uint32_t pass = 0; pass < 2; pass++) {
+        for (int32_t y = 0; y < TEST_H; y++) {
+            for (int32_t x = 0; x < TEST_W; x++) {
+                for (uint32_t c = 0; c < 3; c++) {
+                    uint32_t sum = 0, n = 0;
+
+                    for (int32_t d = -(int32_t)r; d <= (int32_t)r; d++) {
+                        int32_t sx = pass ? x : x + d, sy = pass ? y + d : y;
+
+                        if (sx >= 0 && sx < TEST_W && sy >= 0 && sy < TEST_H) {
+                            sum += rgb[((size_t)sy * TEST_W + (size_t)sx) * 3U + c];
+                            n++;
+                        }
+                    }
+                    tmp[((size_t)y * TEST_W + (size_t)x) * 3U + c] = (uint8_t)(sum / n);
+                }
+            }
+        }
+        memcpy(rgb, tmp, sizeof(tmp));
+    }
+}
+
+int main(void)
+{
+    static uint16_t scene[TEST_W * TEST_H];
+    static uint8_t rgb[TEST_W * TEST_H * 3U];
+    static const uint32_t sizes[][2] = { { TEST_W, TEST_H }, { 157, 93 }, { 9, 7 } };
+    uint32_t len, score, last = UINT32_MAX;
+    uint8_t *jpeg;
+    char what[64];
+
+    Host_SceneRGB565(scene, TEST_W, TEST_H, 1);
+    for (uint32_t i = 0; i < TEST_W * TEST_H; i++) {
+        uint32_t r = (scene[i] >> 8) & 0xF8U, g = (scene[i] >> 3) & 0xFCU, b = (scene[i] << 3) & 0xF8U;
+
+        rgb[3U * i] = (uint8_t)(r | (r >> 5));
+        rgb[3U * i + 1U] = (uint8_t)(g | (g >> 6));
+        rgb[3U * i + 2U] = (uint8_t)(b | (b >> 5));
+    }
+
+    for (uint32_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+        for (uint32_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            for (int quality = 50; quality <= 100; quality += 45) {
+                len = encode(rgb, sizes[s][0], sizes[s][1], quality, &layouts[l]);
+                snprintf(what, sizeof(what), "%s %lux%lu q%d", layouts[l].name,
+                         (unsigned long)sizes[s][0], (unsigned long)sizes[s][1], quality);
+                check_same(what, out, len);
+            }
+        }
+    }
+
+    // The stand-in camera's own encoder, not LibJPEG's
+    jpeg = Host_SceneJPEG(800, 600, 2, 80, &len);
+    HOST_CHECK(jpeg != NULL);
+    check_same("camera scene 800x600 q80", jpeg, len);
+    free(jpeg);
+
+    // Sharper is higher
+    for (uint32_t r = 0; r <= 4; r = r ? r * 2U : 1U) {
+        if (r != 0) {
+            blur(rgb, r);
+        }
+        len = encode(rgb, TEST_W, TEST_H, 85, &layouts[1]);
+        snprintf(what, sizeof(what), "4:2:2 q85 blur %lu", (unsigned long)r);
+        score = check_same(what, out, len);
+        HOST_CHECK(score < last);
+        last = score;
+    }
+
+    // Refused: not a JPEG, no scan, progressive
+    len = encode(rgb, TEST_W, TEST_H, 85, &layouts[1]);
+    HOST_CHECK(!Sharpness_ScoreJPEG(out + 2, len - 2, &score));
+    HOST_CHECK(!Sharpness_ScoreJPEG(out, 2, &score));
+    for (uint32_t i = 2; i + 1 < len; i++) {
+        if (out[i] == 0xFF && out[i + 1] == 0xDA) {
+            HOST_CHECK(!Sharpness_ScoreJPEG(out, i, &score));
+            break;
+        }
+    }
+    for (uint32_t i = 2; i + 1 < len; i++) {
+        if (out[i] == 0xFF && out[i + 1] == 0xC0) {
+            out[i + 1] = 0xC2;
+            HOST_CHECK(!Sharpness_ScoreJPEG(out, len, &score));
+            break;
+        }
+    }
+
+    // Truncated anywhere before its EOI: refused, with or without restarts.
+    // Only the EOI itself may go.
+    for (uint32_t l = 1; l <= 4; l += 3) {
+        uint32_t full, refused = 0, bad = 0;
+
+        len = encode(rgb, 157, 93, 85, &layouts[l]);
+        HOST_CHECK(Sharpness_ScoreJPEG(out, len, &full));
+        for (uint32_t cut = 0; cut <= len; cut++) {
+            uint8_t ok = Sharpness_ScoreJPEG(out, cut, &score);
+
+            refused += !ok;
+            bad += (cut < len - 2U) ? ok : (!ok || score != full);
+        }
+        HOST_CHECK(bad == 0);
+        printf("%-28s %6lu cuts, %lu refused, %lu wrong\n",
+               (l == 1) ? "truncated 4:2:2" : "truncated 4:2:2 RST3", (unsigned long)len + 1U,
+               (unsigned long)refused, (unsigned long)bad);
+    }
+
+    // Corrupt headers and tables
+    len = encode(rgb, TEST_W, TEST_H, 85, &layouts[1]);
+    {
+        // The luma DC table's 12 codes all given one bit
+        static const uint8_t one_bit[16] = { 12 };
+
+        check_refused("DHT: 12 one-bit codes", len, 0xC4, 5, one_bit, sizeof(one_bit));
+    }
+    check_refused("DQT: 16-bit quantizers", len, 0xDB, 4, (const uint8_t *)"\x10", 1);
+    check_refused("DQT: missing", len, 0xDB, 1, (const uint8_t *)"\xEE", 1);
+    check_refused("SOF: 12-bit samples", len, 0xC0, 4, (const uint8_t *)"\x0C", 1);
+    check_refused("SOF: 65535 rows", len, 0xC0, 5, (const uint8_t *)"\xFF\xFF", 2);
+    check_refused("SOF: 65535 columns", len, 0xC0, 7, (const uint8_t *)"\xFF\xFF", 2);
+    check_refused("SOF: luma sampling 0x1", len, 0xC0, 11, (const uint8_t *)"\x01", 1);
+    check_refused("SOF: luma sampling 3x1", len, 0xC0, 11, (const uint8_t *)"\x31", 1);
+    check_refused("SOS: unknown component", len, 0xDA, 5, (const uint8_t *)"\x09", 1);
+    check_refused("SOS: DC table 2", len, 0xDA, 6, (const uint8_t *)"\x20", 1);
+
+    // Random damage anywhere past the SOI: whatever the outcome, the reads
+    // must stay inside the file and the tables (run under a sanitizer to see)
+    len = encode(rgb, 157, 93, 85, &layouts[4]);
+    {
+        static uint8_t copy[TEST_OUT_SIZE];
+        uint32_t seed = 0x2545F491U, refused = 0;
+
+        for (uint32_t t = 0; t < 4000; t++) {
+            memcpy(copy, out, len);
+            for (uint32_t n = 0; n <= t % 4U; n++) {
+                seed ^= seed << 13;
+                seed ^= seed >> 17;
+                seed ^= seed << 5;
+                copy[2U + seed % (len - 2U)] ^= (uint8_t)(1U << ((seed >> 24) & 7U));
+            }
+            refused += !Sharpness_ScoreJPEG(copy, len, &score);
+        }
+        HOST_CHECK(refused > 0);
+        printf("%-28s %6u files, %lu refused\n", "random bit flips", 4000U, (unsigned long)refused);
+    }
+
+    return Host_Result();
+}
@@ -0,0 +1,190 @@
+#include "host.h"
+#include "stdlib.h"
+#include "string.h"
+#include "capture.h"
+#include "preview.h"
+#include "jpeg_encode.h"
+#include "libjpeg.h"
+
+// SNAPSHOT.ON on the card: a K1 press saves the preview frame through the
+// LibJPEG encoder instead of switching the sensor to JPEG. The file must
+// decode to the centre of the scene the camera sends, close to the original
+// pixels at JPEG_ENCODE_QUALITY.
+
+#define TEST_DISK       HOST_OUT_DIR "/test_snapshot.img"
+#define TEST_TIMEOUT_MS 20000U
+#define TEST_SENSOR_H   120U    // QQVGA; the DCMI keeps the middle 80 lines
+#define TEST_MAX_ERROR  8.0     // mean absolute error per 8-bit channel
+
+int Firmware_Main(void);
+
+static uint16_t scene[TEST_SENSOR_H * PREVIEW_WIDTH];
+
+typedef enum {
+    STEP_BOOT_PRESS,
+    STEP_BOOT_RELEASE,
+    STEP_SETTLE,
+    STEP_PRESS,
+    STEP_RELEASE,
+} step_t;
+
+static step_t step;
+static uint32_t step_tick;
+
+// Status lines go to stdout as well as the LCD
+void Capture_ShowStatus(const char *msg)
+{
+    printf("status: %s\n", msg);
+}
+
+// This port's error_exit returns and LibJPEG carries on; stop instead
+static void test_error_exit(j_common_ptr cinfo)
+{
+    char msg[JMSG_LENGTH_MAX];
+
+    (*cinfo->err->format_message)(cinfo, msg);
+    printf("LibJPEG: %s\n", msg);
+    HOST_CHECK(0);
+    exit(Host_Result());
+}
+
+static void next(step_t s)
+{
+    step = s;
+    step_tick = HAL_GetTick();
+}
+
+// The one photo on the card
+static uint8_t *load_photo(uint32_t *len)
+{
+    DIR dir;
+    FILINFO fno;
+    FIL f;
+    UINT n = 0;
+    uint8_t *buf = NULL;
+
+    *len = 0;
+    if (f_opendir(&dir, "") != FR_OK) {
+        return NULL;
+    }
+    while (f_readdir(&dir, &fno) == FR_OK && fno.fname[0] != '\0') {
+        if (strstr(fno.fname, ".JPG") == NULL && strstr(fno.fname, ".jpeg") == NULL) {
+            continue;
+        }
+        HOST_CHECK(buf == NULL);
+        if (buf == NULL && f_open(&f, fno.fname, FA_READ) == FR_OK) {
+            buf = malloc(fno.fsize);
+            if (f_read(&f, buf, (UINT)fno.fsize, &n) == FR_OK && n == fno.fsize) {
+                *len = n;
+            }
+            f_close(&f);
+            printf("%s: %lu bytes\n", fno.fname, (unsigned long)fno.fsize);
+        }
+    }
+    f_closedir(&dir);
+    return buf;
+}
+
+static void check_photo(void)
+{
+    struct jpeg_decompress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    uint32_t len;
+    uint8_t *jpeg = load_photo(&len);
+    uint8_t row[PREVIEW_WIDTH * 3];
+    JSAMPROW rows[1] = { row };
+    double error = 0;
+
+    HOST_CHECK(jpeg != NULL && len > 0U);
+    if (jpeg == NULL || len == 0U) {
+        return;
+    }
+    cinfo.err = jpeg_std_error(&jerr);
+    jerr.error_exit = test_error_exit;
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, jpeg, len);
+    jpeg_read_header(&cinfo, TRUE);
+    // No 16x16 IDCT in the trimmed library for fancy upsampling to use
+    cinfo.do_fancy_upsampling = FALSE;
+    cinfo.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&cinfo);
+    HOST_CHECK(cinfo.output_width == PREVIEW_WIDTH && cinfo.output_height == PREVIEW_HEIGHT);
+    while (cinfo.output_scanline < cinfo.output_height && cinfo.output_width == PREVIEW_WIDTH) {
+        const uint16_t *src;
+
+        src = scene + (cinfo.output_scanline + (TEST_SENSOR_H - PREVIEW_HEIGHT) / 2U) * PREVIEW_WIDTH;
+        jpeg_read_scanlines(&cinfo, rows, 1);
+        for (uint32_t x = 0; x < PREVIEW_WIDTH; x++) {
+            uint16_t p = src[x];
+            int r = ((p >> 11) & 0x1F) * 255 / 31;
+            int g = ((p >> 5) & 0x3F) * 255 / 63;
+            int b = (p & 0x1F) * 255 / 31;
+
+            error += abs(row[3 * x] - r) + abs(row[3 * x + 1] - g) + abs(row[3 * x + 2] - b);
+        }
+    }
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    free(jpeg);
+
+    error /= (double)PREVIEW_WIDTH * PREVIEW_HEIGHT * 3;
+    printf("decoded %ux%u, mean error %.2f per channel\n", PREVIEW_WIDTH, PREVIEW_HEIGHT, error);
+    HOST_CHECK(error < TEST_MAX_ERROR);
+}
+
+static void loop_hook(void)
+{
+    uint32_t now = HAL_GetTick();
+
+    if (now > TEST_TIMEOUT_MS) {
+        printf("timed out in step %d\n", step);
+        HOST_CHECK(0);
+        exit(Host_Result());
+    }
+
+    switch (step) {
+    case STEP_BOOT_PRESS:
+        Host_SetKey(1);
+        next(STEP_BOOT_RELEASE);
+        break;
+    case STEP_BOOT_RELEASE:
+        Host_SetKey(0);
+        next(STEP_SETTLE);
+        break;
+    case STEP_SETTLE:
+        if (now - step_tick >= 500U) {
+            next(STEP_PRESS);
+            Host_SetKey(1);
+        }
+        break;
+    case STEP_PRESS:
+        if (now - step_tick >= 50U) {
+            Host_SetKey(0);
+            next(STEP_RELEASE);
+        }
+        break;
+    case STEP_RELEASE:
+        // The snapshot is taken and written before the loop comes round;
+        // the sensor never left preview
+        HOST_CHECK(Capture_GetState() == CAPTURE_STATE_IDLE);
+        check_photo();
+        exit(Host_Result());
+    }
+}
+
+int main(void)
+{
+    FIL f;
+
+    HOST_CHECK(Host_DiskOpen(TEST_DISK, 64U * 2048U, 100U, 200U, 2U));
+    HOST_CHECK(Host_DiskFormat(1) == FR_OK);
+    HOST_CHECK(f_open(&f, JPEG_SNAPSHOT_FILE, FA_CREATE_ALWAYS | FA_WRITE) == FR_OK);
+    f_close(&f);
+
+    Host_SceneRGB565(scene, PREVIEW_WIDTH, TEST_SENSOR_H, 1);
+    Host_CameraSetRGB565(scene, PREVIEW_WIDTH, TEST_SENSOR_H, 1);
+
+    Host_SetLoopHook(loop_hook);
+    Firmware_Main();
+    return 1;
+}
@@ -0,0 +1,136 @@
+#######################################
+# Host build (make host / host-test / host-bench)
+#######################################
+# The capture, storage and display modules built for the development machine
+# with gcc, against the peripheral stand-ins in Host/Src: a camera replaying
+# recorded frames through a DCMI/DMA model, an SD card backed by a disk image
+# file, and an ST7735 framebuffer behind the SPI. Tests and benchmarks link
+# the same firmware sources as the target build.
+# HOST_DSP=1 builds into its own directory with the DSP extension emulated
+# (host_cmsis.h), so the modules' SIMD paths run instead of their plain C
+HOST_DSP ?= 0
+ifeq ($(HOST_DSP),1)
+HOST_BUILD_DIR = $(BUILD_DIR)/host-dsp
+else
+HOST_BUILD_DIR = $(BUILD_DIR)/host
+endif
+HOST_CC = gcc
+
+# Non-PIE and statics below 4 GB: the firmware keeps buffer addresses in
+# 32-bit DMA registers. .sram1/.ram_d2 land where the linker script puts them
+# on the target, so the DMA reachability checks see the same memory map.
+HOST_CFLAGS = -O2 -g -Wall -Wno-format -Wno-pointer-to-int-cast -Wno-int-to-pointer-cast \
+-fno-pie -fno-strict-aliasing $(C_DEFS) -DHOST_BUILD=1 -DHOST_DSP=$(HOST_DSP) -DHOST_OUT_DIR=\"$(HOST_BUILD_DIR)\" -include host_cmsis.h \
+-IHost/Inc $(C_INCLUDES) -MMD -MP
+HOST_LDFLAGS = -no-pie -rdynamic -Wl,-Tdata=0x24000000 -Wl,-T,Host/host.ld -lm
+
+HOST_FW_SOURCES = \
+Src/main.c \
+Src/gpio.c \
+Src/dma.c \
+Src/tim.c \
+Src/lptim.c \
+Src/sdmmc.c \
+Src/timelapse.c \
+Src/capture.c \
+Src/capture_profile.c \
+Src/preview.c \
+Src/dcmi.c \
+Src/i2c.c \
+Src/spi.c \
+Src/metrics.c \
+Src/jpeg_marker.c \
+Src/contig_write.c \
+Src/sd_diskio.c \
+Src/bsp_driver_sd.c \
+Src/fatfs_platform.c \
+Src/sd_bus.c \
+Src/sd_bench.c \
+Src/fatfs.c \
+Src/ae_awb.c \
+Src/motion.c \
+Src/jpeg_walk.c \
+Src/sharpness.c \
+Src/burst.c \
+Src/review.c \
+Src/jpeg_encode.c \
+Src/jpeg_dsp.c \
+Src/libjpeg.c \
+Src/jdata_conf.c \
+Drivers/CMSIS/DSP/Source/StatisticsFunctions/arm_mean_q15.c \
+Drivers/CMSIS/DSP/Source/StatisticsFunctions/arm_max_q15.c \
+Drivers/BSP/Camera/camera.c \
+Drivers/BSP/Camera/ov7670.c \
+Drivers/BSP/Camera/ov2640.c \
+Drivers/BSP/Camera/ov7725.c \
+Drivers/BSP/Camera/ov5640.c \
+Drivers/BSP/Camera/ov7670_regs.c \
+Drivers/BSP/Camera/ov2640_regs.c \
+Drivers/BSP/Camera/ov7725_regs.c \
+Drivers/BSP/Camera/ov5640_regs.c \
+Drivers/BSP/ST7735/st7735.c \
+Drivers/BSP/ST7735/st7735_reg.c \
+Drivers/BSP/ST7735/lcd.c \
+Drivers/BSP/ST7735/logo_160_80.c \
+Drivers/BSP/ST7735/logo_128_160.c \
+Drivers/BSP/ST7735/logo.c \
+Drivers/STM32H7xx_HAL_Driver/Src/stm32h7xx_hal_cortex.c \
+Drivers/STM32H7xx_HAL_Driver/Src/stm32h7xx_hal_dcmi.c \
+Middlewares/Third_Party/FatFs/src/diskio.c \
+Middlewares/Third_Party/FatFs/src/ff.c \
+Middlewares/Third_Party/FatFs/src/ff_gen_drv.c \
+$(filter Middlewares/Third_Party/LibJPEG/%,$(C_SOURCES))
+
+HOST_SOURCES = \
+Host/Src/host_hal.c \
+Host/Src/host_dcmi.c \
+Host/Src/host_i2c.c \
+Host/Src/host_spi.c \
+Host/Src/host_disk.c \
+Host/Src/host_scene.c
+
+HOST_TESTS = $(patsubst Host/Test/%.c,$(HOST_BUILD_DIR)/%,$(wildcard Host/Test/*.c))
+HOST_BENCHES = $(patsubst Host/Bench/%.c,$(HOST_BUILD_DIR)/%,$(wildcard Host/Bench/*.c))
+
+HOST_OBJECTS = $(addprefix $(HOST_BUILD_DIR)/,$(notdir $(HOST_FW_SOURCES:.c=.o) $(HOST_SOURCES:.c=.o)))
+vpath %.c $(sort $(dir $(HOST_FW_SOURCES) $(HOST_SOURCES)) Host/Test/ Host/Bench/)
+
+$(HOST_BUILD_DIR)/%.o: %.c Makefile Host/host.mk | $(HOST_BUILD_DIR)
+	$(HOST_CC) -c $(HOST_CFLAGS) $< -o $@
+
+# The stand-ins', tests' and benchmarks' own statics move out of the
+# target's AXI SRAM budget (see host.ld)
+HOST_SIDE_OBJECTS = $(addprefix $(HOST_BUILD_DIR)/,$(notdir $(HOST_SOURCES:.c=.o))) \
+$(HOST_TESTS:=.o) $(HOST_BENCHES:=.o)
+$(HOST_SIDE_OBJECTS): $(HOST_BUILD_DIR)/%.o: %.c Makefile Host/host.mk | $(HOST_BUILD_DIR)
+	$(HOST_CC) -c $(HOST_CFLAGS) $< -o $@
+	objcopy --rename-section .data=.host.data --rename-section .bss=.host.bss $@
+
+# The firmware's main() stays out of the way of each program's own, and its
+# Error_Handler, which blinks forever, gives way to one that stops
+$(HOST_BUILD_DIR)/main.o: HOST_CFLAGS += -Dmain=Firmware_Main -DError_Handler=Firmware_Error_Handler
+
+# Every object is linked, not taken from an archive, so a strong definition
+# always wins over the __weak one whatever the link order
+$(HOST_BUILD_DIR)/%: $(HOST_BUILD_DIR)/%.o $(HOST_OBJECTS) Host/host.ld
+	$(HOST_CC) $(filter %.o,$^) $(HOST_LDFLAGS) -o $@
+
+$(HOST_BUILD_DIR):
+	mkdir -p $@
+
+.PHONY: host host-test host-bench
+.SECONDARY:
+
+host: $(HOST_TESTS) $(HOST_BENCHES)
+
+# The tests run again with the DSP extension emulated
+host-test: $(HOST_TESTS)
+	@for t in $(HOST_TESTS); do echo "$$t"; $$t || exit 1; done
+ifneq ($(HOST_DSP),1)
+	@$(MAKE) --no-print-directory host-test HOST_DSP=1
+endif
+
+host-bench: $(HOST_BENCHES)
+	@for b in $(HOST_BENCHES); do echo "$$b"; $$b || exit 1; done
+
+-include $(wildcard $(HOST_BUILD_DIR)/*.d)
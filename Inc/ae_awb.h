@@ -0,0 +1,110 @@
+#ifndef __AE_AWB_H
+#define __AE_AWB_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+#include "arm_math.h"
+#include "camera.h"
+#include "preview.h"
+
+// 1: exposure, gain and white balance are set from preview frame statistics.
+// 0: the sensor's own AEC/AGC/AWB run as before.
+#ifndef AE_AWB_ENABLE
+#define AE_AWB_ENABLE        1
+#endif
+
+// Every AE_STEP-th pixel of every AE_STEP-th row is sampled
+#ifndef AE_STEP
+#define AE_STEP              4
+#endif
+#define AE_MAX_SAMPLES       ((PREVIEW_WIDTH / AE_STEP) * (PREVIEW_HEIGHT / AE_STEP))
+#define AE_HIST_BINS         64
+
+// Mean luma aimed for (0..255) and how far off it may be before the
+// sensor is touched
+#ifndef AE_TARGET
+#define AE_TARGET            118
+#endif
+#ifndef AE_DEADBAND
+#define AE_DEADBAND          8
+#endif
+// More than this percentage of samples in the top histogram bin counts as
+// blown highlights and pulls the exposure down
+#ifndef AE_CLIP_PERCENT
+#define AE_CLIP_PERCENT      2
+#endif
+// Exposure limits: lines (beyond a frame's worth the preview slows down)
+// and AGC gain in sixteenths (128 = 8x, the COM9 ceiling)
+#ifndef AE_MAX_LINES
+#define AE_MAX_LINES         640
+#endif
+#ifndef AE_MAX_GAIN16
+#define AE_MAX_GAIN16        128
+#endif
+// Channel balance error, in percent of green, that AWB leaves alone
+#ifndef AWB_DEADBAND_PERCENT
+#define AWB_DEADBAND_PERCENT 3
+#endif
+#define AWB_GAIN_MIN         0x30
+#define AWB_GAIN_MAX         0x90
+
+// Sensor updates are at least this far apart, bounding the I2C traffic to
+// a handful of register writes per update
+#ifndef AE_UPDATE_MS
+#define AE_UPDATE_MS         100
+#endif
+
+// Exposure lines scale (Q8) from the preview mode to a JPEG mode. Preview
+// runs the sensor's SVGA timing (1190 clocks a line) at CLKRC 0x00, JPEG
+// at CLKRC 0x03 (a quarter of the clock) with SVGA or UXGA (1922 clocks a
+// line) timing, so the same exposure time is 1/4 or 1/6.5 of the lines.
+#ifndef AE_CAPTURE_SCALE_SVGA
+#define AE_CAPTURE_SCALE_SVGA 64
+#endif
+#ifndef AE_CAPTURE_SCALE_UXGA
+#define AE_CAPTURE_SCALE_UXGA 40
+#endif
+
+// Statistics of one preview frame. Levels are Q15 (0x7FFF full scale).
+typedef struct {
+    q15_t mean_y, max_y;
+    q15_t mean_r, mean_g, mean_b;
+    uint32_t max_index;                 // sample holding max_y
+    uint16_t hist[AE_HIST_BINS];        // luma histogram of the samples
+    uint16_t samples;
+    uint32_t cycles;                    // CPU cycles AeAwb_Process spent on them
+} AeAwb_StatsTypeDef;
+
+// Exposure state the loop last sent to the sensor
+typedef struct {
+    uint16_t lines, gain16;             // exposure lines, AGC gain (16 = 1x)
+    uint8_t wb_r, wb_g, wb_b;           // white balance gains (0x40 ~ 1x)
+    uint32_t updates;                   // times the sensor was written
+} AeAwb_StateTypeDef;
+
+// Statistics of a big-endian RGB565 frame, subsampled by AE_STEP. Pure C
+// and CMSIS-DSP, so recorded frames can be run through it on a host.
+void AeAwb_ComputeStats(const uint16_t *frame, uint16_t width, uint16_t height,
+                        AeAwb_StatsTypeDef *st);
+// The preview (re)started: take over the exposure the sensor is at
+void AeAwb_Start(void);
+// Measure a preview frame and, at most every AE_UPDATE_MS, correct the
+// sensor's exposure, gain and white balance
+void AeAwb_Process(const uint16_t *frame);
+// The sensor was just switched to JPEG at 'framesize': give it the
+// preview's exposure and white balance instead of its own AEC/AWB
+void AeAwb_ApplyCapture(framesize_t framesize);
+// Hand exposure and white balance back to the sensor (1), for modes
+// without a preview to measure, or take them over again (0)
+void AeAwb_Suspend(uint8_t on);
+const AeAwb_StatsTypeDef *AeAwb_GetStats(void);
+const AeAwb_StateTypeDef *AeAwb_GetState(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __AE_AWB_H */
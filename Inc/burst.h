@@ -0,0 +1,73 @@
+#ifndef __BURST_H
+#define __BURST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+#include "camera.h"
+
+// Burst frames are smaller than a full snapshot so several fit the queue
+#ifndef BURST_FRAMESIZE
+#define BURST_FRAMESIZE  FRAMESIZE_SVGA
+#endif
+#ifndef BURST_QUALITY
+#define BURST_QUALITY    12
+#endif
+// Frames taken per burst
+#ifndef BURST_FRAMES
+#define BURST_FRAMES     10
+#endif
+// Queue slot size; the capture buffer is split into slots of this size
+#define BURST_SLOT_SIZE  (64*1024)
+
+// Best-of: while this file is on the card (checked at mount) a K1 photo is
+// the sharpest of several frames at the capture profile. Its first line
+// may hold the number of candidates.
+#define BURST_BEST_FILE    "BESTOF.ON"
+#ifndef BURST_BEST_FRAMES
+#define BURST_BEST_FRAMES  5
+#endif
+#define BURST_BEST_MAX     16
+
+typedef struct {
+    uint32_t captured;   // frames ended by DCMI
+    uint32_t saved;      // frames written to the card
+    uint32_t dropped;    // frames lost because the queue was full
+    uint32_t oversize;   // frames larger than a queue slot
+    uint32_t invalid;    // frames without SOI/EOI markers
+    uint32_t max_depth;  // deepest the queue got
+    uint32_t best;       // best-of: candidate kept (0 = first)
+    uint32_t best_score; // best-of: its sharpness score
+    uint32_t score_cycles; // best-of: CPU cycles scoring all candidates
+} Burst_StatsTypeDef;
+
+// Capture 'frames' JPEG frames back to back with the sensor left in JPEG
+// mode; frames queue in the capture buffer while earlier ones go to SD.
+// Returns the number of frames saved.
+uint32_t Burst_Capture(DCMI_HandleTypeDef *hdcmi, uint32_t frames);
+// Call from HAL_DCMI_FrameEventCallback; stops the DMA stream without waiting.
+// The DMA abort callback then queues the frame and re-arms the stream.
+void Burst_FrameEvent(DCMI_HandleTypeDef *hdcmi);
+// Candidates per best-of photo if the trigger file is on the mounted card,
+// else 0
+uint32_t Burst_BestRequested(void);
+// Best-of candidates for K1 photos; 0 turns it off (the default)
+void Burst_SetBest(uint32_t candidates);
+uint32_t Burst_Best(void);
+// Take 'candidates' frames at the current capture profile one after the
+// other, score each with Sharpness_ScoreJPEG() and save only the sharpest.
+// Frames go to two halves of the capture buffer, so each must fit in half.
+// Returns 1 if a photo was saved.
+uint8_t Burst_CaptureBest(DCMI_HandleTypeDef *hdcmi, uint32_t candidates);
+// Frames captured but not yet written
+uint32_t Burst_QueueDepth(void);
+// Counters of the current or last burst
+void Burst_GetStats(Burst_StatsTypeDef *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BURST_H */
@@ -8,11 +8,85 @@ extern "C" {
 #include "main.h"
 #include "fatfs.h"
 
+// 1: write JPEG chunks to SD while DCMI is still receiving (frame size not
+//    limited by the capture buffer). 0: capture whole frame, then write.
+#ifndef CAPTURE_STREAM_MODE
+#define CAPTURE_STREAM_MODE 1
+#endif
+
+// JPEG quality (OV2640 QS, lower is finer) of the default capture profile;
+// photos are taken at the size and QS of the selected profile (capture_profile.h).
+// A frame that does not fit is retaken at twice the QS, up to CAPTURE_QUALITY_MAX.
+#ifndef CAPTURE_QUALITY
+#define CAPTURE_QUALITY     2
+#endif
+#ifndef CAPTURE_QUALITY_MAX
+#define CAPTURE_QUALITY_MAX 16
+#endif
+// Bytes added to the estimated frame size for headers and tables
+#ifndef CAPTURE_JPEG_MARGIN
+#define CAPTURE_JPEG_MARGIN (8*1024)
+#endif
+
+// 1: keep the next photo ID in PHOTOID.IDX on the card so a fresh mount does
+//    not have to scan the root directory. 0: scan once per mount.
+#ifndef CAPTURE_PHOTO_INDEX
+#define CAPTURE_PHOTO_INDEX 1
+#endif
+// Photo IDs reserved per index write. The index holds an ID no photo has
+// reached yet and is only rewritten once the photos pass it, so the card
+// sees one index write per this many shots; after a remount numbering
+// resumes from the reservation, skipping up to this many unused IDs.
+#ifndef CAPTURE_PHOTO_INDEX_STEP
+#define CAPTURE_PHOTO_INDEX_STEP 32
+#endif
+
+typedef enum {
+    CAPTURE_STATE_IDLE,     // no capture in flight
+    CAPTURE_STATE_SETTLE,   // sensor switched to JPEG, waiting before arming DMA
+    CAPTURE_STATE_VSYNC,    // DMA armed, waiting for the frame to start
+    CAPTURE_STATE_FRAME,    // frame arriving (streaming: chunks going to SD)
+} Capture_StateTypeDef;
 
-// Function to save RGB565 frame as BMP to SD card
+// Capture a JPEG to the SD card; blocks until it is saved or has failed
 uint8_t take_A_Picture(DCMI_HandleTypeDef *hdcmi);
-// Optional helper to show status on LCD (if needed)
-void Capture_ShowSavedMessage(void);
+// Open the photo file and switch the sensor to JPEG; the rest of the capture
+// is driven by Capture_Process(). 0 if a capture is already in flight or the
+// file cannot be created. The DCMI must already be in JPEG mode.
+uint8_t Capture_Start(DCMI_HandleTypeDef *hdcmi);
+// Advance the capture in flight from the DCMI/DMA events it has seen. Call
+// from the main loop; returns 1 while the capture still needs calls.
+uint8_t Capture_Process(void);
+Capture_StateTypeDef Capture_GetState(void);
+// 1 if the last finished capture was saved
+uint8_t Capture_LastResult(void);
+// Load the next photo ID for the mounted card (index file or one directory
+// scan). Optional: the first capture after a mount does it otherwise.
+void Capture_InitPhotoId(void);
+// Mount the card if needed and create the file for the next free photo ID
+// (FR_NOT_READY if the card cannot be mounted, FR_EXIST if no name is free)
+FRESULT Capture_OpenPhotoFile(FIL *fp, char *filename, size_t filename_size, uint32_t *id_out);
+// Close a file from Capture_OpenPhotoFile; ok == 0 deletes it and frees its ID
+void Capture_ClosePhotoFile(FIL *fp, const char *filename, uint32_t id, uint8_t ok);
+// After a photo is saved: reserve the next CAPTURE_PHOTO_INDEX_STEP IDs in
+// the index file if the photos have used up the last reservation (no-op
+// otherwise, and unless CAPTURE_PHOTO_INDEX)
+void Capture_SavePhotoIndex(void);
+// The JPEG capture buffer in AXI SRAM, for other capture modes to borrow
+uint8_t *Capture_Buffer(uint32_t *size);
+// The last saved image (SOI..EOI) while it is still whole in the capture
+// buffer, NULL otherwise (streamed frame larger than the ring, failed
+// capture, buffer borrowed since)
+const uint8_t *Capture_LastJPEG(uint32_t *len);
+// File name of the last saved image, NULL if the last capture failed
+const char *Capture_LastFilename(void);
+// CPU cycles the last capture spent locating the JPEG SOI/EOI markers
+uint32_t Capture_LastScanCycles(void);
+// Card write rate of the last saved capture in KB/s, from its first write
+// to the file close; the bus speed behind it is SD_Bus_GetSpeed()
+uint32_t Capture_LastWriteRate(void);
+// Show a capture status message (LCD status line by default; weak)
+void Capture_ShowStatus(const char *msg);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,50 @@
+#ifndef __CAPTURE_PROFILE_H
+#define __CAPTURE_PROFILE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+#include "fatfs.h"
+#include "camera.h"
+
+// Read after mount; selects and (re)defines profiles, see CaptureProfile_Load
+#define CAPTURE_PROFILE_FILE    "CAPTURE.CFG"
+#ifndef CAPTURE_PROFILE_MAX
+#define CAPTURE_PROFILE_MAX     8
+#endif
+#define CAPTURE_PROFILE_NAME_LEN 8
+
+// What a photo is taken at. With a target size the QS floats between 'qs'
+// and CAPTURE_QUALITY_MAX, steered by the size of the previous photo; with
+// target 0 every photo is taken at 'qs'.
+typedef struct {
+    char name[CAPTURE_PROFILE_NAME_LEN];
+    framesize_t framesize;
+    uint8_t qs;             // finest QS (2..60, lower is finer)
+    uint32_t target;        // file size aimed for in bytes, 0 for fixed QS
+} CaptureProfile_TypeDef;
+
+// The profile the next photo uses
+const CaptureProfile_TypeDef *CaptureProfile_Get(void);
+// Step to the next profile (wrapping) and return it
+const CaptureProfile_TypeDef *CaptureProfile_Next(void);
+// Select a profile by name (case-insensitive); 0 if there is none
+uint8_t CaptureProfile_Select(const char *name);
+// QS to start the next photo at
+uint8_t CaptureProfile_QS(void);
+// A photo of 'bytes' was saved at QS 'qs': adjust the QS of the next one
+// towards the profile's target size
+void CaptureProfile_Update(uint8_t qs, uint32_t bytes);
+// Read a profile file. One setting per line, '#' starts a comment:
+//   <name> = <width>x<height> <qs> [<target KB>]   define or replace a profile
+//   profile = <name>                               select the starting profile
+// FR_NO_FILE leaves the built-in profiles as they are.
+FRESULT CaptureProfile_Load(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CAPTURE_PROFILE_H */
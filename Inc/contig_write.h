@@ -0,0 +1,42 @@
+#ifndef __CONTIG_WRITE_H
+#define __CONTIG_WRITE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+#include "fatfs.h"
+
+// 1: photo files get their clusters in one contiguous run up front (f_expand)
+//    and data goes straight to the card in multi-block writes. 0: f_write.
+#ifndef CONTIG_WRITE_ENABLE
+#define CONTIG_WRITE_ENABLE 1
+#endif
+
+// Writer over one freshly created (empty) file
+typedef struct {
+    FIL *fp;
+    DWORD sect;         // first sector of the pre-allocated run, 0 if none
+    DWORD nsect;        // sectors in the run
+    DWORD done;         // sectors of the run written so far
+    UINT fill;          // bytes of a part sector held in 'tail'
+    uint8_t tail[_MAX_SS];
+} ContigWrite_TypeDef;
+
+// Pre-allocate 'expect' bytes, rounded up to whole clusters, as one run.
+// If the volume has no free run that long the writer falls back to f_write;
+// FR_OK either way unless the card itself fails.
+FRESULT ContigWrite_Begin(ContigWrite_TypeDef *cw, FIL *fp, FSIZE_t expect);
+// Append bytes. Whole sectors go to the card in one multi-block write from
+// 'buf' itself; past the end of the run, FatFs extends the file as usual.
+FRESULT ContigWrite_Write(ContigWrite_TypeDef *cw, const void *buf, UINT len);
+// Write the last part sector and cut the file to the bytes written, freeing
+// the rest of the run. The file is left open for f_close.
+FRESULT ContigWrite_End(ContigWrite_TypeDef *cw);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CONTIG_WRITE_H */
@@ -41,6 +41,9 @@ extern DCMI_HandleTypeDef hdcmi;
 void MX_DCMI_Init(void);
 
 /* USER CODE BEGIN Prototypes */
+HAL_StatusTypeDef DCMI_Start_DMA_DoubleBuffer(DCMI_HandleTypeDef *hdcmi, uint32_t DCMI_Mode,
+                                              uint32_t Buf0, uint32_t Buf1, uint32_t Length,
+                                              void (*XferCplt)(DMA_HandleTypeDef *hdma));
 
 /* USER CODE END Prototypes */
 
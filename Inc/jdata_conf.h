@@ -31,8 +31,19 @@
 /* Private functions ---------------------------------------------------------*/
 
 /*This defines the memory allocation methods.*/
-#define JMALLOC   malloc
-#define JFREE     free
+/*LibJPEG allocates from a static arena in DTCM instead of the heap, which is
+  only _Min_Heap_Size (4 KB). One compress or decompress object at a time; the
+  arena is reset when its last block is freed (jpeg_destroy).*/
+#ifndef JPEG_ARENA_SIZE
+#define JPEG_ARENA_SIZE  (32*1024)
+#endif
+#define JMALLOC   jpeg_arena_alloc
+#define JFREE     jpeg_arena_free
+
+void *jpeg_arena_alloc (size_t size);
+void jpeg_arena_free (void *ptr);
+/*Most arena bytes in use at once since reset, for sizing JPEG_ARENA_SIZE*/
+size_t jpeg_arena_peak (void);
 
 /*This defines the File data manager type.*/
 #define JFILE            FIL
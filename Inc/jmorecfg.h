@@ -152,11 +152,15 @@ typedef short    INT16;
 #ifndef _BASETSD_H_ /* Microsoft defines it in basetsd.h */
 #ifndef _BASETSD_H  /* MinGW is slightly different */
 #ifndef QGLOBAL_H   /* Qt defines it in qglobal.h */
+#if defined(HOST_BUILD)
+typedef int INT32;  /* 32 bits as on the target: the tables fill the arena alike */
+#else
 typedef long INT32;
 #endif
 #endif
 #endif
 #endif
+#endif
 
 /* Datatype used for image dimensions.  The JPEG standard only supports
  * images up to 64K*64K due to 16-bit fields in SOF markers.  Therefore
@@ -239,6 +243,15 @@ typedef int boolean;
 #define JPEG_INTERNAL_OPTIONS
 #endif
 
+/*
+ * The target keeps the message codes but not their text. Outside the
+ * internal options, as jerror.c (which builds the table) is not a core
+ * module and does not define JPEG_INTERNALS.
+ */
+#ifndef HOST_BUILD
+#define NO_MESSAGE_TEXT /* Message codes only, no strings? */
+#endif
+
 #ifdef JPEG_INTERNAL_OPTIONS
 
 /*
@@ -249,19 +262,28 @@ typedef int boolean;
  * (You may HAVE to do that if your compiler doesn't like null source files.)
  */
 
+/*
+ * Trimmed for the 128K flash to what the camera uses: baseline Huffman
+ * files and 8x8 DCTs when compressing (chroma is downsampled). The firmware
+ * does not decode with it; the host tests do, to check the encoder and
+ * jpeg_walk.c, baseline only, at full size without fancy upsampling or at
+ * 1/2, 1/4 and 1/8. Other JPEGs fail with JERR_NOT_COMPILED or
+ * JERR_BAD_DCTSIZE.
+ */
+
 /* Capability options common to encoder and decoder: */
 
 #define DCT_ISLOW_SUPPORTED /* slow but accurate integer algorithm */
 #define DCT_IFAST_SUPPORTED /* faster, less accurate integer method */
-#define DCT_FLOAT_SUPPORTED /* floating-point: accurate, fast on fast HW */
+#undef DCT_FLOAT_SUPPORTED /* floating-point: accurate, fast on fast HW */
 
 /* Encoder capability options: */
 
-#define C_ARITH_CODING_SUPPORTED /* Arithmetic coding back end? */
-#define C_MULTISCAN_FILES_SUPPORTED /* Multiple-scan JPEG files? */
-#define C_PROGRESSIVE_SUPPORTED /* Progressive JPEG? (Requires MULTISCAN) */
-#define DCT_SCALING_SUPPORTED /* Input rescaling via DCT? (Requires DCT_ISLOW) */
-#define ENTROPY_OPT_SUPPORTED /* Optimization of entropy coding parms? */
+#undef C_ARITH_CODING_SUPPORTED /* Arithmetic coding back end? */
+#undef C_MULTISCAN_FILES_SUPPORTED /* Multiple-scan JPEG files? */
+#undef C_PROGRESSIVE_SUPPORTED /* Progressive JPEG? (Requires MULTISCAN) */
+#undef DCT_SCALING_SUPPORTED /* Input rescaling via DCT? (Requires DCT_ISLOW) */
+#undef ENTROPY_OPT_SUPPORTED /* Optimization of entropy coding parms? */
 
 /* Note: if you selected 12-bit data precision, it is dangerous to turn off
  * ENTROPY_OPT_SUPPORTED.  The standard Huffman tables are only good for 8-bit
@@ -272,20 +294,21 @@ typedef int boolean;
  * don't work for progressive mode.  (This may get fixed, however.)
  */
 
-#define INPUT_SMOOTHING_SUPPORTED /* Input image smoothing option? */
+#undef INPUT_SMOOTHING_SUPPORTED /* Input image smoothing option? */
 
 /* Decoder capability options: */
 
-#define D_ARITH_CODING_SUPPORTED /* Arithmetic coding back end? */
-#define D_MULTISCAN_FILES_SUPPORTED /* Multiple-scan JPEG files? */
-#define D_PROGRESSIVE_SUPPORTED /* Progressive JPEG? (Requires MULTISCAN) */
+#undef D_ARITH_CODING_SUPPORTED /* Arithmetic coding back end? */
+#undef D_MULTISCAN_FILES_SUPPORTED /* Multiple-scan JPEG files? */
+#undef D_PROGRESSIVE_SUPPORTED /* Progressive JPEG? (Requires MULTISCAN) */
 #define IDCT_SCALING_SUPPORTED /* Output rescaling via IDCT? */
-#define SAVE_MARKERS_SUPPORTED /* jpeg_save_markers() needed? */
-#define BLOCK_SMOOTHING_SUPPORTED /* Block smoothing? (Progressive only) */
+#define IDCT_SCALING_POW2_ONLY /* ...but only to 1/2, 1/4 and 1/8? */
+#undef SAVE_MARKERS_SUPPORTED /* jpeg_save_markers() needed? */
+#undef BLOCK_SMOOTHING_SUPPORTED /* Block smoothing? (Progressive only) */
 #undef UPSAMPLE_SCALING_SUPPORTED /* Output rescaling at upsample stage? */
 #define UPSAMPLE_MERGING_SUPPORTED /* Fast path for sloppy upsampling? */
-#define QUANT_1PASS_SUPPORTED /* 1-pass color quantization? */
-#define QUANT_2PASS_SUPPORTED /* 2-pass color quantization? */
+#undef QUANT_1PASS_SUPPORTED /* 1-pass color quantization? */
+#undef QUANT_2PASS_SUPPORTED /* 2-pass color quantization? */
 
 /* more capability options later, no doubt */
 
@@ -353,4 +376,14 @@ typedef int boolean;
 #endif
 #endif
 
+/* JPEG_DSP_DCT selects the Cortex-M7 DSP-extension (SMLAD) version of the
+ * 8x8 ISLOW forward DCT in Src/jpeg_dsp.c; jpeg_dsp_setup_compress()
+ * installs it in place of jfdctint.c.  Define it as 0 to keep the
+ * reference code.
+ */
+
+#ifndef JPEG_DSP_DCT
+#define JPEG_DSP_DCT  1
+#endif
+
 #endif /* JPEG_INTERNAL_OPTIONS */
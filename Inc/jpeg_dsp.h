@@ -0,0 +1,28 @@
+#ifndef __JPEG_DSP_H
+#define __JPEG_DSP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stdio.h"
+#include "jpeglib.h"
+
+// Cortex-M7 DSP-extension kernels for the bundled LibJPEG's encoder,
+// installed into a running compress object. The 8x8 DCT follows jfdctint.c
+// with its multiply chains folded into SMLAD pairs and the butterflies done
+// two lanes at a time (SADD16/SSUB16); its output is identical. JPEG_DSP_DCT
+// in jmorecfg.h turns it off. Without __ARM_FEATURE_DSP the same code runs
+// on plain C arithmetic.
+
+// Call after jpeg_start_compress(). Replaces the 8x8 ISLOW forward DCT of
+// each component; with rgb565 set, scanlines are taken as big-endian RGB565
+// (2 bytes per pixel) instead of RGB888 (in_color_space stays JCS_RGB).
+// Returns TRUE if scanlines are now RGB565.
+boolean jpeg_dsp_setup_compress(j_compress_ptr cinfo, boolean rgb565);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __JPEG_DSP_H */
@@ -0,0 +1,44 @@
+#ifndef __JPEG_ENCODE_H
+#define __JPEG_ENCODE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+#include "fatfs.h"
+
+// LibJPEG quality (0-100, higher is finer) for re-encoded frames
+#ifndef JPEG_ENCODE_QUALITY
+#define JPEG_ENCODE_QUALITY   85
+#endif
+// Compressed bytes gathered before each f_write. A multiple of the sector
+// size keeps every write sector-aligned, so FatFs sends it to the card
+// directly instead of through its sector window.
+#ifndef JPEG_ENCODE_OUT_SIZE
+#define JPEG_ENCODE_OUT_SIZE  (4*1024)
+#endif
+// Snapshot: while this file is on the card (checked at mount) a K1 photo is
+// the preview frame the LCD shows, compressed here, instead of a sensor JPEG.
+// No mode switch, so it is taken within a frame of the press.
+#define JPEG_SNAPSHOT_FILE    "SNAPSHOT.ON"
+
+// Compress an RGB565 image into an open file. Pixels are high byte first, as
+// DCMI stores them and the LCD takes them; stride is in pixels. Working memory
+// comes from the LibJPEG arena (JPEG_ARENA_SIZE in jdata_conf.h), output goes
+// straight to FatFs, so no frame-sized buffer is needed. Returns FR_OK, the
+// FatFs error that stopped the output, or FR_NOT_ENOUGH_CORE if LibJPEG gave
+// up (arena too small for the width, bad size). 'bytes' may be NULL.
+FRESULT JPEG_EncodeRGB565(FIL *file, const uint8_t *pixels, uint32_t width, uint32_t height,
+                          uint32_t stride, int quality, uint32_t *bytes);
+// Same, into a new photo file with the next free ID (see Capture_OpenPhotoFile)
+FRESULT JPEG_SaveRGB565(const uint8_t *pixels, uint32_t width, uint32_t height,
+                        uint32_t stride, int quality);
+// Nonzero if JPEG_SNAPSHOT_FILE is on the mounted card
+uint8_t JPEG_SnapshotRequested(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __JPEG_ENCODE_H */
@@ -0,0 +1,22 @@
+#ifndef __JPEG_MARKER_H
+#define __JPEG_MARKER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define JPEG_MARKER_SOI  0xD8
+#define JPEG_MARKER_EOI  0xD9
+
+// Offset of the first 0xFF,<marker> pair in buf[0..len), or len if none
+uint32_t JPEG_FindMarker(const uint8_t *buf, uint32_t len, uint8_t marker);
+// Offset of the last 0xFF,<marker> pair in buf[0..len), or len if none
+uint32_t JPEG_FindMarkerReverse(const uint8_t *buf, uint32_t len, uint8_t marker);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __JPEG_MARKER_H */
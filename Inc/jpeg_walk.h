@@ -0,0 +1,82 @@
+#ifndef __JPEG_WALK_H
+#define __JPEG_WALK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+// Baseline JPEG read without LibJPEG, as far as reduced-scale views need:
+// every block is Huffman decoded, but only its four lowest coefficients are
+// kept. They are all LibJPEG's 1/4- and 1/8-scale IDCTs read (jpeg_idct_2x2,
+// jpeg_idct_1x1, and 2x1 or 1x2 where chroma is scaled up instead of
+// upsampled), so a walk gives the pixels LibJPEG decodes at those scales.
+// Baseline (SOF0/SOF1) 8-bit files in one interleaved scan, with the luma
+// the full-resolution component and sampling factors of 1 or 2. One walk
+// at a time: the Huffman tables are shared.
+
+#define JPEG_WALK_MAX_COMPS  3
+#define JPEG_WALK_MAX_SAMP   2
+
+typedef struct {
+    uint8_t id;
+    uint8_t h, v;           // sampling factors
+    uint8_t tq;             // quantization table
+    uint8_t td, ta;         // DC and AC Huffman tables
+} JPEG_WalkCompTypeDef;
+
+// One block of component 'ci': its dequantized coefficients 0, 1, 8 and 9,
+// at block column 'bx' of the component and block row 'by' of the MCU row
+typedef void (*JPEG_WalkBlockFn)(void *arg, uint32_t ci, uint32_t bx, uint32_t by,
+                                 const int32_t *coef);
+// More of a file walked through a buffer: up to 'size' bytes into 'buf',
+// 0 at its end
+typedef uint32_t (*JPEG_WalkReadFn)(void *arg, uint8_t *buf, uint32_t size);
+
+typedef struct {
+    // From the headers
+    uint32_t width, height;
+    uint32_t ncomp;
+    uint32_t hmax, vmax;        // MCU size in blocks
+    uint32_t mcus_x, mcus_y;
+    JPEG_WalkCompTypeDef comp[JPEG_WALK_MAX_COMPS];
+    uint32_t mcu_row;           // MCU rows walked so far
+
+    // Entropy-coded data
+    const uint8_t *data;
+    uint32_t len;
+    uint32_t pos;
+    uint32_t acc;               // bits not consumed yet, in the low 'bits'
+    int32_t bits;
+    uint32_t zeros;             // bytes made up past the end of the data
+    JPEG_WalkReadFn read;       // NULL once the file is all in data[]
+    void *read_arg;
+    uint32_t size;              // of the buffer data[] is read into
+    uint32_t restart;           // interval in MCUs, 0 for none
+    uint32_t left;              // MCUs to the next restart marker
+    int32_t pred[JPEG_WALK_MAX_COMPS];
+    uint8_t scan[JPEG_WALK_MAX_COMPS];
+    uint16_t q[4][4];           // quantizers of coefficients 0, 1, 8 and 9
+} JPEG_WalkTypeDef;
+
+// Read the headers of a JPEG held in memory up to its scan. 0 if it is not
+// a file the walker reads, or the headers are malformed.
+uint8_t JPEG_WalkStart(JPEG_WalkTypeDef *w, const uint8_t *jpeg, uint32_t len);
+// Same for a file read through 'buf' a 'size' at a time; its headers must
+// fit in the first read
+uint8_t JPEG_WalkStartRead(JPEG_WalkTypeDef *w, uint8_t *buf, uint32_t size,
+                           JPEG_WalkReadFn read, void *arg);
+// Decode the next MCU row, handing every block to 'block' in file order.
+// 0 at a bad code, or if the row needed data past the end of the file: it
+// is truncated, or corrupt and out of step.
+uint8_t JPEG_WalkRow(JPEG_WalkTypeDef *w, JPEG_WalkBlockFn block, void *arg);
+// LibJPEG's w x h IDCT (1 or 2 each) of a block's coefficients, rows
+// 'stride' apart
+void JPEG_WalkIDCT(const int32_t *coef, uint32_t w, uint32_t h, uint8_t *out, uint32_t stride);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __JPEG_WALK_H */
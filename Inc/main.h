@@ -53,6 +53,8 @@ extern "C" {
 void Error_Handler(void);
 
 /* USER CODE BEGIN EFP */
+// Also run again on leaving Stop mode, which drops the PLLs
+void SystemClock_Config(void);
 
 /* USER CODE END EFP */
 
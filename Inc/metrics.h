@@ -0,0 +1,97 @@
+#ifndef __METRICS_H
+#define __METRICS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+#include "fatfs.h"
+
+// Frame records kept for dumping; must be a power of two
+#define METRICS_RING_LEN      64
+// Latency histogram buckets: [0,1) ms, then [2^(n-1), 2^n) ms, last is open
+#define METRICS_HIST_BINS     16
+// A VSYNC edge this recent at frame-complete is the one ending the frame,
+// handled in the same interrupt, not the one that started it
+#define METRICS_VSYNC_GUARD_US  200
+// Records are dumped once this many newer frames have started, so the
+// display stages have landed
+#define METRICS_SETTLE_FRAMES 4
+
+// 1: append the frame records and histograms to the card after each capture
+#ifndef METRICS_LOG_TO_CARD
+#define METRICS_LOG_TO_CARD   1
+#endif
+#define METRICS_CSV_FILE      "FRAMES.CSV"
+#define METRICS_HIST_FILE     "LATENCY.CSV"
+
+// Per-frame timestamps, in stamp order for a JPEG shot
+typedef enum {
+    METRICS_WAKE,           // out of Stop mode (timelapse only; before SHUTTER)
+    METRICS_SHUTTER,        // capture requested (JPEG only; before VSYNC)
+    METRICS_VSYNC,          // VSYNC edge that started the frame
+    METRICS_FRAME_DONE,     // DCMI frame-complete
+    METRICS_DISPLAY_START,  // LCD transfer of the frame started
+    METRICS_DISPLAY_DONE,   // LCD transfer finished
+    METRICS_SD_START,       // first byte of the frame handed to FatFs
+    METRICS_SD_DONE,        // file closed
+    METRICS_NUM_STAMPS
+} Metrics_StampTypeDef;
+
+typedef enum {
+    METRICS_FRAME_PREVIEW,
+    METRICS_FRAME_JPEG
+} Metrics_KindTypeDef;
+
+typedef enum {
+    METRICS_HIST_SHUTTER_TO_FILE,   // SHUTTER -> SD_DONE
+    METRICS_HIST_SENSOR_TO_GLASS,   // VSYNC -> DISPLAY_DONE
+    METRICS_HIST_WAKE_TO_FILE,      // WAKE -> SD_DONE
+    METRICS_NUM_HIST
+} Metrics_HistTypeDef;
+
+typedef struct {
+    uint32_t seq;                       // frame number, 0 while being reset
+    uint32_t kind;                      // Metrics_KindTypeDef
+    uint32_t bytes;                     // bytes saved (JPEG), 0 otherwise
+    uint32_t energy_uj;                 // estimated energy of the shot, 0 if not known
+    uint32_t t[METRICS_NUM_STAMPS];     // DWT cycle counts, 0 = not reached
+} Metrics_FrameTypeDef;
+
+// Start the DWT cycle counter used for every timestamp
+void Metrics_Init(void);
+// Current cycle count, never 0
+uint32_t Metrics_Now(void);
+// Kind of the frames that follow (set on camera mode changes)
+void Metrics_SetKind(uint32_t kind);
+// DCMI VSYNC interrupt: opens the record of the next frame
+void Metrics_VsyncEvent(void);
+// DCMI frame-complete interrupt: stamps the frame and returns its number
+uint32_t Metrics_FrameEvent(void);
+// Number of the frame DCMI is receiving or has just finished
+uint32_t Metrics_CurrentFrame(void);
+// Number of the last frame that completed
+uint32_t Metrics_LastFrame(void);
+// Stamp a stage of frame 'seq' now, or at a cycle count taken earlier.
+// Ignored if the record has been reused since.
+void Metrics_Stamp(uint32_t seq, uint32_t stage);
+void Metrics_StampAt(uint32_t seq, uint32_t stage, uint32_t cycles);
+void Metrics_SetBytes(uint32_t seq, uint32_t bytes);
+void Metrics_SetEnergy(uint32_t seq, uint32_t energy_uj);
+// Send up to 'max' settled records over SWO (ITM port 0) as CSV lines;
+// nothing is consumed while no debugger has enabled the port
+uint32_t Metrics_DumpSWO(uint32_t max);
+// Append the settled records to a CSV file on the card
+FRESULT Metrics_DumpCSV(const char *path, uint32_t *count);
+// Rewrite the histogram file with the current bucket counts
+FRESULT Metrics_SaveHistograms(const char *path);
+void Metrics_GetHistogram(uint32_t which, uint32_t bins[METRICS_HIST_BINS]);
+// Records overwritten before they could be dumped
+uint32_t Metrics_Lost(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __METRICS_H */
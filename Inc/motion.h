@@ -0,0 +1,81 @@
+#ifndef __MOTION_H
+#define __MOTION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+#include "preview.h"
+
+// Motion detection runs on the preview while this file is on the card
+// (checked at mount); each detection takes a photo as K1 would
+#define MOTION_TRIGGER_FILE      "MOTION.ON"
+
+// Luma grid the preview is averaged down to; one cell is 8x8 pixels
+#define MOTION_GRID_W            20
+#define MOTION_GRID_H            10
+#define MOTION_CELLS             (MOTION_GRID_W * MOTION_GRID_H)
+#define MOTION_CELL_W            (PREVIEW_WIDTH / MOTION_GRID_W)
+#define MOTION_CELL_H            (PREVIEW_HEIGHT / MOTION_GRID_H)
+
+// A cell has changed when it is this many luma levels (0..255) off the
+// background
+#ifndef MOTION_CELL_THRESHOLD
+#define MOTION_CELL_THRESHOLD    12
+#endif
+// Percentage of changed cells that fires a capture
+#ifndef MOTION_TRIGGER_PERCENT
+#define MOTION_TRIGGER_PERCENT   5
+#endif
+// Above this percentage the change is taken as lighting or exposure (the
+// whole scene shifting) and the background is simply taken over
+#ifndef MOTION_GLOBAL_PERCENT
+#define MOTION_GLOBAL_PERCENT    60
+#endif
+// The background moves 1/2^MOTION_BG_SHIFT of the way to each new frame
+#ifndef MOTION_BG_SHIFT
+#define MOTION_BG_SHIFT          3
+#endif
+// Frames after a (re)start that only build the background
+#ifndef MOTION_WARMUP_FRAMES
+#define MOTION_WARMUP_FRAMES     8
+#endif
+// Shortest time between two triggers
+#ifndef MOTION_HOLDOFF_MS
+#define MOTION_HOLDOFF_MS        3000
+#endif
+
+typedef struct {
+    uint32_t changed;       // cells off the background in the last frame
+    uint32_t sad;           // sum of absolute cell differences, last frame
+    uint32_t cycles;        // CPU cycles Motion_Process spent on it
+    uint32_t triggers;      // captures fired since boot
+} Motion_StatsTypeDef;
+
+// Average a big-endian RGB565 frame down to MOTION_GRID_W x MOTION_GRID_H
+// luma cells (every other pixel and row of each cell)
+void Motion_BuildGrid(const uint16_t *frame, uint16_t width, uint16_t height, uint8_t *grid);
+// Cells of 'grid' at least 'threshold' off 'bg', four per SIMD step
+// (USUB8/SEL); the sum of absolute differences (USAD8) goes to *sad.
+// 'cells' must be a multiple of 4. Without __ARM_FEATURE_DSP the same code
+// runs on plain C, so recorded clips can be replayed on a host.
+uint32_t Motion_Compare(const uint8_t *grid, const uint8_t *bg, uint32_t cells,
+                        uint8_t threshold, uint32_t *sad);
+
+// 1 if the trigger file is on the mounted card
+uint8_t Motion_Requested(void);
+// Turn detection on or off; off by default
+void Motion_Arm(uint8_t on);
+uint8_t Motion_Armed(void);
+// The preview (re)started: rebuild the background before triggering again
+void Motion_Start(void);
+// Feed a preview frame; 1 when it shows motion and a capture should start
+uint8_t Motion_Process(const uint16_t *frame);
+const Motion_StatsTypeDef *Motion_GetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __MOTION_H */
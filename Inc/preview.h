@@ -0,0 +1,51 @@
+#ifndef __PREVIEW_H
+#define __PREVIEW_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+
+// RGB565 preview frame: exactly what the 160x80 LCD shows, nothing more
+#define PREVIEW_WIDTH  160
+#define PREVIEW_HEIGHT 80
+
+// Sensor mode the preview runs in. The DCMI crops it to the centre and, for
+// modes at least twice the frame in both directions, drops every other pixel
+// and line, so only displayed pixels reach memory.
+#ifndef PREVIEW_FRAMESIZE
+#define PREVIEW_FRAMESIZE FRAMESIZE_QQVGA
+#endif
+
+// Where the preview frame comes from in the sensor image
+typedef struct {
+    uint16_t sensor_w, sensor_h;    // resolution of PREVIEW_FRAMESIZE
+    uint16_t crop_x, crop_y;        // top-left of the DCMI crop window, sensor pixels
+    uint16_t crop_w, crop_h;        // size of the window, sensor pixels
+    uint8_t decimate;               // 1, or 2 for byte/line select on both axes
+} Preview_GeometryTypeDef;
+
+// Start continuous capture into the preview frame pool (DMA double-buffer
+// mode), with the DCMI crop and byte/line select set up for the frame size.
+// The sensor must already be running at PREVIEW_FRAMESIZE.
+HAL_StatusTypeDef Preview_Start(DCMI_HandleTypeDef *hdcmi);
+// Back to full-frame DCMI capture (no crop, every byte and line) for JPEG
+void Preview_ReleaseDCMI(DCMI_HandleTypeDef *hdcmi);
+// Crop and decimation of the running preview
+const Preview_GeometryTypeDef *Preview_GetGeometry(void);
+// Take ownership of the newest complete frame; NULL if none arrived since the
+// last call. DMA never writes a frame while it is owned.
+uint16_t *Preview_AcquireFrame(void);
+// Return a frame from Preview_AcquireFrame to the pool
+void Preview_ReleaseFrame(uint16_t *frame);
+// Metrics frame number of a frame from Preview_AcquireFrame, 0 if unknown
+uint32_t Preview_FrameSeq(const uint16_t *frame);
+// Frames completed by DMA but replaced before anyone acquired them
+uint32_t Preview_DroppedFrames(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PREVIEW_H */
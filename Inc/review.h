@@ -0,0 +1,43 @@
+#ifndef __REVIEW_H
+#define __REVIEW_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+
+// How long the review of a new photo stays up before the preview resumes
+#ifndef REVIEW_HOLD_MS
+#define REVIEW_HOLD_MS    1500
+#endif
+// LCD rows converted per DMA transfer (two such bands alternate)
+#define REVIEW_BAND_ROWS  8
+#define REVIEW_MAX_WIDTH  160
+// Widest 1/8-scale row, for 2592-pixel (QSXGA) frames
+#define REVIEW_MAX_SRC_WIDTH  324
+// A file is read this much at a time, into the capture buffer
+#define REVIEW_READ_SIZE  (32U * 1024U)
+
+// Decode a JPEG held in memory at 1/8 scale, as LibJPEG would without fancy
+// upsampling, and draw it on the LCD fitted to the panel width and cropped
+// to its middle rows like the preview. The decode is jpeg_walk's (DC terms
+// for luma, the four lowest coefficients for subsampled chroma), so no
+// LibJPEG decoder is linked. Rows go to the panel by SPI DMA as each MCU row
+// is converted; no frame is stored, and the rows below the crop are not
+// decoded. Returns 1 if the image was drawn.
+uint8_t Review_ShowJPEG(const uint8_t *jpeg, uint32_t len);
+// Same, reading the JPEG from a file on the card through the capture
+// buffer, whose image it overwrites
+uint8_t Review_ShowFile(const char *path);
+// Show the photo just taken: from the capture buffer while it is still
+// whole there, otherwise from its file
+uint8_t Review_ShowLastCapture(void);
+// CPU cycles the last review took, decode and LCD transfer included
+uint32_t Review_LastCycles(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __REVIEW_H */
@@ -0,0 +1,41 @@
+#ifndef __SD_BENCH_H
+#define __SD_BENCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+#include "fatfs.h"
+
+// The benchmark runs at boot when this file is on the card (it is deleted
+// so the next boot is normal) and writes its results to SD_BENCH_REPORT
+#define SD_BENCH_TRIGGER      "SDBENCH.RUN"
+#define SD_BENCH_REPORT       "SDBENCH.CSV"
+// Scratch file whose pre-allocated clusters the raw sector I/O stays inside
+#define SD_BENCH_AREA_FILE    "SDBENCH.TMP"
+#ifndef SD_BENCH_AREA_SIZE
+#define SD_BENCH_AREA_SIZE    (8*1024*1024)
+#endif
+// Transfers timed per test; each test is one access pattern and size
+#ifndef SD_BENCH_OPS
+#define SD_BENCH_OPS          64
+#endif
+// Largest transfer, in sectors; also the size of the buffer borrowed from
+// the capture buffer
+#define SD_BENCH_MAX_SECTORS  128
+
+// 1 if the trigger file is on the mounted card
+uint8_t SDBench_Requested(void);
+// Time sequential and random writes and reads of 1, 8, 64 and 128 sectors
+// through the disk driver (SD_write/SD_read, one multi-block command per
+// transfer) and write throughput and latency percentiles to 'report' as
+// CSV. The raw I/O only touches the clusters of SD_BENCH_AREA_FILE, which
+// is deleted afterwards. Overwrites the capture buffer.
+FRESULT SDBench_Run(const char *report);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SD_BENCH_H */
@@ -0,0 +1,42 @@
+#ifndef __SD_BUS_H
+#define __SD_BUS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+
+// Bus speeds tried from the top down. UHS (SDR50/SDR104) needs 1.8 V
+// signalling, which this board has no level shifter for
+// (USE_SD_TRANSCEIVER 0), so High Speed is the ceiling.
+typedef enum {
+    SD_BUS_SAFE,        // the ClockDiv from MX_SDMMC1_SD_Init
+    SD_BUS_DEFAULT,     // Default Speed, up to 25 MHz
+    SD_BUS_HIGH,        // High Speed (CMD6 switch), up to 50 MHz
+} SD_BusSpeedTypeDef;
+
+// Fastest speed negotiated at card init
+#ifndef SD_BUS_MAX_SPEED
+#define SD_BUS_MAX_SPEED  SD_BUS_HIGH
+#endif
+
+// BSP_SD_Init (overriding the weak one in bsp_driver_sd.c) brings the card
+// up in 4-bit mode and then negotiates the fastest speed whose test read
+// passes. A CRC error later drops one speed (SD_Bus_Fallback).
+SD_BusSpeedTypeDef SD_Bus_GetSpeed(void);
+const char *SD_Bus_SpeedName(SD_BusSpeedTypeDef speed);
+// SDMMC_CK in Hz at the current speed
+uint32_t SD_Bus_GetClockHz(void);
+// Speeds dropped since card init because of bus errors
+uint32_t SD_Bus_Fallbacks(void);
+// Called by the disk driver after a failed transfer: if it was a CRC or
+// FIFO error and there is a slower speed left, switch to it and return 1 so
+// the transfer is retried
+uint8_t SD_Bus_Fallback(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SD_BUS_H */
@@ -0,0 +1,44 @@
+#ifndef __SHARPNESS_H
+#define __SHARPNESS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+
+// JPEGs are scored on their luma at 1/4 scale: an SVGA frame is looked at
+// as 200x150, UXGA as 400x300. The 2x2 IDCT of that scale still carries the
+// lowest AC terms that camera shake smears out; 1/8 would leave only the DC
+// terms. Widest 1/4 luma row, for 2592-pixel (QSXGA) frames:
+#define SHARPNESS_MAX_WIDTH  648
+
+// Running sums of the Laplacian over the rows seen so far
+typedef struct {
+    int64_t sum2;           // sum of squares
+    int32_t sum;
+    uint32_t count;         // pixels
+} Sharpness_AccTypeDef;
+
+// Add the 4-neighbour Laplacian (4c - n - s - w - e) of the inner pixels of
+// 'row' to 'acc', four pixels per step (two halfword lanes per UXTB16
+// unpack, SSUB16/UADD16 for the kernel, SMLALD/SMLAD for the sums). Without
+// __ARM_FEATURE_DSP the same code runs on plain C, so recorded frames can
+// be scored on a host.
+void Sharpness_AccumulateRow(const uint8_t *up, const uint8_t *row, const uint8_t *down,
+                             uint32_t width, Sharpness_AccTypeDef *acc);
+// Variance of the Laplacian summed in 'acc': higher is sharper
+uint32_t Sharpness_Variance(const Sharpness_AccTypeDef *acc);
+// Laplacian variance of an 8-bit luma plane
+uint32_t Sharpness_Luma(const uint8_t *luma, uint32_t width, uint32_t height, uint32_t stride);
+// Laplacian variance of a JPEG held in memory, taken on the luma LibJPEG
+// would decode at 1/4 scale, without LibJPEG: jpeg_walk reads the four
+// lowest coefficients of each luma block for the 2x2 IDCT. Returns 0 for
+// files it does not read, truncated ones, or if the data does not decode.
+uint8_t Sharpness_ScoreJPEG(const uint8_t *jpeg, uint32_t len, uint32_t *score);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SHARPNESS_H */
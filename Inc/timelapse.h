@@ -0,0 +1,72 @@
+#ifndef __TIMELAPSE_H
+#define __TIMELAPSE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+
+// Timelapse runs while this file is on the card (checked at mount). Its
+// first line may hold the interval in seconds; empty means the default.
+#define TIMELAPSE_TRIGGER_FILE   "TIMELAPS.ON"
+
+#ifndef TIMELAPSE_INTERVAL_S
+#define TIMELAPSE_INTERVAL_S     60
+#endif
+#ifndef TIMELAPSE_MIN_INTERVAL_S
+#define TIMELAPSE_MIN_INTERVAL_S 2
+#endif
+#define TIMELAPSE_MAX_INTERVAL_S 86400
+// Sensor run time between leaving standby and the JPEG switch, for its AEC
+// to catch up with the light after a long sleep; taken out of the sleep
+#ifndef TIMELAPSE_WARMUP_MS
+#define TIMELAPSE_WARMUP_MS      150
+#endif
+// Waits shorter than this are spent awake rather than in Stop mode
+#ifndef TIMELAPSE_MIN_SLEEP_MS
+#define TIMELAPSE_MIN_SLEEP_MS   100
+#endif
+
+// Energy model for the per-shot estimate: board current awake (CPU at full
+// clock, sensor streaming, SD card writing) and in Stop mode (sensor in
+// standby, backlight off). The board has no current sense; measure these
+// once on the supply and set them here.
+#ifndef TIMELAPSE_SUPPLY_MV
+#define TIMELAPSE_SUPPLY_MV      3300
+#endif
+#ifndef TIMELAPSE_RUN_MA
+#define TIMELAPSE_RUN_MA         180
+#endif
+#ifndef TIMELAPSE_STOP_UA
+#define TIMELAPSE_STOP_UA        3000
+#endif
+
+typedef struct {
+    uint32_t shots;         // photos saved since timelapse was armed
+    uint32_t sleep_ms;      // time in Stop mode before the last shot
+    uint32_t run_ms;        // time awake for the last shot
+    uint32_t wake_to_file_ms;
+    uint32_t energy_uj;     // estimated energy of the last shot, sleep included
+} Timelapse_StatsTypeDef;
+
+// Interval in seconds if the trigger file is on the mounted card, else 0
+uint32_t Timelapse_Requested(void);
+// Start taking a photo every 'interval_s' seconds (0: off). The LCD is
+// turned off and exposure is left to the sensor, as there is no preview.
+void Timelapse_Arm(uint32_t interval_s);
+uint8_t Timelapse_Armed(void);
+// Sleep in Stop mode until the next photo is due, with DCMI stopped and the
+// sensor in standby, then wake the sensor. Returns at once for the first
+// photo. The caller takes the photo straight after.
+void Timelapse_Sleep(void);
+// The capture started after Timelapse_Sleep() has finished; 'saved' if the
+// photo is on the card. Its metrics record gets the wake time and energy.
+void Timelapse_ShotDone(uint8_t saved);
+const Timelapse_StatsTypeDef *Timelapse_GetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TIMELAPSE_H */
@@ -167,9 +167,13 @@ transencode_master_selection (j_compress_ptr cinfo,
   jinit_c_master_control(cinfo, TRUE /* transcode only */);
 
   /* Entropy encoding: either Huffman or arithmetic coding. */
-  if (cinfo->arith_code)
+  if (cinfo->arith_code) {
+#ifdef C_ARITH_CODING_SUPPORTED
     jinit_arith_encoder(cinfo);
-  else {
+#else
+    ERREXIT(cinfo, JERR_NOT_COMPILED);
+#endif
+  } else {
     jinit_huff_encoder(cinfo);
   }
 
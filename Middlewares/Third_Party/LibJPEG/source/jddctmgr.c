@@ -109,14 +109,17 @@ start_pass (j_decompress_ptr cinfo)
       method_ptr = jpeg_idct_2x2;
       method = JDCT_ISLOW;	/* jidctint uses islow-style table */
       break;
+#ifndef IDCT_SCALING_POW2_ONLY
     case ((3 << 8) + 3):
       method_ptr = jpeg_idct_3x3;
       method = JDCT_ISLOW;	/* jidctint uses islow-style table */
       break;
+#endif
     case ((4 << 8) + 4):
       method_ptr = jpeg_idct_4x4;
       method = JDCT_ISLOW;	/* jidctint uses islow-style table */
       break;
+#ifndef IDCT_SCALING_POW2_ONLY
     case ((5 << 8) + 5):
       method_ptr = jpeg_idct_5x5;
       method = JDCT_ISLOW;	/* jidctint uses islow-style table */
@@ -177,14 +180,17 @@ start_pass (j_decompress_ptr cinfo)
       method_ptr = jpeg_idct_10x5;
       method = JDCT_ISLOW;	/* jidctint uses islow-style table */
       break;
+#endif
     case ((8 << 8) + 4):
       method_ptr = jpeg_idct_8x4;
       method = JDCT_ISLOW;	/* jidctint uses islow-style table */
       break;
+#ifndef IDCT_SCALING_POW2_ONLY
     case ((6 << 8) + 3):
       method_ptr = jpeg_idct_6x3;
       method = JDCT_ISLOW;	/* jidctint uses islow-style table */
       break;
+#endif
     case ((4 << 8) + 2):
       method_ptr = jpeg_idct_4x2;
       method = JDCT_ISLOW;	/* jidctint uses islow-style table */
@@ -193,6 +199,7 @@ start_pass (j_decompress_ptr cinfo)
       method_ptr = jpeg_idct_2x1;
       method = JDCT_ISLOW;	/* jidctint uses islow-style table */
       break;
+#ifndef IDCT_SCALING_POW2_ONLY
     case ((8 << 8) + 16):
       method_ptr = jpeg_idct_8x16;
       method = JDCT_ISLOW;	/* jidctint uses islow-style table */
@@ -225,6 +232,7 @@ start_pass (j_decompress_ptr cinfo)
       method_ptr = jpeg_idct_1x2;
       method = JDCT_ISLOW;	/* jidctint uses islow-style table */
       break;
+#endif
 #endif
     case ((DCTSIZE << 8) + DCTSIZE):
       switch (cinfo->dct_method) {
@@ -353,9 +353,13 @@ master_selection (j_decompress_ptr cinfo)
   /* Inverse DCT */
   jinit_inverse_dct(cinfo);
   /* Entropy decoding: either Huffman or arithmetic coding. */
-  if (cinfo->arith_code)
+  if (cinfo->arith_code) {
+#ifdef D_ARITH_CODING_SUPPORTED
     jinit_arith_decoder(cinfo);
-  else {
+#else
+    ERREXIT(cinfo, JERR_NOT_COMPILED);
+#endif
+  } else {
     jinit_huff_decoder(cinfo);
   }
 
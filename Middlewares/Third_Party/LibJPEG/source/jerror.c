@@ -45,7 +45,11 @@
 #define jpeg_std_message_table	jMsgTable
 #endif
 
+#ifdef NO_MESSAGE_TEXT
+#define JMESSAGE(code,string)	"" ,
+#else
 #define JMESSAGE(code,string)	string ,
+#endif
 
 const char * const jpeg_std_message_table[] = {
 #include "jerror.h"
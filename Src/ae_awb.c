@@ -0,0 +1,226 @@
+#include "ae_awb.h"
+#include "string.h"
+#include "metrics.h"
+
+// Starting white balance: the OV2640's daylight gains
+#define AWB_INIT_R           0x5e
+#define AWB_INIT_G           0x41
+#define AWB_INIT_B           0x54
+// Green below this (Q15) is too dark to judge the colour by
+#define AWB_MIN_LEVEL        0x0800
+
+// Sampled planes, Q15; CMSIS-DSP reduces them
+static q15_t ae_y[AE_MAX_SAMPLES];
+static q15_t ae_r[AE_MAX_SAMPLES];
+static q15_t ae_g[AE_MAX_SAMPLES];
+static q15_t ae_b[AE_MAX_SAMPLES];
+
+static AeAwb_StatsTypeDef ae_stats;
+static AeAwb_StateTypeDef ae_state;
+static uint8_t ae_seeded;           // ae_state holds a real exposure
+static uint8_t ae_dirty;            // sensor may not hold ae_state: write it all
+static uint32_t ae_tick;            // last sensor update
+static uint8_t ae_suspended;        // the sensor's own AEC/AWB are in charge
+
+void AeAwb_ComputeStats(const uint16_t *frame, uint16_t width, uint16_t height,
+                        AeAwb_StatsTypeDef *st)
+{
+    uint32_t n = 0;
+
+    memset(st->hist, 0, sizeof(st->hist));
+    for (uint32_t y = 0; y < height && n < AE_MAX_SAMPLES; y += AE_STEP) {
+        const uint16_t *row = frame + y * width;
+
+        for (uint32_t x = 0; x < width && n < AE_MAX_SAMPLES; x += AE_STEP) {
+            // Bytes arrive high first, so the halfword is swapped
+            uint32_t px = (uint32_t)((row[x] >> 8) | (row[x] << 8)) & 0xFFFFU;
+            uint32_t r5 = px >> 11, g6 = (px >> 5) & 0x3FU, b5 = px & 0x1FU;
+            // Low bits repeat the high ones so full scale is 0x7FFF
+            int32_t r = (int32_t)((r5 << 10) | (r5 << 5) | r5);
+            int32_t g = (int32_t)((g6 << 9) | (g6 << 3) | (g6 >> 3));
+            int32_t b = (int32_t)((b5 << 10) | (b5 << 5) | b5);
+            int32_t l = (77 * r + 150 * g + 29 * b) >> 8;
+
+            ae_r[n] = (q15_t)r;
+            ae_g[n] = (q15_t)g;
+            ae_b[n] = (q15_t)b;
+            ae_y[n] = (q15_t)l;
+            st->hist[l >> 9]++;
+            n++;
+        }
+    }
+
+    st->samples = (uint16_t)n;
+    if (n == 0) {
+        st->mean_y = st->max_y = st->mean_r = st->mean_g = st->mean_b = 0;
+        st->max_index = 0;
+        return;
+    }
+    arm_mean_q15(ae_y, n, &st->mean_y);
+    arm_max_q15(ae_y, n, &st->max_y, &st->max_index);
+    arm_mean_q15(ae_r, n, &st->mean_r);
+    arm_mean_q15(ae_g, n, &st->mean_g);
+    arm_mean_q15(ae_b, n, &st->mean_b);
+}
+
+// Halfway from 'gain' to the gain that would bring 'ch' level with green,
+// or 'gain' itself inside the deadband
+static uint8_t awb_step(uint8_t gain, uint32_t ch, uint32_t g)
+{
+    uint32_t diff = (ch > g) ? ch - g : g - ch;
+    uint32_t next;
+
+    if (diff * 100U <= g * AWB_DEADBAND_PERCENT) {
+        return gain;
+    }
+    if (ch == 0) {
+        ch = 1;
+    }
+    next = gain * (ch + g) / (2U * ch);
+    if (next < AWB_GAIN_MIN) next = AWB_GAIN_MIN;
+    if (next > AWB_GAIN_MAX) next = AWB_GAIN_MAX;
+    return (uint8_t)next;
+}
+
+// Exposure first, gain only once the lines run out
+static void ae_split(uint32_t exposure, uint16_t *lines, uint16_t *gain16)
+{
+    uint32_t l = exposure / 16U, g;
+
+    if (l < 1) l = 1;
+    if (l > AE_MAX_LINES) l = AE_MAX_LINES;
+    g = exposure / l;
+    if (g < 16) g = 16;
+    if (g > AE_MAX_GAIN16) g = AE_MAX_GAIN16;
+    *lines = (uint16_t)l;
+    *gain16 = (uint16_t)g;
+}
+
+static void ae_update(void)
+{
+    const AeAwb_StatsTypeDef *st = &ae_stats;
+    uint32_t mean = (uint32_t)st->mean_y >> 7;      // 0..255
+    uint32_t target = AE_TARGET;
+    uint32_t exposure = (uint32_t)ae_state.lines * ae_state.gain16;
+    uint16_t lines = ae_state.lines, gain16 = ae_state.gain16;
+    uint8_t wb_r = ae_state.wb_r, wb_b = ae_state.wb_b;
+
+    if (st->samples == 0) {
+        return;
+    }
+    if (mean == 0) {
+        mean = 1;
+    }
+    // Blown highlights: aim under the current level until they are gone
+    if (st->hist[AE_HIST_BINS - 1] * 100U > (uint32_t)st->samples * AE_CLIP_PERCENT &&
+        target > mean * 7U / 8U) {
+        target = mean * 7U / 8U;
+    }
+    if (mean > target + AE_DEADBAND || mean + AE_DEADBAND < target) {
+        // Halfway to the exposure that would hit the target, at most 2x
+        // either way per update
+        uint32_t next = (uint32_t)((uint64_t)exposure * (target + mean) / (2U * mean));
+
+        if (next > exposure * 2U) next = exposure * 2U;
+        if (next < exposure / 2U) next = exposure / 2U;
+        ae_split(next, &lines, &gain16);
+    }
+
+    // Grey world: red and blue are pulled level with green
+    if (st->mean_g >= AWB_MIN_LEVEL) {
+        wb_r = awb_step(ae_state.wb_r, (uint32_t)st->mean_r, (uint32_t)st->mean_g);
+        wb_b = awb_step(ae_state.wb_b, (uint32_t)st->mean_b, (uint32_t)st->mean_g);
+    }
+
+    if (ae_dirty || lines != ae_state.lines || gain16 != ae_state.gain16) {
+        Camera_Exposure_Device(lines, gain16);
+        ae_state.lines = lines;
+        ae_state.gain16 = gain16;
+        ae_state.updates++;
+    }
+    if (ae_dirty || wb_r != ae_state.wb_r || wb_b != ae_state.wb_b) {
+        Camera_WhiteBalance_Device(wb_r, ae_state.wb_g, wb_b);
+        ae_state.wb_r = wb_r;
+        ae_state.wb_b = wb_b;
+        ae_state.updates++;
+    }
+    ae_dirty = 0;
+}
+
+void AeAwb_Start(void)
+{
+    if (!AE_AWB_ENABLE || ae_suspended) {
+        return;
+    }
+    if (!ae_seeded) {
+        if (Camera_GetExposure_Device(&ae_state.lines, &ae_state.gain16) != Camera_OK) {
+            return;
+        }
+        ae_split((uint32_t)ae_state.lines * ae_state.gain16, &ae_state.lines, &ae_state.gain16);
+        ae_state.wb_r = AWB_INIT_R;
+        ae_state.wb_g = AWB_INIT_G;
+        ae_state.wb_b = AWB_INIT_B;
+        ae_seeded = 1;
+    }
+    // A reset sensor is back on its own AEC; a restored one is not, but
+    // rewriting costs a few register writes once
+    ae_dirty = 1;
+    ae_tick = HAL_GetTick();
+}
+
+void AeAwb_Process(const uint16_t *frame)
+{
+    uint32_t start;
+
+    if (!AE_AWB_ENABLE || !ae_seeded || ae_suspended) {
+        return;
+    }
+    start = Metrics_Now();
+    AeAwb_ComputeStats(frame, PREVIEW_WIDTH, PREVIEW_HEIGHT, &ae_stats);
+    ae_stats.cycles = Metrics_Now() - start;
+
+    if (HAL_GetTick() - ae_tick < AE_UPDATE_MS) {
+        return;
+    }
+    ae_tick = HAL_GetTick();
+    ae_update();
+}
+
+void AeAwb_ApplyCapture(framesize_t framesize)
+{
+    uint32_t scale, lines;
+
+    if (!AE_AWB_ENABLE || !ae_seeded || ae_suspended) {
+        return;
+    }
+    scale = (dvp_cam_resolution[framesize][0] <= 800) ? AE_CAPTURE_SCALE_SVGA
+                                                      : AE_CAPTURE_SCALE_UXGA;
+    lines = ((uint32_t)ae_state.lines * scale + 128U) >> 8;
+    Camera_Exposure_Device((uint16_t)lines, ae_state.gain16);
+    Camera_WhiteBalance_Device(ae_state.wb_r, ae_state.wb_g, ae_state.wb_b);
+    Camera_RegFlush(&hcamera);
+}
+
+void AeAwb_Suspend(uint8_t on)
+{
+    if (!AE_AWB_ENABLE || ae_suspended == on) {
+        return;
+    }
+    ae_suspended = on;
+    if (on) {
+        Camera_AutoExposure_Device();
+        Camera_RegFlush(&hcamera);
+    } else {
+        AeAwb_Start();
+    }
+}
+
+const AeAwb_StatsTypeDef *AeAwb_GetStats(void)
+{
+    return &ae_stats;
+}
+
+const AeAwb_StateTypeDef *AeAwb_GetState(void)
+{
+    return &ae_state;
+}
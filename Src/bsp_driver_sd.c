@@ -253,6 +253,18 @@ void HAL_SD_RxCpltCallback(SD_HandleTypeDef *hsd)
   BSP_SD_ReadCpltCallback();
 }
 
+/* USER CODE BEGIN ErrorCallbackSection */
+/**
+  * @brief SD error callback
+  * @param hsd: SD handle
+  * @retval None
+  */
+void HAL_SD_ErrorCallback(SD_HandleTypeDef *hsd)
+{
+  BSP_SD_ErrorCallback();
+}
+/* USER CODE END ErrorCallbackSection */
+
 /* USER CODE BEGIN CallBacksSection_C */
 /**
   * @brief BSP SD Abort callback
@@ -274,6 +286,16 @@ __weak void BSP_SD_WriteCpltCallback(void)
 
 }
 
+/**
+  * @brief BSP SD transfer error callback
+  * @retval None
+  * @note empty (up to the user to fill it in or to remove it if useless)
+  */
+__weak void BSP_SD_ErrorCallback(void)
+{
+
+}
+
 /**
   * @brief BSP Rx Transfer completed callback
   * @retval None
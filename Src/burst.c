@@ -0,0 +1,382 @@
+#include "burst.h"
+#include "fatfs.h"
+#include "stdio.h"
+#include "string.h"
+#include "i2c.h"
+#include "capture.h"
+#include "jpeg_marker.h"
+#include "contig_write.h"
+#include "ae_awb.h"
+#include "capture_profile.h"
+#include "sharpness.h"
+#include "metrics.h"
+
+#define BURST_MAX_SLOTS      16
+#define BURST_FRAME_TIMEOUT_MS 4000
+
+// Frame queue over the capture buffer. DMA fills slot (burst_tail % n);
+// slots burst_head..burst_tail-1 hold complete frames waiting for the card.
+// At most n-1 frames are queued so the DMA slot is never one being written.
+static uint8_t *burst_base;
+static uint32_t burst_num_slots;
+static uint32_t burst_slot_size = BURST_SLOT_SIZE;
+static volatile uint32_t burst_len[BURST_MAX_SLOTS];  // bytes DMA stored per slot
+static volatile uint32_t burst_head;     // frames taken off the queue
+static volatile uint32_t burst_tail;     // frames put on the queue
+static volatile uint32_t burst_frames;   // frames to queue in this burst
+static volatile uint8_t  burst_running;
+static volatile uint8_t  burst_one;      // stop after one frame, kept or not
+static uint32_t burst_best_frames;       // best-of candidates, 0 while off
+static DCMI_HandleTypeDef *burst_dcmi;    // re-armed when the stream has stopped
+static volatile Burst_StatsTypeDef burst_stats;
+
+static uint8_t *burst_slot(uint32_t frame)
+{
+    return burst_base + (frame % burst_num_slots) * burst_slot_size;
+}
+
+// Snapshot capture into the slot at the queue tail. JPEG frames end before
+// the DMA count runs out, so the frame interrupt is enabled here rather than
+// by the HAL's transfer-complete handler.
+static HAL_StatusTypeDef burst_arm(DCMI_HandleTypeDef *hdcmi)
+{
+    HAL_StatusTypeDef status;
+
+    status = HAL_DCMI_Start_DMA(hdcmi, DCMI_MODE_SNAPSHOT, (uint32_t)burst_slot(burst_tail),
+                                burst_slot_size / 4);
+    __HAL_DCMI_ENABLE_IT(hdcmi, DCMI_IT_FRAME);
+    return status;
+}
+
+// The stream has stopped and its FIFO is flushed: NDTR gives the length.
+// Runs from the DMA interrupt once the abort has gone through.
+static void burst_frame_done(DMA_HandleTypeDef *hdma)
+{
+    uint32_t len, depth;
+
+    if (!burst_running) {
+        // The burst was called off while the stream was stopping
+        return;
+    }
+    len = (burst_slot_size / 4 - __HAL_DMA_GET_COUNTER(hdma)) * 4;
+    burst_stats.captured++;
+
+    if (len >= burst_slot_size) {
+        // Slot filled before the frame ended: the JPEG is cut short
+        burst_stats.oversize++;
+    } else if (burst_tail - burst_head >= burst_num_slots - 1) {
+        // Nowhere to move on to; the slot is reused for the next frame
+        burst_stats.dropped++;
+    } else {
+        burst_len[burst_tail % burst_num_slots] = len;
+        burst_tail++;
+        depth = burst_tail - burst_head;
+        if (depth > burst_stats.max_depth) {
+            burst_stats.max_depth = depth;
+        }
+    }
+
+    if (burst_one || burst_tail >= burst_frames) {
+        burst_running = 0;
+        return;
+    }
+    if (burst_arm(burst_dcmi) != HAL_OK) {
+        burst_running = 0;
+    }
+}
+
+void Burst_FrameEvent(DCMI_HandleTypeDef *hdcmi)
+{
+    if (!burst_running) {
+        return;
+    }
+
+    // Disabling the stream takes a few bus cycles to flush the FIFO; rather
+    // than wait for it here, the DMA interrupt reports it through the abort
+    // callback. A stream that already ran to the end of the slot is stopped.
+    burst_dcmi = hdcmi;
+    hdcmi->DMA_Handle->XferAbortCallback = burst_frame_done;
+    if (HAL_DMA_Abort_IT(hdcmi->DMA_Handle) != HAL_OK) {
+        burst_frame_done(hdcmi->DMA_Handle);
+    }
+}
+
+// Where SOI..EOI lies in a frame DMA stored; 0 if a marker is missing
+static uint8_t burst_trim(const uint8_t *frame, uint32_t len, uint32_t *soi, uint32_t *size)
+{
+    uint32_t eoi;
+
+#if defined(__DCACHE_PRESENT) && (__DCACHE_PRESENT == 1U)
+    SCB_InvalidateDCache_by_Addr((void *)frame, (int32_t)len);
+#endif
+
+    *soi = JPEG_FindMarker(frame, len, JPEG_MARKER_SOI);
+    eoi = (*soi < len) ? JPEG_FindMarkerReverse(frame + *soi, len - *soi, JPEG_MARKER_EOI) : 0;
+    if (*soi == len || eoi == len - *soi) {
+        return 0;
+    }
+    *size = eoi + 2;
+    return 1;
+}
+
+// Write a trimmed JPEG to its own file
+static FRESULT burst_write(const uint8_t *jpeg, uint32_t size)
+{
+    FIL file;
+    char filename[32];
+    ContigWrite_TypeDef cw;
+    uint32_t id;
+    FRESULT res;
+
+    res = Capture_OpenPhotoFile(&file, filename, sizeof(filename), &id);
+    if (res != FR_OK) {
+        return res;
+    }
+    // The size is known up front, so one run covers the whole frame
+    res = ContigWrite_Begin(&cw, &file, size);
+    if (res == FR_OK) {
+        res = ContigWrite_Write(&cw, jpeg, size);
+    }
+    if (res == FR_OK) {
+        res = ContigWrite_End(&cw);
+    }
+    Capture_ClosePhotoFile(&file, filename, id, res == FR_OK);
+    if (res == FR_OK) {
+        burst_stats.saved++;
+    }
+    return res;
+}
+
+// Trim one queued frame to SOI..EOI and write it to its own file
+static FRESULT burst_save(const uint8_t *frame, uint32_t len)
+{
+    uint32_t soi, size;
+
+    if (!burst_trim(frame, len, &soi, &size)) {
+        burst_stats.invalid++;
+        return FR_OK;
+    }
+    return burst_write(frame + soi, size);
+}
+
+uint32_t Burst_Capture(DCMI_HandleTypeDef *hdcmi, uint32_t frames)
+{
+    char msg[64];
+    uint32_t size;
+    uint32_t last_tail = 0;
+    uint32_t wait_start;
+    FRESULT res = FR_OK;
+
+    burst_base = Capture_Buffer(&size);
+    burst_slot_size = BURST_SLOT_SIZE;
+    burst_num_slots = size / BURST_SLOT_SIZE;
+    if (burst_num_slots > BURST_MAX_SLOTS) {
+        burst_num_slots = BURST_MAX_SLOTS;
+    }
+    burst_head = 0;
+    burst_tail = 0;
+    burst_frames = frames;
+    burst_one = 0;
+    memset((void *)&burst_stats, 0, sizeof(burst_stats));
+
+    Capture_ShowStatus("Burst...");
+
+    // Sensor stays in JPEG mode for the whole burst
+    Camera_Burst_Device(&hi2c1, BURST_FRAMESIZE, BURST_QUALITY);
+    AeAwb_ApplyCapture(BURST_FRAMESIZE);
+    HAL_Delay(50);
+
+#if defined(__DCACHE_PRESENT) && (__DCACHE_PRESENT == 1U)
+    SCB_InvalidateDCache_by_Addr(burst_base, (int32_t)(burst_num_slots * BURST_SLOT_SIZE));
+#endif
+
+    __HAL_DCMI_CLEAR_FLAG(hdcmi, DCMI_FLAG_FRAMERI | DCMI_FLAG_VSYNCRI |
+                          DCMI_FLAG_ERRRI | DCMI_FLAG_OVRRI | DCMI_FLAG_LINERI);
+    burst_running = 1;
+    if (burst_arm(hdcmi) != HAL_OK) {
+        burst_running = 0;
+        Capture_ShowStatus("DMA start failed");
+        return 0;
+    }
+
+    // Drain the queue while DCMI keeps filling it
+    wait_start = HAL_GetTick();
+    while (burst_head < frames && res == FR_OK) {
+        if (burst_head == burst_tail) {
+            if (!burst_running || HAL_GetTick() - wait_start >= BURST_FRAME_TIMEOUT_MS) {
+                break;
+            }
+            continue;
+        }
+        if (burst_tail != last_tail) {
+            last_tail = burst_tail;
+            wait_start = HAL_GetTick();
+        }
+
+        res = burst_save(burst_slot(burst_head), burst_len[burst_head % burst_num_slots]);
+        burst_head++;
+    }
+
+    burst_running = 0;
+    HAL_DCMI_Stop(hdcmi);
+    Capture_SavePhotoIndex();
+
+    if (res != FR_OK) {
+        snprintf(msg, sizeof(msg), "Write err:%d", res);
+    } else {
+        snprintf(msg, sizeof(msg), "Burst %lu/%lu drop:%lu q:%lu",
+                 (unsigned long)burst_stats.saved, (unsigned long)frames,
+                 (unsigned long)(burst_stats.dropped + burst_stats.oversize + burst_stats.invalid),
+                 (unsigned long)burst_stats.max_depth);
+    }
+    Capture_ShowStatus(msg);
+
+    return burst_stats.saved;
+}
+
+// One snapshot into 'slot', the queue held at that slot; 1 with the DMA
+// length in *len once the frame is in, 0 if it was lost or too large
+static uint8_t burst_take(DCMI_HandleTypeDef *hdcmi, uint32_t slot, uint32_t *len)
+{
+    uint32_t start = HAL_GetTick();
+
+    burst_head = slot;
+    burst_tail = slot;
+    burst_frames = slot + 1;
+    burst_one = 1;
+    __HAL_DCMI_CLEAR_FLAG(hdcmi, DCMI_FLAG_FRAMERI | DCMI_FLAG_VSYNCRI |
+                          DCMI_FLAG_ERRRI | DCMI_FLAG_OVRRI | DCMI_FLAG_LINERI);
+    burst_running = 1;
+    if (burst_arm(hdcmi) != HAL_OK) {
+        burst_running = 0;
+        return 0;
+    }
+    while (burst_running && HAL_GetTick() - start < BURST_FRAME_TIMEOUT_MS) {
+    }
+    if (burst_running) {
+        burst_running = 0;
+        HAL_DCMI_Stop(hdcmi);
+        return 0;
+    }
+    if (burst_tail == slot) {
+        return 0;
+    }
+    *len = burst_len[slot];
+    return 1;
+}
+
+uint32_t Burst_BestRequested(void)
+{
+    FIL f;
+    char line[16];
+    unsigned long n;
+
+    if (f_open(&f, BURST_BEST_FILE, FA_READ) != FR_OK) {
+        return 0;
+    }
+    if (f_gets(line, sizeof(line), &f) == NULL || sscanf(line, "%lu", &n) != 1 || n == 0) {
+        n = BURST_BEST_FRAMES;
+    }
+    f_close(&f);
+    return (n > BURST_BEST_MAX) ? BURST_BEST_MAX : (uint32_t)n;
+}
+
+void Burst_SetBest(uint32_t candidates)
+{
+    burst_best_frames = (candidates > BURST_BEST_MAX) ? BURST_BEST_MAX : candidates;
+}
+
+uint32_t Burst_Best(void)
+{
+    return burst_best_frames;
+}
+
+uint8_t Burst_CaptureBest(DCMI_HandleTypeDef *hdcmi, uint32_t candidates)
+{
+    const CaptureProfile_TypeDef *profile = CaptureProfile_Get();
+    char msg[64];
+    uint32_t size, cur = 0, best_slot = 0, best_soi = 0, best_size = 0, best_score = 0;
+    int32_t best = -1;
+    FRESULT res;
+
+    // Two halves: the best frame so far stays in one while the next
+    // candidate lands in the other
+    burst_base = Capture_Buffer(&size);
+    burst_slot_size = (size / 2) & ~31U;
+    burst_num_slots = 2;
+    memset((void *)&burst_stats, 0, sizeof(burst_stats));
+
+    Capture_ShowStatus("Best of...");
+
+    Camera_JPEG_Device(&hi2c1, profile->framesize, CaptureProfile_QS());
+    AeAwb_ApplyCapture(profile->framesize);
+    HAL_Delay(50);
+
+#if defined(__DCACHE_PRESENT) && (__DCACHE_PRESENT == 1U)
+    SCB_InvalidateDCache_by_Addr(burst_base, (int32_t)(2 * burst_slot_size));
+#endif
+
+    // Each candidate is scored while the sensor runs on; the next one is
+    // simply the next frame after that
+    for (uint32_t i = 0; i < candidates; i++) {
+        uint32_t len, soi, jpeg_size, score, start;
+        uint8_t *frame = burst_slot(cur);
+        uint8_t ok;
+
+        if (!burst_take(hdcmi, cur, &len)) {
+            continue;
+        }
+        if (!burst_trim(frame, len, &soi, &jpeg_size)) {
+            burst_stats.invalid++;
+            continue;
+        }
+        start = Metrics_Now();
+        ok = Sharpness_ScoreJPEG(frame + soi, jpeg_size, &score);
+        burst_stats.score_cycles += Metrics_Now() - start;
+        if (!ok) {
+            burst_stats.invalid++;
+            continue;
+        }
+        if (best < 0 || score > best_score) {
+            best = (int32_t)i;
+            best_score = score;
+            best_slot = cur;
+            best_soi = soi;
+            best_size = jpeg_size;
+            cur ^= 1U;
+        }
+    }
+    burst_one = 0;
+    HAL_DCMI_Stop(hdcmi);
+
+    if (best < 0) {
+        Capture_ShowStatus("No usable frame");
+        return 0;
+    }
+    burst_stats.best = (uint32_t)best;
+    burst_stats.best_score = best_score;
+
+    res = burst_write(burst_slot(best_slot) + best_soi, best_size);
+    Capture_SavePhotoIndex();
+    if (res != FR_OK) {
+        snprintf(msg, sizeof(msg), "Write err:%d", res);
+        Capture_ShowStatus(msg);
+        return 0;
+    }
+    CaptureProfile_Update(hcamera.quality, best_size);
+
+    snprintf(msg, sizeof(msg), "Best %lu/%lu score %lu", (unsigned long)best + 1,
+             (unsigned long)candidates, (unsigned long)best_score);
+    Capture_ShowStatus(msg);
+    return 1;
+}
+
+uint32_t Burst_QueueDepth(void)
+{
+    return burst_tail - burst_head;
+}
+
+void Burst_GetStats(Burst_StatsTypeDef *stats)
+{
+    *stats = burst_stats;
+}
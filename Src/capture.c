@@ -2,28 +2,87 @@
 #include "stdio.h"
 #include "string.h"
 #include "main.h"
+#include "dcmi.h"
 #include "i2c.h"
 #include "camera.h"
 #include "lcd.h"
+#include "capture.h"
+#include "jpeg_marker.h"
+#include "metrics.h"
+#include "contig_write.h"
+#include "capture_profile.h"
+#include "ae_awb.h"
 
 extern uint32_t photo_id;
 extern volatile uint32_t DCMI_FrameIsReady;
 extern volatile uint32_t DCMI_VsyncFlag;
 extern volatile uint32_t DCMI_CallbackCount;
 
-// JPEG capture buffer - single snapshot mode
+// JPEG capture buffer - single snapshot mode, or chunk ring in streaming mode
 #define JPEG_BUFFER_SIZE   (448*1024)  // 448KB buffer for JPEG snapshot
 #define JPEG_BUFFER_WORDS  (JPEG_BUFFER_SIZE/4)
-__attribute__((section(".sram1"))) static uint8_t jpeg_buffer[JPEG_BUFFER_SIZE];
+__attribute__((section(".sram1"), aligned(32))) static uint8_t jpeg_buffer[JPEG_BUFFER_SIZE];
+
+// Streaming mode: the buffer is split into fixed-size chunks that DCMI DMA
+// fills in turn (double-buffer mode, idle target re-aimed at the next slot).
+// Completed chunks are written to the file while later ones are arriving.
+// Single-shot mode uses the same ring, cut down to the expected frame size,
+// with nothing written until the frame ends.
+#define STREAM_CHUNK_SIZE   (32*1024)
+#define STREAM_CHUNK_WORDS  (STREAM_CHUNK_SIZE/4)
+#define STREAM_NUM_CHUNKS   (JPEG_BUFFER_SIZE/STREAM_CHUNK_SIZE)
+
+// Capture attempt results
+#define CAPTURE_FAILED      0
+#define CAPTURE_DONE        1
+#define CAPTURE_OVERRUN     2   // frame larger than the buffer; retry smaller
+#define CAPTURE_SD_SLOW     3   // DMA lapped the card writer; retry smaller
+
+static uint32_t stream_num_chunks;              // chunks in the ring
+static volatile uint32_t stream_chunks_done;    // chunks completed by DMA
+static volatile uint32_t stream_chunks_written; // chunks flushed to the file
+static volatile uint32_t stream_next_chunk;     // next chunk to aim an idle DMA target at
+static volatile uint8_t  stream_overrun;        // DMA lapped the writer
+
+static uint32_t scan_cycles;    // CPU cycles spent locating SOI/EOI in the last capture
+
+// Last saved image, while it is still whole in jpeg_buffer (else NULL)
+static const uint8_t *cap_jpeg;
+static uint32_t cap_jpeg_len;
 
 // Timeout constants
 #define VSYNC_TIMEOUT_MS    1000
 #define FRAME_TIMEOUT_MS    4000
-#define DELAY_STEP_MS       10
+#define CAPTURE_SETTLE_MS   50      // sensor settling after the switch to JPEG
 
 // File naming constants
 #define MAX_PHOTO_ID        100000
 #define MAX_FILENAME_ATTEMPTS 1000
+#define PHOTO_INDEX_FILE    "PHOTOID.IDX"
+
+// Photo ID cache: photo_id holds the next ID to try and is valid for the
+// volume mount whose FATFS id is photo_id_mount
+static WORD photo_id_mount = 0xFFFF;
+static uint32_t photo_id_reserved;  // IDs from here on are unused as far as the index says
+static uint8_t photo_short_names;   // 8.3 names only (no LFN support)
+
+// Discard cached lines over a DMA-written region before the CPU reads it
+static void dcache_invalidate(void *addr, uint32_t size)
+{
+#if defined(__DCACHE_PRESENT) && (__DCACHE_PRESENT == 1U)
+    SCB_InvalidateDCache_by_Addr(addr, (int32_t)size);
+#else
+    (void)addr;
+    (void)size;
+#endif
+}
+
+// Status line under the preview. Weak so a build without the ST7735 (or
+// with its own UI) can route capture messages elsewhere.
+__weak void Capture_ShowStatus(const char *msg)
+{
+    LCD_ShowString(0, 50, ST7735Ctx.Width, 5, 12, (uint8_t*)msg);
+}
 
 // Helper: convert char to lowercase
 static char to_lower(char c)
@@ -100,197 +159,738 @@ static int ensure_sd_mounted(void)
     if (res != FR_OK) {
         char msg[32];
         snprintf(msg, sizeof(msg), "SD mount err:%d", res);
-        LCD_ShowString(0, 50, ST7735Ctx.Width, 5, 12, (uint8_t*)msg);
+        Capture_ShowStatus(msg);
         return 0;
     }
     
     return 1;
 }
 
-// Find unused filename, trying both long and short name formats
-static FRESULT find_unused_filename(char *filename, size_t filename_size, uint32_t *photo_id_ptr)
+// Build the file name for a photo ID
+static void photo_filename(char *filename, size_t filename_size, uint32_t id)
 {
-    FILINFO finfo;
-    FRESULT res;
-    int use_short_name = 0;
-    uint32_t attempts = 0;
-    uint32_t id = *photo_id_ptr;
-    
-    while (attempts < MAX_FILENAME_ATTEMPTS) {
-        // Generate filename
-        if (use_short_name) {
-            snprintf(filename, filename_size, "P%05lu.JPG", id % MAX_PHOTO_ID);
-        } else {
-            snprintf(filename, filename_size, "PHOTO_%05lu.jpeg", id % MAX_PHOTO_ID);
-        }
-        
-        // Check if file exists
-        res = f_stat(filename, &finfo);
-        
-        // If long filename not supported, switch to short names
-        if (res == FR_INVALID_NAME && !use_short_name) {
-            use_short_name = 1;
-            continue; // Don't increment attempts, just retry with short name
-        }
-        
-        // File doesn't exist - we can use this name
-        if (res == FR_NO_FILE || res == FR_INVALID_NAME) {
-            *photo_id_ptr = (id + 1) % MAX_PHOTO_ID;
-            return FR_OK;
+    if (photo_short_names) {
+        snprintf(filename, filename_size, "P%05lu.JPG", id % MAX_PHOTO_ID);
+    } else {
+        snprintf(filename, filename_size, "PHOTO_%05lu.jpeg", id % MAX_PHOTO_ID);
+    }
+}
+
+// Read the next photo ID from the index file; 0 if missing or unreadable
+static int load_photo_index(uint32_t *id_out)
+{
+    FIL f;
+    char buf[12];
+    UINT n = 0;
+    uint32_t id = 0;
+
+    if (f_open(&f, PHOTO_INDEX_FILE, FA_READ) != FR_OK) {
+        return 0;
+    }
+    f_read(&f, buf, sizeof(buf) - 1, &n);
+    f_close(&f);
+
+    if (n == 0 || buf[0] < '0' || buf[0] > '9') {
+        return 0;
+    }
+    for (UINT i = 0; i < n && buf[i] >= '0' && buf[i] <= '9'; i++) {
+        id = id * 10 + (uint32_t)(buf[i] - '0');
+    }
+
+    *id_out = id % MAX_PHOTO_ID;
+    return 1;
+}
+
+// Store an unused photo ID so the next mount can skip the directory scan
+static void save_photo_index(uint32_t id)
+{
+    FIL f;
+    char buf[12];
+    UINT n;
+    int len = snprintf(buf, sizeof(buf), "%05lu\n", id % MAX_PHOTO_ID);
+
+    if (f_open(&f, PHOTO_INDEX_FILE, FA_OPEN_ALWAYS | FA_WRITE) != FR_OK) {
+        return;
+    }
+    f_write(&f, buf, (UINT)len, &n);
+    f_truncate(&f);
+    f_close(&f);
+}
+
+void Capture_InitPhotoId(void)
+{
+    uint32_t id;
+
+    // Long names need LFN support; the probe name never exists on the card
+    photo_short_names = (f_stat("PHOTO_00000.probe", NULL) == FR_INVALID_NAME);
+
+    if (!(CAPTURE_PHOTO_INDEX && load_photo_index(&id))) {
+        id = find_next_photo_id();
+    }
+
+    photo_id = id;
+    photo_id_reserved = id;
+    photo_id_mount = SDFatFS.id;
+}
+
+// Create the file for the next free photo ID. The cached ID is normally
+// free already; names taken behind our back (card edited on a PC, stale
+// index) are skipped by FA_CREATE_NEW rather than probed with f_stat.
+static FRESULT create_photo_file(FIL *fp, char *filename, size_t filename_size, uint32_t *id_out)
+{
+    FRESULT res = FR_DENIED;
+    uint32_t id;
+
+    // First capture on this mount (or card swapped): rebuild the cache
+    if (photo_id_mount != SDFatFS.id) {
+        Capture_InitPhotoId();
+    }
+    id = photo_id;
+
+    for (uint32_t attempts = 0; attempts < MAX_FILENAME_ATTEMPTS; attempts++) {
+        photo_filename(filename, filename_size, id);
+        res = f_open(fp, filename, FA_CREATE_NEW | FA_WRITE);
+        if (res != FR_EXIST) {
+            break;
         }
-        
-        // File exists or other error - try next ID
         id = (id + 1) % MAX_PHOTO_ID;
-        attempts++;
     }
-    
-    return FR_DENIED; // No free filename found
+
+    *id_out = id;
+    return res;
 }
 
-// Capture JPEG image and save to SD card
-uint8_t take_A_Picture(DCMI_HandleTypeDef *hdcmi)
+FRESULT Capture_OpenPhotoFile(FIL *fp, char *filename, size_t filename_size, uint32_t *id_out)
 {
-    FRESULT res;
-    char filename[32];
-    char msg[64];
-    
-    // Ensure SD card is mounted
     if (!ensure_sd_mounted()) {
-        return 0;
+        return FR_NOT_READY;
     }
-    
-    // Find next available photo ID and filename
-    photo_id = find_next_photo_id();
-    res = find_unused_filename(filename, sizeof(filename), &photo_id);
-    
-    if (res != FR_OK) {
-        LCD_ShowString(0, 50, ST7735Ctx.Width, 5, 12, (uint8_t*)"No free filename");
-        return 0;
+    return create_photo_file(fp, filename, filename_size, id_out);
+}
+
+void Capture_ClosePhotoFile(FIL *fp, const char *filename, uint32_t id, uint8_t ok)
+{
+    if (!ok) {
+        // The ID stays free for the next attempt
+        photo_id = id;
+        f_close(fp);
+        f_unlink(filename);
+        return;
     }
-    
-    // Create file
-    LCD_ShowString(0, 50, ST7735Ctx.Width, 5, 12, (uint8_t*)"Creating file...");
-    
-    FIL capture_file;
-    res = f_open(&capture_file, filename, FA_CREATE_NEW | FA_WRITE);
-    if (res != FR_OK) {
-        snprintf(msg, sizeof(msg), "File open err:%d", res);
-        LCD_ShowString(0, 50, ST7735Ctx.Width, 5, 12, (uint8_t*)msg);
-        return 0;
+
+    f_sync(fp);
+    f_close(fp);
+    photo_id = (id + 1) % MAX_PHOTO_ID;
+}
+
+void Capture_SavePhotoIndex(void)
+{
+    // Still at or before the reservation (modulo the ID wrap): nothing to do
+    uint32_t ahead = (photo_id_reserved + MAX_PHOTO_ID - photo_id) % MAX_PHOTO_ID;
+
+    if (CAPTURE_PHOTO_INDEX && ahead > CAPTURE_PHOTO_INDEX_STEP) {
+        photo_id_reserved = (photo_id + CAPTURE_PHOTO_INDEX_STEP) % MAX_PHOTO_ID;
+        save_photo_index(photo_id_reserved);
+    }
+}
+
+uint8_t *Capture_Buffer(uint32_t *size)
+{
+    // The borrower overwrites the last image
+    cap_jpeg = NULL;
+    *size = JPEG_BUFFER_SIZE;
+    return jpeg_buffer;
+}
+
+static uint8_t *stream_slot(uint32_t chunk)
+{
+    return &jpeg_buffer[(chunk % stream_num_chunks) * STREAM_CHUNK_SIZE];
+}
+
+// Upper estimate of a JPEG frame at this size and QS, rounded up to whole
+// chunks. OV2640 output shrinks roughly as 1/(QS + 6); the margin covers
+// headers, tables and the bytes before SOI. Unknown size or quality gets the
+// whole buffer.
+static uint32_t capture_jpeg_bound(framesize_t framesize, uint8_t qs)
+{
+    uint32_t pixels = (uint32_t)dvp_cam_resolution[framesize][0] * dvp_cam_resolution[framesize][1];
+    uint32_t bound;
+
+    if (pixels == 0 || qs == 0) {
+        return STREAM_NUM_CHUNKS * STREAM_CHUNK_SIZE;
+    }
+
+    bound = pixels * 2 / (qs + 6U) + CAPTURE_JPEG_MARGIN;
+    bound = (bound + STREAM_CHUNK_SIZE - 1) / STREAM_CHUNK_SIZE * STREAM_CHUNK_SIZE;
+    if (bound < 2 * STREAM_CHUNK_SIZE) {
+        bound = 2 * STREAM_CHUNK_SIZE;
+    }
+    if (bound > STREAM_NUM_CHUNKS * STREAM_CHUNK_SIZE) {
+        bound = STREAM_NUM_CHUNKS * STREAM_CHUNK_SIZE;
+    }
+    return bound;
+}
+
+// DMA transfer-complete for either memory target: one more chunk is full and
+// the target that just finished is idle, so point it at the next ring slot.
+static void stream_dma_xfer_cplt(DMA_HandleTypeDef *hdma)
+{
+    uint32_t done = stream_chunks_done + 1;
+    HAL_DMA_MemoryTypeDef idle =
+        (((DMA_Stream_TypeDef *)hdma->Instance)->CR & DMA_SxCR_CT) ? MEMORY0 : MEMORY1;
+
+    // DMA is now filling chunk 'done'; its slot last held chunk done - N
+    if (done >= stream_num_chunks && stream_chunks_written <= done - stream_num_chunks) {
+        stream_overrun = 1;
+    }
+
+    HAL_DMAEx_ChangeMemory(hdma, (uint32_t)stream_slot(stream_next_chunk), idle);
+    stream_next_chunk++;
+    stream_chunks_done = done;
+}
+
+// Start DCMI snapshot capture with DMA cycling through a ring of 'chunks'
+static HAL_StatusTypeDef stream_start(DCMI_HandleTypeDef *hdcmi, uint32_t chunks)
+{
+    stream_num_chunks = chunks;
+    stream_chunks_done = 0;
+    stream_chunks_written = 0;
+    stream_next_chunk = 2;
+    stream_overrun = 0;
+
+    return DCMI_Start_DMA_DoubleBuffer(hdcmi, DCMI_MODE_SNAPSHOT,
+                                       (uint32_t)stream_slot(0), (uint32_t)stream_slot(1),
+                                       STREAM_CHUNK_WORDS, stream_dma_xfer_cplt);
+}
+
+// Write bytes [from, to) of a chunk to the file
+static FRESULT stream_write_chunk(ContigWrite_TypeDef *cw, uint32_t chunk, uint32_t from, uint32_t to)
+{
+    if (to <= from) return FR_OK;
+    return ContigWrite_Write(cw, stream_slot(chunk) + from, to - from);
+}
+
+// Capture state shared between Capture_Start() and the Capture_Process() steps
+static volatile Capture_StateTypeDef cap_state = CAPTURE_STATE_IDLE;
+static DCMI_HandleTypeDef *cap_hdcmi;
+static FIL cap_file;
+static ContigWrite_TypeDef cap_writer;  // pre-allocated run of cap_file
+static char cap_filename[32];
+static uint32_t cap_id;
+static uint32_t cap_tick;           // entry time of the current state
+static uint32_t cap_bound;          // bytes of the buffer DMA may fill
+static uint32_t cap_soi;            // SOI offset in chunk 0 (streaming)
+static FRESULT cap_res;             // first file error of this attempt
+static uint8_t cap_no_soi;
+static uint8_t cap_eoi_held;        // EOI seen while draining: rest waits for the frame end
+static uint8_t cap_result;          // 1 if the last capture was saved
+static uint32_t cap_size;           // bytes saved by the last capture
+static uint32_t cap_shutter;        // cycle count when the capture was requested
+static uint32_t cap_sd_start;       // cycle count of the first write, 0 if none yet
+static uint32_t cap_write_rate;     // KB/s from the first write to the close, last capture
+
+static void capture_set_state(Capture_StateTypeDef state)
+{
+    cap_state = state;
+    cap_tick = HAL_GetTick();
+}
+
+// Start DMA for one attempt: the whole ring when streaming, otherwise only
+// as much of the buffer as the frame should need
+static uint8_t capture_arm(void)
+{
+    DCMI_HandleTypeDef *hdcmi = cap_hdcmi;
+
+    cap_bound = CAPTURE_STREAM_MODE ? STREAM_NUM_CHUNKS * STREAM_CHUNK_SIZE
+                                    : capture_jpeg_bound(hcamera.framesize, hcamera.quality);
+    cap_soi = 0;
+    cap_no_soi = 0;
+    cap_eoi_held = 0;
+    scan_cycles = 0;
+    // The file is empty here (a retry truncates it), so it can get a fresh
+    // contiguous run sized for this attempt's quality
+    cap_res = ContigWrite_Begin(&cap_writer, &cap_file,
+                                capture_jpeg_bound(hcamera.framesize, hcamera.quality));
+    if (cap_res != FR_OK) {
+        char msg[32];
+
+        snprintf(msg, sizeof(msg), "Write err:%d", cap_res);
+        Capture_ShowStatus(msg);
+        return CAPTURE_FAILED;
     }
-    
-    // Prepare for capture
-    memset(jpeg_buffer, 0, JPEG_BUFFER_SIZE);
     DCMI_FrameIsReady = 0;
     DCMI_VsyncFlag = 0;
-    
-    // Configure camera for JPEG mode
-    Camera_Picture_Device(&hi2c1);
-    HAL_Delay(50);
-    
+
+    // No clearing: only the bytes DMA reports as written are looked at.
+    // Invalidate before DMA writes so no stale dirty line lands on top later.
+    dcache_invalidate(jpeg_buffer, cap_bound);
+
     // Clear DCMI flags and enable interrupts
     __HAL_DCMI_CLEAR_FLAG(hdcmi, DCMI_FLAG_FRAMERI | DCMI_FLAG_VSYNCRI | 
                           DCMI_FLAG_ERRRI | DCMI_FLAG_OVRRI | DCMI_FLAG_LINERI);
     __HAL_DCMI_ENABLE_IT(hdcmi, DCMI_IT_FRAME | DCMI_IT_VSYNC);
-    
-    // CRITICAL: Invalidate cache before DMA writes to buffer
-    // This discards any stale cache lines so DMA has clean memory to write to
-#if defined(SCB_InvalidateDCache_by_Addr)
-    SCB_InvalidateDCache_by_Addr((uint32_t*)jpeg_buffer, JPEG_BUFFER_SIZE);
-#endif
-    
-    // Start DCMI DMA capture
-    LCD_ShowString(0, 50, ST7735Ctx.Width, 5, 12, (uint8_t*)"Capturing...");
-    
-    if (HAL_DCMI_Start_DMA(hdcmi, DCMI_MODE_SNAPSHOT, (uint32_t)jpeg_buffer, 
-                           JPEG_BUFFER_WORDS) != HAL_OK) {
-        LCD_ShowString(0, 50, ST7735Ctx.Width, 5, 12, (uint8_t*)"DMA start failed");
-        f_close(&capture_file);
-        return 0;
+
+    Capture_ShowStatus("Capturing...");
+
+    if (stream_start(hdcmi, cap_bound / STREAM_CHUNK_SIZE) != HAL_OK) {
+        Capture_ShowStatus("DMA start failed");
+        return CAPTURE_FAILED;
     }
-    
-    // Wait for VSYNC signal
-    uint32_t wait_ms = 0;
-    while (!DCMI_VsyncFlag && wait_ms < VSYNC_TIMEOUT_MS) {
-        HAL_Delay(DELAY_STEP_MS);
-        wait_ms += DELAY_STEP_MS;
+    return CAPTURE_DONE;
+}
+
+// Streaming: write the oldest completed chunk, if any, while the frame is
+// still arriving. The newest completed chunk is held back so the end of the
+// image can be trimmed at EOI. One chunk per call keeps the main loop going.
+// A chunk with an EOI in it, or the 0xFF of one split with the next chunk,
+// is not written: the sensor's padding after EOI may fill whole chunks, and
+// stream_finish() has to see the last EOI in what is still unwritten.
+static void stream_drain_step(void)
+{
+    uint32_t chunk = stream_chunks_written;
+    uint8_t *p = stream_slot(chunk);
+    uint32_t scan_start;
+    uint32_t from;
+
+    if (cap_eoi_held || stream_chunks_done < chunk + 2) {
+        return;
     }
-    
-    if (!DCMI_VsyncFlag) {
-        LCD_ShowString(0, 50, ST7735Ctx.Width, 5, 12, (uint8_t*)"VSYNC timeout");
-        HAL_DCMI_Stop(hdcmi);
-        f_close(&capture_file);
-        return 0;
+
+    scan_start = DWT->CYCCNT;
+    dcache_invalidate(p, STREAM_CHUNK_SIZE);
+    dcache_invalidate(stream_slot(chunk + 1), 32);
+    if (chunk == 0) {
+        cap_soi = JPEG_FindMarker(p, STREAM_CHUNK_SIZE, JPEG_MARKER_SOI);
+        if (cap_soi == STREAM_CHUNK_SIZE) {
+            cap_no_soi = 1;
+            return;
+        }
     }
-    
-    // Wait for frame capture to complete
-    wait_ms = 0;
-    while (!DCMI_FrameIsReady && wait_ms < FRAME_TIMEOUT_MS) {
-        HAL_Delay(DELAY_STEP_MS);
-        wait_ms += DELAY_STEP_MS;
+    from = (chunk == 0) ? cap_soi : 0;
+    if (JPEG_FindMarker(p + from, STREAM_CHUNK_SIZE - from, JPEG_MARKER_EOI) != STREAM_CHUNK_SIZE - from ||
+        (p[STREAM_CHUNK_SIZE - 1] == 0xFF && stream_slot(chunk + 1)[0] == JPEG_MARKER_EOI)) {
+        cap_eoi_held = 1;
     }
-    
-    if (!DCMI_FrameIsReady) {
-        LCD_ShowString(0, 50, ST7735Ctx.Width, 5, 12, (uint8_t*)"Frame timeout");
-        HAL_DCMI_Stop(hdcmi);
-        f_close(&capture_file);
-        return 0;
+    scan_cycles += DWT->CYCCNT - scan_start;
+    if (cap_eoi_held) {
+        return;
     }
-    
-    // Stop DCMI
+    if (!cap_sd_start) {
+        cap_sd_start = Metrics_Now();
+    }
+    cap_res = stream_write_chunk(&cap_writer, chunk, from, STREAM_CHUNK_SIZE);
+    stream_chunks_written = chunk + 1;
+}
+
+// Streaming attempt ended early: report why. An overrun is only reported
+// once the retries are used up (capture_end), so it is not shown here.
+static uint8_t stream_fail(void)
+{
+    DCMI_HandleTypeDef *hdcmi = cap_hdcmi;
+    char msg[64];
+
+    HAL_DCMI_Stop(hdcmi);
+    if (cap_no_soi) {
+        snprintf(msg, sizeof(msg), "Invalid JPEG");
+    } else if (cap_res != FR_OK) {
+        snprintf(msg, sizeof(msg), "Write err:%d", cap_res);
+    } else if (stream_overrun) {
+        return CAPTURE_SD_SLOW;
+    } else if (hdcmi->ErrorCode != HAL_DCMI_ERROR_NONE) {
+        snprintf(msg, sizeof(msg), "DCMI err:0x%lx", (unsigned long)hdcmi->ErrorCode);
+    } else if (!DCMI_FrameIsReady) {
+        snprintf(msg, sizeof(msg), "Frame timeout");
+    } else {
+        snprintf(msg, sizeof(msg), "Invalid JPEG");
+    }
+    Capture_ShowStatus(msg);
+    return CAPTURE_FAILED;
+}
+
+// Pipelined capture, after the frame has ended: write what is left up to EOI.
+// The shot costs about max(capture, write) and the frame may exceed the ring.
+static uint8_t stream_finish(void)
+{
+    DCMI_HandleTypeDef *hdcmi = cap_hdcmi;
+    ContigWrite_TypeDef *file = &cap_writer;
+    char msg[64];
+    FRESULT res = FR_OK;
+    uint32_t soi_pos = cap_soi;
+
+    // Stopping the stream flushes the DMA FIFO; NDTR then gives the fill level
+    // of the chunk that was active at frame end.
     if (HAL_DCMI_Stop(hdcmi) != HAL_OK) {
-        LCD_ShowString(0, 50, ST7735Ctx.Width, 5, 12, (uint8_t*)"DCMI stop failed");
-        f_close(&capture_file);
-        return 0;
+        Capture_ShowStatus("DCMI stop failed");
+        return CAPTURE_FAILED;
     }
-    
-    // Invalidate cache to ensure we read DMA data
-#if defined(SCB_InvalidateDCache_by_Addr)
-    SCB_InvalidateDCache_by_Addr((uint32_t*)jpeg_buffer, JPEG_BUFFER_SIZE);
-#endif
-    
-    // Find JPEG Start of Image (SOI: 0xFFD8) and End of Image (EOI: 0xFFD9)
-    uint32_t soi_pos = JPEG_BUFFER_SIZE;
-    uint32_t eoi_pos = JPEG_BUFFER_SIZE;
-    
-    for (uint32_t i = 0; i + 1 < JPEG_BUFFER_SIZE; i++) {
-        if (soi_pos == JPEG_BUFFER_SIZE && 
-            jpeg_buffer[i] == 0xFF && jpeg_buffer[i+1] == 0xD8) {
-            soi_pos = i;
+
+    uint32_t first = stream_chunks_written;
+    uint32_t last = stream_chunks_done;
+    uint32_t tail = (STREAM_CHUNK_WORDS - __HAL_DMA_GET_COUNTER(hdcmi->DMA_Handle)) * 4;
+    if (tail == 0 && last > first) {
+        last--;
+        tail = STREAM_CHUNK_SIZE;
+    }
+    // The ring for this frame may be shorter than the whole buffer
+    if (last - first >= stream_num_chunks) {
+        return CAPTURE_SD_SLOW;
+    }
+
+    uint32_t scan_start = DWT->CYCCNT;
+
+    // Locate the start in the first chunk if nothing has been written yet
+    uint32_t start = 0;
+    if (!cap_sd_start) {
+        cap_sd_start = Metrics_Now();
+    }
+    for (uint32_t c = first; c <= last; c++) {
+        dcache_invalidate(stream_slot(c), STREAM_CHUNK_SIZE);
+    }
+    if (first == 0) {
+        uint32_t end = (last == 0) ? tail : STREAM_CHUNK_SIZE;
+        soi_pos = JPEG_FindMarker(stream_slot(0), end, JPEG_MARKER_SOI);
+        if (soi_pos == end) {
+            Capture_ShowStatus("Invalid JPEG");
+            return CAPTURE_FAILED;
+        }
+        start = soi_pos;
+    }
+
+    // Find the last EOI (0xFFD9) in the unwritten region, scanning backwards;
+    // between two chunks, check for a pair split across the boundary
+    uint32_t eoi_chunk = last + 1;
+    uint32_t eoi_end = 0;
+    for (uint32_t c = last + 1; c-- > first; ) {
+        uint8_t *p = stream_slot(c);
+        uint32_t end = (c == last) ? tail : STREAM_CHUNK_SIZE;
+        uint32_t lo = (c == first) ? start : 0;
+        uint32_t pos = JPEG_FindMarkerReverse(p + lo, end - lo, JPEG_MARKER_EOI);
+
+        if (pos != end - lo) {
+            eoi_chunk = c;
+            eoi_end = lo + pos + 2;
+            break;
         }
-        if (soi_pos != JPEG_BUFFER_SIZE && 
-            jpeg_buffer[i] == 0xFF && jpeg_buffer[i+1] == 0xD9) {
-            eoi_pos = i + 2;
+        if (c > first && end > 0 && p[0] == JPEG_MARKER_EOI &&
+            stream_slot(c - 1)[STREAM_CHUNK_SIZE - 1] == 0xFF) {
+            eoi_chunk = c - 1;
+            eoi_end = STREAM_CHUNK_SIZE + 1;
             break;
         }
     }
+    scan_cycles += DWT->CYCCNT - scan_start;
+
+    if (eoi_chunk > last) {
+        Capture_ShowStatus("Invalid JPEG");
+        return CAPTURE_FAILED;
+    }
+
+    // Without a wrap the ring slots are in order, so the image is still
+    // whole in the buffer for Capture_LastJPEG
+    if (last + 1 < stream_num_chunks) {
+        cap_jpeg = stream_slot(0) + soi_pos;
+        cap_jpeg_len = eoi_chunk * STREAM_CHUNK_SIZE + eoi_end - soi_pos;
+    }
+
+    // EOI may straddle into the following chunk
+    if (eoi_end > STREAM_CHUNK_SIZE) {
+        eoi_end = STREAM_CHUNK_SIZE;
+        res = FR_OK;
+        for (uint32_t c = first; c <= eoi_chunk && res == FR_OK; c++) {
+            res = stream_write_chunk(file, c, (c == first) ? start : 0, STREAM_CHUNK_SIZE);
+        }
+        if (res == FR_OK) {
+            res = stream_write_chunk(file, eoi_chunk + 1, 0, 1);
+        }
+    } else {
+        for (uint32_t c = first; c <= eoi_chunk && res == FR_OK; c++) {
+            res = stream_write_chunk(file, c, (c == first) ? start : 0,
+                                     (c == eoi_chunk) ? eoi_end : STREAM_CHUNK_SIZE);
+        }
+    }
+
+    if (res == FR_OK) {
+        res = ContigWrite_End(file);
+    }
+    if (res != FR_OK) {
+        snprintf(msg, sizeof(msg), "Write err:%d", res);
+        Capture_ShowStatus(msg);
+        return CAPTURE_FAILED;
+    }
+
+    cap_size = f_size(&cap_file);
+    return CAPTURE_DONE;
+}
+
+// Single-shot capture, after the frame has ended: the whole frame is in
+// jpeg_buffer and goes out in one multi-block write
+static uint8_t single_finish(void)
+{
+    DCMI_HandleTypeDef *hdcmi = cap_hdcmi;
+    FRESULT res;
+    char msg[64];
+
+    // Stop DCMI
+    if (HAL_DCMI_Stop(hdcmi) != HAL_OK) {
+        Capture_ShowStatus("DCMI stop failed");
+        return CAPTURE_FAILED;
+    }
     
+    // The ring has not wrapped, so the frame is contiguous from jpeg_buffer.
+    // Only the part DMA actually wrote needs invalidating and scanning.
+    uint32_t received = stream_chunks_done * STREAM_CHUNK_SIZE +
+                        (STREAM_CHUNK_WORDS - __HAL_DMA_GET_COUNTER(hdcmi->DMA_Handle)) * 4;
+    if (stream_overrun || received > cap_bound) {
+        return CAPTURE_OVERRUN;
+    }
+    dcache_invalidate(jpeg_buffer, received);
+
+    // Find JPEG Start of Image (SOI: 0xFFD8) and End of Image (EOI: 0xFFD9)
+    uint32_t scan_start = DWT->CYCCNT;
+    uint32_t soi_pos = JPEG_FindMarker(jpeg_buffer, received, JPEG_MARKER_SOI);
+    uint32_t eoi_pos = received;
+    if (soi_pos < received) {
+        eoi_pos = soi_pos + 2 + JPEG_FindMarker(&jpeg_buffer[soi_pos + 2], received - soi_pos - 2,
+                                                JPEG_MARKER_EOI);
+    }
+    scan_cycles = DWT->CYCCNT - scan_start;
+
     // Validate JPEG markers found
-    if (soi_pos == JPEG_BUFFER_SIZE || eoi_pos == JPEG_BUFFER_SIZE || eoi_pos <= soi_pos) {
-        LCD_ShowString(0, 50, ST7735Ctx.Width, 5, 12, (uint8_t*)"Invalid JPEG");
-        f_close(&capture_file);
-        return 0;
+    if (soi_pos >= received || eoi_pos >= received) {
+        Capture_ShowStatus("Invalid JPEG");
+        return CAPTURE_FAILED;
     }
+    eoi_pos += 2;
     
     // Write JPEG data to file
     uint32_t jpeg_size = eoi_pos - soi_pos;
-    UINT bytes_written = 0;
     
-    res = f_write(&capture_file, &jpeg_buffer[soi_pos], jpeg_size, &bytes_written);
-    if (res != FR_OK || bytes_written != jpeg_size) {
+    cap_sd_start = Metrics_Now();
+    res = ContigWrite_Write(&cap_writer, &jpeg_buffer[soi_pos], jpeg_size);
+    if (res == FR_OK) {
+        res = ContigWrite_End(&cap_writer);
+    }
+    if (res != FR_OK) {
         snprintf(msg, sizeof(msg), "Write err:%d", res);
-        LCD_ShowString(0, 50, ST7735Ctx.Width, 5, 12, (uint8_t*)msg);
-        f_close(&capture_file);
-        return 0;
+        Capture_ShowStatus(msg);
+        return CAPTURE_FAILED;
     }
-    
-    // Sync and close file
-    f_sync(&capture_file);
-    f_close(&capture_file);
-    
+
+    cap_size = jpeg_size;
+    cap_jpeg = &jpeg_buffer[soi_pos];
+    cap_jpeg_len = jpeg_size;
+    return CAPTURE_DONE;
+}
+
+// Close the file and report how the capture ended
+static void capture_end(uint8_t ok)
+{
+    char msg[64];
+    uint32_t seq, sd_cycles;
+
+    if (ok == CAPTURE_OVERRUN) {
+        Capture_ShowStatus("Frame too large");
+    } else if (ok == CAPTURE_SD_SLOW) {
+        Capture_ShowStatus("SD too slow");
+    }
+    Capture_ClosePhotoFile(&cap_file, cap_filename, cap_id, ok == CAPTURE_DONE);
+    cap_result = (ok == CAPTURE_DONE);
+    cap_write_rate = 0;
+    if (!cap_result) {
+        cap_jpeg = NULL;
+    }
+    capture_set_state(CAPTURE_STATE_IDLE);
+    if (!cap_result) {
+        return;
+    }
+    Capture_SavePhotoIndex();
+
+    // The saved frame is the last one DCMI completed
+    seq = Metrics_LastFrame();
+    Metrics_StampAt(seq, METRICS_SHUTTER, cap_shutter);
+    Metrics_StampAt(seq, METRICS_SD_START, cap_sd_start);
+    Metrics_SetBytes(seq, cap_size);
+    Metrics_Stamp(seq, METRICS_SD_DONE);
+    CaptureProfile_Update(hcamera.quality, cap_size);
+
+    sd_cycles = Metrics_Now() - cap_sd_start;
+    if (cap_sd_start && sd_cycles) {
+        cap_write_rate = (uint32_t)((uint64_t)cap_size * SystemCoreClock / 1024U / sd_cycles);
+    }
+
     // Display success message
-    snprintf(msg, sizeof(msg), "Saved %lu bytes", (unsigned long)bytes_written);
-    LCD_ShowString(0, 50, ST7735Ctx.Width, 5, 12, (uint8_t*)msg);
-    
+    snprintf(msg, sizeof(msg), "Saved %lu bytes %luK/s", (unsigned long)cap_size,
+             (unsigned long)cap_write_rate);
+    Capture_ShowStatus(msg);
+}
+
+// An attempt finished: save, give up, or retake a frame that did not fit
+// (or outran the card) with coarser quantisation rather than save it cut short
+static void capture_attempt_done(uint8_t ok)
+{
+    char msg[64];
+
+    if (ok != CAPTURE_OVERRUN && ok != CAPTURE_SD_SLOW) {
+        capture_end(ok);
+        return;
+    }
+    if (hcamera.quality == 0 || hcamera.quality * 2 > CAPTURE_QUALITY_MAX) {
+        capture_end(ok);
+        return;
+    }
+    // Drop any part already written
+    if (f_lseek(&cap_file, 0) != FR_OK || f_truncate(&cap_file) != FR_OK) {
+        capture_end(CAPTURE_FAILED);
+        return;
+    }
+    Camera_Quality_Device(hcamera.quality * 2);
+    snprintf(msg, sizeof(msg), "Retry at QS %u", hcamera.quality);
+    Capture_ShowStatus(msg);
+    capture_set_state(CAPTURE_STATE_SETTLE);
+}
+
+uint8_t Capture_Start(DCMI_HandleTypeDef *hdcmi)
+{
+    FRESULT res;
+    char msg[64];
+
+    if (cap_state != CAPTURE_STATE_IDLE) {
+        return 0;
+    }
+    cap_result = 0;
+    cap_jpeg = NULL;
+    cap_hdcmi = hdcmi;
+
+    // Create the file under the next free photo ID
+    Capture_ShowStatus("Creating file...");
+
+    res = Capture_OpenPhotoFile(&cap_file, cap_filename, sizeof(cap_filename), &cap_id);
+    if (res == FR_NOT_READY) {
+        return 0;
+    }
+    if (res == FR_EXIST) {
+        Capture_ShowStatus("No free filename");
+        return 0;
+    }
+    if (res != FR_OK) {
+        snprintf(msg, sizeof(msg), "File open err:%d", res);
+        Capture_ShowStatus(msg);
+        return 0;
+    }
+
+    // Prepare for capture; the DWT counter also times the marker scan
+    Metrics_Init();
+    cap_shutter = Metrics_Now();
+    cap_sd_start = 0;
+
+    // Configure camera for JPEG at the current profile; the first frame is
+    // taken once the sensor has settled
+    Camera_JPEG_Device(&hi2c1, CaptureProfile_Get()->framesize, CaptureProfile_QS());
+    AeAwb_ApplyCapture(CaptureProfile_Get()->framesize);
+    capture_set_state(CAPTURE_STATE_SETTLE);
     return 1;
-}
\ No newline at end of file
+}
+
+uint8_t Capture_Process(void)
+{
+    DCMI_HandleTypeDef *hdcmi = cap_hdcmi;
+    uint32_t elapsed = HAL_GetTick() - cap_tick;
+
+    switch (cap_state) {
+    case CAPTURE_STATE_SETTLE:
+        if (elapsed < CAPTURE_SETTLE_MS) {
+            break;
+        }
+        if (capture_arm() != CAPTURE_DONE) {
+            capture_end(CAPTURE_FAILED);
+            break;
+        }
+        capture_set_state(CAPTURE_STATE_VSYNC);
+        break;
+
+    case CAPTURE_STATE_VSYNC:
+        if (DCMI_VsyncFlag) {
+            capture_set_state(CAPTURE_STATE_FRAME);
+        } else if (elapsed >= VSYNC_TIMEOUT_MS) {
+            Capture_ShowStatus("VSYNC timeout");
+            HAL_DCMI_Stop(hdcmi);
+            capture_end(CAPTURE_FAILED);
+        }
+        break;
+
+    case CAPTURE_STATE_FRAME:
+        if (CAPTURE_STREAM_MODE) {
+            if (!DCMI_FrameIsReady && elapsed < FRAME_TIMEOUT_MS && !stream_overrun &&
+                hdcmi->ErrorCode == HAL_DCMI_ERROR_NONE && cap_res == FR_OK && !cap_no_soi) {
+                stream_drain_step();
+                break;
+            }
+            if (!DCMI_FrameIsReady || stream_overrun || hdcmi->ErrorCode != HAL_DCMI_ERROR_NONE ||
+                cap_res != FR_OK || cap_no_soi) {
+                capture_attempt_done(stream_fail());
+            } else {
+                capture_attempt_done(stream_finish());
+            }
+        } else {
+            // The frame ends, or DMA runs out of buffer first
+            if (stream_overrun) {
+                HAL_DCMI_Stop(hdcmi);
+                capture_attempt_done(CAPTURE_OVERRUN);
+            } else if (DCMI_FrameIsReady) {
+                capture_attempt_done(single_finish());
+            } else if (elapsed >= FRAME_TIMEOUT_MS) {
+                Capture_ShowStatus("Frame timeout");
+                HAL_DCMI_Stop(hdcmi);
+                capture_end(CAPTURE_FAILED);
+            }
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    return cap_state != CAPTURE_STATE_IDLE;
+}
+
+Capture_StateTypeDef Capture_GetState(void)
+{
+    return cap_state;
+}
+
+uint8_t Capture_LastResult(void)
+{
+    return cap_result;
+}
+
+// Capture JPEG image and save to SD card; blocks until it is done
+uint8_t take_A_Picture(DCMI_HandleTypeDef *hdcmi)
+{
+    if (!Capture_Start(hdcmi)) {
+        return 0;
+    }
+    while (Capture_Process()) {
+    }
+    return cap_result;
+}
+
+const uint8_t *Capture_LastJPEG(uint32_t *len)
+{
+    *len = cap_jpeg ? cap_jpeg_len : 0U;
+    return cap_jpeg;
+}
+
+const char *Capture_LastFilename(void)
+{
+    return cap_result ? cap_filename : NULL;
+}
+
+uint32_t Capture_LastScanCycles(void)
+{
+    return scan_cycles;
+}
+
+uint32_t Capture_LastWriteRate(void)
+{
+    return cap_write_rate;
+}
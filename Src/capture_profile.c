@@ -0,0 +1,199 @@
+#include "capture_profile.h"
+#include "stdio.h"
+#include "string.h"
+#include "ctype.h"
+#include "capture.h"
+#include "ov2640.h"
+
+// Built-in profiles, the first one selected at boot. Targets are about what
+// a typical indoor scene gives at the profile's finest QS.
+static CaptureProfile_TypeDef profiles[CAPTURE_PROFILE_MAX] = {
+    { "UXGA",   FRAMESIZE_UXGA, CAPTURE_QUALITY, 0 },
+    { "UXGA-S", FRAMESIZE_UXGA, 6,  160*1024 },
+    { "XGA",    FRAMESIZE_XGA,  6,  96*1024 },
+    { "SVGA",   FRAMESIZE_SVGA, 8,  64*1024 },
+    { "VGA",    FRAMESIZE_VGA,  10, 32*1024 },
+};
+static uint8_t profile_count = 5;
+static uint8_t profile_cur;
+static uint8_t profile_qs = CAPTURE_QUALITY;    // QS the next photo starts at
+
+static int profile_namecmp(const char *a, const char *b)
+{
+    while (*a && tolower((unsigned char)*a) == tolower((unsigned char)*b)) {
+        a++;
+        b++;
+    }
+    return tolower((unsigned char)*a) - tolower((unsigned char)*b);
+}
+
+static void profile_use(uint8_t i)
+{
+    profile_cur = i;
+    profile_qs = profiles[i].qs;
+}
+
+// The JPEG-capable framesize with this resolution, FRAMESIZE_INVALID if none
+static framesize_t profile_framesize(uint32_t w, uint32_t h)
+{
+    for (int fs = FRAMESIZE_INVALID + 1; fs <= FRAMESIZE_5MPP; fs++) {
+        if (dvp_cam_resolution[fs][0] == w && dvp_cam_resolution[fs][1] == h &&
+            ov2640_check_framesize((uint8_t)fs) == 0) {
+            return (framesize_t)fs;
+        }
+    }
+    return FRAMESIZE_INVALID;
+}
+
+// "<name> = <w>x<h> <qs> [<target KB>]"; 0 if malformed or the table is full
+static uint8_t profile_define(const char *name, const char *value)
+{
+    unsigned long w, h, qs, target_kb = 0;
+    framesize_t fs;
+    uint8_t i;
+
+    if (sscanf(value, "%lux%lu %lu %lu", &w, &h, &qs, &target_kb) < 3 ||
+        strlen(name) >= CAPTURE_PROFILE_NAME_LEN || qs < 2 || qs > 60) {
+        return 0;
+    }
+    fs = profile_framesize(w, h);
+    if (fs == FRAMESIZE_INVALID) {
+        return 0;
+    }
+    for (i = 0; i < profile_count; i++) {
+        if (profile_namecmp(profiles[i].name, name) == 0) {
+            break;
+        }
+    }
+    if (i == profile_count) {
+        if (profile_count == CAPTURE_PROFILE_MAX) {
+            return 0;
+        }
+        profile_count++;
+    }
+    strcpy(profiles[i].name, name);
+    profiles[i].framesize = fs;
+    profiles[i].qs = (uint8_t)qs;
+    profiles[i].target = (uint32_t)target_kb * 1024U;
+    if (i == profile_cur) {
+        profile_use(i);
+    }
+    return 1;
+}
+
+// Strip leading and trailing blanks in place
+static char *profile_trim(char *s)
+{
+    char *end;
+
+    while (isspace((unsigned char)*s)) {
+        s++;
+    }
+    end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) {
+        end--;
+    }
+    *end = '\0';
+    return s;
+}
+
+const CaptureProfile_TypeDef *CaptureProfile_Get(void)
+{
+    return &profiles[profile_cur];
+}
+
+const CaptureProfile_TypeDef *CaptureProfile_Next(void)
+{
+    profile_use((uint8_t)((profile_cur + 1) % profile_count));
+    return &profiles[profile_cur];
+}
+
+uint8_t CaptureProfile_Select(const char *name)
+{
+    for (uint8_t i = 0; i < profile_count; i++) {
+        if (profile_namecmp(profiles[i].name, name) == 0) {
+            profile_use(i);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+uint8_t CaptureProfile_QS(void)
+{
+    return profile_qs;
+}
+
+void CaptureProfile_Update(uint8_t qs, uint32_t bytes)
+{
+    const CaptureProfile_TypeDef *p = &profiles[profile_cur];
+    uint32_t max = (p->qs > CAPTURE_QUALITY_MAX) ? p->qs : CAPTURE_QUALITY_MAX;
+    uint32_t next;
+
+    if (p->target == 0 || qs == 0) {
+        return;
+    }
+    // Same model as the capture size estimate: bytes ~ 1/(QS + 6). Rounded
+    // up so the next photo errs towards the smaller side of the target.
+    next = (uint32_t)(((uint64_t)(qs + 6U) * bytes + p->target - 1U) / p->target);
+    next = (next > 6U) ? next - 6U : 0U;
+    if (next < p->qs) {
+        next = p->qs;
+    }
+    if (next > max) {
+        next = max;
+    }
+    profile_qs = (uint8_t)next;
+}
+
+FRESULT CaptureProfile_Load(const char *path)
+{
+    FIL f;
+    FRESULT res;
+    char line[64], msg[32];
+    char select[CAPTURE_PROFILE_NAME_LEN] = "";
+    unsigned lineno = 0, bad = 0;
+
+    res = f_open(&f, path, FA_READ);
+    if (res != FR_OK) {
+        return res;
+    }
+    while (f_gets(line, sizeof(line), &f) != NULL) {
+        char *hash = strchr(line, '#');
+        char *eq, *key, *value;
+
+        lineno++;
+        if (hash != NULL) {
+            *hash = '\0';
+        }
+        key = profile_trim(line);
+        if (*key == '\0') {
+            continue;
+        }
+        eq = strchr(key, '=');
+        if (eq == NULL) {
+            bad = bad ? bad : lineno;
+            continue;
+        }
+        *eq = '\0';
+        key = profile_trim(key);
+        value = profile_trim(eq + 1);
+        if (profile_namecmp(key, "profile") == 0) {
+            strncpy(select, value, sizeof(select) - 1);
+        } else if (!profile_define(key, value)) {
+            bad = bad ? bad : lineno;
+        }
+    }
+    f_close(&f);
+
+    // Selected last so the name may be one the file defines further down
+    if (select[0] != '\0' && !CaptureProfile_Select(select)) {
+        bad = bad ? bad : lineno;
+    }
+    if (bad) {
+        snprintf(msg, sizeof(msg), "%s line %u?", path, bad);
+        Capture_ShowStatus(msg);
+        return FR_INVALID_PARAMETER;
+    }
+    return FR_OK;
+}
@@ -0,0 +1,144 @@
+#include "contig_write.h"
+#include "diskio.h"
+#include "string.h"
+
+// Write n whole sectors at the end of the run; one multi-block command
+static FRESULT contig_sectors(ContigWrite_TypeDef *cw, const uint8_t *buf, DWORD n)
+{
+    FATFS *fs = cw->fp->obj.fs;
+
+    if (disk_write(fs->drv, buf, cw->sect + cw->done, (UINT)n) != RES_OK) {
+        return FR_DISK_ERR;
+    }
+    cw->done += n;
+    return FR_OK;
+}
+
+// The run is used up: let FatFs carry on from the end of what was written
+static FRESULT contig_handover(ContigWrite_TypeDef *cw)
+{
+    UINT bw = 0;
+    FRESULT res;
+
+    cw->sect = 0;
+    res = f_lseek(cw->fp, (FSIZE_t)cw->done * _MAX_SS);
+    if (res == FR_OK && cw->fill > 0) {
+        res = f_write(cw->fp, cw->tail, cw->fill, &bw);
+        if (res == FR_OK && bw != cw->fill) {
+            res = FR_DENIED;    // card full
+        }
+    }
+    cw->fill = 0;
+    return res;
+}
+
+FRESULT ContigWrite_Begin(ContigWrite_TypeDef *cw, FIL *fp, FSIZE_t expect)
+{
+    FATFS *fs = fp->obj.fs;
+    FSIZE_t cluster = (FSIZE_t)fs->csize * _MAX_SS;
+    FRESULT res;
+
+    cw->fp = fp;
+    cw->sect = 0;
+    cw->nsect = 0;
+    cw->done = 0;
+    cw->fill = 0;
+    if (!CONTIG_WRITE_ENABLE || expect == 0) {
+        return FR_OK;
+    }
+
+    expect = (expect + cluster - 1) / cluster * cluster;
+    res = f_expand(fp, expect, 1);
+    if (res == FR_DENIED) {
+        // No free run that long (or the file is not empty): plain f_write
+        return FR_OK;
+    }
+    if (res != FR_OK) {
+        return res;
+    }
+    cw->sect = fs->database + (fp->obj.sclust - 2) * fs->csize;
+    cw->nsect = (DWORD)(expect / _MAX_SS);
+    // The run is written behind FatFs' back, so drop the sector it caches
+    fp->sect = 0;
+    return FR_OK;
+}
+
+FRESULT ContigWrite_Write(ContigWrite_TypeDef *cw, const void *buf, UINT len)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+    UINT bw = 0, n;
+    FRESULT res;
+
+    if (cw->sect && ((FSIZE_t)cw->done * _MAX_SS + cw->fill + len > (FSIZE_t)cw->nsect * _MAX_SS)) {
+        res = contig_handover(cw);
+        if (res != FR_OK) {
+            return res;
+        }
+    }
+    if (!cw->sect) {
+        res = f_write(cw->fp, buf, len, &bw);
+        if (res == FR_OK && bw != len) {
+            res = FR_DENIED;    // card full
+        }
+        return res;
+    }
+
+    // Complete a part sector left by the last call
+    if (cw->fill > 0) {
+        n = (len < _MAX_SS - cw->fill) ? len : _MAX_SS - cw->fill;
+        memcpy(&cw->tail[cw->fill], p, n);
+        cw->fill += n;
+        p += n;
+        len -= n;
+        if (cw->fill < _MAX_SS) {
+            return FR_OK;
+        }
+        res = contig_sectors(cw, cw->tail, 1);
+        if (res != FR_OK) {
+            return res;
+        }
+        cw->fill = 0;
+    }
+
+    // Whole sectors straight from the caller's buffer
+    n = len / _MAX_SS;
+    if (n > 0) {
+        res = contig_sectors(cw, p, n);
+        if (res != FR_OK) {
+            return res;
+        }
+        p += n * _MAX_SS;
+        len -= n * _MAX_SS;
+    }
+
+    if (len > 0) {
+        memcpy(cw->tail, p, len);
+        cw->fill = len;
+    }
+    return FR_OK;
+}
+
+FRESULT ContigWrite_End(ContigWrite_TypeDef *cw)
+{
+    FRESULT res;
+
+    if (cw->sect) {
+        FSIZE_t size = (FSIZE_t)cw->done * _MAX_SS + cw->fill;
+
+        if (cw->fill > 0) {
+            memset(&cw->tail[cw->fill], 0, _MAX_SS - cw->fill);
+            res = contig_sectors(cw, cw->tail, 1);
+            if (res != FR_OK) {
+                return res;
+            }
+        }
+        cw->sect = 0;
+        cw->fill = 0;
+        res = f_lseek(cw->fp, size);
+        if (res != FR_OK) {
+            return res;
+        }
+    }
+    // Frees the clusters past the end, including any f_write left allocated
+    return f_truncate(cw->fp);
+}
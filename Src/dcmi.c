@@ -21,7 +21,7 @@
 #include "dcmi.h"
 
 /* USER CODE BEGIN 0 */
-
+static void (*dcmi_dbm_cplt)(DMA_HandleTypeDef *hdma);
 /* USER CODE END 0 */
 
 DCMI_HandleTypeDef hdcmi;
@@ -208,5 +208,80 @@ void HAL_DCMI_MspDeInit(DCMI_HandleTypeDef* dcmiHandle)
 }
 
 /* USER CODE BEGIN 1 */
+static void DCMI_DBM_XferCplt(DMA_HandleTypeDef *hdma)
+{
+  DCMI_HandleTypeDef *dcmi = (DCMI_HandleTypeDef *)hdma->Parent;
+
+  /* The frame IRQ masks itself; re-arm it as HAL's own DMA callback does */
+  __HAL_DCMI_ENABLE_IT(dcmi, DCMI_IT_FRAME);
+
+  if (dcmi_dbm_cplt != NULL)
+  {
+    dcmi_dbm_cplt(hdma);
+  }
+}
+
+static void DCMI_DBM_XferError(DMA_HandleTypeDef *hdma)
+{
+  DCMI_HandleTypeDef *dcmi = (DCMI_HandleTypeDef *)hdma->Parent;
+
+  /* FIFO errors are expected with a word-wide peripheral source */
+  if (hdma->ErrorCode != HAL_DMA_ERROR_FE)
+  {
+    dcmi->State = HAL_DCMI_STATE_READY;
+    dcmi->ErrorCode |= HAL_DCMI_ERROR_DMA;
+    HAL_DCMI_ErrorCallback(dcmi);
+  }
+}
 
+/**
+  * @brief  Start DCMI capture with the DMA stream in double-buffer mode.
+  *         Each memory target receives Length words. XferCplt runs in the DMA
+  *         IRQ whenever one target has been filled; the stream has already
+  *         switched to the other target, so the callback may re-aim the idle
+  *         one with HAL_DMAEx_ChangeMemory().
+  * @param  hdcmi     DCMI handle
+  * @param  DCMI_Mode DCMI_MODE_CONTINUOUS or DCMI_MODE_SNAPSHOT
+  * @param  Buf0      First memory target (32-byte aligned for cache upkeep)
+  * @param  Buf1      Second memory target
+  * @param  Length    Words per target
+  * @param  XferCplt  Target-full callback
+  * @retval HAL status
+  */
+HAL_StatusTypeDef DCMI_Start_DMA_DoubleBuffer(DCMI_HandleTypeDef *hdcmi, uint32_t DCMI_Mode,
+                                              uint32_t Buf0, uint32_t Buf1, uint32_t Length,
+                                              void (*XferCplt)(DMA_HandleTypeDef *hdma))
+{
+  DMA_HandleTypeDef *hdma = hdcmi->DMA_Handle;
+
+  __HAL_LOCK(hdcmi);
+
+  hdcmi->State = HAL_DCMI_STATE_BUSY;
+  hdcmi->ErrorCode = HAL_DCMI_ERROR_NONE;
+  __HAL_DCMI_ENABLE(hdcmi);
+
+  hdcmi->Instance->CR &= ~(DCMI_CR_CM);
+  hdcmi->Instance->CR |= DCMI_Mode;
+
+  dcmi_dbm_cplt = XferCplt;
+  hdma->XferCpltCallback = DCMI_DBM_XferCplt;
+  hdma->XferM1CpltCallback = DCMI_DBM_XferCplt;
+  hdma->XferErrorCallback = DCMI_DBM_XferError;
+  hdma->XferHalfCpltCallback = NULL;
+  hdma->XferM1HalfCpltCallback = NULL;
+  hdma->XferAbortCallback = NULL;
+
+  if (HAL_DMAEx_MultiBufferStart_IT(hdma, (uint32_t)&hdcmi->Instance->DR, Buf0, Buf1, Length) != HAL_OK)
+  {
+    hdcmi->ErrorCode = HAL_DCMI_ERROR_DMA;
+    hdcmi->State = HAL_DCMI_STATE_READY;
+    __HAL_UNLOCK(hdcmi);
+    return HAL_ERROR;
+  }
+
+  hdcmi->Instance->CR |= DCMI_CR_CAPTURE;
+
+  __HAL_UNLOCK(hdcmi);
+  return HAL_OK;
+}
 /* USER CODE END 1 */
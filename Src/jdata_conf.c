@@ -27,19 +27,64 @@
 /* Private define ------------------------------------------------------------*/
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
+/*Bump arena for JMALLOC; blocks are 8-byte aligned like malloc's. Only the
+  CPU touches it, so it sits in DTCM beside the stack rather than in AXI SRAM,
+  which the capture buffer fills*/
+__attribute__((section(".dtcm"), aligned(32))) static uint8_t jpeg_arena[JPEG_ARENA_SIZE];
+static size_t jpeg_arena_used;
+static size_t jpeg_arena_max;
+static uint32_t jpeg_arena_live;
 /* Private function prototypes -----------------------------------------------*/
 /* Private functions ---------------------------------------------------------*/
 
+/*NULL once the arena is full: the memory manager retries with less slop, then
+  fails with JERR_OUT_OF_MEMORY*/
+void *jpeg_arena_alloc (size_t size)
+{
+void *ptr;
+size = (size + 7U) & ~(size_t)7U;
+if (size > JPEG_ARENA_SIZE - jpeg_arena_used)
+{
+  return NULL;
+}
+ptr = &jpeg_arena[jpeg_arena_used];
+jpeg_arena_used += size;
+jpeg_arena_live++;
+if (jpeg_arena_used > jpeg_arena_max)
+{
+  jpeg_arena_max = jpeg_arena_used;
+}
+return ptr;
+}
+
+/*Blocks are not reused one by one; LibJPEG frees all its pools together*/
+void jpeg_arena_free (void *ptr)
+{
+if (ptr == NULL || jpeg_arena_live == 0)
+{
+  return;
+}
+if (--jpeg_arena_live == 0)
+{
+  jpeg_arena_used = 0;
+}
+}
+
+size_t jpeg_arena_peak (void)
+{
+return jpeg_arena_max;
+}
+
 size_t read_file (FIL  *file, uint8_t *buf, uint32_t sizeofbuf)
 {
-static size_t BytesReadfile ;
+static UINT BytesReadfile;
 f_read (file, buf , sizeofbuf, &BytesReadfile);
 return BytesReadfile;
 }
 
 size_t write_file (FIL  *file, uint8_t *buf, uint32_t sizeofbuf)
 {
-static size_t BytesWritefile;
+static UINT BytesWritefile;
 f_write (file, buf , sizeofbuf, &BytesWritefile);
 return BytesWritefile;
 }
@@ -0,0 +1,244 @@
+#include "main.h"
+#include "string.h"
+#define JPEG_INTERNALS
+#include "jpeg_dsp.h"
+#include "jdct.h"
+
+#define DSP_CONST_BITS  13      // as jfdctint.c
+#define DSP_PASS1_BITS  2
+#define DSP_SCALEBITS   16      // as jccolor.c
+#define DSP_ONE_HALF    ((int32_t)1 << (DSP_SCALEBITS - 1))
+
+// Two int16 lanes (lo, hi) in one word
+#define DSP_PAIR(lo, hi)  ((((uint32_t)(lo)) & 0xFFFFU) | (((uint32_t)(hi)) << 16))
+
+// The reference kernel's MULTIPLY chains, multiplied out: each output is a
+// dot product of two lane pairs with these FIX(x) sums (CONST_BITS 13)
+#define K_EVEN_A   DSP_PAIR(10703,   4433)  // c6 rotator, first output
+#define K_EVEN_B   DSP_PAIR( 4433, -10704)  // c6 rotator, second output
+#define K_ODD1_LO  DSP_PAIR(11363,   9633)
+#define K_ODD1_HI  DSP_PAIR( 6437,   2260)
+#define K_ODD3_LO  DSP_PAIR( 9633,  -2259)
+#define K_ODD3_HI  DSP_PAIR(-11362, -6436)
+#define K_ODD5_LO  DSP_PAIR( 6437, -11362)
+#define K_ODD5_HI  DSP_PAIR( 2261,   9633)
+#define K_ODD7_LO  DSP_PAIR( 2260,  -6436)
+#define K_ODD7_HI  DSP_PAIR( 9633, -11363)
+
+// Colour constants, FIX(x) at SCALEBITS 16. Those of 0.5 and above do not
+// fit a lane and are split into a shift plus a lane constant.
+#define K_Y_RB     DSP_PAIR(19595, 7471)        // 0.29900, 0.11400
+#define K_Y_G      38470                        // 0.58700
+#define K_CB_RG    DSP_PAIR(-11059, -21709)     // -0.16874, -0.33126 (+0.5 B)
+#define K_CR_GB    DSP_PAIR(-27439, -5329)      // -0.41869, -0.08131 (+0.5 R)
+#define K_CBCR_OFF (((int32_t)CENTERJSAMPLE << DSP_SCALEBITS) + DSP_ONE_HALF - 1)
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#define dsp_smlad(x, y, acc)  ((int32_t)__SMLAD((x), (y), (uint32_t)(acc)))
+#define dsp_sadd16(x, y)      __SADD16((x), (y))
+#define dsp_ssub16(x, y)      __SSUB16((x), (y))
+#define dsp_uxtb16(x)         __UXTB16(x)
+#else
+static inline int32_t dsp_smlad(uint32_t x, uint32_t y, int32_t acc)
+{
+    return acc + (int16_t)x * (int16_t)y + (int16_t)(x >> 16) * (int16_t)(y >> 16);
+}
+
+static inline uint32_t dsp_sadd16(uint32_t x, uint32_t y)
+{
+    return DSP_PAIR((int16_t)x + (int16_t)y, (int16_t)(x >> 16) + (int16_t)(y >> 16));
+}
+
+static inline uint32_t dsp_ssub16(uint32_t x, uint32_t y)
+{
+    return DSP_PAIR((int16_t)x - (int16_t)y, (int16_t)(x >> 16) - (int16_t)(y >> 16));
+}
+
+static inline uint32_t dsp_uxtb16(uint32_t x)
+{
+    return x & 0x00FF00FFU;
+}
+#endif
+
+static inline int32_t dsp_lo(uint32_t x)
+{
+    return (int16_t)x;
+}
+
+static inline int32_t dsp_hi(uint32_t x)
+{
+    return (int16_t)(x >> 16);
+}
+
+static inline uint32_t dsp_load32(const void *p)
+{
+    uint32_t w;
+    memcpy(&w, p, sizeof(w));
+    return w;
+}
+
+/* ---- Forward DCT -------------------------------------------------------- */
+
+// Divisors per quantisation table, as jcdctmgr.c computes them for ISLOW
+static DCTELEM dsp_divisors[NUM_QUANT_TBLS][DCTSIZE2];
+
+// One row or column: s01/s23 hold the sums x[i] + x[7-i] for i = 0,1 / 2,3,
+// d01/d23 the differences. Writes the eight outputs 'stride' apart after
+// rounding away 'shift' bits; out[0] and out[4] are returned unscaled.
+static inline void dsp_fdct_1d(uint32_t s01, uint32_t s23, uint32_t d01, uint32_t d23,
+                               int32_t *sum04, int32_t *dif04,
+                               int16_t *out, int stride, int shift)
+{
+    int32_t round = (int32_t)1 << (shift - 1);
+    // (tmp3, tmp2) so that one add/sub gives (tmp10, tmp11) and (tmp12, tmp13)
+    uint32_t s32 = (s23 >> 16) | (s23 << 16);
+    uint32_t even = dsp_sadd16(s01, s32);
+    uint32_t rot = dsp_ssub16(s01, s32);
+
+    *sum04 = dsp_lo(even) + dsp_hi(even);
+    *dif04 = dsp_lo(even) - dsp_hi(even);
+    out[2 * stride] = (int16_t)(dsp_smlad(rot, K_EVEN_A, round) >> shift);
+    out[6 * stride] = (int16_t)(dsp_smlad(rot, K_EVEN_B, round) >> shift);
+    out[1 * stride] = (int16_t)(dsp_smlad(d01, K_ODD1_LO, dsp_smlad(d23, K_ODD1_HI, round)) >> shift);
+    out[3 * stride] = (int16_t)(dsp_smlad(d01, K_ODD3_LO, dsp_smlad(d23, K_ODD3_HI, round)) >> shift);
+    out[5 * stride] = (int16_t)(dsp_smlad(d01, K_ODD5_LO, dsp_smlad(d23, K_ODD5_HI, round)) >> shift);
+    out[7 * stride] = (int16_t)(dsp_smlad(d01, K_ODD7_LO, dsp_smlad(d23, K_ODD7_HI, round)) >> shift);
+}
+
+// jpeg_fdct_islow on 8x8 samples into out[], unquantised. Pass 1 stores its
+// rows transposed so pass 2 reads each column as contiguous lane pairs.
+static void dsp_fdct_islow(JSAMPARRAY sample_data, JDIMENSION start_col, int16_t out[DCTSIZE2])
+{
+    int16_t ws[DCTSIZE2];
+    int32_t sum04, dif04;
+
+    // Pass 1: rows, scaled up by 2^PASS1_BITS, stored as columns of ws
+    for (int row = 0; row < DCTSIZE; row++) {
+        const JSAMPLE *p = sample_data[row] + start_col;
+        uint32_t w0 = dsp_load32(p), w1 = dsp_load32(p + 4);
+        uint32_t e02 = dsp_uxtb16(w0), e13 = dsp_uxtb16(w0 >> 8);
+        uint32_t e46 = dsp_uxtb16(w1), e57 = dsp_uxtb16(w1 >> 8);
+        uint32_t a01 = (e02 & 0xFFFFU) | (e13 << 16);          // (x0, x1)
+        uint32_t a23 = (e02 >> 16) | (e13 & 0xFFFF0000U);      // (x2, x3)
+        uint32_t b76 = (e57 >> 16) | (e46 & 0xFFFF0000U);      // (x7, x6)
+        uint32_t b54 = (e57 & 0xFFFFU) | (e46 << 16);          // (x5, x4)
+
+        dsp_fdct_1d(dsp_sadd16(a01, b76), dsp_sadd16(a23, b54),
+                    dsp_ssub16(a01, b76), dsp_ssub16(a23, b54),
+                    &sum04, &dif04, &ws[row], DCTSIZE, DSP_CONST_BITS - DSP_PASS1_BITS);
+        ws[row] = (int16_t)((sum04 - 8 * CENTERJSAMPLE) << DSP_PASS1_BITS);
+        ws[4 * DCTSIZE + row] = (int16_t)(dif04 << DSP_PASS1_BITS);
+    }
+
+    // Pass 2: columns (rows of ws), PASS1_BITS removed, left scaled by 8
+    for (int col = 0; col < DCTSIZE; col++) {
+        const int16_t *c = &ws[col * DCTSIZE];
+        uint32_t a01 = dsp_load32(c), a23 = dsp_load32(c + 2);
+        uint32_t w45 = dsp_load32(c + 4), w67 = dsp_load32(c + 6);
+        uint32_t b76 = (w67 >> 16) | (w67 << 16);
+        uint32_t b54 = (w45 >> 16) | (w45 << 16);
+        int32_t round = (int32_t)1 << (DSP_PASS1_BITS - 1);
+
+        dsp_fdct_1d(dsp_sadd16(a01, b76), dsp_sadd16(a23, b54),
+                    dsp_ssub16(a01, b76), dsp_ssub16(a23, b54),
+                    &sum04, &dif04, &out[col], DCTSIZE, DSP_CONST_BITS + DSP_PASS1_BITS);
+        out[col] = (int16_t)((sum04 + round) >> DSP_PASS1_BITS);
+        out[4 * DCTSIZE + col] = (int16_t)((dif04 + round) >> DSP_PASS1_BITS);
+    }
+}
+
+// forward_DCT of jcdctmgr.c with the DSP kernel: DCT, then quantise
+METHODDEF(void)
+dsp_forward_dct(j_compress_ptr cinfo, jpeg_component_info *compptr,
+                JSAMPARRAY sample_data, JBLOCKROW coef_blocks,
+                JDIMENSION start_row, JDIMENSION start_col, JDIMENSION num_blocks)
+{
+    const DCTELEM *divisors = dsp_divisors[compptr->quant_tbl_no];
+    int16_t ws[DCTSIZE2];
+    (void)cinfo;
+
+    sample_data += start_row;
+    for (JDIMENSION bi = 0; bi < num_blocks; bi++, start_col += DCTSIZE) {
+        JCOEFPTR outp = coef_blocks[bi];
+
+        dsp_fdct_islow(sample_data, start_col, ws);
+        for (int i = 0; i < DCTSIZE2; i++) {
+            DCTELEM q = divisors[i];
+            DCTELEM t = ws[i];
+
+            // Round half away from zero; most coefficients quantise to 0
+            if (t < 0) {
+                t = -t + (q >> 1);
+                outp[i] = (JCOEF)((t >= q) ? -(t / q) : 0);
+            } else {
+                t += q >> 1;
+                outp[i] = (JCOEF)((t >= q) ? t / q : 0);
+            }
+        }
+    }
+}
+
+/* ---- Colour conversion -------------------------------------------------- */
+
+// RGB565 scanlines (high byte first) to YCbCr, as rgb_ycc_convert in
+// jccolor.c computes it from the 5/6-bit values widened to 8 bits
+METHODDEF(void)
+dsp_rgb565_ycc_convert(j_compress_ptr cinfo, JSAMPARRAY input_buf, JSAMPIMAGE output_buf,
+                       JDIMENSION output_row, int num_rows)
+{
+    JDIMENSION width = cinfo->image_width;
+
+    while (--num_rows >= 0) {
+        const JSAMPLE *in = *input_buf++;
+        JSAMPROW y = output_buf[0][output_row];
+        JSAMPROW cb = output_buf[1][output_row];
+        JSAMPROW cr = output_buf[2][output_row];
+
+        output_row++;
+        for (JDIMENSION col = 0; col < width; col++) {
+            uint32_t px = ((uint32_t)in[0] << 8) | in[1];
+            int32_t r = (int32_t)((px >> 8) & 0xF8U);
+            int32_t g = (int32_t)((px >> 3) & 0xFCU);
+            int32_t b = (int32_t)((px << 3) & 0xF8U);
+
+            r |= r >> 5;
+            g |= g >> 6;
+            b |= b >> 5;
+            y[col] = (JSAMPLE)(dsp_smlad(DSP_PAIR(r, b), K_Y_RB, K_Y_G * g + DSP_ONE_HALF) >> DSP_SCALEBITS);
+            cb[col] = (JSAMPLE)(dsp_smlad(DSP_PAIR(r, g), K_CB_RG, (b << 15) + K_CBCR_OFF) >> DSP_SCALEBITS);
+            cr[col] = (JSAMPLE)(dsp_smlad(DSP_PAIR(g, b), K_CR_GB, (r << 15) + K_CBCR_OFF) >> DSP_SCALEBITS);
+            in += 2;
+        }
+    }
+}
+
+/* ---- Installation ------------------------------------------------------- */
+
+GLOBAL(boolean)
+jpeg_dsp_setup_compress(j_compress_ptr cinfo, boolean rgb565)
+{
+#if JPEG_DSP_DCT
+    if (cinfo->dct_method == JDCT_ISLOW) {
+        for (int ci = 0; ci < cinfo->num_components; ci++) {
+            jpeg_component_info *compptr = &cinfo->comp_info[ci];
+            JQUANT_TBL *qtbl = cinfo->quant_tbl_ptrs[compptr->quant_tbl_no];
+
+            if (compptr->DCT_h_scaled_size != DCTSIZE || compptr->DCT_v_scaled_size != DCTSIZE ||
+                qtbl == NULL) {
+                continue;
+            }
+            for (int i = 0; i < DCTSIZE2; i++) {
+                dsp_divisors[compptr->quant_tbl_no][i] = ((DCTELEM)qtbl->quantval[i]) << 3;
+            }
+            cinfo->fdct->forward_DCT[ci] = dsp_forward_dct;
+        }
+    }
+#endif
+
+    if (!rgb565 || cinfo->in_color_space != JCS_RGB || cinfo->jpeg_color_space != JCS_YCbCr ||
+        cinfo->num_components != 3) {
+        return FALSE;
+    }
+    cinfo->cconvert->color_convert = dsp_rgb565_ycc_convert;
+    return TRUE;
+}
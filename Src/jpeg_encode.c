@@ -0,0 +1,197 @@
+#include "jpeg_encode.h"
+#include "capture.h"
+#include "stdio.h"
+#include "setjmp.h"
+#include "libjpeg.h"
+#include "jerror.h"
+#include "jpeg_dsp.h"
+
+// Destination manager writing each full output buffer to the file
+typedef struct {
+    struct jpeg_destination_mgr pub;
+    FIL *file;
+    FRESULT res;        // first FatFs error, FR_OK otherwise
+    uint32_t bytes;     // bytes written so far
+} encode_dest_t;
+
+// Error manager returning to JPEG_EncodeRGB565 instead of calling exit()
+typedef struct {
+    struct jpeg_error_mgr pub;
+    jmp_buf jump;
+} encode_error_t;
+
+// Output buffer; 32-byte aligned so the SD DMA can take it without a copy
+__attribute__((aligned(32))) static uint8_t encode_out[JPEG_ENCODE_OUT_SIZE];
+
+static void encode_dest_init(j_compress_ptr cinfo)
+{
+    encode_dest_t *dest = (encode_dest_t *)cinfo->dest;
+
+    dest->pub.next_output_byte = encode_out;
+    dest->pub.free_in_buffer = sizeof(encode_out);
+}
+
+static FRESULT encode_dest_write(encode_dest_t *dest, uint32_t len)
+{
+    UINT bw = 0;
+    FRESULT res;
+
+    res = f_write(dest->file, encode_out, len, &bw);
+    if (res == FR_OK && bw != len) {
+        res = FR_DENIED;    // card full
+    }
+    dest->bytes += bw;
+    return res;
+}
+
+// Called with the buffer full, whatever free_in_buffer says
+static boolean encode_dest_empty(j_compress_ptr cinfo)
+{
+    encode_dest_t *dest = (encode_dest_t *)cinfo->dest;
+
+    dest->res = encode_dest_write(dest, sizeof(encode_out));
+    if (dest->res != FR_OK) {
+        ERREXIT(cinfo, JERR_FILE_WRITE);
+    }
+    encode_dest_init(cinfo);
+    return TRUE;
+}
+
+static void encode_dest_term(j_compress_ptr cinfo)
+{
+    encode_dest_t *dest = (encode_dest_t *)cinfo->dest;
+    uint32_t len = sizeof(encode_out) - dest->pub.free_in_buffer;
+
+    if (len > 0) {
+        dest->res = encode_dest_write(dest, len);
+        if (dest->res != FR_OK) {
+            ERREXIT(cinfo, JERR_FILE_WRITE);
+        }
+    }
+}
+
+static void encode_error_exit(j_common_ptr cinfo)
+{
+    encode_error_t *err = (encode_error_t *)cinfo->err;
+
+    longjmp(err->jump, 1);
+}
+
+// No console to print warnings on
+static void encode_output_message(j_common_ptr cinfo)
+{
+    (void)cinfo;
+}
+
+// One row of big-endian RGB565 to RGB888, low bits filled from the high ones
+static void encode_row(const uint8_t *src, JSAMPROW dst, uint32_t width)
+{
+    for (uint32_t x = 0; x < width; x++) {
+        uint32_t hi = src[0], lo = src[1];
+        uint32_t r = hi & 0xF8U;
+        uint32_t g = ((hi << 5) | (lo >> 3)) & 0xFCU;
+        uint32_t b = (lo << 3) & 0xF8U;
+
+        dst[0] = (JSAMPLE)(r | (r >> 5));
+        dst[1] = (JSAMPLE)(g | (g >> 6));
+        dst[2] = (JSAMPLE)(b | (b >> 5));
+        src += 2;
+        dst += 3;
+    }
+}
+
+FRESULT JPEG_EncodeRGB565(FIL *file, const uint8_t *pixels, uint32_t width, uint32_t height,
+                          uint32_t stride, int quality, uint32_t *bytes)
+{
+    struct jpeg_compress_struct cinfo;
+    encode_error_t jerr;
+    encode_dest_t dest;
+    JSAMPARRAY row;
+
+    dest.file = file;
+    dest.res = FR_OK;
+    dest.bytes = 0;
+    if (bytes != NULL) {
+        *bytes = 0;
+    }
+
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = encode_error_exit;
+    jerr.pub.output_message = encode_output_message;
+    if (setjmp(jerr.jump)) {
+        // Frees every pool, which resets the arena
+        jpeg_destroy_compress(&cinfo);
+        if (bytes != NULL) {
+            *bytes = dest.bytes;
+        }
+        return (dest.res != FR_OK) ? dest.res : FR_NOT_ENOUGH_CORE;
+    }
+
+    jpeg_create_compress(&cinfo);
+    dest.pub.init_destination = encode_dest_init;
+    dest.pub.empty_output_buffer = encode_dest_empty;
+    dest.pub.term_destination = encode_dest_term;
+    cinfo.dest = &dest.pub;
+
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+
+    jpeg_start_compress(&cinfo, TRUE);
+    if (jpeg_dsp_setup_compress(&cinfo, TRUE)) {
+        // Frame rows go in as they are, no RGB888 copy
+        JSAMPROW src;
+
+        while (cinfo.next_scanline < cinfo.image_height) {
+            src = (JSAMPROW)(pixels + (size_t)cinfo.next_scanline * stride * 2);
+            jpeg_write_scanlines(&cinfo, &src, 1);
+        }
+    } else {
+        row = (*cinfo.mem->alloc_sarray)((j_common_ptr)&cinfo, JPOOL_IMAGE, width * 3, 1);
+        while (cinfo.next_scanline < cinfo.image_height) {
+            encode_row(pixels + (size_t)cinfo.next_scanline * stride * 2, row[0], width);
+            jpeg_write_scanlines(&cinfo, row, 1);
+        }
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+
+    if (bytes != NULL) {
+        *bytes = dest.bytes;
+    }
+    return FR_OK;
+}
+
+FRESULT JPEG_SaveRGB565(const uint8_t *pixels, uint32_t width, uint32_t height,
+                        uint32_t stride, int quality)
+{
+    FIL file;
+    char filename[32];
+    char msg[64];
+    uint32_t id, bytes = 0;
+    FRESULT res;
+
+    res = Capture_OpenPhotoFile(&file, filename, sizeof(filename), &id);
+    if (res != FR_OK) {
+        return res;
+    }
+    res = JPEG_EncodeRGB565(&file, pixels, width, height, stride, quality, &bytes);
+    Capture_ClosePhotoFile(&file, filename, id, res == FR_OK);
+    Capture_SavePhotoIndex();
+
+    if (res == FR_OK) {
+        snprintf(msg, sizeof(msg), "Saved %lu bytes", (unsigned long)bytes);
+    } else {
+        snprintf(msg, sizeof(msg), "Encode err:%d", res);
+    }
+    Capture_ShowStatus(msg);
+    return res;
+}
+
+uint8_t JPEG_SnapshotRequested(void)
+{
+    return f_stat(JPEG_SNAPSHOT_FILE, NULL) == FR_OK;
+}
@@ -0,0 +1,88 @@
+#include "jpeg_marker.h"
+#include "string.h"
+#include "main.h"
+
+// Non-zero if any byte of w is 0xFF. Words without one (the vast majority of
+// entropy-coded data) are skipped without looking at individual bytes.
+static inline uint32_t word_has_ff(uint32_t w)
+{
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+    // UADD8 sets GE[n] when byte n carries out of +1, i.e. byte n is 0xFF;
+    // SEL turns the GE bits into a byte mask
+    (void)__UADD8(w, 0x01010101U);
+    return __SEL(0xFFFFFFFFU, 0U);
+#else
+    // Zero-byte test on ~w; may flag extra bytes, callers re-check each byte
+    uint32_t x = ~w;
+    return (x - 0x01010101U) & ~x & 0x80808080U;
+#endif
+}
+
+static inline uint32_t load_word(const uint8_t *p)
+{
+    uint32_t w;
+    memcpy(&w, p, sizeof(w));
+    return w;
+}
+
+uint32_t JPEG_FindMarker(const uint8_t *buf, uint32_t len, uint8_t marker)
+{
+    uint32_t i = 0;
+
+    if (len < 2) {
+        return len;
+    }
+
+    // Bytes up to the first word boundary
+    while (i + 1 < len && ((uintptr_t)(buf + i) & 3U) != 0U) {
+        if (buf[i] == 0xFF && buf[i + 1] == marker) return i;
+        i++;
+    }
+
+    // Whole words; the pair may end in the following word, so stop one short
+    while (i + 4 < len) {
+        if (word_has_ff(load_word(buf + i))) {
+            for (uint32_t k = 0; k < 4; k++) {
+                if (buf[i + k] == 0xFF && buf[i + k + 1] == marker) return i + k;
+            }
+        }
+        i += 4;
+    }
+
+    for (; i + 1 < len; i++) {
+        if (buf[i] == 0xFF && buf[i + 1] == marker) return i;
+    }
+    return len;
+}
+
+uint32_t JPEG_FindMarkerReverse(const uint8_t *buf, uint32_t len, uint8_t marker)
+{
+    // Candidate pair starts are [0, end)
+    uint32_t end;
+
+    if (len < 2) {
+        return len;
+    }
+    end = len - 1;
+
+    // Bytes down to a word boundary
+    while (end > 0 && ((uintptr_t)(buf + end) & 3U) != 0U) {
+        end--;
+        if (buf[end] == 0xFF && buf[end + 1] == marker) return end;
+    }
+
+    while (end >= 4) {
+        end -= 4;
+        if (word_has_ff(load_word(buf + end))) {
+            for (uint32_t k = 4; k-- > 0; ) {
+                if (buf[end + k] == 0xFF && buf[end + k + 1] == marker) return end + k;
+            }
+        }
+    }
+
+    while (end > 0) {
+        end--;
+        if (buf[end] == 0xFF && buf[end + 1] == marker) return end;
+    }
+    return len;
+}
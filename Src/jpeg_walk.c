@@ -0,0 +1,463 @@
+#include "jpeg_walk.h"
+#include "string.h"
+
+#define WALK_MAX_TABLES     2       // baseline: two DC and two AC tables
+
+typedef struct {
+    uint16_t look[256];     // next 8 bits -> (length << 8) | value, 0 if longer
+    int32_t maxcode[17];    // largest code of each length, -1 if none
+    int32_t valoffset[17];  // huffval index of a code minus the code
+    uint8_t huffval[256];
+    uint8_t defined;
+} walk_huff_t;
+
+static walk_huff_t walk_dc[WALK_MAX_TABLES];
+static walk_huff_t walk_ac[WALK_MAX_TABLES];
+
+static uint32_t walk_be16(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 8) | p[1];
+}
+
+// jdhuff.c's derived table: lookahead for codes of up to 8 bits, and the
+// per-length limits for the rest. 0 if the table is malformed: a length with
+// more codes than it has room for is refused before it reaches look[].
+static uint8_t walk_make_huff(walk_huff_t *h, const uint8_t *bits, const uint8_t *vals, uint32_t n)
+{
+    uint32_t code = 0, p = 0;
+
+    memset(h->look, 0, sizeof(h->look));
+    memcpy(h->huffval, vals, n);
+    for (uint32_t l = 1; l <= 16; l++) {
+        h->valoffset[l] = (int32_t)p - (int32_t)code;
+        for (uint32_t i = 0; i < bits[l - 1]; i++, p++, code++) {
+            if (code >= (1U << l)) {
+                return 0;
+            }
+            if (l <= 8) {
+                uint32_t first = code << (8 - l);
+
+                for (uint32_t x = 0; x < (1U << (8 - l)); x++) {
+                    h->look[first + x] = (uint16_t)((l << 8) | vals[p]);
+                }
+            }
+        }
+        h->maxcode[l] = bits[l - 1] ? (int32_t)code - 1 : -1;
+        code <<= 1;
+    }
+    h->defined = 1;
+    return 1;
+}
+
+// Read more of the file once fewer than two bytes are left, keeping those:
+// a 0xFF is only told from a marker by the byte after it
+static void walk_more(JPEG_WalkTypeDef *w)
+{
+    uint8_t *buf = (uint8_t *)w->data;
+    uint32_t keep, n;
+
+    if (w->read == NULL || w->len - w->pos >= 2U) {
+        return;
+    }
+    keep = w->len - w->pos;
+    memmove(buf, &buf[w->pos], keep);
+    n = w->read(w->read_arg, &buf[keep], w->size - keep);
+    w->pos = 0;
+    w->len = keep + n;
+    if (n == 0) {
+        w->read = NULL;
+    }
+}
+
+// Top up to at least 25 bits. A marker ends the data: zeros follow, as
+// LibJPEG inserts at a premature end.
+static void walk_fill(JPEG_WalkTypeDef *w)
+{
+    while (w->bits <= 24) {
+        uint32_t byte = 0;
+
+        walk_more(w);
+        if (w->pos < w->len) {
+            byte = w->data[w->pos];
+            if (byte != 0xFF) {
+                w->pos++;
+            } else if (w->pos + 1 < w->len && w->data[w->pos + 1] == 0x00) {
+                w->pos += 2;
+            } else {
+                byte = 0;
+                w->zeros++;
+            }
+        } else {
+            w->zeros++;
+        }
+        w->acc = (w->acc << 8) | byte;
+        w->bits += 8;
+    }
+}
+
+// Whether bits past the end of the data were used: the file is truncated, or
+// the data is corrupt and no longer in step with it
+static uint8_t walk_overrun(const JPEG_WalkTypeDef *w)
+{
+    return (int64_t)w->zeros * 8 > w->bits;
+}
+
+static uint32_t walk_get(JPEG_WalkTypeDef *w, uint32_t n)
+{
+    if (w->bits < (int32_t)n) {
+        walk_fill(w);
+    }
+    w->bits -= (int32_t)n;
+    return (w->acc >> w->bits) & ((1U << n) - 1U);
+}
+
+// Next Huffman symbol, -1 for a code the table does not have
+static int32_t walk_decode(JPEG_WalkTypeDef *w, const walk_huff_t *h)
+{
+    uint32_t look;
+
+    if (w->bits < 16) {
+        walk_fill(w);
+    }
+    look = h->look[(w->acc >> (w->bits - 8)) & 0xFFU];
+    if (look != 0) {
+        w->bits -= (int32_t)(look >> 8);
+        return (int32_t)(look & 0xFFU);
+    }
+    for (uint32_t l = 9; l <= 16; l++) {
+        int32_t code = (int32_t)((w->acc >> (w->bits - (int32_t)l)) & ((1U << l) - 1U));
+
+        if (code <= h->maxcode[l]) {
+            w->bits -= (int32_t)l;
+            return h->huffval[(code + h->valoffset[l]) & 0xFF];
+        }
+    }
+    return -1;
+}
+
+// 's' bits of a coefficient as a signed value (JPEG F.2.2.1 EXTEND)
+static int32_t walk_extend(JPEG_WalkTypeDef *w, uint32_t s)
+{
+    int32_t v;
+
+    if (s == 0) {
+        return 0;
+    }
+    v = (int32_t)walk_get(w, s);
+    return (v < (1 << (s - 1))) ? v - (1 << s) + 1 : v;
+}
+
+// One block; coefficients 0, 1, 8 and 9 (zig-zag 0, 1, 2 and 4) into c[],
+// DC with its prediction. 0 on a bad code.
+static uint8_t walk_block(JPEG_WalkTypeDef *w, const walk_huff_t *dc, const walk_huff_t *ac,
+                          int32_t *pred, int32_t *c)
+{
+    int32_t s = walk_decode(w, dc);
+
+    if (s < 0 || s > 15) {
+        return 0;
+    }
+    *pred += walk_extend(w, (uint32_t)s);
+    if (*pred < -32768 || *pred > 32767) {
+        return 0;   // out of JCOEF range: corrupt differences adding up
+    }
+    c[0] = *pred;
+    c[1] = c[2] = c[3] = 0;
+    for (uint32_t k = 1; k < 64; k++) {
+        int32_t rs = walk_decode(w, ac);
+        uint32_t r, size;
+
+        if (rs < 0) {
+            return 0;
+        }
+        r = (uint32_t)rs >> 4;
+        size = (uint32_t)rs & 15U;
+        if (size == 0) {
+            if (r != 15) {
+                break;      // EOB
+            }
+            k += 15;
+            continue;
+        }
+        k += r;
+        if (k >= 64) {
+            return 0;
+        }
+        if (k <= 4 && k != 3) {
+            c[k == 4 ? 3 : k] = walk_extend(w, size);
+        } else {
+            (void)walk_get(w, size);
+        }
+    }
+    return 1;
+}
+
+// Headers up to the first SOS, from data[pos]
+static uint8_t walk_headers(JPEG_WalkTypeDef *w)
+{
+    const uint8_t *jpeg = w->data;
+    uint32_t len = w->len, pos = 2, ncomp = 0, nscan, qdefined = 0;
+
+    if (len < 4 || jpeg[0] != 0xFF || jpeg[1] != 0xD8) {
+        return 0;
+    }
+    for (uint32_t t = 0; t < WALK_MAX_TABLES; t++) {
+        walk_dc[t].defined = walk_ac[t].defined = 0;
+    }
+    w->hmax = w->vmax = 1;
+    w->restart = 0;
+
+    for (;;) {
+        uint32_t marker, seg;
+        const uint8_t *p;
+
+        if (pos >= len || jpeg[pos] != 0xFF) {
+            return 0;
+        }
+        while (pos < len && jpeg[pos] == 0xFF) {
+            pos++;
+        }
+        if (pos + 2 >= len) {
+            return 0;
+        }
+        marker = jpeg[pos++];
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) {
+            continue;
+        }
+        seg = walk_be16(&jpeg[pos]);
+        if (marker == 0xD9 || seg < 2 || pos + seg > len) {
+            return 0;
+        }
+        p = &jpeg[pos + 2];
+        seg -= 2;
+        pos += seg + 2;
+
+        if (marker == 0xDB) {
+            // DQT: the coefficients the IDCTs need, in zig-zag order.
+            // 8-bit baseline has 8-bit quantizers, which keeps the IDCTs'
+            // products within 32 bits.
+            while (seg >= 65) {
+                uint32_t pq = p[0] >> 4, tq = p[0] & 15U;
+
+                if (pq != 0 || tq > 3) {
+                    return 0;
+                }
+                for (uint32_t i = 0; i < 4; i++) {
+                    static const uint8_t zz[4] = { 0, 1, 2, 4 };
+                    w->q[tq][i] = p[1 + zz[i]];
+                }
+                qdefined |= 1U << tq;
+                p += 65;
+                seg -= 65;
+            }
+        } else if (marker == 0xC4) {
+            while (seg >= 17) {
+                uint32_t tc = p[0] >> 4, th = p[0] & 15U, n = 0;
+
+                for (uint32_t i = 1; i <= 16; i++) {
+                    n += p[i];
+                }
+                if (tc > 1 || th >= WALK_MAX_TABLES || n > 256 || seg < 17 + n ||
+                    !walk_make_huff(tc ? &walk_ac[th] : &walk_dc[th], &p[1], &p[17], n)) {
+                    return 0;
+                }
+                p += 17 + n;
+                seg -= 17 + n;
+            }
+        } else if (marker == 0xC0 || marker == 0xC1) {
+            if (seg < 6 || p[0] != 8) {
+                return 0;
+            }
+            w->height = walk_be16(&p[1]);
+            w->width = walk_be16(&p[3]);
+            ncomp = p[5];
+            if (ncomp == 0 || ncomp > JPEG_WALK_MAX_COMPS || seg < 6 + 3 * ncomp) {
+                return 0;
+            }
+            for (uint32_t i = 0; i < ncomp; i++) {
+                JPEG_WalkCompTypeDef *c = &w->comp[i];
+
+                c->id = p[6 + 3 * i];
+                c->h = p[7 + 3 * i] >> 4;
+                c->v = p[7 + 3 * i] & 15U;
+                c->tq = p[8 + 3 * i] & 3U;
+                if (c->h == 0 || c->v == 0) {
+                    return 0;
+                }
+                w->hmax = (c->h > w->hmax) ? c->h : w->hmax;
+                w->vmax = (c->v > w->vmax) ? c->v : w->vmax;
+            }
+        } else if (marker >= 0xC2 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 &&
+                   marker != 0xCC) {
+            return 0;   // progressive, lossless or arithmetic coded
+        } else if (marker == 0xDD) {
+            if (seg < 2) {
+                return 0;
+            }
+            w->restart = walk_be16(p);
+        } else if (marker == 0xDA) {
+            if (ncomp == 0 || seg < 1) {
+                return 0;
+            }
+            nscan = p[0];
+            // One interleaved scan of every component
+            if (nscan != ncomp || seg < 1 + 2 * nscan) {
+                return 0;
+            }
+            for (uint32_t i = 0; i < nscan; i++) {
+                JPEG_WalkCompTypeDef *c = NULL;
+
+                for (uint32_t j = 0; j < ncomp; j++) {
+                    if (w->comp[j].id == p[1 + 2 * i]) {
+                        c = &w->comp[j];
+                        w->scan[i] = (uint8_t)j;
+                    }
+                }
+                if (c == NULL) {
+                    return 0;
+                }
+                c->td = p[2 + 2 * i] >> 4;
+                c->ta = p[2 + 2 * i] & 15U;
+                if (c->td >= WALK_MAX_TABLES || c->ta >= WALK_MAX_TABLES ||
+                    !walk_dc[c->td].defined || !walk_ac[c->ta].defined ||
+                    !(qdefined & (1U << c->tq))) {
+                    return 0;
+                }
+            }
+            break;
+        }
+    }
+
+    // A grayscale scan is not interleaved: one block per MCU, whatever the
+    // sampling factors say. Otherwise the luma must be the full-resolution
+    // component, as LibJPEG takes it without upsampling.
+    w->ncomp = ncomp;
+    if (ncomp == 1) {
+        w->comp[0].h = w->comp[0].v = 1;
+        w->hmax = w->vmax = 1;
+    }
+    if (w->comp[0].h != w->hmax || w->comp[0].v != w->vmax ||
+        w->hmax > JPEG_WALK_MAX_SAMP || w->vmax > JPEG_WALK_MAX_SAMP ||
+        w->width == 0 || w->height == 0) {
+        return 0;
+    }
+    w->mcus_x = (w->width + 8U * w->hmax - 1U) / (8U * w->hmax);
+    w->mcus_y = (w->height + 8U * w->vmax - 1U) / (8U * w->vmax);
+    w->mcu_row = 0;
+
+    w->pos = pos;
+    w->acc = 0;
+    w->bits = 0;
+    w->zeros = 0;
+    w->left = w->restart;
+    memset(w->pred, 0, sizeof(w->pred));
+    return 1;
+}
+
+uint8_t JPEG_WalkStart(JPEG_WalkTypeDef *w, const uint8_t *jpeg, uint32_t len)
+{
+    w->data = jpeg;
+    w->len = len;
+    w->read = NULL;
+    return walk_headers(w);
+}
+
+uint8_t JPEG_WalkStartRead(JPEG_WalkTypeDef *w, uint8_t *buf, uint32_t size,
+                           JPEG_WalkReadFn read, void *arg)
+{
+    w->data = buf;
+    w->len = read(arg, buf, size);
+    w->read = (w->len == size) ? read : NULL;
+    w->read_arg = arg;
+    w->size = size;
+    return walk_headers(w);
+}
+
+uint8_t JPEG_WalkRow(JPEG_WalkTypeDef *w, JPEG_WalkBlockFn block, void *arg)
+{
+    if (w->mcu_row >= w->mcus_y) {
+        return 0;
+    }
+    for (uint32_t mx = 0; mx < w->mcus_x; mx++) {
+        if (w->restart != 0 && w->left-- == 0) {
+            // Byte-aligned RSTn: drop what is buffered and skip it
+            if (walk_overrun(w)) {
+                return 0;
+            }
+            w->acc = 0;
+            w->bits = 0;
+            w->zeros = 0;
+            walk_more(w);
+            while (w->pos + 2 < w->len && w->data[w->pos] == 0xFF && w->data[w->pos + 1] == 0xFF) {
+                w->pos++;
+                walk_more(w);
+            }
+            if (w->pos + 1 < w->len && w->data[w->pos] == 0xFF &&
+                (w->data[w->pos + 1] & 0xF8U) == 0xD0) {
+                w->pos += 2;
+            }
+            memset(w->pred, 0, sizeof(w->pred));
+            w->left = w->restart - 1U;
+        }
+        for (uint32_t i = 0; i < w->ncomp; i++) {
+            uint32_t ci = w->scan[i];
+            const JPEG_WalkCompTypeDef *c = &w->comp[ci];
+            const uint16_t *q = w->q[c->tq];
+
+            for (uint32_t by = 0; by < c->v; by++) {
+                for (uint32_t bx = 0; bx < c->h; bx++) {
+                    int32_t coef[4];
+
+                    if (!walk_block(w, &walk_dc[c->td], &walk_ac[c->ta], &w->pred[ci], coef)) {
+                        return 0;
+                    }
+                    coef[0] *= q[0];
+                    coef[1] *= q[1];
+                    coef[2] *= q[2];
+                    coef[3] *= q[3];
+                    block(arg, ci, mx * c->h + bx, by, coef);
+                }
+            }
+        }
+    }
+    w->mcu_row++;
+    return !walk_overrun(w);
+}
+
+// IDCT_range_limit() of jdmaster.c, indexed as the IDCTs do
+static uint8_t walk_limit(int32_t x)
+{
+    uint32_t i = (uint32_t)x & 1023U;
+
+    if (i < 128U) {
+        return (uint8_t)(i + 128U);
+    }
+    if (i < 512U) {
+        return 255;
+    }
+    return (i < 896U) ? 0 : (uint8_t)(i - 896U);
+}
+
+void JPEG_WalkIDCT(const int32_t *coef, uint32_t w, uint32_t h, uint8_t *out, uint32_t stride)
+{
+    // jpeg_idct_2x2; the smaller ones are the same sums without the
+    // coefficients they do not read
+    int32_t c1 = (w > 1) ? coef[1] : 0;
+    int32_t c8 = (h > 1) ? coef[2] : 0;
+    int32_t c9 = (w > 1 && h > 1) ? coef[3] : 0;
+    int32_t tmp0 = coef[0] + 4 + c8;
+    int32_t tmp2 = coef[0] + 4 - c8;
+    int32_t tmp1 = c1 + c9;
+    int32_t tmp3 = c1 - c9;
+
+    out[0] = walk_limit((tmp0 + tmp1) >> 3);
+    if (w > 1) {
+        out[1] = walk_limit((tmp0 - tmp1) >> 3);
+    }
+    if (h > 1) {
+        out[stride] = walk_limit((tmp2 + tmp3) >> 3);
+        if (w > 1) {
+            out[stride + 1] = walk_limit((tmp2 - tmp3) >> 3);
+        }
+    }
+}
@@ -23,6 +23,7 @@
 #include "fatfs.h"
 #include "i2c.h"
 #include "libjpeg.h"
+#include "lptim.h"
 #include "sdmmc.h"
 #include "spi.h"
 #include "tim.h"
@@ -33,17 +34,29 @@
 #include "camera.h"
 #include "capture.h"
 #include "lcd.h"
+#include "preview.h"
+#include "burst.h"
+#include "metrics.h"
+#include "review.h"
+#include "jpeg_encode.h"
+#include "sd_bench.h"
+#include "capture_profile.h"
+#include "ae_awb.h"
+#include "motion.h"
+#include "timelapse.h"
 
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
 /* USER CODE BEGIN PTD */
-#define PREVIEW_WIDTH  160
-#define PREVIEW_HEIGHT 120
+
 /* USER CODE END PTD */
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
+#define KEY_BURST_HOLD_MS  800   // K1 held this long starts a burst instead of a single shot
+#define KEY_DOUBLE_MS      250   // second K1 press this soon after a shot's release: next capture profile (0: off)
+#define KEY_PRESSED        GPIO_PIN_SET  // K1 pulls PC13 up against its pull-down
 
 /* USER CODE END PD */
 
@@ -64,8 +77,13 @@ FRESULT res;
 
 uint32_t photo_id = 0;
 
-
-uint16_t pic[PREVIEW_HEIGHT][PREVIEW_WIDTH];
+static uint16_t *lcd_frame;              // preview frame being sent to the LCD
+static uint32_t lcd_frame_seq;           // its metrics frame number
+static uint8_t lcd_overlay_pending = 0;  // FPS text due once lcd_frame has landed
+static uint8_t lcd_review = 0;           // a new photo is on the LCD instead of the preview
+static uint32_t lcd_review_tick;
+static uint8_t motion_pending = 0;       // motion seen, capture once idle
+static uint8_t key_snapshot = 0;         // SNAPSHOT.ON: K1 saves the preview frame
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -191,23 +209,24 @@ static void Camera_SetMode(cam_mode_t mode)
     __HAL_DCMI_CLEAR_FLAG(&hdcmi, DCMI_IT_FRAME | DCMI_IT_OVR | DCMI_IT_ERR | DCMI_IT_LINE | DCMI_IT_VSYNC);
     __HAL_DCMI_ENABLE_IT(&hdcmi, DCMI_IT_FRAME | DCMI_IT_VSYNC);
 
+    Metrics_SetKind(mode == CAM_MODE_PREVIEW ? METRICS_FRAME_PREVIEW : METRICS_FRAME_JPEG);
+
     if (mode == CAM_MODE_PREVIEW) {
         DCMI_SetJPEGMode(DCMI_JPEG_DISABLE);
         hdcmi.Instance->CR &= ~DCMI_CR_JPEG;
         DCMI_ReinitDMAMode(DMA_CIRCULAR);
 
-        Camera_Init_Device(&hi2c1, FRAMESIZE_QQVGA);
-        HAL_Delay(80);
+        // Coming back from JPEG only rewrites the registers it changed;
+        // the driver waits for the sensor itself
+        Camera_Init_Device(&hi2c1, PREVIEW_FRAMESIZE);
+        AeAwb_Start();
+        Motion_Start();
 
         DCMI_FrameIsReady = 0;
-        uint32_t buf_bytes = PREVIEW_WIDTH * PREVIEW_HEIGHT * sizeof(uint16_t);
-        uint32_t length_words = (buf_bytes + 3) / 4;
-    #if defined(SCB_CleanDCache_by_Addr)
-        SCB_CleanDCache_by_Addr((uint32_t*)pic, buf_bytes);
-        SCB_InvalidateDCache_by_Addr((uint32_t*)pic, buf_bytes);
-    #endif
-        HAL_DCMI_Start_DMA(&hdcmi, DCMI_MODE_CONTINUOUS, (uint32_t)pic, length_words);
+        Preview_Start(&hdcmi);
     } else {
+        // JPEG data must arrive whole: no crop, every byte and line
+        Preview_ReleaseDCMI(&hdcmi);
         DCMI_SetJPEGMode(DCMI_JPEG_ENABLE);
         hdcmi.Instance->CR |= DCMI_CR_JPEG;
         DCMI_ReinitDMAMode(DMA_NORMAL);
@@ -215,6 +234,13 @@ static void Camera_SetMode(cam_mode_t mode)
 }
 
 
+// SPI DMA done: the LCD no longer reads the frame
+static void Preview_LCDXferCplt(void)
+{
+    Metrics_Stamp(lcd_frame_seq, METRICS_DISPLAY_DONE);
+    Preview_ReleaseFrame(lcd_frame);
+}
+
 void Camera_StartPreview(void)
 {
     Camera_SetMode(CAM_MODE_PREVIEW);
@@ -223,11 +249,51 @@ void Camera_StartPreview(void)
 void Camera_CaptureJPEG(void)
 {
     Camera_SetMode(CAM_MODE_JPEG);
-    take_A_Picture(&hdcmi); // saves JPEG to SD
-    // Return to preview automatically
+    // The capture runs on from the main loop, which returns to preview
+    // once it is done
+    if (!Capture_Start(&hdcmi)) {
+        Camera_SetMode(CAM_MODE_PREVIEW);
+    }
+}
+
+void Camera_BurstJPEG(void)
+{
+    Camera_SetMode(CAM_MODE_JPEG);
+    Burst_Capture(&hdcmi, BURST_FRAMES); // queued frames drain to SD
     Camera_SetMode(CAM_MODE_PREVIEW);
 }
 
+void Camera_BestJPEG(void)
+{
+    Camera_SetMode(CAM_MODE_JPEG);
+    Burst_CaptureBest(&hdcmi, Burst_Best()); // only the sharpest is written
+    Camera_SetMode(CAM_MODE_PREVIEW);
+}
+
+void Camera_SnapshotJPEG(void)
+{
+    uint16_t *frame = NULL;
+    uint32_t start;
+
+    // Only one frame may be held: wait for the LCD to give its back, then
+    // take the next one the preview completes
+    while (LCD_IsBusy())
+    {
+    }
+    start = HAL_GetTick();
+    while ((frame = Preview_AcquireFrame()) == NULL && HAL_GetTick() - start < 200)
+    {
+    }
+    if (frame == NULL)
+    {
+        Capture_ShowStatus("No preview");
+        return;
+    }
+    JPEG_SaveRGB565((const uint8_t *)frame, PREVIEW_WIDTH, PREVIEW_HEIGHT, PREVIEW_WIDTH,
+                    JPEG_ENCODE_QUALITY);
+    Preview_ReleaseFrame(frame);
+}
+
 /* USER CODE END 0 */
 
 /**
@@ -259,7 +325,12 @@ int main(void)
   SystemClock_Config();
 
   /* USER CODE BEGIN SysInit */
-
+  /* DWT cycle counter timestamps every frame */
+  Metrics_Init();
+  /* D2 SRAM holds the preview frame pool */
+  __HAL_RCC_D2SRAM1_CLK_ENABLE();
+  __HAL_RCC_D2SRAM2_CLK_ENABLE();
+  __HAL_RCC_D2SRAM3_CLK_ENABLE();
   /* USER CODE END SysInit */
 
   /* Initialize all configured peripherals */
@@ -269,6 +340,7 @@ int main(void)
   MX_I2C1_Init();
   MX_SPI4_Init();
   MX_TIM1_Init();
+  MX_LPTIM1_Init();
   MX_SDMMC1_SD_Init();
   MX_FATFS_Init();
 
@@ -302,6 +374,26 @@ int main(void)
   }
 
   res = f_mount(&SDFatFS, SDPath, 4);
+  if (res == FR_OK)
+  {
+    // Pick up the next photo ID now rather than on the first shutter press
+    Capture_InitPhotoId();
+    // CAPTURE.CFG on the card: profile definitions and the one to start in
+    CaptureProfile_Load(CAPTURE_PROFILE_FILE);
+    // MOTION.ON on the card: unattended, photos are taken on motion
+    Motion_Arm(Motion_Requested());
+    // TIMELAPS.ON on the card: a photo every N seconds, asleep in between
+    Timelapse_Arm(Timelapse_Requested());
+    // BESTOF.ON on the card: K1 keeps the sharpest of several frames
+    Burst_SetBest(Burst_BestRequested());
+    // SNAPSHOT.ON on the card: K1 saves the preview frame as it is shown
+    key_snapshot = JPEG_SnapshotRequested();
+    // SDBENCH.RUN on the card: characterise it before the camera starts
+    if (SDBench_Requested())
+    {
+      SDBench_Run(SD_BENCH_REPORT);
+    }
+  }
 HAL_Delay(100);
   //	HAL_TIM_PWM_Start(&htim1,TIM_CHANNEL_1);
   //	HAL_Delay(10);
@@ -314,27 +406,139 @@ HAL_Delay(100);
 //
   /* Infinite loop */
   /* USER CODE BEGIN WHILE */
-  uint8_t key_prev = GPIO_PIN_SET;
+  // K1 may still be down from the press that started the camera: that one
+  // takes no picture
+  uint8_t key_prev = HAL_GPIO_ReadPin(KEY_GPIO_Port, KEY_Pin);
+  uint32_t key_down_tick = 0;
+  uint8_t key_handled = 1;
+  uint8_t key_shot_taken = 0;
+  uint32_t key_up_tick = 0;
   while (1)
   {
-     // Continuous preview update
-    if (DCMI_FrameIsReady)
+     // Continuous preview: the newest complete frame goes out by SPI DMA
+     // while the loop carries on; the FPS text is drawn once it has landed
+    if (lcd_review && HAL_GetTick() - lcd_review_tick >= REVIEW_HOLD_MS)
     {
-        DCMI_FrameIsReady = 0;
-        ST7735_FillRGBRect(&st7735_pObj, 0, 0, (uint8_t *)&pic[20][0], ST7735Ctx.Width, 80);
-        sprintf((char *)text, "%luFPS", Camera_FPS);
-        LCD_ShowString(5, 5, 60, 16, 12, text);
+        lcd_review = 0;
+    }
+    if (!LCD_IsBusy() && !lcd_review)
+    {
+        if (lcd_overlay_pending)
+        {
+            lcd_overlay_pending = 0;
+            sprintf((char *)text, "%luFPS", Camera_FPS);
+            LCD_ShowString(5, 5, 60, 16, 12, text);
+        }
+
+        uint16_t *frame = Preview_AcquireFrame();
+        if (frame != NULL)
+        {
+            lcd_frame = frame;
+            lcd_frame_seq = Preview_FrameSeq(frame);
+            lcd_overlay_pending = 1;
+            Metrics_Stamp(lcd_frame_seq, METRICS_DISPLAY_START);
+            LCD_FillRGBRect_DMA(0, 0, (uint8_t *)frame, PREVIEW_WIDTH, PREVIEW_HEIGHT,
+                                Preview_LCDXferCplt);
+            // Statistics are read while SPI DMA sends the same frame
+            AeAwb_Process(frame);
+            if (Motion_Process(frame))
+            {
+                motion_pending = 1;
+            }
+        }
     }
 
-    // Edge-detect K1 press to avoid blocking the preview loop
-    uint8_t key_now = HAL_GPIO_ReadPin(KEY_GPIO_Port, KEY_Pin);
-    if (key_prev == GPIO_PIN_SET && key_now == GPIO_PIN_RESET)
+    // Capture in flight: advance it on the DCMI events seen so far, and go
+    // back to preview once it has finished
+    uint8_t capture_idle = (Capture_GetState() == CAPTURE_STATE_IDLE);
+    if (!capture_idle && !Capture_Process())
+    {
+        // Show the new photo while the sensor goes back to preview; in
+        // timelapse the sensor stays in JPEG for the next wake instead
+        if (Timelapse_Armed())
+        {
+            Timelapse_ShotDone(Capture_LastResult());
+        }
+        else if (Capture_LastResult() && Review_ShowLastCapture())
+        {
+            lcd_review = 1;
+            lcd_review_tick = HAL_GetTick();
+        }
+#if METRICS_LOG_TO_CARD
+        Metrics_DumpCSV(METRICS_CSV_FILE, NULL);
+        Metrics_SaveHistograms(METRICS_HIST_FILE);
+#endif
+        if (!Timelapse_Armed())
+        {
+            Camera_SetMode(CAM_MODE_PREVIEW);
+        }
+    }
+
+    // Timelapse: sleep until the next photo is due, then take it
+    if (Timelapse_Armed() && Capture_GetState() == CAPTURE_STATE_IDLE)
     {
+        Timelapse_Sleep();
         Camera_CaptureJPEG();
-        HAL_Delay(300); // Allow SD write to finish or sensor to stabilize
-        Camera_StartPreview();
+        continue;
+    }
+
+    // Frame records go out over SWO while a debugger is listening
+    Metrics_DumpSWO(1);
+
+    // K1: a short press takes one picture on release (the sharpest of a few
+    // with BESTOF.ON, the preview frame with SNAPSHOT.ON) and holding it
+    // starts a burst instead. A second press
+    // within KEY_DOUBLE_MS of that release steps to the next capture profile
+    // for the photos after it, so the shot itself never waits to rule it
+    // out. Edges are detected so the preview loop never blocks on the key.
+    // No shot or burst is started while a capture is in flight.
+    uint8_t key_now = HAL_GPIO_ReadPin(KEY_GPIO_Port, KEY_Pin);
+    if (key_prev != KEY_PRESSED && key_now == KEY_PRESSED)
+    {
+        key_handled = 0;
+        if (key_shot_taken && HAL_GetTick() - key_up_tick < KEY_DOUBLE_MS)
+        {
+            const CaptureProfile_TypeDef *profile = CaptureProfile_Next();
+
+            key_handled = 1;
+            sprintf((char *)text, "Profile %s", profile->name);
+            Capture_ShowStatus((char *)text);
+        }
+        key_shot_taken = 0;
+        key_down_tick = HAL_GetTick();
+    }
+    else if (capture_idle && key_now == KEY_PRESSED && !key_handled &&
+             HAL_GetTick() - key_down_tick >= KEY_BURST_HOLD_MS)
+    {
+        key_handled = 1;
+        Camera_BurstJPEG();
+    }
+    else if (capture_idle && key_prev == KEY_PRESSED && key_now != KEY_PRESSED && !key_handled)
+    {
+        key_up_tick = HAL_GetTick();
+        key_shot_taken = 1;
+        if (key_snapshot)
+        {
+            Camera_SnapshotJPEG();
+        }
+        else if (Burst_Best())
+        {
+            Camera_BestJPEG();
+        }
+        else
+        {
+            Camera_CaptureJPEG();
+        }
     }
     key_prev = key_now;
+
+    // Not capture_idle: K1 may have started a capture since it was sampled
+    if (motion_pending && Capture_GetState() == CAPTURE_STATE_IDLE)
+    {
+        motion_pending = 0;
+        Capture_ShowStatus("Motion");
+        Camera_CaptureJPEG();
+    }
   }
 }
 /**
@@ -401,6 +605,8 @@ void SystemClock_Config(void)
 /* USER CODE BEGIN 4 */
 void HAL_DCMI_FrameEventCallback(DCMI_HandleTypeDef *hdcmi)
 {
+	Metrics_FrameEvent();
+	Burst_FrameEvent(hdcmi);
 	static uint32_t count = 0,tick = 0;
 	   DCMI_CallbackCount++;  // Increment each time callback is called
 	if(HAL_GetTick() - tick >= 1000)
@@ -416,6 +622,7 @@ void HAL_DCMI_FrameEventCallback(DCMI_HandleTypeDef *hdcmi)
 }
 void HAL_DCMI_VsyncEventCallback(DCMI_HandleTypeDef *hdcmi)
 {
+    Metrics_VsyncEvent();
     DCMI_VsyncFlag = 1;
     DCMI_CallbackCount++;
 }
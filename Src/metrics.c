@@ -0,0 +1,293 @@
+#include "metrics.h"
+#include "stdio.h"
+#include "string.h"
+
+#define METRICS_RING_MASK  (METRICS_RING_LEN - 1)
+
+// Frame records, indexed by frame number. Each stage is stamped by the one
+// context that owns it (DCMI/DMA/SPI interrupts or the main loop), so no lock
+// is needed: a record is invalidated (seq = 0) while VSYNC resets it, and the
+// reader checks seq again after copying one out.
+static Metrics_FrameTypeDef metrics_ring[METRICS_RING_LEN];
+static volatile uint32_t metrics_seq;       // newest frame opened by VSYNC
+static volatile uint32_t metrics_done;      // newest frame completed
+static uint32_t metrics_read = 1;           // next frame to dump
+static uint32_t metrics_lost;
+static volatile uint32_t metrics_kind = METRICS_FRAME_PREVIEW;
+static volatile uint32_t metrics_hist[METRICS_NUM_HIST][METRICS_HIST_BINS];
+
+static const char *const metrics_kind_name[] = { "preview", "jpeg" };
+
+void Metrics_Init(void)
+{
+    if ((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) == 0U) {
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->LAR = 0xC5ACCE55U;
+        DWT->CYCCNT = 0;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    }
+}
+
+uint32_t Metrics_Now(void)
+{
+    uint32_t t = DWT->CYCCNT;
+    return t ? t : 1U;
+}
+
+void Metrics_SetKind(uint32_t kind)
+{
+    metrics_kind = kind;
+}
+
+void Metrics_VsyncEvent(void)
+{
+    uint32_t seq = metrics_seq + 1;
+    Metrics_FrameTypeDef *rec = &metrics_ring[seq & METRICS_RING_MASK];
+    uint32_t now = Metrics_Now();
+
+    rec->seq = 0;
+    __DMB();
+    memset(rec->t, 0, sizeof(rec->t));
+    rec->kind = metrics_kind;
+    rec->bytes = 0;
+    rec->energy_uj = 0;
+    rec->t[METRICS_VSYNC] = now;
+    __DMB();
+    rec->seq = seq;
+    metrics_seq = seq;
+}
+
+uint32_t Metrics_CurrentFrame(void)
+{
+    uint32_t seq = metrics_seq;
+    uint32_t guard = (SystemCoreClock / 1000000U) * METRICS_VSYNC_GUARD_US;
+
+    // The edge ending a frame can be handled just before its frame-complete
+    if (seq > 1 && Metrics_Now() - metrics_ring[seq & METRICS_RING_MASK].t[METRICS_VSYNC] < guard) {
+        seq--;
+    }
+    return seq;
+}
+
+uint32_t Metrics_FrameEvent(void)
+{
+    uint32_t seq = Metrics_CurrentFrame();
+
+    Metrics_Stamp(seq, METRICS_FRAME_DONE);
+    metrics_done = seq;
+    return seq;
+}
+
+uint32_t Metrics_LastFrame(void)
+{
+    return metrics_done;
+}
+
+// Bucket 0 is [0,1) ms, bucket n is [2^(n-1), 2^n) ms
+static void metrics_hist_add(uint32_t which, uint32_t cycles)
+{
+    uint32_t ms = cycles / (SystemCoreClock / 1000U);
+    uint32_t bin = ms ? 32U - __CLZ(ms) : 0U;
+
+    if (bin >= METRICS_HIST_BINS) {
+        bin = METRICS_HIST_BINS - 1;
+    }
+    metrics_hist[which][bin]++;
+}
+
+void Metrics_StampAt(uint32_t seq, uint32_t stage, uint32_t cycles)
+{
+    Metrics_FrameTypeDef *rec = &metrics_ring[seq & METRICS_RING_MASK];
+
+    if (seq == 0 || stage >= METRICS_NUM_STAMPS || rec->seq != seq) {
+        return;
+    }
+    rec->t[stage] = cycles ? cycles : 1U;
+
+    if (stage == METRICS_DISPLAY_DONE && rec->t[METRICS_VSYNC]) {
+        metrics_hist_add(METRICS_HIST_SENSOR_TO_GLASS, cycles - rec->t[METRICS_VSYNC]);
+    } else if (stage == METRICS_SD_DONE && rec->t[METRICS_SHUTTER]) {
+        metrics_hist_add(METRICS_HIST_SHUTTER_TO_FILE, cycles - rec->t[METRICS_SHUTTER]);
+    }
+    // The wake time is only known to belong to a frame once it is saved, so
+    // it usually lands after SD_DONE
+    if (stage == METRICS_WAKE && rec->t[METRICS_SD_DONE]) {
+        metrics_hist_add(METRICS_HIST_WAKE_TO_FILE, rec->t[METRICS_SD_DONE] - cycles);
+    } else if (stage == METRICS_SD_DONE && rec->t[METRICS_WAKE]) {
+        metrics_hist_add(METRICS_HIST_WAKE_TO_FILE, cycles - rec->t[METRICS_WAKE]);
+    }
+}
+
+void Metrics_Stamp(uint32_t seq, uint32_t stage)
+{
+    Metrics_StampAt(seq, stage, Metrics_Now());
+}
+
+void Metrics_SetBytes(uint32_t seq, uint32_t bytes)
+{
+    Metrics_FrameTypeDef *rec = &metrics_ring[seq & METRICS_RING_MASK];
+
+    if (seq != 0 && rec->seq == seq) {
+        rec->bytes = bytes;
+    }
+}
+
+void Metrics_SetEnergy(uint32_t seq, uint32_t energy_uj)
+{
+    Metrics_FrameTypeDef *rec = &metrics_ring[seq & METRICS_RING_MASK];
+
+    if (seq != 0 && rec->seq == seq) {
+        rec->energy_uj = energy_uj;
+    }
+}
+
+// Copy out the next settled record; 0 if there is none yet
+static uint8_t metrics_next(Metrics_FrameTypeDef *out)
+{
+    uint32_t newest = metrics_seq;
+    uint32_t oldest;
+    Metrics_FrameTypeDef *rec;
+
+    while (metrics_read + METRICS_SETTLE_FRAMES <= newest) {
+        // Keep clear of the slots VSYNC is about to reuse
+        oldest = (newest > METRICS_RING_LEN - METRICS_SETTLE_FRAMES) ?
+                 newest - (METRICS_RING_LEN - METRICS_SETTLE_FRAMES) : 1U;
+        if (metrics_read < oldest) {
+            metrics_lost += oldest - metrics_read;
+            metrics_read = oldest;
+        }
+
+        rec = &metrics_ring[metrics_read & METRICS_RING_MASK];
+        *out = *rec;
+        __DMB();
+        if (out->seq == metrics_read && rec->seq == metrics_read) {
+            metrics_read++;
+            return 1;
+        }
+        metrics_lost++;
+        metrics_read++;
+    }
+    return 0;
+}
+
+static const char metrics_csv_header[] =
+    "seq,kind,bytes,energy_uj,vsync_cycles,wake_us,shutter_us,frame_us,"
+    "display_start_us,display_done_us,sd_start_us,sd_done_us\n";
+
+// One CSV line; stages are microseconds from VSYNC, empty if not reached
+static int metrics_format(const Metrics_FrameTypeDef *r, char *buf, size_t size)
+{
+    uint32_t per_us = SystemCoreClock / 1000000U;
+    uint32_t t0 = r->t[METRICS_VSYNC];
+    int len;
+
+    len = snprintf(buf, size, "%lu,%s,%lu,%lu,%lu", (unsigned long)r->seq,
+                   metrics_kind_name[r->kind & 1U], (unsigned long)r->bytes,
+                   (unsigned long)r->energy_uj, (unsigned long)t0);
+    for (uint32_t s = 0; s < METRICS_NUM_STAMPS && len < (int)size; s++) {
+        if (s == METRICS_VSYNC) {
+            continue;
+        }
+        if (r->t[s] && t0) {
+            len += snprintf(buf + len, size - len, ",%ld",
+                            (long)((int32_t)(r->t[s] - t0) / (int32_t)per_us));
+        } else {
+            len += snprintf(buf + len, size - len, ",");
+        }
+    }
+    if (len < (int)size) {
+        len += snprintf(buf + len, size - len, "\n");
+    }
+    return (len < (int)size) ? len : (int)size - 1;
+}
+
+uint32_t Metrics_DumpSWO(uint32_t max)
+{
+    Metrics_FrameTypeDef rec;
+    char line[128];
+    uint32_t n = 0;
+
+    // ITM_SendChar drops characters while the port is off; keep the records
+    if ((ITM->TCR & ITM_TCR_ITMENA_Msk) == 0U || (ITM->TER & 1UL) == 0U) {
+        return 0;
+    }
+
+    while (n < max && metrics_next(&rec)) {
+        int len = metrics_format(&rec, line, sizeof(line));
+        for (int i = 0; i < len; i++) {
+            ITM_SendChar((uint32_t)line[i]);
+        }
+        n++;
+    }
+    return n;
+}
+
+FRESULT Metrics_DumpCSV(const char *path, uint32_t *count)
+{
+    Metrics_FrameTypeDef rec;
+    char line[128];
+    FIL f;
+    UINT bw;
+    FRESULT res;
+    uint32_t n = 0;
+
+    res = f_open(&f, path, FA_OPEN_APPEND | FA_WRITE);
+    if (res != FR_OK) {
+        return res;
+    }
+    if (f_size(&f) == 0) {
+        res = f_write(&f, metrics_csv_header, sizeof(metrics_csv_header) - 1, &bw);
+    }
+    while (res == FR_OK && metrics_next(&rec)) {
+        int len = metrics_format(&rec, line, sizeof(line));
+        res = f_write(&f, line, (UINT)len, &bw);
+        if (res == FR_OK && bw != (UINT)len) {
+            res = FR_DISK_ERR;
+        }
+        n++;
+    }
+    f_close(&f);
+
+    if (count != NULL) {
+        *count = n;
+    }
+    return res;
+}
+
+void Metrics_GetHistogram(uint32_t which, uint32_t bins[METRICS_HIST_BINS])
+{
+    for (uint32_t i = 0; i < METRICS_HIST_BINS; i++) {
+        bins[i] = (which < METRICS_NUM_HIST) ? metrics_hist[which][i] : 0U;
+    }
+}
+
+FRESULT Metrics_SaveHistograms(const char *path)
+{
+    char line[64];
+    FIL f;
+    UINT bw;
+    FRESULT res;
+    int len;
+
+    res = f_open(&f, path, FA_CREATE_ALWAYS | FA_WRITE);
+    if (res != FR_OK) {
+        return res;
+    }
+    len = snprintf(line, sizeof(line), "from_ms,shutter_to_file,sensor_to_glass,wake_to_file\n");
+    res = f_write(&f, line, (UINT)len, &bw);
+    for (uint32_t i = 0; i < METRICS_HIST_BINS && res == FR_OK; i++) {
+        len = snprintf(line, sizeof(line), "%lu,%lu,%lu,%lu\n",
+                       (unsigned long)(i ? 1UL << (i - 1) : 0UL),
+                       (unsigned long)metrics_hist[METRICS_HIST_SHUTTER_TO_FILE][i],
+                       (unsigned long)metrics_hist[METRICS_HIST_SENSOR_TO_GLASS][i],
+                       (unsigned long)metrics_hist[METRICS_HIST_WAKE_TO_FILE][i]);
+        res = f_write(&f, line, (UINT)len, &bw);
+    }
+    f_close(&f);
+    return res;
+}
+
+uint32_t Metrics_Lost(void)
+{
+    return metrics_lost;
+}
@@ -0,0 +1,227 @@
+#include "motion.h"
+#include "string.h"
+#include "fatfs.h"
+#include "metrics.h"
+
+#define MOTION_WORDS  (MOTION_CELLS / 4)
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+// Per-byte |a - b|: USUB8 sets the GE flag of each byte where a >= b and
+// SEL picks a - b there, b - a elsewhere
+static inline uint32_t motion_absdiff8(uint32_t a, uint32_t b)
+{
+    uint32_t ba = __USUB8(b, a);
+    uint32_t ab = __USUB8(a, b);
+
+    return __SEL(ab, ba);
+}
+
+// Bytes of x at or above the matching byte of t
+static inline uint32_t motion_count_ge8(uint32_t x, uint32_t t)
+{
+    (void)__USUB8(x, t);
+    return __USAD8(__SEL(0x01010101U, 0U), 0U);
+}
+
+#define motion_sad8(a, b)    __USAD8((a), (b))
+#define motion_havg8(a, b)   __UHADD8((a), (b))
+#else
+static inline uint32_t motion_absdiff8(uint32_t a, uint32_t b)
+{
+    uint32_t r = 0;
+
+    for (int i = 0; i < 32; i += 8) {
+        uint32_t x = (a >> i) & 0xFFU, y = (b >> i) & 0xFFU;
+
+        r |= ((x >= y) ? x - y : y - x) << i;
+    }
+    return r;
+}
+
+static inline uint32_t motion_count_ge8(uint32_t x, uint32_t t)
+{
+    uint32_t n = 0;
+
+    for (int i = 0; i < 32; i += 8) {
+        n += ((x >> i) & 0xFFU) >= ((t >> i) & 0xFFU);
+    }
+    return n;
+}
+
+static inline uint32_t motion_sad8(uint32_t a, uint32_t b)
+{
+    uint32_t d = motion_absdiff8(a, b);
+
+    return (d & 0xFFU) + ((d >> 8) & 0xFFU) + ((d >> 16) & 0xFFU) + (d >> 24);
+}
+
+static inline uint32_t motion_havg8(uint32_t a, uint32_t b)
+{
+    uint32_t r = 0;
+
+    for (int i = 0; i < 32; i += 8) {
+        r |= ((((a >> i) & 0xFFU) + ((b >> i) & 0xFFU)) >> 1) << i;
+    }
+    return r;
+}
+#endif
+
+// Word access to the grids keeps the SIMD loop on whole registers
+static uint32_t motion_grid[MOTION_WORDS];
+static uint32_t motion_bg[MOTION_WORDS];
+static uint32_t motion_norm[MOTION_WORDS];  // grid at the background's brightness
+
+static Motion_StatsTypeDef motion_stats;
+static uint8_t motion_armed;
+static uint32_t motion_warmup;      // frames left before triggers are allowed
+static uint32_t motion_last;        // tick of the last trigger
+
+void Motion_BuildGrid(const uint16_t *frame, uint16_t width, uint16_t height, uint8_t *grid)
+{
+    uint32_t cell_w = width / MOTION_GRID_W, cell_h = height / MOTION_GRID_H;
+    uint32_t samples = ((cell_w + 1) / 2) * ((cell_h + 1) / 2);
+
+    for (uint32_t gy = 0; gy < MOTION_GRID_H; gy++) {
+        for (uint32_t gx = 0; gx < MOTION_GRID_W; gx++) {
+            const uint16_t *cell = frame + gy * cell_h * width + gx * cell_w;
+            uint32_t sum = 0;
+
+            for (uint32_t y = 0; y < cell_h; y += 2) {
+                const uint16_t *row = cell + y * width;
+
+                for (uint32_t x = 0; x < cell_w; x += 2) {
+                    // Bytes arrive high first, so the halfword is swapped
+                    uint32_t px = (uint32_t)((row[x] >> 8) | (row[x] << 8)) & 0xFFFFU;
+
+                    sum += (77U * ((px >> 8) & 0xF8U) + 150U * ((px >> 3) & 0xFCU) +
+                            29U * ((px << 3) & 0xF8U)) >> 8;
+                }
+            }
+            grid[gy * MOTION_GRID_W + gx] = (uint8_t)(sum / samples);
+        }
+    }
+}
+
+uint32_t Motion_Compare(const uint8_t *grid, const uint8_t *bg, uint32_t cells,
+                        uint8_t threshold, uint32_t *sad)
+{
+    uint32_t thr = threshold * 0x01010101U;
+    uint32_t changed = 0, total = 0;
+
+    for (uint32_t i = 0; i < cells; i += 4) {
+        uint32_t a, b;
+
+        memcpy(&a, &grid[i], 4);
+        memcpy(&b, &bg[i], 4);
+        changed += motion_count_ge8(motion_absdiff8(a, b), thr);
+        total += motion_sad8(a, b);
+    }
+    if (sad != NULL) {
+        *sad = total;
+    }
+    return changed;
+}
+
+// Sum of the cells, four per USAD8
+static uint32_t motion_sum(const uint32_t *words)
+{
+    uint32_t sum = 0;
+
+    for (uint32_t i = 0; i < MOTION_WORDS; i++) {
+        sum += motion_sad8(words[i], 0U);
+    }
+    return sum;
+}
+
+// The grid scaled to the mean of the background. Exposure and gain scale
+// every cell by the same factor, also after the sensor's gamma, so a step
+// of the AE loop does not count as motion in the bright cells only.
+static void motion_normalize(void)
+{
+    uint32_t sum = motion_sum(motion_grid), bg_sum = motion_sum(motion_bg);
+    uint32_t ratio = sum ? (bg_sum * 256U + sum / 2U) / sum : 256U;    // Q8
+    const uint8_t *grid = (const uint8_t *)motion_grid;
+    uint8_t *norm = (uint8_t *)motion_norm;
+
+    for (uint32_t i = 0; i < MOTION_CELLS; i++) {
+        uint32_t v = (grid[i] * ratio + 128U) >> 8;
+
+        norm[i] = (uint8_t)(v > 255U ? 255U : v);
+    }
+}
+
+uint8_t Motion_Requested(void)
+{
+    return f_stat(MOTION_TRIGGER_FILE, NULL) == FR_OK;
+}
+
+void Motion_Arm(uint8_t on)
+{
+    motion_armed = on;
+    Motion_Start();
+}
+
+uint8_t Motion_Armed(void)
+{
+    return motion_armed;
+}
+
+void Motion_Start(void)
+{
+    motion_warmup = MOTION_WARMUP_FRAMES;
+}
+
+uint8_t Motion_Process(const uint16_t *frame)
+{
+    uint32_t start, changed;
+    uint8_t fire = 0;
+
+    if (!motion_armed) {
+        return 0;
+    }
+    start = Metrics_Now();
+    Motion_BuildGrid(frame, PREVIEW_WIDTH, PREVIEW_HEIGHT, (uint8_t *)motion_grid);
+
+    if (motion_warmup > 0) {
+        // Nothing to compare with yet: follow the scene outright
+        motion_warmup--;
+        memcpy(motion_bg, motion_grid, sizeof(motion_bg));
+        motion_stats.changed = 0;
+        motion_stats.sad = 0;
+        motion_stats.cycles = Metrics_Now() - start;
+        return 0;
+    }
+
+    motion_normalize();
+    changed = Motion_Compare((const uint8_t *)motion_norm, (const uint8_t *)motion_bg,
+                             MOTION_CELLS, MOTION_CELL_THRESHOLD, &motion_stats.sad);
+    motion_stats.changed = changed;
+
+    if (changed * 100U > MOTION_CELLS * MOTION_GLOBAL_PERCENT) {
+        // The whole scene moved (light, exposure): take it as the new background
+        memcpy(motion_bg, motion_grid, sizeof(motion_bg));
+    } else {
+        if (changed * 100U >= MOTION_CELLS * MOTION_TRIGGER_PERCENT &&
+            HAL_GetTick() - motion_last >= MOTION_HOLDOFF_MS) {
+            motion_last = HAL_GetTick();
+            motion_stats.triggers++;
+            fire = 1;
+        }
+        // Background follows slowly: repeated halving averages
+        for (uint32_t i = 0; i < MOTION_WORDS; i++) {
+            uint32_t t = motion_grid[i];
+
+            for (int s = 0; s < MOTION_BG_SHIFT; s++) {
+                t = motion_havg8(motion_bg[i], t);
+            }
+            motion_bg[i] = t;
+        }
+    }
+    motion_stats.cycles = Metrics_Now() - start;
+    return fire;
+}
+
+const Motion_StatsTypeDef *Motion_GetStats(void)
+{
+    return &motion_stats;
+}
@@ -0,0 +1,178 @@
+#include "preview.h"
+#include "dcmi.h"
+#include "camera.h"
+#include "metrics.h"
+
+// Three frames: one being filled by DMA, one complete, one held by the
+// consumer. DMA's two memory targets always point at frames nobody reads.
+#define PREVIEW_NUM_FRAMES   3
+#define PREVIEW_FRAME_BYTES  (PREVIEW_WIDTH * PREVIEW_HEIGHT * 2)
+#define PREVIEW_FRAME_WORDS  (PREVIEW_FRAME_BYTES / 4)
+
+// D2 SRAM keeps the pool out of the AXI SRAM used by the JPEG buffer
+__attribute__((section(".ram_d2"), aligned(32)))
+static uint16_t preview_frames[PREVIEW_NUM_FRAMES][PREVIEW_HEIGHT][PREVIEW_WIDTH];
+
+static int8_t preview_target[2];         // frame index behind DMA MEMORY0/MEMORY1
+static volatile int8_t preview_ready;    // newest complete frame, -1 if none
+static volatile int8_t preview_held;     // frame owned by the consumer, -1 if none
+static volatile uint32_t preview_dropped;
+static volatile uint32_t preview_seq[PREVIEW_NUM_FRAMES]; // metrics frame number per frame
+static Preview_GeometryTypeDef preview_geo;
+
+// Centred window of the sensor image that becomes the preview frame,
+// decimated 2:1 when the sensor mode is large enough
+static HAL_StatusTypeDef preview_geometry(framesize_t framesize, Preview_GeometryTypeDef *geo)
+{
+    geo->sensor_w = dvp_cam_resolution[framesize][0];
+    geo->sensor_h = dvp_cam_resolution[framesize][1];
+    geo->decimate = (geo->sensor_w >= 2 * PREVIEW_WIDTH && geo->sensor_h >= 2 * PREVIEW_HEIGHT) ? 2 : 1;
+    geo->crop_w = PREVIEW_WIDTH * geo->decimate;
+    geo->crop_h = PREVIEW_HEIGHT * geo->decimate;
+    if (geo->sensor_w < geo->crop_w || geo->sensor_h < geo->crop_h) {
+        return HAL_ERROR;
+    }
+    geo->crop_x = (geo->sensor_w - geo->crop_w) / 2;
+    geo->crop_y = (geo->sensor_h - geo->crop_h) / 2;
+    return HAL_OK;
+}
+
+// Byte/line select lives in CR, which may only change while capture is off
+static void preview_select(DCMI_HandleTypeDef *hdcmi, uint32_t bsm, uint32_t lsm)
+{
+    hdcmi->Init.ByteSelectMode = bsm;
+    hdcmi->Init.ByteSelectStart = DCMI_OEBS_ODD;
+    hdcmi->Init.LineSelectMode = lsm;
+    hdcmi->Init.LineSelectStart = DCMI_OELS_ODD;
+    MODIFY_REG(hdcmi->Instance->CR, DCMI_CR_BSM | DCMI_CR_OEBS | DCMI_CR_LSM | DCMI_CR_OELS,
+               bsm | DCMI_OEBS_ODD | lsm | DCMI_OELS_ODD);
+}
+
+// The window is counted in sensor pixel clocks (two per RGB565 pixel on
+// the 8-bit bus) and lines; byte/line select then thins what it lets
+// through. Two bytes out of four keeps whole pixels.
+static void preview_config_dcmi(DCMI_HandleTypeDef *hdcmi, const Preview_GeometryTypeDef *geo)
+{
+    if (geo->decimate == 2) {
+        preview_select(hdcmi, DCMI_BSM_ALTERNATE_2, DCMI_LSM_ALTERNATE_2);
+    } else {
+        preview_select(hdcmi, DCMI_BSM_ALL, DCMI_LSM_ALL);
+    }
+    if (geo->crop_w == geo->sensor_w && geo->crop_h == geo->sensor_h) {
+        HAL_DCMI_DisableCrop(hdcmi);
+        return;
+    }
+    HAL_DCMI_ConfigCrop(hdcmi, geo->crop_x * 2U, geo->crop_y, geo->crop_w * 2U - 1U, geo->crop_h - 1U);
+    HAL_DCMI_EnableCrop(hdcmi);
+}
+
+// DMA target-full: the finished frame becomes the ready one and the idle
+// target moves to a frame that is neither filling, ready nor held.
+static void preview_dma_xfer_cplt(DMA_HandleTypeDef *hdma)
+{
+    HAL_DMA_MemoryTypeDef idle =
+        (((DMA_Stream_TypeDef *)hdma->Instance)->CR & DMA_SxCR_CT) ? MEMORY0 : MEMORY1;
+    int8_t active = preview_target[idle == MEMORY0 ? 1 : 0];
+    int8_t done = preview_target[idle];
+    int8_t next = -1;
+
+    if (preview_ready >= 0) {
+        preview_dropped++;
+    }
+    preview_seq[done] = Metrics_CurrentFrame();
+    preview_ready = done;
+
+    for (int8_t i = 0; i < PREVIEW_NUM_FRAMES; i++) {
+        if (i != active && i != done && i != preview_held) {
+            next = i;
+            break;
+        }
+    }
+
+    // Consumer holds the only spare frame: recycle the one just finished
+    if (next < 0) {
+        next = done;
+        preview_ready = -1;
+        preview_dropped++;
+    }
+
+    if (next != done) {
+        HAL_DMAEx_ChangeMemory(hdma, (uint32_t)preview_frames[next], idle);
+    }
+    preview_target[idle] = next;
+}
+
+HAL_StatusTypeDef Preview_Start(DCMI_HandleTypeDef *hdcmi)
+{
+    if (preview_geometry(PREVIEW_FRAMESIZE, &preview_geo) != HAL_OK) {
+        return HAL_ERROR;
+    }
+    preview_config_dcmi(hdcmi, &preview_geo);
+
+    preview_target[0] = 0;
+    preview_target[1] = 1;
+    preview_ready = -1;
+    preview_held = -1;
+    preview_dropped = 0;
+
+    return DCMI_Start_DMA_DoubleBuffer(hdcmi, DCMI_MODE_CONTINUOUS,
+                                       (uint32_t)preview_frames[0], (uint32_t)preview_frames[1],
+                                       PREVIEW_FRAME_WORDS, preview_dma_xfer_cplt);
+}
+
+void Preview_ReleaseDCMI(DCMI_HandleTypeDef *hdcmi)
+{
+    preview_select(hdcmi, DCMI_BSM_ALL, DCMI_LSM_ALL);
+    HAL_DCMI_DisableCrop(hdcmi);
+}
+
+const Preview_GeometryTypeDef *Preview_GetGeometry(void)
+{
+    return &preview_geo;
+}
+
+uint16_t *Preview_AcquireFrame(void)
+{
+    uint32_t primask = __get_PRIMASK();
+    int8_t idx;
+
+    __disable_irq();
+    idx = preview_ready;
+    if (idx >= 0) {
+        preview_held = idx;
+        preview_ready = -1;
+    }
+    __set_PRIMASK(primask);
+
+    if (idx < 0) {
+        return NULL;
+    }
+
+    // Drop stale cache lines so the CPU sees what DMA wrote
+#if defined(__DCACHE_PRESENT) && (__DCACHE_PRESENT == 1U)
+    SCB_InvalidateDCache_by_Addr(preview_frames[idx], PREVIEW_FRAME_BYTES);
+#endif
+    return &preview_frames[idx][0][0];
+}
+
+void Preview_ReleaseFrame(uint16_t *frame)
+{
+    if (preview_held >= 0 && frame == &preview_frames[preview_held][0][0]) {
+        preview_held = -1;
+    }
+}
+
+uint32_t Preview_FrameSeq(const uint16_t *frame)
+{
+    for (int8_t i = 0; i < PREVIEW_NUM_FRAMES; i++) {
+        if (frame == &preview_frames[i][0][0]) {
+            return preview_seq[i];
+        }
+    }
+    return 0;
+}
+
+uint32_t Preview_DroppedFrames(void)
+{
+    return preview_dropped;
+}
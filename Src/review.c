@@ -0,0 +1,169 @@
+#include "review.h"
+#include "fatfs.h"
+#include "lcd.h"
+#include "capture.h"
+#include "metrics.h"
+#include "jpeg_walk.h"
+
+// Two bands of big-endian RGB565 LCD rows: one is filled while the other is
+// sent. In D2 SRAM, with the preview frames: SPI4's DMA1 cannot reach DTCM,
+// where the stack is, and AXI SRAM is left to the capture buffer.
+__attribute__((section(".ram_d2"), aligned(32)))
+static uint8_t review_band[2][REVIEW_BAND_ROWS * REVIEW_MAX_WIDTH * 2];
+
+// One MCU row at 1/8 scale, each component at the luma's resolution: the
+// luma from jpeg_idct_1x1, subsampled chroma scaled up by its IDCT as
+// LibJPEG does when it does not upsample
+static uint8_t review_rows[JPEG_WALK_MAX_COMPS][JPEG_WALK_MAX_SAMP][REVIEW_MAX_SRC_WIDTH];
+
+static uint32_t review_cycles;
+
+static void review_block(void *arg, uint32_t ci, uint32_t bx, uint32_t by, const int32_t *coef)
+{
+    const JPEG_WalkTypeDef *w = (const JPEG_WalkTypeDef *)arg;
+    uint32_t sw = w->hmax / w->comp[ci].h, sh = w->vmax / w->comp[ci].v;
+
+    JPEG_WalkIDCT(coef, sw, sh, &review_rows[ci][by * sh][bx * sw], REVIEW_MAX_SRC_WIDTH);
+}
+
+static uint32_t review_clamp(int32_t x)
+{
+    return (x < 0) ? 0U : (x > 255) ? 255U : (uint32_t)x;
+}
+
+// Row r of review_rows to an LCD row, taking every step'th pixel (16.16):
+// jdcolor.c's YCbCr to RGB (its tables' FIX() values, SCALEBITS 16), then
+// RGB565 as the panel takes it
+static void review_row(uint32_t r, uint32_t ncomp, uint8_t *dst, uint32_t width, uint32_t step)
+{
+    uint32_t sx = 0;
+
+    for (uint32_t x = 0; x < width; x++) {
+        uint32_t i = sx >> 16;
+        int32_t y = review_rows[0][r][i];
+        uint32_t red = (uint32_t)y, green = (uint32_t)y, blue = (uint32_t)y;
+
+        if (ncomp == 3) {
+            int32_t cb = review_rows[1][r][i] - 128, cr = review_rows[2][r][i] - 128;
+
+            red = review_clamp(y + ((91881 * cr + 32768) >> 16));
+            green = review_clamp(y + ((-22554 * cb + 32768 - 46802 * cr) >> 16));
+            blue = review_clamp(y + ((116130 * cb + 32768) >> 16));
+        }
+        dst[0] = (uint8_t)((red & 0xF8U) | (green >> 5));
+        dst[1] = (uint8_t)(((green << 3) & 0xE0U) | (blue >> 3));
+        dst += 2;
+        sx += step;
+    }
+}
+
+// Walk the scan from its first MCU row and draw band by band
+static uint8_t review_draw(JPEG_WalkTypeDef *w)
+{
+    uint32_t lcd_w = ST7735Ctx.Width;
+    uint32_t lcd_h = ST7735Ctx.Height;
+    uint32_t out_w = (w->width + 7U) / 8U;
+    uint32_t out_h = (w->height + 7U) / 8U;
+    uint32_t step, fit_h, top, rows, y = 0, n = 0, band = 0, src_y = 0;
+
+    if (lcd_w > REVIEW_MAX_WIDTH) {
+        lcd_w = REVIEW_MAX_WIDTH;
+    }
+    // Grayscale or YCbCr
+    if (w->ncomp == 2 || w->mcus_x * w->hmax > REVIEW_MAX_SRC_WIDTH) {
+        return 0;
+    }
+
+    // Fit the width; of the rows that gives, show the middle ones
+    step = (out_w << 16) / lcd_w;
+    fit_h = (out_h << 16) / step;
+    rows = (fit_h < lcd_h) ? fit_h : lcd_h;
+    top = (fit_h - rows) / 2;
+
+    while (y < rows) {
+        if (!JPEG_WalkRow(w, review_block, w)) {
+            LCD_WaitTransfer();
+            return 0;
+        }
+        // Every LCD row sampling one of this MCU row's rows
+        for (uint32_t r = 0; r < w->vmax; r++, src_y++) {
+            while (y < rows && (((top + y) * step) >> 16) == src_y) {
+                review_row(r, w->ncomp, &review_band[band][n * lcd_w * 2], lcd_w, step);
+                n++;
+                y++;
+                if (n == REVIEW_BAND_ROWS || y == rows) {
+                    // Waits for the other band, so this one is free next time
+                    LCD_FillRGBRect_DMA(0, (uint16_t)(y - n), review_band[band], (uint16_t)lcd_w,
+                                        (uint16_t)n, NULL);
+                    band ^= 1U;
+                    n = 0;
+                }
+            }
+        }
+    }
+    // The rows below the crop are not needed
+    LCD_WaitTransfer();
+    return 1;
+}
+
+uint8_t Review_ShowJPEG(const uint8_t *jpeg, uint32_t len)
+{
+    JPEG_WalkTypeDef walk;
+    uint32_t start = Metrics_Now();
+
+    if (jpeg == NULL || !JPEG_WalkStart(&walk, jpeg, len) || !review_draw(&walk)) {
+        return 0;
+    }
+    review_cycles = Metrics_Now() - start;
+    return 1;
+}
+
+static uint32_t review_read(void *arg, uint8_t *buf, uint32_t size)
+{
+    UINT n = 0;
+
+    if (f_read((FIL *)arg, buf, size, &n) != FR_OK) {
+        return 0;
+    }
+    return n;
+}
+
+uint8_t Review_ShowFile(const char *path)
+{
+    JPEG_WalkTypeDef walk;
+    FIL file;
+    uint32_t size, start = Metrics_Now();
+    uint8_t *buf, ok;
+
+    if (f_open(&file, path, FA_READ) != FR_OK) {
+        return 0;
+    }
+    buf = Capture_Buffer(&size);
+    if (size > REVIEW_READ_SIZE) {
+        size = REVIEW_READ_SIZE;
+    }
+    ok = JPEG_WalkStartRead(&walk, buf, size, review_read, &file) && review_draw(&walk);
+    f_close(&file);
+    if (ok) {
+        review_cycles = Metrics_Now() - start;
+    }
+    return ok;
+}
+
+uint8_t Review_ShowLastCapture(void)
+{
+    uint32_t len;
+    const uint8_t *jpeg = Capture_LastJPEG(&len);
+    const char *path;
+
+    if (jpeg != NULL) {
+        return Review_ShowJPEG(jpeg, len);
+    }
+    path = Capture_LastFilename();
+    return (path != NULL) ? Review_ShowFile(path) : 0;
+}
+
+uint32_t Review_LastCycles(void)
+{
+    return review_cycles;
+}
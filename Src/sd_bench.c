@@ -0,0 +1,194 @@
+#include "sd_bench.h"
+#include "stdio.h"
+#include "diskio.h"
+#include "sdmmc.h"
+#include "capture.h"
+#include "metrics.h"
+#include "sd_bus.h"
+
+typedef enum {
+    SD_BENCH_SEQ_WRITE,
+    SD_BENCH_RAND_WRITE,
+    SD_BENCH_SEQ_READ,
+    SD_BENCH_RAND_READ,
+    SD_BENCH_NUM_PATTERNS
+} sd_bench_pattern_t;
+
+typedef struct {
+    uint32_t kb_per_s;
+    uint32_t p50_us, p90_us, p99_us, max_us;
+} sd_bench_result_t;
+
+static const char *const sd_bench_pattern_name[SD_BENCH_NUM_PATTERNS] = {
+    "seq_write", "rand_write", "seq_read", "rand_read"
+};
+static const uint16_t sd_bench_sizes[] = { 1, 8, 64, SD_BENCH_MAX_SECTORS };
+
+static uint32_t sd_bench_lat[SD_BENCH_OPS];     // cycles per transfer
+static uint32_t sd_bench_seed;
+
+// xorshift32: the same "random" offsets on every run and every card
+static uint32_t sd_bench_rand(void)
+{
+    uint32_t x = sd_bench_seed;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sd_bench_seed = x;
+    return x;
+}
+
+static void sd_bench_sort(uint32_t *v, uint32_t n)
+{
+    for (uint32_t i = 1; i < n; i++) {
+        uint32_t key = v[i], j = i;
+
+        while (j > 0 && v[j - 1] > key) {
+            v[j] = v[j - 1];
+            j--;
+        }
+        v[j] = key;
+    }
+}
+
+// Time SD_BENCH_OPS transfers of n sectors inside the area [base, base + area)
+static DRESULT sd_bench_test(BYTE drv, uint8_t *buf, DWORD base, DWORD area,
+                             sd_bench_pattern_t pattern, uint32_t n, sd_bench_result_t *r)
+{
+    uint32_t per_us = SystemCoreClock / 1000000U;
+    uint32_t slots = area / n;
+    uint64_t total = 0;
+    DRESULT res;
+
+    for (uint32_t i = 0; i < SD_BENCH_OPS; i++) {
+        uint32_t slot = (pattern == SD_BENCH_SEQ_WRITE || pattern == SD_BENCH_SEQ_READ)
+                      ? i % slots : sd_bench_rand() % slots;
+        DWORD at = base + slot * n;
+        uint32_t start = Metrics_Now();
+
+        if (pattern == SD_BENCH_SEQ_WRITE || pattern == SD_BENCH_RAND_WRITE) {
+            res = disk_write(drv, buf, at, n);
+        } else {
+            res = disk_read(drv, buf, at, n);
+        }
+        sd_bench_lat[i] = Metrics_Now() - start;
+        if (res != RES_OK) {
+            return res;
+        }
+        total += sd_bench_lat[i];
+    }
+
+    sd_bench_sort(sd_bench_lat, SD_BENCH_OPS);
+    r->kb_per_s = total ? (uint32_t)((uint64_t)SD_BENCH_OPS * n * _MAX_SS * SystemCoreClock /
+                                     1024U / total) : 0U;
+    r->p50_us = sd_bench_lat[(SD_BENCH_OPS - 1) * 50 / 100] / per_us;
+    r->p90_us = sd_bench_lat[(SD_BENCH_OPS - 1) * 90 / 100] / per_us;
+    r->p99_us = sd_bench_lat[(SD_BENCH_OPS - 1) * 99 / 100] / per_us;
+    r->max_us = sd_bench_lat[SD_BENCH_OPS - 1] / per_us;
+    return RES_OK;
+}
+
+uint8_t SDBench_Requested(void)
+{
+    return f_stat(SD_BENCH_TRIGGER, NULL) == FR_OK;
+}
+
+FRESULT SDBench_Run(const char *report)
+{
+    HAL_SD_CardInfoTypeDef info;
+    sd_bench_result_t r;
+    FIL area_file, f;
+    char line[96];
+    UINT bw;
+    FRESULT res;
+    DRESULT dres = RES_OK;
+    DWORD base, area;
+    uint32_t size;
+    uint8_t *buf;
+    int len;
+
+    // One-shot: the next boot goes straight to the camera
+    f_unlink(SD_BENCH_TRIGGER);
+
+    // Raw I/O goes only where FatFs has handed out clusters
+    res = f_open(&area_file, SD_BENCH_AREA_FILE, FA_CREATE_ALWAYS | FA_WRITE);
+    if (res != FR_OK) {
+        return res;
+    }
+    res = f_expand(&area_file, SD_BENCH_AREA_SIZE, 1);
+    if (res != FR_OK) {
+        f_close(&area_file);
+        f_unlink(SD_BENCH_AREA_FILE);
+        Capture_ShowStatus("Bench: no space");
+        return res;
+    }
+    base = SDFatFS.database + (area_file.obj.sclust - 2) * SDFatFS.csize;
+    area = SD_BENCH_AREA_SIZE / _MAX_SS;
+    f_close(&area_file);
+
+    res = f_open(&f, report, FA_CREATE_ALWAYS | FA_WRITE);
+    if (res != FR_OK) {
+        f_unlink(SD_BENCH_AREA_FILE);
+        return res;
+    }
+    HAL_SD_GetCardInfo(&hsd1, &info);
+    len = snprintf(line, sizeof(line), "# card type %lu version %lu class 0x%lx, %lu blocks of %lu\n",
+                   (unsigned long)info.CardType, (unsigned long)info.CardVersion,
+                   (unsigned long)info.Class, (unsigned long)info.BlockNbr,
+                   (unsigned long)info.BlockSize);
+    res = f_write(&f, line, (UINT)len, &bw);
+    len = snprintf(line, sizeof(line), "# bus %s %lu Hz\n", SD_Bus_SpeedName(SD_Bus_GetSpeed()),
+                   (unsigned long)SD_Bus_GetClockHz());
+    if (res == FR_OK) {
+        res = f_write(&f, line, (UINT)len, &bw);
+    }
+    len = snprintf(line, sizeof(line), "test,sectors,ops,kb_per_s,p50_us,p90_us,p99_us,max_us\n");
+    if (res == FR_OK) {
+        res = f_write(&f, line, (UINT)len, &bw);
+    }
+
+    // Written data is a counting pattern so reads have something to return
+    buf = Capture_Buffer(&size);
+    for (uint32_t i = 0; i < SD_BENCH_MAX_SECTORS * _MAX_SS / 4; i++) {
+        ((uint32_t *)buf)[i] = i;
+    }
+
+    sd_bench_seed = 0x2545F491U;
+    for (uint32_t p = 0; p < SD_BENCH_NUM_PATTERNS && res == FR_OK && dres == RES_OK; p++) {
+        for (uint32_t s = 0; s < sizeof(sd_bench_sizes) / sizeof(sd_bench_sizes[0]); s++) {
+            uint32_t n = sd_bench_sizes[s];
+
+            snprintf(line, sizeof(line), "Bench %s %lu", sd_bench_pattern_name[p], (unsigned long)n);
+            Capture_ShowStatus(line);
+            dres = sd_bench_test(SDFatFS.drv, buf, base, area, (sd_bench_pattern_t)p, n, &r);
+            if (dres != RES_OK) {
+                len = snprintf(line, sizeof(line), "%s,%lu,%u,error %d\n",
+                               sd_bench_pattern_name[p], (unsigned long)n, SD_BENCH_OPS, dres);
+            } else {
+                len = snprintf(line, sizeof(line), "%s,%lu,%u,%lu,%lu,%lu,%lu,%lu\n",
+                               sd_bench_pattern_name[p], (unsigned long)n, SD_BENCH_OPS,
+                               (unsigned long)r.kb_per_s, (unsigned long)r.p50_us,
+                               (unsigned long)r.p90_us, (unsigned long)r.p99_us,
+                               (unsigned long)r.max_us);
+            }
+            res = f_write(&f, line, (UINT)len, &bw);
+            if (res != FR_OK || dres != RES_OK) {
+                break;
+            }
+        }
+    }
+    f_close(&f);
+    f_unlink(SD_BENCH_AREA_FILE);
+
+    if (res == FR_OK && dres != RES_OK) {
+        res = FR_DISK_ERR;
+    }
+    if (res == FR_OK) {
+        snprintf(line, sizeof(line), "Bench done");
+    } else {
+        snprintf(line, sizeof(line), "Bench err:%d", res);
+    }
+    Capture_ShowStatus(line);
+    return res;
+}
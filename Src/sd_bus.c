@@ -0,0 +1,146 @@
+#include "sd_bus.h"
+#include "stdio.h"
+#include "sdmmc.h"
+#include "bsp_driver_sd.h"
+#include "capture.h"
+
+#define SD_BUS_DEFAULT_HZ  25000000U
+#define SD_BUS_HIGH_HZ     50000000U
+#define SD_BUS_VERIFY_MS   100
+
+// Errors that mean the bus is running too fast for the card or wiring
+#define SD_BUS_SPEED_ERRORS (HAL_SD_ERROR_CMD_CRC_FAIL | HAL_SD_ERROR_DATA_CRC_FAIL | \
+                             HAL_SD_ERROR_TX_UNDERRUN | HAL_SD_ERROR_RX_OVERRUN)
+
+static const char *const sd_bus_names[] = { "safe", "DS", "HS" };
+
+static SD_BusSpeedTypeDef sd_bus_speed = SD_BUS_SAFE;
+static uint32_t sd_bus_safe_div;        // ClockDiv of SD_BUS_SAFE
+static uint32_t sd_bus_fallbacks;
+
+// Target for the verify read; polled, so any RAM will do
+__attribute__((aligned(4))) static uint8_t sd_bus_block[BLOCKSIZE];
+
+// Smallest divider keeping SDMMC_CK at or under 'hz' (CK = ker_ck / 2 / div)
+static uint32_t sd_bus_div_for(uint32_t hz)
+{
+    uint32_t ker = HAL_RCCEx_GetPeriphCLKFreq(RCC_PERIPHCLK_SDMMC);
+    uint32_t div = (ker + 2U * hz - 1U) / (2U * hz);
+
+    return (div < sd_bus_safe_div) ? div : sd_bus_safe_div;
+}
+
+static uint32_t sd_bus_div(SD_BusSpeedTypeDef speed)
+{
+    switch (speed) {
+    case SD_BUS_HIGH:    return sd_bus_div_for(SD_BUS_HIGH_HZ);
+    case SD_BUS_DEFAULT: return sd_bus_div_for(SD_BUS_DEFAULT_HZ);
+    default:             return sd_bus_safe_div;
+    }
+}
+
+// Set the clock for 'speed'; a card switched to High Speed may run slower
+static void sd_bus_set(SD_BusSpeedTypeDef speed)
+{
+    uint32_t div = sd_bus_div(speed);
+
+    hsd1.Init.ClockDiv = div;
+    MODIFY_REG(hsd1.Instance->CLKCR, SDMMC_CLKCR_CLKDIV, div);
+    sd_bus_speed = speed;
+}
+
+// One polled block read at the current clock
+static uint8_t sd_bus_verify(void)
+{
+    uint32_t start = HAL_GetTick();
+
+    if (HAL_SD_ReadBlocks(&hsd1, sd_bus_block, 0, 1, SD_BUS_VERIFY_MS) != HAL_OK) {
+        return 0;
+    }
+    while (HAL_SD_GetCardState(&hsd1) != HAL_SD_CARD_TRANSFER) {
+        if (HAL_GetTick() - start >= SD_BUS_VERIFY_MS) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Fastest speed up to 'max' that the card accepts and reads back cleanly
+static void sd_bus_negotiate(SD_BusSpeedTypeDef max)
+{
+    SD_BusSpeedTypeDef speed = max;
+
+    if (speed == SD_BUS_HIGH &&
+        HAL_SD_ConfigSpeedBusOperation(&hsd1, SDMMC_SPEED_MODE_HIGH) != HAL_OK) {
+        // No CMD6 High Speed function (SDSC v1.0 card)
+        speed = SD_BUS_DEFAULT;
+    }
+    for (;;) {
+        sd_bus_set(speed);
+        if (speed == SD_BUS_SAFE || sd_bus_verify()) {
+            break;
+        }
+        speed--;
+    }
+}
+
+uint8_t BSP_SD_Init(void)
+{
+    char msg[32];
+
+    if (BSP_SD_IsDetected() != SD_PRESENT) {
+        return MSD_ERROR_SD_NOT_PRESENT;
+    }
+    if (sd_bus_safe_div == 0) {
+        sd_bus_safe_div = hsd1.Init.ClockDiv;
+    }
+    hsd1.Init.ClockDiv = sd_bus_safe_div;
+    sd_bus_fallbacks = 0;
+    if (HAL_SD_Init(&hsd1) != HAL_OK ||
+        HAL_SD_ConfigWideBusOperation(&hsd1, SDMMC_BUS_WIDE_4B) != HAL_OK) {
+        return MSD_ERROR;
+    }
+
+    sd_bus_negotiate(SD_BUS_MAX_SPEED);
+    snprintf(msg, sizeof(msg), "SD %s %luMHz", sd_bus_names[sd_bus_speed],
+             (unsigned long)(SD_Bus_GetClockHz() / 1000000U));
+    Capture_ShowStatus(msg);
+    return MSD_OK;
+}
+
+uint8_t SD_Bus_Fallback(void)
+{
+    char msg[32];
+
+    if ((hsd1.ErrorCode & SD_BUS_SPEED_ERRORS) == 0U || sd_bus_speed == SD_BUS_SAFE) {
+        return 0;
+    }
+    sd_bus_set(sd_bus_speed - 1);
+    sd_bus_fallbacks++;
+    snprintf(msg, sizeof(msg), "SD CRC, %luMHz", (unsigned long)(SD_Bus_GetClockHz() / 1000000U));
+    Capture_ShowStatus(msg);
+    return 1;
+}
+
+SD_BusSpeedTypeDef SD_Bus_GetSpeed(void)
+{
+    return sd_bus_speed;
+}
+
+const char *SD_Bus_SpeedName(SD_BusSpeedTypeDef speed)
+{
+    return (speed <= SD_BUS_HIGH) ? sd_bus_names[speed] : "?";
+}
+
+uint32_t SD_Bus_GetClockHz(void)
+{
+    uint32_t div = hsd1.Init.ClockDiv;
+    uint32_t ker = HAL_RCCEx_GetPeriphCLKFreq(RCC_PERIPHCLK_SDMMC);
+
+    return div ? ker / (2U * div) : ker;
+}
+
+uint32_t SD_Bus_Fallbacks(void)
+{
+    return sd_bus_fallbacks;
+}
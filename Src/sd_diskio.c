@@ -17,8 +17,8 @@
   */
 /* USER CODE END Header */
 
-/* Note: code generation based on sd_diskio_template_bspv1.c v2.1.4
-   as "Use dma template" is disabled. */
+/* Note: code generation based on sd_diskio_dma_template_bspv1.c v2.1.4
+   as "Use dma template" is enabled. */
 
 /* USER CODE BEGIN firstSection */
 /* can be used to modify / undefine following code or add new definitions */
@@ -27,20 +27,40 @@
 /* Includes ------------------------------------------------------------------*/
 #include "ff_gen_drv.h"
 #include "sd_diskio.h"
+#include "sd_bus.h"
+
+#include <string.h>
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
-/* use the default SD timout as defined in the platform BSP driver*/
-#if defined(SDMMC_DATATIMEOUT)
-#define SD_TIMEOUT SDMMC_DATATIMEOUT
-#elif defined(SD_DATATIMEOUT)
-#define SD_TIMEOUT SD_DATATIMEOUT
-#else
+/*
+ * the following Timeout is useful to give the control back to the applications
+ * in case of errors in either BSP_SD_ReadCpltCallback() or BSP_SD_WriteCpltCallback()
+ * the value is in ms (HAL tick)
+ */
 #define SD_TIMEOUT 30 * 1000
-#endif
 
 #define SD_DEFAULT_BLOCK_SIZE 512
 
+/*
+ * when using cacheable memory region, it may be needed to maintain the cache
+ * validity. Enable the define below to activate a cache maintenance at each
+ * read and write operation.
+ * Notice: This is applicable only for cortex M7 based platform.
+ */
+/* USER CODE BEGIN enableSDDmaCacheMaintenance */
+#define ENABLE_SD_DMA_CACHE_MAINTENANCE  1
+/* USER CODE END enableSDDmaCacheMaintenance */
+
+/*
+ * Some DMA requires 4-Byte aligned address buffer to correctly read/write data,
+ * in FatFs some accesses aren't thus we need a 4-byte aligned scratch buffer to correctly
+ * transfer data
+ */
+/* USER CODE BEGIN enableScratchBuffer */
+#define ENABLE_SCRATCH_BUFFER
+/* USER CODE END enableScratchBuffer */
+
 /*
  * Depending on the use case, the SD card initialization could be done at the
  * application level: if it is the case define the flag below to disable
@@ -55,8 +75,15 @@
 /* Disk status */
 static volatile DSTATUS Stat = STA_NOINIT;
 
+static volatile  UINT  WriteStatus = 0, ReadStatus = 0;
+/* USER CODE BEGIN transferError */
+static volatile  UINT  TransferError = 0;
+/* USER CODE END transferError */
+
 /* Private function prototypes -----------------------------------------------*/
 static DSTATUS SD_CheckStatus(BYTE lun);
+static int SD_WaitFlag(volatile UINT *flag);
+static int SD_CheckStatusWithTimeout(uint32_t timeout);
 DSTATUS SD_initialize (BYTE);
 DSTATUS SD_status (BYTE);
 DRESULT SD_read (BYTE, BYTE*, DWORD, UINT);
@@ -83,10 +110,67 @@ const Diskio_drvTypeDef  SD_Driver =
 
 /* USER CODE BEGIN beforeFunctionSection */
 /* can be used to modify / undefine following code or add new code */
+#if defined(ENABLE_SCRATCH_BUFFER)
+/*
+ * SDMMC1's internal DMA only reaches AXI SRAM (not DTCM or D2 SRAM) and
+ * needs word-aligned buffers; reads additionally want whole cache lines so
+ * invalidation cannot drop neighbouring data. Anything else bounces through
+ * this buffer, several blocks per transfer to keep multi-block commands.
+ */
+#define SD_SCRATCH_BLOCKS 16
+__attribute__((aligned(32))) static uint8_t scratch[SD_SCRATCH_BLOCKS * BLOCKSIZE];
+
+#define SD_IS_DMA_REACHABLE(addr) \
+  (((uint32_t)(addr) >= D1_AXISRAM_BASE) && ((uint32_t)(addr) < (D1_AXISRAM_BASE + 0x80000U)))
+#endif /* ENABLE_SCRATCH_BUFFER */
 /* USER CODE END beforeFunctionSection */
 
 /* Private functions ---------------------------------------------------------*/
 
+/**
+  * @brief  Called while waiting for an SD DMA transfer; the CPU is free to do
+  *         other work here (it runs from inside FatFs, so it must not call it)
+  * @retval None
+  */
+__weak void SD_IdleCallback(void)
+{
+}
+
+static int SD_CheckStatusWithTimeout(uint32_t timeout)
+{
+  uint32_t timer = HAL_GetTick();
+  /* block until SDIO IP is ready again or a timeout occur */
+  while(HAL_GetTick() - timer < timeout)
+  {
+    if (BSP_SD_GetCardState() == SD_TRANSFER_OK)
+    {
+      return 0;
+    }
+    SD_IdleCallback();
+  }
+
+  return -1;
+}
+
+/* wait for the DMA completion callback; 0 on success */
+static int SD_WaitFlag(volatile UINT *flag)
+{
+  uint32_t timer = HAL_GetTick();
+
+  while((*flag == 0) && (TransferError == 0) && ((HAL_GetTick() - timer) < SD_TIMEOUT))
+  {
+    SD_IdleCallback();
+  }
+
+  if ((*flag == 0) || (TransferError != 0))
+  {
+    return -1;
+  }
+
+  *flag = 0;
+  return SD_CheckStatusWithTimeout(SD_TIMEOUT);
+}
+
 static DSTATUS SD_CheckStatus(BYTE lun)
 {
   Stat = STA_NOINIT;
@@ -144,26 +228,100 @@ DSTATUS SD_status(BYTE lun)
   * @retval DRESULT: Operation result
   */
 
-DRESULT SD_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
+static DRESULT SD_read_once(BYTE lun, BYTE *buff, DWORD sector, UINT count)
 {
   DRESULT res = RES_ERROR;
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+  uint32_t alignedAddr;
+#endif
 
-  if(BSP_SD_ReadBlocks((uint32_t*)buff,
-                       (uint32_t) (sector),
-                       count, SD_TIMEOUT) == MSD_OK)
+  /*
+   * ensure the SDCard is ready for a new operation
+   */
+
+  if (SD_CheckStatusWithTimeout(SD_TIMEOUT) < 0)
+  {
+    return res;
+  }
+
+#if defined(ENABLE_SCRATCH_BUFFER)
+  if (SD_IS_DMA_REACHABLE(buff) && !((uint32_t)buff & 0x1F))
   {
-    /* wait until the read operation is finished */
-    while(BSP_SD_GetCardState()!= MSD_OK)
+#endif
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+    /* drop lines that could otherwise be evicted over the DMA data */
+    alignedAddr = (uint32_t)buff & ~0x1F;
+    SCB_InvalidateDCache_by_Addr((uint32_t*)alignedAddr, count*BLOCKSIZE + ((uint32_t)buff - alignedAddr));
+#endif
+    ReadStatus = 0;
+    TransferError = 0;
+    if(BSP_SD_ReadBlocks_DMA((uint32_t*)buff,
+                             (uint32_t) (sector),
+                             count) == MSD_OK)
     {
+      /* Wait that the reading process is completed or a timeout occurs */
+      if (SD_WaitFlag(&ReadStatus) == 0)
+      {
+        res = RES_OK;
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+        /*
+         * the SCB_InvalidateDCache_by_Addr() requires a 32-Byte aligned address,
+         * adjust the address and the D-Cache size to invalidate accordingly.
+         */
+        alignedAddr = (uint32_t)buff & ~0x1F;
+        SCB_InvalidateDCache_by_Addr((uint32_t*)alignedAddr, count*BLOCKSIZE + ((uint32_t)buff - alignedAddr));
+#endif
+      }
     }
+#if defined(ENABLE_SCRATCH_BUFFER)
+  }
+  else
+  {
+    /* Slow path, fetch each group of blocks into the scratch buffer */
+    uint32_t n;
+
     res = RES_OK;
+    while ((count > 0) && (res == RES_OK))
+    {
+      n = (count > SD_SCRATCH_BLOCKS) ? SD_SCRATCH_BLOCKS : count;
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+      SCB_InvalidateDCache_by_Addr((uint32_t*)scratch, n * BLOCKSIZE);
+#endif
+      ReadStatus = 0;
+      TransferError = 0;
+      if ((BSP_SD_ReadBlocks_DMA((uint32_t*)scratch, (uint32_t)sector, n) != MSD_OK) ||
+          (SD_WaitFlag(&ReadStatus) != 0))
+      {
+        res = RES_ERROR;
+        break;
+      }
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+      SCB_InvalidateDCache_by_Addr((uint32_t*)scratch, n * BLOCKSIZE);
+#endif
+      memcpy(buff, scratch, n * BLOCKSIZE);
+      buff += n * BLOCKSIZE;
+      sector += n;
+      count -= n;
+    }
   }
+#endif
 
   return res;
 }
 
 /* USER CODE BEGIN beforeWriteSection */
 /* can be used to modify previous code / undefine following code / add new code */
+DRESULT SD_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
+{
+  DRESULT res = SD_read_once(lun, buff, sector, count);
+
+  /* CRC error at a raised bus clock: retry one speed lower */
+  while ((res != RES_OK) && SD_Bus_Fallback())
+  {
+    res = SD_read_once(lun, buff, sector, count);
+  }
+  return res;
+}
 /* USER CODE END beforeWriteSection */
 /**
   * @brief  Writes Sector(s)
@@ -175,20 +333,75 @@ DRESULT SD_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
   */
 #if _USE_WRITE == 1
 
-DRESULT SD_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count)
+static DRESULT SD_write_once(BYTE lun, const BYTE *buff, DWORD sector, UINT count)
 {
   DRESULT res = RES_ERROR;
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+  uint32_t alignedAddr;
+#endif
+
+  /*
+   * ensure the SDCard is ready for a new operation
+   */
+
+  if (SD_CheckStatusWithTimeout(SD_TIMEOUT) < 0)
+  {
+    return res;
+  }
 
-  if(BSP_SD_WriteBlocks((uint32_t*)buff,
-                        (uint32_t)(sector),
-                        count, SD_TIMEOUT) == MSD_OK)
+#if defined(ENABLE_SCRATCH_BUFFER)
+  if (SD_IS_DMA_REACHABLE(buff) && !((uint32_t)buff & 0x3))
   {
-	/* wait until the Write operation is finished */
-    while(BSP_SD_GetCardState() != MSD_OK)
+#endif
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+    /*
+     * the SCB_CleanDCache_by_Addr() requires a 32-Byte aligned address
+     * adjust the address and the D-Cache size to clean accordingly.
+     */
+    alignedAddr = (uint32_t)buff & ~0x1F;
+    SCB_CleanDCache_by_Addr((uint32_t*)alignedAddr, count*BLOCKSIZE + ((uint32_t)buff - alignedAddr));
+#endif
+    WriteStatus = 0;
+    TransferError = 0;
+    if(BSP_SD_WriteBlocks_DMA((uint32_t*)buff,
+                              (uint32_t)(sector),
+                              count) == MSD_OK)
     {
+      /* Wait that writing process is completed or a timeout occurs */
+      if (SD_WaitFlag(&WriteStatus) == 0)
+      {
+        res = RES_OK;
+      }
     }
+#if defined(ENABLE_SCRATCH_BUFFER)
+  }
+  else
+  {
+    /* Slow path, stage each group of blocks in the scratch buffer */
+    uint32_t n;
+
     res = RES_OK;
+    while ((count > 0) && (res == RES_OK))
+    {
+      n = (count > SD_SCRATCH_BLOCKS) ? SD_SCRATCH_BLOCKS : count;
+      memcpy(scratch, buff, n * BLOCKSIZE);
+#if (ENABLE_SD_DMA_CACHE_MAINTENANCE == 1)
+      SCB_CleanDCache_by_Addr((uint32_t*)scratch, n * BLOCKSIZE);
+#endif
+      WriteStatus = 0;
+      TransferError = 0;
+      if ((BSP_SD_WriteBlocks_DMA((uint32_t*)scratch, (uint32_t)sector, n) != MSD_OK) ||
+          (SD_WaitFlag(&WriteStatus) != 0))
+      {
+        res = RES_ERROR;
+        break;
+      }
+      buff += n * BLOCKSIZE;
+      sector += n;
+      count -= n;
+    }
   }
+#endif
 
   return res;
 }
@@ -196,6 +409,19 @@ DRESULT SD_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count)
 
 /* USER CODE BEGIN beforeIoctlSection */
 /* can be used to modify previous code / undefine following code / add new code */
+#if _USE_WRITE == 1
+DRESULT SD_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count)
+{
+  DRESULT res = SD_write_once(lun, buff, sector, count);
+
+  /* CRC error at a raised bus clock: retry one speed lower */
+  while ((res != RES_OK) && SD_Bus_Fallback())
+  {
+    res = SD_write_once(lun, buff, sector, count);
+  }
+  return res;
+}
+#endif /* _USE_WRITE == 1 */
 /* USER CODE END beforeIoctlSection */
 /**
   * @brief  I/O control operation
@@ -252,6 +478,46 @@ DRESULT SD_ioctl(BYTE lun, BYTE cmd, void *buff)
 /* can be used to modify previous code / undefine following code / add new code */
 /* USER CODE END afterIoctlSection */
 
+/* USER CODE BEGIN callbackSection */
+/* can be used to modify / following code or add code */
+/* USER CODE END callbackSection */
+/**
+  * @brief Tx Transfer completed callback
+  * @param hsd: SD handle
+  * @retval None
+  */
+void BSP_SD_WriteCpltCallback(void)
+{
+
+  WriteStatus = 1;
+}
+
+/**
+  * @brief Rx Transfer completed callback
+  * @param hsd: SD handle
+  * @retval None
+  */
+void BSP_SD_ReadCpltCallback(void)
+{
+  ReadStatus = 1;
+}
+
+/* USER CODE BEGIN ErrorAbortCallbacks */
+/**
+  * @brief SD transfer error or abort: release whoever is waiting
+  * @retval None
+  */
+void BSP_SD_ErrorCallback(void)
+{
+  TransferError = 1;
+}
+
+void BSP_SD_AbortCallback(void)
+{
+  TransferError = 1;
+}
+/* USER CODE END ErrorAbortCallbacks */
+
 /* USER CODE BEGIN lastSection */
 /* can be used to modify / undefine previous code or add new code */
 /* USER CODE END lastSection */
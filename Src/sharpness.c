@@ -0,0 +1,127 @@
+#include "sharpness.h"
+#include "jpeg_walk.h"
+#include "string.h"
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+// Laplacian of the pixels in the low bytes of the two halfwords (UXTB16),
+// added to the sums. 4c and the neighbour sum stay below 1021, so neither
+// crosses into the other lane.
+static inline void sharp_lap2(uint32_t c, uint32_t n, uint32_t s, uint32_t w, uint32_t e,
+                              int64_t *sum2, int32_t *sum)
+{
+    uint32_t nbr = __UADD16(__UADD16(__UXTB16(n), __UXTB16(s)),
+                            __UADD16(__UXTB16(w), __UXTB16(e)));
+    uint32_t lap = __SSUB16(__UXTB16(c) << 2, nbr);
+
+    *sum2 = (int64_t)__SMLALD(lap, lap, (uint64_t)*sum2);
+    *sum = (int32_t)__SMLAD(lap, 0x00010001U, (uint32_t)*sum);
+}
+#endif
+
+void Sharpness_AccumulateRow(const uint8_t *up, const uint8_t *row, const uint8_t *down,
+                             uint32_t width, Sharpness_AccTypeDef *acc)
+{
+    int64_t sum2 = acc->sum2;
+    int32_t sum = acc->sum;
+    uint32_t x = 1;
+
+    if (width < 3) {
+        return;
+    }
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+    for (; x + 4 < width; x += 4) {
+        uint32_t c, n, s, w, e;
+
+        memcpy(&c, row + x, 4);
+        memcpy(&n, up + x, 4);
+        memcpy(&s, down + x, 4);
+        memcpy(&w, row + x - 1, 4);
+        memcpy(&e, row + x + 1, 4);
+        // Bytes 0 and 2, then 1 and 3
+        sharp_lap2(c, n, s, w, e, &sum2, &sum);
+        sharp_lap2(__ROR(c, 8), __ROR(n, 8), __ROR(s, 8), __ROR(w, 8), __ROR(e, 8),
+                   &sum2, &sum);
+    }
+#endif
+    for (; x + 1 < width; x++) {
+        int32_t lap = 4 * row[x] - up[x] - down[x] - row[x - 1] - row[x + 1];
+
+        sum2 += lap * lap;
+        sum += lap;
+    }
+    acc->sum2 = sum2;
+    acc->sum = sum;
+    acc->count += width - 2;
+}
+
+uint32_t Sharpness_Variance(const Sharpness_AccTypeDef *acc)
+{
+    int64_t n = acc->count;
+
+    if (n == 0) {
+        return 0;
+    }
+    return (uint32_t)((acc->sum2 - (int64_t)acc->sum * acc->sum / n) / n);
+}
+
+uint32_t Sharpness_Luma(const uint8_t *luma, uint32_t width, uint32_t height, uint32_t stride)
+{
+    Sharpness_AccTypeDef acc = { 0, 0, 0 };
+
+    for (uint32_t y = 1; y + 1 < height; y++) {
+        const uint8_t *row = luma + y * stride;
+
+        Sharpness_AccumulateRow(row - stride, row, row + stride, width, &acc);
+    }
+    return Sharpness_Variance(&acc);
+}
+
+
+// 2x2 IDCT output rows of one MCU row of luma, after the last two of the
+// one above
+static uint8_t sharp_rows[2 + 2 * JPEG_WALK_MAX_SAMP][SHARPNESS_MAX_WIDTH];
+
+// jpeg_idct_2x2 on each luma block; the chroma is only walked past
+static void sharp_block(void *arg, uint32_t ci, uint32_t bx, uint32_t by, const int32_t *coef)
+{
+    (void)arg;
+    if (ci == 0) {
+        JPEG_WalkIDCT(coef, 2, 2, &sharp_rows[2 + 2 * by][2 * bx], SHARPNESS_MAX_WIDTH);
+    }
+}
+
+uint8_t Sharpness_ScoreJPEG(const uint8_t *jpeg, uint32_t len, uint32_t *score)
+{
+    Sharpness_AccTypeDef acc = { 0, 0, 0 };
+    JPEG_WalkTypeDef walk;
+    uint32_t out_w, out_h, band, y = 0;
+
+    if (!JPEG_WalkStart(&walk, jpeg, len)) {
+        return 0;
+    }
+    // LibJPEG's output size at 1/4
+    out_w = (walk.width + 3U) / 4U;
+    out_h = (walk.height + 3U) / 4U;
+    band = 2U * walk.vmax;
+    if (walk.mcus_x * walk.hmax * 2U > SHARPNESS_MAX_WIDTH) {
+        return 0;
+    }
+
+    while (y < out_h) {
+        if (!JPEG_WalkRow(&walk, sharp_block, NULL)) {
+            return 0;
+        }
+        // The band's rows, each scored once the one below it is in
+        for (uint32_t r = 0; r < band && y < out_h; r++, y++) {
+            if (y >= 2) {
+                Sharpness_AccumulateRow(sharp_rows[r], sharp_rows[r + 1], sharp_rows[r + 2],
+                                        out_w, &acc);
+            }
+        }
+        memcpy(sharp_rows[0], sharp_rows[band], sizeof(sharp_rows[0]));
+        memcpy(sharp_rows[1], sharp_rows[band + 1], sizeof(sharp_rows[1]));
+    }
+
+    *score = Sharpness_Variance(&acc);
+    return 1;
+}
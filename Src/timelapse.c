@@ -0,0 +1,195 @@
+#include "timelapse.h"
+#include "stdio.h"
+#include "dcmi.h"
+#include "lptim.h"
+#include "fatfs.h"
+#include "camera.h"
+#include "lcd.h"
+#include "ae_awb.h"
+#include "metrics.h"
+
+static Timelapse_StatsTypeDef tl_stats;
+static uint32_t tl_interval_ms;     // 0 while off
+static uint8_t tl_started;          // a photo has been taken since arming
+static uint32_t tl_shot_tick;       // tick the last photo was started at
+static uint32_t tl_wake_cycles;     // cycle count on leaving Stop for it
+static uint32_t tl_cycle_tick;      // tick the last saved photo finished at
+static uint32_t tl_slept_ms;        // Stop time since then
+static volatile uint8_t tl_alarm;
+
+// LPTIM1 reached its autoreload: the sleep is over
+void HAL_LPTIM_AutoReloadMatchCallback(LPTIM_HandleTypeDef *hlptim)
+{
+    if (hlptim->Instance == LPTIM1) {
+        tl_alarm = 1;
+    }
+}
+
+// Stop mode turns off every PLL. PLL2 (the SDMMC1 kernel clock, set up in
+// HAL_SD_MspInit) and PLL3 keep their dividers, so the ones that were running
+// only need switching back on; SystemClock_Config() restores just PLL1.
+static void timelapse_resume_plls(uint32_t plls)
+{
+    SET_BIT(RCC->CR, plls);
+    if (plls & RCC_CR_PLL2ON) {
+        while (__HAL_RCC_GET_FLAG(RCC_FLAG_PLL2RDY) == RESET) {}
+    }
+    if (plls & RCC_CR_PLL3ON) {
+        while (__HAL_RCC_GET_FLAG(RCC_FLAG_PLL3RDY) == RESET) {}
+    }
+}
+
+// One Stop mode stretch of at most 'ms' (up to 65535 LPTIM ticks, about
+// 4 minutes); returns the time slept. Other interrupts may wake the CPU on
+// the way, it goes straight back to Stop until the alarm.
+static uint32_t timelapse_stop(uint32_t ms)
+{
+    uint32_t ticks = (uint32_t)((uint64_t)ms * LPTIM1_TICK_HZ / 1000U);
+    uint32_t plls = RCC->CR & (RCC_CR_PLL2ON | RCC_CR_PLL3ON);
+
+    if (ticks > 0xFFFFU) {
+        ticks = 0xFFFFU;
+    }
+    if (ticks < 2U) {
+        return 0;
+    }
+    tl_alarm = 0;
+    if (HAL_LPTIM_Counter_Start_IT(&hlptim1, ticks) != HAL_OK) {
+        return 0;
+    }
+    HAL_SuspendTick();
+    while (!tl_alarm) {
+        HAL_PWR_EnterSTOPMode(PWR_LOWPOWERREGULATOR_ON, PWR_STOPENTRY_WFI);
+    }
+    // Stop mode leaves the CPU on HSI with the PLLs (and XCLK on MCO1) off
+    SystemClock_Config();
+    timelapse_resume_plls(plls);
+    HAL_ResumeTick();
+    HAL_LPTIM_Counter_Stop_IT(&hlptim1);
+
+    // SysTick did not count while stopped
+    ms = ticks * 1000U / LPTIM1_TICK_HZ;
+    uwTick += ms;
+    return ms;
+}
+
+// Microjoules for 'run_ms' awake and 'stop_ms' in Stop mode
+static uint32_t timelapse_energy_uj(uint32_t run_ms, uint32_t stop_ms)
+{
+    // mV * uA * ms = pJ
+    uint64_t pj = (uint64_t)TIMELAPSE_SUPPLY_MV *
+                  ((uint64_t)TIMELAPSE_RUN_MA * 1000U * run_ms +
+                   (uint64_t)TIMELAPSE_STOP_UA * stop_ms);
+
+    return (uint32_t)(pj / 1000000U);
+}
+
+uint32_t Timelapse_Requested(void)
+{
+    FIL f;
+    char line[16];
+    unsigned long s;
+
+    if (f_open(&f, TIMELAPSE_TRIGGER_FILE, FA_READ) != FR_OK) {
+        return 0;
+    }
+    if (f_gets(line, sizeof(line), &f) == NULL || sscanf(line, "%lu", &s) != 1 || s == 0) {
+        s = TIMELAPSE_INTERVAL_S;
+    }
+    f_close(&f);
+    if (s > TIMELAPSE_MAX_INTERVAL_S) {
+        s = TIMELAPSE_MAX_INTERVAL_S;
+    }
+    return (s < TIMELAPSE_MIN_INTERVAL_S) ? TIMELAPSE_MIN_INTERVAL_S : (uint32_t)s;
+}
+
+void Timelapse_Arm(uint32_t interval_s)
+{
+    tl_interval_ms = interval_s * 1000U;
+    tl_started = 0;
+    tl_slept_ms = 0;
+    tl_cycle_tick = HAL_GetTick();
+    if (!tl_interval_ms) {
+        return;
+    }
+    // Nobody is watching: no backlight, no panel, and no preview for the
+    // exposure loop to work from
+    LCD_SetBrightness(0);
+    ST7735_LCD_Driver.DisplayOff(&st7735_pObj);
+    AeAwb_Suspend(1);
+}
+
+uint8_t Timelapse_Armed(void)
+{
+    return tl_interval_ms != 0;
+}
+
+void Timelapse_Sleep(void)
+{
+    uint32_t elapsed = HAL_GetTick() - tl_shot_tick;
+    uint32_t left = (tl_started && elapsed < tl_interval_ms) ? tl_interval_ms - elapsed : 0;
+
+    tl_wake_cycles = 0;
+    if (left >= TIMELAPSE_WARMUP_MS + TIMELAPSE_MIN_SLEEP_MS) {
+        uint32_t sleep = left - TIMELAPSE_WARMUP_MS;
+
+        // The sensor keeps its registers (still in JPEG mode) in standby,
+        // so waking it needs no reload
+        HAL_DCMI_Stop(&hdcmi);
+        Camera_Standby_Device(1);
+
+        while (sleep >= TIMELAPSE_MIN_SLEEP_MS) {
+            uint32_t ms = timelapse_stop(sleep);
+
+            if (ms == 0) {
+                break;
+            }
+            tl_slept_ms += ms;
+            sleep = (ms < sleep) ? sleep - ms : 0;
+        }
+        tl_wake_cycles = Metrics_Now();
+
+        Camera_Standby_Device(0);
+        elapsed = HAL_GetTick() - tl_shot_tick;
+        left = (elapsed < tl_interval_ms) ? tl_interval_ms - elapsed : 0;
+    }
+    // What is left (sensor warm-up included) is waited out awake
+    if (tl_started && left) {
+        HAL_Delay(left);
+    }
+    if (!tl_wake_cycles) {
+        tl_wake_cycles = Metrics_Now();
+    }
+    tl_shot_tick = HAL_GetTick();
+    tl_started = 1;
+}
+
+void Timelapse_ShotDone(uint8_t saved)
+{
+    uint32_t now = HAL_GetTick(), seq = Metrics_LastFrame();
+    uint32_t per_ms = SystemCoreClock / 1000U;
+    uint32_t run_ms;
+
+    if (!saved) {
+        // Its time and energy go to the next photo that is saved
+        return;
+    }
+    run_ms = now - tl_cycle_tick;
+    run_ms = (run_ms > tl_slept_ms) ? run_ms - tl_slept_ms : 0;
+
+    tl_stats.shots++;
+    tl_stats.sleep_ms = tl_slept_ms;
+    tl_stats.run_ms = run_ms;
+    tl_stats.wake_to_file_ms = (Metrics_Now() - tl_wake_cycles) / per_ms;
+    tl_stats.energy_uj = timelapse_energy_uj(run_ms, tl_slept_ms);
+    Metrics_StampAt(seq, METRICS_WAKE, tl_wake_cycles);
+    Metrics_SetEnergy(seq, tl_stats.energy_uj);
+
+    tl_cycle_tick = now;
+    tl_slept_ms = 0;
+}
+
+const Timelapse_StatsTypeDef *Timelapse_GetStats(void)
+{
+    return &tl_stats;
+}